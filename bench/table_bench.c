@@ -0,0 +1,143 @@
+// Microbenchmark for vm/table.c: times global-style lookups and inserts
+// against the linear-probing table it replaced, which is kept below.
+//
+//     cmake -DBUILD_BENCHMARKS=ON .. && make table_bench && ./table_bench
+
+#define _POSIX_C_SOURCE 200809L
+#include "vm/table.h"
+#include "utils/hash.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define KEY_COUNTS 4
+#define LOOKUPS 4000000
+
+
+// The previous table: modulo indexing, a hash and strcmp per probe
+
+typedef struct {
+    char* key;
+    Value value;
+} OldEntry;
+
+typedef struct {
+    int count;
+    int capacity;
+    OldEntry* entries;
+} OldTable;
+
+
+static OldEntry* old_find_entry(OldEntry* entries, int capacity, const char* key) {
+    uint32_t index = hash_string(key, (int)strlen(key)) % capacity;
+    for (;;) {
+        OldEntry* entry = &entries[index];
+        if (entry->key == NULL || strcmp(entry->key, key) == 0) return entry;
+        index = (index + 1) % capacity;
+    }
+}
+
+
+static void old_table_set(OldTable* table, const char* key, Value value) {
+    if (table->count + 1 > table->capacity * 0.75) {
+        int capacity = table->capacity < 8 ? 8 : table->capacity * 2;
+        OldEntry* entries = calloc(capacity, sizeof(OldEntry));
+        for (int i = 0; i < table->capacity; i++) {
+            OldEntry* entry = &table->entries[i];
+            if (entry->key) *old_find_entry(entries, capacity, entry->key) = *entry;
+        }
+        free(table->entries);
+        table->entries = entries;
+        table->capacity = capacity;
+    }
+
+    OldEntry* entry = old_find_entry(table->entries, table->capacity, key);
+    if (entry->key == NULL) {
+        entry->key = strdup(key);
+        table->count++;
+    }
+    entry->value = value;
+}
+
+
+static bool old_table_get(OldTable* table, const char* key, Value* value) {
+    if (table->count == 0) return false;
+    OldEntry* entry = old_find_entry(table->entries, table->capacity, key);
+    if (entry->key == NULL) return false;
+    *value = entry->value;
+    return true;
+}
+
+
+static void old_free_table(OldTable* table) {
+    for (int i = 0; i < table->capacity; i++) free(table->entries[i].key);
+    free(table->entries);
+}
+
+
+static double now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+
+// Names shaped like the globals of a program: builtins and user definitions
+static char** make_keys(int count) {
+    char** keys = malloc(sizeof(char*) * count);
+    for (int i = 0; i < count; i++) {
+        char name[32];
+        snprintf(name, sizeof(name), "%s-%d", i % 3 ? "user-procedure" : "list", i);
+        keys[i] = strdup(name);
+    }
+    return keys;
+}
+
+
+static void bench(int count) {
+    char** keys = make_keys(count);
+    Value value;
+    double sink = 0;
+
+    double start = now();
+    Table table;
+    init_table(&table);
+    for (int i = 0; i < count; i++) table_set(&table, keys[i], NUMBER_VAL(i));
+    double new_insert = now() - start;
+
+    start = now();
+    for (int i = 0; i < LOOKUPS; i++) {
+        if (table_get(&table, keys[i % count], &value)) sink += AS_NUMBER(value);
+    }
+    double new_lookup = now() - start;
+
+    start = now();
+    OldTable old = {0, 0, NULL};
+    for (int i = 0; i < count; i++) old_table_set(&old, keys[i], NUMBER_VAL(i));
+    double old_insert = now() - start;
+
+    start = now();
+    for (int i = 0; i < LOOKUPS; i++) {
+        if (old_table_get(&old, keys[i % count], &value)) sink -= AS_NUMBER(value);
+    }
+    double old_lookup = now() - start;
+
+    printf("%8d keys   insert %8.1f / %8.1f ns   lookup %6.1f / %6.1f ns   (new / old)%s\n",
+           count,
+           new_insert * 1e9 / count, old_insert * 1e9 / count,
+           new_lookup * 1e9 / LOOKUPS, old_lookup * 1e9 / LOOKUPS,
+           sink == 0 ? "" : "  mismatch");
+
+    free_table(&table);
+    old_free_table(&old);
+    for (int i = 0; i < count; i++) free(keys[i]);
+    free(keys);
+}
+
+
+int main(void) {
+    static const int counts[KEY_COUNTS] = {64, 1000, 50000, 1000000};
+    for (int i = 0; i < KEY_COUNTS; i++) bench(counts[i]);
+    return 0;
+}
@@ -6,25 +6,47 @@
 #include "../vm/value.h"  // Use VM's ValueType as single source of truth
 #include "symbol_table.h"
 
-#define MAX_BUILTINS 50
+#define MAX_BUILTINS 256
 
 typedef struct {
     const char* name;
     int min_arity;      // Minimum number of arguments (-1 for special handling)
     int max_arity;      // Maximum number of arguments (-1 for unlimited)
     ValueType arg_type; // Expected type for arguments (VAL_ANY for mixed)
+    ValueType result_type; // Type of every result (VAL_ANY if it varies)
 } BuiltinInfo;
 
+// The function whose body is being analyzed. It hands out local slots and
+// collects what the function captures; codegen emits both as they are.
+typedef struct FunctionState {
+    struct FunctionState* enclosing;
+    int depth;
+    int local_count;
+    int capture_count;
+    bool is_let;        // Called where it is made, so it cannot outlive its captures
+    Capture captures[UINT8_MAX + 1];
+} FunctionState;
+
 typedef struct Analyzer {
     Scope* current_scope;
+    FunctionState* function;    // NULL at top level
     Token* builtin_tokens[MAX_BUILTINS]; 
     int builtin_token_count;
+    Arena arena;        // Builtin tokens outlive any one compilation unit
+    Scanner* scanner;   // Names are interned in the parser's table
+    ErrorContext* errors;
 } Analyzer;
 
-Analyzer* init_analyzer();
+// Shares the parser's interned names and error context
+Analyzer* init_analyzer(Parser* p);
 
 void free_analyzer(Analyzer* a);
 
+// Makes a global defined outside Scheme (e.g. a native) known to later code
+void declare_global(Analyzer* a, const char* name);
+
+// Also annotates every identifier with its binding, and every form that
+// creates a function with its captures, in the parser's arena
 bool analyze_ast(Analyzer* a,AstNode* root);
 
 #endif // ANALYZER_H
\ No newline at end of file
@@ -3,6 +3,7 @@
 
 #include <stdbool.h>
 #include "../scanner/token.h"
+#include "../vm/value.h"
 
 typedef enum {
     SYMBOL_DECLARED,
@@ -10,9 +11,20 @@ typedef enum {
 } SymbolState;
 
 
+// Borrows the interned name from the token. The scanner's intern table owns
+// it, not the unit's arena, so scopes that outlive a compilation unit (the
+// global scope) stay valid until the scanner is freed.
 typedef struct Symbol {
-    Token* token;
+    const char* name;
+    uint32_t id;
+    uint32_t hash;
     SymbolState state;
+    int depth;          // Nesting depth of the function binding it; 0 is global
+    int slot;           // Local slot in that function, or -1 for globals
+    ValueType type;     // Proven type of a local's value, VAL_ANY for globals
+    ValueType return_type;
+    int uses;           // References resolved to it so far
+    bool captured;      // A local captured by a nested function other than a let's
     struct Symbol* next;
 } Symbol;
 
@@ -29,7 +41,8 @@ Scope* init_scope(Scope* parent);
 
 void free_scope(Scope* s);
 
-bool add_symbol(Scope* s, Token* t);
+// Adds a global; the analyzer assigns local slots itself
+Symbol* add_symbol(Scope* s, Token* t);
 
 Symbol* find_symbol(Scope* s, Token* t);
 
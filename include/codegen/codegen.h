@@ -7,34 +7,24 @@
 #include <stdint.h>
 
 
-typedef struct {
-    const char* name;
-    int depth;
-    bool is_captured;
-} Local;
-
-typedef struct {
-    uint8_t index;
-    bool is_local;
-} Upvalue;
-
-
 typedef struct Compiler {
     struct Compiler* enclosing;
     ObjFunction* function;
-
-    Local locals[UINT8_MAX + 1];
-    uint8_t local_count;
-    Upvalue upvalues[UINT8_MAX + 1];
-    uint8_t scope_depth;
+    Arena* arena;       // Compilation-unit arena for temporary AST nodes
+    ErrorContext* errors;
+    int loop_start;     // Where a loop's jumps go back to, or -1 outside a loop
+    int let_slots;      // Slots of inlined lets, above the loop's own, that a jump drops
 } Compiler;
 
 
+// The returned bytecode owns copies of every string it references, so the
+// arena holding the AST can be released as soon as these return.
 // For REPL
-Bytecode* compile(AstNode* node);
-Bytecode* compile_program(AstNode** nodes, int count);
+Bytecode* compile(Arena* arena, ErrorContext* errors, AstNode* node);
+Bytecode* compile_program(Arena* arena, ErrorContext* errors, AstNode** nodes, int count);
 
-// For interpreting
+// For interpreting. Variables are emitted as the analyzer resolved them,
+// so node must have been through analyze_ast.
 void codegen_expr(Compiler* compiler, AstNode* node);
 
 #endif // CODEGEN_H
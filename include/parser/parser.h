@@ -3,10 +3,18 @@
 
 #include <stdio.h>
 #include "../scanner/token.h"
+#include "../scanner/scanner.h"
+#include "../utils/arena.h"
+#include "../utils/error.h"
+#include "../vm/value.h"
 #include <stdbool.h>
+#include <stdint.h>
 
 typedef struct {
     FILE* file;
+    Arena* arena;       // Owns every token and node of the compilation unit
+    ErrorContext* errors;
+    Scanner scanner;
     Token* current;
     Token* next;
     bool panic_mode;
@@ -18,6 +26,20 @@ typedef enum {
     NODE_NIL
 } NodeType;
 
+// Where the value of an identifier lives, as resolved by the analyzer
+typedef enum {
+    BINDING_NONE,       // Not a variable reference, or not analyzed
+    BINDING_GLOBAL,     // Looked up by name in the VM's globals
+    BINDING_LOCAL,      // Stack slot of the current function
+    BINDING_UPVALUE,    // Upvalue of the current function
+} BindingKind;
+
+// One variable captured by a function, in the order of its upvalues
+typedef struct {
+    uint8_t index;      // Slot or upvalue index in the enclosing function
+    bool is_local;      // True if index is a local slot there
+} Capture;
+
 typedef struct ast_node {
     NodeType type;
     Token* token;
@@ -25,11 +47,25 @@ typedef struct ast_node {
     struct ast_node* cdr;
     int line;      // Source line number
     int column;    // Source column number
+
+    // Filled in by the analyzer for codegen
+    BindingKind binding;    // Identifier references
+    int slot;               // Local slot or upvalue index; for named let and do,
+                            // the slot holding the loop's own closure, or -1
+    bool loop_jump;         // A tail call of a named let, or a do's next
+                            // iteration, compiled as a backward jump
+    bool inlined;           // A let in tail position of a named let, whose
+                            // variables take slots in the loop's function
+    Capture* captures;      // Forms that create a function (lambda, define, let)
+    int capture_count;
+    ValueType value_type;   // Proven type of the value, or VAL_ANY
+    ValueType return_type;  // Of a call, when value_type is VAL_PROCEDURE
 } AstNode;
 
 
-Parser* init_parser(FILE* file);
-void free_parser(Parser* p);
+Parser* init_parser(FILE* file, Arena* arena, ErrorContext* errors);
+void free_parser(Parser* p);     // Also releases the scanner and its source
+void reset_parser(Parser* p);   // Re-primes the lookahead after scan_text
 Token* peek(Parser* p);
 Token* advance(Parser* p);
 bool match(Parser* p, TokenType type);
@@ -38,10 +74,15 @@ Token* expect(Parser* p, TokenType type);
 AstNode* parse_expression(Parser* p);
 AstNode* parse_list(Parser* p);
 AstNode* parse_atom(Parser* p);
-void free_ast(AstNode* node);
+
+// Resets the arena once the parsed forms are compiled. The lookahead
+// tokens already scanned for the next form are carried over.
+void release_parsed(Parser* p);
 
 // Helper: get the nth argument (0-based) from a cons-cell argument list
 AstNode* get_arg(AstNode* args, int n);
-AstNode* create_nil_node();
+
+// Every list ends in this one shared, never-freed node
+AstNode* nil_node(void);
 
 #endif
\ No newline at end of file
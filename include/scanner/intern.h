@@ -0,0 +1,35 @@
+#ifndef INTERN_H
+#define INTERN_H
+
+#include <stdint.h>
+#include "token.h"
+
+// Id 0 is never handed out, so tokens can use it for "not a symbol"
+#define NO_SYMBOL 0
+
+typedef struct InternedSymbol {
+    char* name;         // NUL-terminated copy owned by the table
+    uint32_t length;
+    uint32_t hash;
+    uint32_t id;
+    TokenType type;     // Keyword type, or TOKEN_IDENTIFIER
+} InternedSymbol;
+
+typedef struct {
+    InternedSymbol* symbols;    // Indexed by id
+    int32_t count;
+    int32_t capacity;
+
+    uint32_t* slots;            // Open addressing over ids, 0 = empty
+    int32_t slot_capacity;      // Always a power of two
+} InternTable;
+
+void init_intern_table(InternTable* table);
+void free_intern_table(InternTable* table);
+
+// Returns the unique entry for chars[0..length), adding it on first sight.
+// The pointer is only valid until the next intern_symbol call.
+const InternedSymbol* intern_symbol(InternTable* table, const char* chars, uint32_t length, uint32_t hash);
+const InternedSymbol* get_interned(InternTable* table, uint32_t id);
+
+#endif // INTERN_H
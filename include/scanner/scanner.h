@@ -3,10 +3,38 @@
 
 #include <stdio.h>
 #include "token.h"
+#include "intern.h"
+#include "../utils/buffer.h"
+#include "../utils/error.h"
+
+// Everything one scan needs. A scanner is owned by its parser, so separate
+// front ends never share state.
+typedef struct {
+    SourceBuffer source;
+    InternTable interner;   // Identifier names are interned once; tokens share the table's copy
+    Arena* arena;           // Tokens are allocated from the caller's compilation-unit arena
+    ErrorContext* errors;
+
+    // Cursor over the loaded source. The scanner walks these pointers directly.
+    const char* current;
+    const char* line_start;
+    uint32_t line;
+} Scanner;
 
 // Scanner functions
-void init_scanner(FILE *file);
-void cleanup_scanner(void);
-Token* next_token(void);
+void init_scanner(Scanner* s, FILE *file, Arena* token_arena, ErrorContext* errors);
+void cleanup_scanner(Scanner* s);
+
+// Points the scanner at new text, keeping interned names (REPL entries)
+void scan_text(Scanner* s, const char* text, size_t length);
+Token* next_token(Scanner* s);
+
+// Position tracking
+uint32_t get_current_line(const Scanner* s);
+uint32_t get_current_column(const Scanner* s);
+uint32_t get_current_offset(const Scanner* s);
+
+// Interns a name in the scanner's table (e.g. builtins declared by the analyzer)
+const InternedSymbol* intern_name(Scanner* s, const char* name);
 
 #endif // SCANNER_H
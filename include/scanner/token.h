@@ -2,6 +2,7 @@
 #define TOKEN_H
 
 #include <stdint.h>
+#include "../utils/arena.h"
 
 typedef enum {
     // Special forms (keywords) - these control evaluation and cannot be redefined
@@ -19,19 +20,26 @@ typedef enum {
     TOKEN_SYMBOL // quoted symbol
 } TokenType;
 
+typedef struct InternedSymbol InternedSymbol;
+
 typedef struct {
     union {
-        char* lexeme;
+        char* lexeme;   // Interned name, static punctuation, or arena-allocated string literal
         int64_t int_value;
         double real_value;
     };   
     TokenType type;
     uint32_t line;      // Source line number
     uint32_t column;    // Source column number
+    uint32_t offset;    // Byte offset of the lexeme in the source
+    uint32_t length;    // Lexeme length in bytes
+    uint32_t symbol;    // Interned id for identifiers and keywords, NO_SYMBOL otherwise
+    uint32_t hash;      // Hash of the interned name
 } Token;
 
-Token* create_token(const char* lexeme, TokenType type);
-void free_token(Token* t);
+// Tokens live in the arena of their compilation unit; the lexeme is borrowed
+Token* create_token(Arena* arena, const char* lexeme, TokenType type);
+Token* create_symbol_token(Arena* arena, const InternedSymbol* symbol);
 const char* token_type_to_string(TokenType type);
 TokenType check_keyword(const char* lexeme);
 
@@ -0,0 +1,62 @@
+#ifndef SCHEME_H
+#define SCHEME_H
+
+// Embedding API. Link against libscheme and include only this header.
+//
+//   SchemeVM* vm = scheme_new();
+//   scheme_define_native(vm, "host-time", 0, host_time);
+//   scheme_eval(vm, "(define (f x) (* x (host-time)))", NULL);
+//
+//   Value f, result;
+//   Value arg = NUMBER_VAL(2);
+//   if (scheme_get_global(vm, "f", &f) && scheme_call(vm, f, 1, &arg, &result)) ...
+//   scheme_free(vm);
+//
+// Runtime and compile errors never exit the host: the failing call returns
+// false and scheme_error() describes what went wrong.
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "vm/value.h"
+#include "vm/vm.h"
+
+typedef struct SchemeVM SchemeVM;
+
+// Compiled code. Immutable once built, so one program may be run by any
+// number of VMs, including VMs on other threads.
+typedef struct SchemeProgram SchemeProgram;
+
+SchemeVM* scheme_new(void);
+void scheme_free(SchemeVM* vm);
+
+// Compiles against the VM's globals, so names it defined or registered are
+// known. Returns NULL on a compile error.
+SchemeProgram* scheme_compile(SchemeVM* vm, const char* source, size_t length);
+void scheme_free_program(SchemeProgram* program);
+
+// Runs a program; result (may be NULL) receives the value of its last form
+bool scheme_run(SchemeVM* vm, const SchemeProgram* program, Value* result);
+
+// Compile and run in one step
+bool scheme_eval(SchemeVM* vm, const char* source, Value* result);
+bool scheme_load_file(SchemeVM* vm, const char* path);
+
+bool scheme_get_global(SchemeVM* vm, const char* name, Value* value);
+bool scheme_call(SchemeVM* vm, Value procedure, int32_t arg_count, const Value* args, Value* result);
+
+// Registers a C function as a first-class procedure. The function reads its
+// arguments straight from the VM stack and may call runtime_error() to fail.
+void scheme_define_native(SchemeVM* vm, const char* name, int32_t arity, NativeFn function);
+
+// Instructions a green thread runs before the others get a turn, at least 1.
+// THREAD_BUDGET by default.
+void scheme_set_thread_budget(SchemeVM* vm, int32_t budget);
+
+// Message for the last failed call
+const char* scheme_error(const SchemeVM* vm);
+
+// The interpreter underneath, for natives and direct VM access
+VM* scheme_vm(SchemeVM* vm);
+
+#endif // SCHEME_H
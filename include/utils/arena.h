@@ -0,0 +1,29 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stddef.h>
+
+#define ARENA_BLOCK_SIZE (64 * 1024)
+#define ARENA_ALIGNMENT 8
+
+typedef struct ArenaBlock {
+    struct ArenaBlock* next;
+    size_t used;
+    size_t capacity;
+    char data[];
+} ArenaBlock;
+
+// Bump allocator: everything allocated from it is released together
+typedef struct {
+    ArenaBlock* head;
+} Arena;
+
+#define ARENA_NEW(arena, type) ((type*)arena_alloc(arena, sizeof(type)))
+
+void init_arena(Arena* arena);
+void free_arena(Arena* arena);
+void reset_arena(Arena* arena);     // Releases everything but keeps one block for reuse
+void* arena_alloc(Arena* arena, size_t size);
+char* arena_strndup(Arena* arena, const char* chars, size_t length);
+
+#endif // ARENA_H
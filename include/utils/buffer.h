@@ -3,24 +3,23 @@
 
 #include <stdio.h>
 #include <stdbool.h>
-#include <ctype.h>
-#include <stdint.h>
+#include <stddef.h>
 
-#define BUFFER_SIZE 4096
+// Chunk size used when the input cannot be mapped (pipes, terminals)
+#define READ_CHUNK_SIZE 65536
 
-void init_buffer(FILE* file);
-char get_next_char(void);
-void unget_char(void);
-char peek_char(void);
-char skip_whitespace(void);
-void cleanup_buffer(void);
+// The whole source is loaded up front: mapped when the input is a regular
+// file, otherwise read into one contiguous heap buffer
+typedef struct {
+    const char* data;
+    size_t length;
+    size_t capacity;    // Heap buffer size, 0 when mapped, borrowed or empty
+    bool mapped;
+} SourceBuffer;
 
-// Position tracking
-uint32_t get_current_line(void);
-uint32_t get_current_column(void);
-
-// Buffer internals (for scanner)
-char* get_current_buffer(void);
-int32_t* get_buffer_pos(void);
+void init_source(SourceBuffer* source);
+bool load_source(SourceBuffer* source, FILE* file);
+void use_source(SourceBuffer* source, const char* text, size_t length);  // Borrowed, e.g. a REPL entry
+void free_source(SourceBuffer* source);
 
 #endif // BUFFER_H
@@ -2,11 +2,35 @@
 #define ERROR_H
 
 #include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "buffer.h"
 
-void init_error(const char *filename);
-void report_error(int line, int column, const char *message, ...);
-void error(int line, const char *message, ...);
-bool had_error(void);
-void cleanup_error(void);
+#define DIAGNOSTIC_MAX 256
+
+// Diagnostics for one compilation. Each front end gets its own, so several
+// files can be compiled at once on different threads.
+typedef struct {
+    const char *filename;
+    const SourceBuffer *source;     // Text quoted under each message, may be NULL
+    bool had_error;
+    bool quiet;                     // Record diagnostics without printing them
+
+    // "file:line:column: message" of the first error since the last clear
+    char first_message[DIAGNOSTIC_MAX];
+
+    // Offsets of each line start in the source, built on the first error
+    const char *indexed_source;
+    uint32_t *line_starts;
+    size_t line_count;
+    size_t line_capacity;
+} ErrorContext;
+
+void init_error(ErrorContext *errors, const char *filename);
+void report_error(ErrorContext *errors, int line, int column, const char *message, ...);
+void error(ErrorContext *errors, int line, const char *message, ...);
+bool had_error(const ErrorContext *errors);
+void clear_errors(ErrorContext *errors);    // Start over for a new source, e.g. the next REPL entry
+void cleanup_error(ErrorContext *errors);
 
 #endif // ERROR_H
@@ -3,6 +3,12 @@
 
 #include <stdint.h>
 
+#define FNV_OFFSET_BASIS 2166136261u
+#define FNV_PRIME 16777619u
+
+// One FNV-1a step, for hashing while characters are being scanned
+#define HASH_STEP(hash, c) (((hash) ^ (uint8_t)(c)) * FNV_PRIME)
+
 // FNV-1a hash function
 uint32_t hash_string(const char* key, int length);
 
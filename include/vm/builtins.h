@@ -0,0 +1,17 @@
+#ifndef BUILTINS_H
+#define BUILTINS_H
+
+#include "vm.h"
+
+// Binds every builtin procedure as a native in the VM's globals, so builtins
+// are first-class values: (map car lists) works like any other call. The
+// native objects are static and immutable, shared by all VMs.
+void register_builtins(VM* vm);
+
+// Groups kept in their own files, called by register_builtins
+void register_numvec_builtins(VM* vm);
+void register_hash_table_builtins(VM* vm);
+void register_control_builtins(VM* vm);
+void register_thread_builtins(VM* vm);
+
+#endif // BUILTINS_H
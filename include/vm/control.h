@@ -0,0 +1,22 @@
+#ifndef CONTROL_H
+#define CONTROL_H
+
+#include "vm.h"
+
+// First-class control: continuations captured by call/cc, and generators.
+// Both copy stack segments, the frames and values above some base, out of
+// the VM stack and back in; nothing is run again.
+//
+// A continuation saves the part of the stack that belongs to its RunLevel,
+// so it can be invoked while its level is active: to escape, or to re-enter
+// after the call/cc has returned, any number of times. A generator saves
+// only its own frames while suspended, and can be resumed at any depth.
+
+// Called by call_value for the two new kinds of procedure
+void invoke_continuation(VM* vm, ObjContinuation* continuation, int32_t arg_count);
+void resume_generator(VM* vm, ObjGenerator* generator, int32_t arg_count);
+
+// OP_GENERATOR_RETURN: the generator's procedure has returned
+void finish_generator(VM* vm);
+
+#endif // CONTROL_H
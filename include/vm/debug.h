@@ -4,7 +4,7 @@
 #include "instruction.h"
 #include <stdint.h>
 
-void disassemble_bytecode(Bytecode* bc, const char* name);
-int32_t disassemble_instruction(Bytecode* bc, int32_t offset);
+void disassemble_bytecode(const Bytecode* bc, const char* name);
+int32_t disassemble_instruction(const Bytecode* bc, int32_t offset);
 
 #endif // DEBUG_H
@@ -0,0 +1,17 @@
+#ifndef HASHTABLE_H
+#define HASHTABLE_H
+
+#include "vm.h"
+
+// Scheme hash tables. Keys match under eqv?, except that strings match by
+// contents, so they hash numbers, strings and symbols by value and other
+// objects by identity. Entry arrays live in the VM heap.
+
+Value make_hash_table(VM* vm);
+uint32_t hash_value(VM* vm, Value key);
+
+bool hash_table_get(VM* vm, ObjHashTable* table, Value key, Value* value);
+void hash_table_set(VM* vm, ObjHashTable* table, Value key, Value value);
+bool hash_table_delete(VM* vm, ObjHashTable* table, Value key);
+
+#endif // HASHTABLE_H
@@ -22,6 +22,20 @@ typedef enum {
     OP_NOT_EQUAL, // Check if second top != top stack value
     OP_GREATER_EQUAL, // Check if second top >= top stack value
     OP_LESS_EQUAL,    // Check if second top <= top stack value
+    OP_EQV,           // eq?/eqv? on the top two stack values
+    OP_EQV_CONSTANT,  // Push whether the top value is eqv? to a constant; keeps the top
+
+    // Unchecked variants, for operands the analyzer proved are numbers
+    OP_ADD_NUMBER,
+    OP_SUB_NUMBER,
+    OP_MUL_NUMBER,
+    OP_DIV_NUMBER,    // Still checks for division by zero
+    OP_EQUAL_NUMBER,
+    OP_GREATER_NUMBER,
+    OP_LESS_NUMBER,
+    OP_NOT_EQUAL_NUMBER,
+    OP_GREATER_EQUAL_NUMBER,
+    OP_LESS_EQUAL_NUMBER,
 
     // If-else
     OP_JUMP_IF_FALSE, // Jump if top stack value is false
@@ -36,24 +50,42 @@ typedef enum {
     OP_CAR,     // Get the car of a pair
     OP_CDR,     // Get the cdr of a pair
 
+    // Vector operations
+    OP_MAKE_VECTOR,   // Operand: 1 (length) or 2 (length, fill)
+    OP_VECTOR,        // Collect the top operand values into a vector
+    OP_VECTOR_REF,
+    OP_VECTOR_SET,
+    OP_VECTOR_LENGTH,
+
     OP_DISPLAY, // Display top stack value
     OP_READ,    // Read input from user and push onto stack
     OP_READ_LINE, // Read a line of text from user
     OP_HALT,    // Stop execution
     OP_POP,     // Pop top value from the stack
     OP_NEWLINE, // Print a newline character
+    OP_FLUSH_OUTPUT, // Write buffered output to stdout
     OP_JUMP_IF_TRUE_OR_POP, // Jump if true (keep value), else pop
     OP_JUMP_IF_FALSE_OR_POP, // Jump if false (keep value), else pop
 
     // Functions and Closures
     OP_CLOSURE,
     OP_CALL,
+    OP_CALL_CLOSURE,  // OP_CALL quickened for a closure taking operand arguments
+    OP_CALL_NATIVE,   // OP_CALL quickened for a native
+    OP_CALL_GLOBAL,   // Call the global named by the constant operand, with
+                      // the arguments but no callee on the stack. The next
+                      // word is an OP_ARG_COUNT.
+    OP_ARG_COUNT,     // Operand: argument count of the OP_CALL_GLOBAL before
+                      // it, which skips it. Never executed.
     OP_RETURN,
     OP_GET_LOCAL,
     OP_SET_LOCAL,
     OP_GET_UPVALUE,
     OP_SET_UPVALUE,
     OP_CLOSE_UPVALUE,
+    OP_GET_CALLEE,    // Push the running closure, for a loop that calls itself
+    OP_GENERATOR_RETURN, // Where a generator's procedure returns to
+    OP_THREAD_EXIT,     // Where a green thread's procedure returns to
 } Opcode;
 
 
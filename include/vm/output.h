@@ -0,0 +1,34 @@
+#ifndef OUTPUT_H
+#define OUTPUT_H
+
+#include <stdio.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define OUTPUT_BUFFER_SIZE 65536
+
+// Large enough for any formatted double ("-2.2250738585072014e-308")
+#define NUMBER_BUFFER_SIZE 32
+
+typedef struct {
+    char* data;
+    size_t count;
+    size_t capacity;
+    FILE* sink;
+} OutputBuffer;
+
+void init_output(OutputBuffer* out, FILE* sink);
+void free_output(OutputBuffer* out);
+void flush_output(OutputBuffer* out);
+
+void output_char(OutputBuffer* out, char c);
+void output_string(OutputBuffer* out, const char* chars, size_t length);
+void output_cstring(OutputBuffer* out, const char* chars);
+void output_integer(OutputBuffer* out, int64_t value);
+void output_number(OutputBuffer* out, double value);
+
+// Formatters write into dst (at least NUMBER_BUFFER_SIZE bytes) and return the length
+int format_integer(char* dst, int64_t value);
+int format_number(char* dst, double value);
+
+#endif // OUTPUT_H
@@ -0,0 +1,33 @@
+#ifndef ROPE_H
+#define ROPE_H
+
+#include "vm.h"
+
+// Appends shorter than this copy into a flat string; longer ones make a
+// rope node that shares both halves, so repeated concatenation does not
+// recopy everything built so far.
+#define ROPE_MIN_LENGTH 128
+
+// A rope deeper than this is flattened, bounding the recursion of walks
+#define ROPE_MAX_DEPTH 48
+
+// A flat string from reallocate, for constants that outlive any VM
+ObjString* allocate_string(const char* chars, size_t length);
+
+Value string_append(VM* vm, ObjString* a, ObjString* b);
+
+// The characters of a string, NUL-terminated. Flattens a rope in place.
+const char* string_chars(VM* vm, ObjString* string);
+
+bool string_equal(VM* vm, ObjString* a, ObjString* b);
+
+// Copies the characters of a flat string or rope into dst
+void copy_string_chars(char* dst, const ObjString* string);
+
+// String ports grow geometrically in the VM heap, so appends are amortized
+// O(1) and the whole port is released with the VM.
+Value make_string_port(VM* vm);
+void string_port_append(VM* vm, ObjStringPort* port, const char* chars, size_t length);
+void string_port_append_string(VM* vm, ObjStringPort* port, const ObjString* string);
+
+#endif // ROPE_H
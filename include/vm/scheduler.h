@@ -0,0 +1,44 @@
+#ifndef SCHEDULER_H
+#define SCHEDULER_H
+
+#include "vm.h"
+
+// Green threads: spawn makes one, and the VM runs them in turn. Each has its
+// own stack and frames, so switching only swaps pointers. A thread gives way
+// when its instruction budget runs out, when it waits on a channel or for
+// another thread, and when it would wait for input. Switches only happen in
+// the outermost interpreter level: a native's call into Scheme runs to
+// completion in the thread that made it.
+
+// A FIFO of values with room for capacity of them. With no room, a sender
+// waits for a receiver, so a capacity of 0 makes every send a handover.
+struct ObjChannel {
+    Value* buffer;
+    int32_t capacity;
+    int32_t count;
+    int32_t head;
+    ThreadQueue receivers;      // Waiting for a value; the buffer is empty
+    ThreadQueue senders;        // Waiting for room, with their values in transfer
+};
+
+// Makes the code vm_execute runs the main thread
+void init_threads(VM* vm);
+
+// Another thread is ready to run, and the running one can give way to it
+bool threads_waiting(VM* vm);
+
+// Moves the running thread to the back of the run queue and switches to the
+// front one. Only valid when threads_waiting.
+void yield_thread(VM* vm);
+
+// False when reading vm->in would wait for data to arrive
+bool input_ready(VM* vm);
+
+// OP_THREAD_EXIT: the thread's procedure has returned
+void finish_thread(VM* vm);
+
+// A runtime error unwound out of whichever thread was running. Ends that
+// thread unless it is thread, and makes thread the running one again.
+void recover_thread(VM* vm, ObjThread* thread);
+
+#endif // SCHEDULER_H
@@ -0,0 +1,33 @@
+#ifndef SIMD_H
+#define SIMD_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Bulk kernels over raw arrays, used by the f64vector/u8vector natives.
+// On x86 they use AVX2 when the CPU has it and SSE2 otherwise; elsewhere
+// they are plain loops. Vectorized sums add in a different order than a
+// scalar loop, so f64 results may differ in the last bits.
+
+double f64_sum(const double* a, size_t n);
+double f64_dot(const double* a, const double* b, size_t n);
+double f64_min(const double* a, size_t n);      // n must be > 0
+double f64_max(const double* a, size_t n);      // n must be > 0
+void f64_add(double* dst, const double* a, const double* b, size_t n);
+void f64_mul(double* dst, const double* a, const double* b, size_t n);
+void f64_scale(double* dst, const double* a, double k, size_t n);
+void f64_fill(double* dst, double value, size_t n);
+void f64_copy(double* dst, const double* a, size_t n);
+
+// u8 element-wise results wrap modulo 256, like C unsigned arithmetic
+uint64_t u8_sum(const uint8_t* a, size_t n);
+uint64_t u8_dot(const uint8_t* a, const uint8_t* b, size_t n);
+uint8_t u8_min(const uint8_t* a, size_t n);     // n must be > 0
+uint8_t u8_max(const uint8_t* a, size_t n);     // n must be > 0
+void u8_add(uint8_t* dst, const uint8_t* a, const uint8_t* b, size_t n);
+void u8_mul(uint8_t* dst, const uint8_t* a, const uint8_t* b, size_t n);
+void u8_scale(uint8_t* dst, const uint8_t* a, uint8_t k, size_t n);
+void u8_fill(uint8_t* dst, uint8_t value, size_t n);
+void u8_copy(uint8_t* dst, const uint8_t* a, size_t n);
+
+#endif // SIMD_H
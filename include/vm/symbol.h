@@ -0,0 +1,13 @@
+#ifndef SYMBOL_H
+#define SYMBOL_H
+
+#include "value.h"
+#include <stddef.h>
+
+// Symbols are interned in one table shared by the whole process, so two
+// symbols with the same name are the same object in every VM and in every
+// compiled program, and eq? compares them by pointer. Interning is
+// thread-safe; symbols live until the process exits.
+ObjSymbol* intern_symbol_object(const char* chars, size_t length);
+
+#endif // SYMBOL_H
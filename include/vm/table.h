@@ -3,21 +3,45 @@
 
 #include "value.h"
 #include <stdbool.h>
+#include <stdint.h>
+
+// String-keyed hash table in the Swiss table layout: a control byte per
+// slot holds 7 bits of the key's hash, or marks the slot empty or deleted,
+// and lookups scan a group of control bytes at a time (with SSE2 where
+// available) before touching any key. Entries keep the full hash and the
+// key length, so a key is compared only when both match.
+//
+// Every value stored gets a new version, unique within the table, so a
+// cache of a lookup can tell from the slot alone whether it still holds.
+
+#define TABLE_GROUP_WIDTH 16
 
 typedef struct {
-    char* key;
+    char* key;          // Copy owned by the table
+    uint32_t hash;
+    uint32_t length;
+    uint32_t version;   // Zero in a slot that holds no key
     Value value;
 } TableEntry;
 
 typedef struct {
     int count;
-    int capacity;
+    int capacity;       // Zero or a power of two, at least TABLE_GROUP_WIDTH
+    int growth_left;    // Empty slots that may still be filled before a rehash
+    uint8_t* control;   // capacity + TABLE_GROUP_WIDTH bytes; the tail mirrors the first group
     TableEntry* entries;
+    uint32_t last_version;
 } Table;
 
 void init_table(Table* table);
 void free_table(Table* table);
-bool table_set(Table* table, const char* key, Value value);
+bool table_set(Table* table, const char* key, Value value);   // True if key is new
 bool table_get(Table* table, const char* key, Value* value);
+bool table_delete(Table* table, const char* key);             // True if key was present
+
+// Index of key's slot in entries, or -1. The index stays in range as the
+// table grows; the entry there has the same version only while it still
+// holds the same key and value.
+int table_find(Table* table, const char* key);
 
 #endif // TABLE_H
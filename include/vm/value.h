@@ -3,11 +3,25 @@
 
 #include <stdbool.h>
 #include <stdint.h>
+#include "output.h"
 
 typedef struct ObjPair ObjPair;
 typedef struct Bytecode Bytecode;
 typedef struct ObjUpvalue ObjUpvalue;
 typedef struct ObjClosure ObjClosure;
+typedef struct ObjNative ObjNative;
+typedef struct ObjVector ObjVector;
+typedef struct ObjF64Vector ObjF64Vector;
+typedef struct ObjU8Vector ObjU8Vector;
+typedef struct ObjString ObjString;
+typedef struct ObjStringPort ObjStringPort;
+typedef struct ObjSymbol ObjSymbol;
+typedef struct ObjHashTable ObjHashTable;
+typedef struct ObjContinuation ObjContinuation;
+typedef struct ObjGenerator ObjGenerator;
+typedef struct ObjThread ObjThread;
+typedef struct ObjChannel ObjChannel;
+typedef struct VM VM;
 
 typedef struct {
     int32_t arity;
@@ -28,6 +42,17 @@ typedef enum {
     VAL_PROCEDURE, // For functions/lambdas
     VAL_FUNCTION,  // Raw function code
     VAL_CLOSURE,   // Function instance
+    VAL_NATIVE,    // C function
+    VAL_VECTOR,    // Fixed-length contiguous array
+    VAL_F64VECTOR, // Unboxed array of doubles
+    VAL_U8VECTOR,  // Unboxed array of bytes
+    VAL_STRING_PORT, // Growable output buffer for building strings
+    VAL_SYMBOL,    // Interned name, compared by pointer
+    VAL_HASH_TABLE, // Mutable map keyed by eqv?, strings by contents
+    VAL_CONTINUATION, // Captured by call/cc, or a generator's yield
+    VAL_GENERATOR, // Producer resumed by calling it
+    VAL_THREAD,    // Green thread multiplexed on its VM
+    VAL_CHANNEL,   // Queue that threads send values through
     VAL_ANY,       // For semantic analysis - accepts any type
 } ValueType;
 
@@ -35,31 +60,164 @@ typedef struct {
     ValueType type;
     union {
         double number;
-        char* string;
+        ObjString* string;
         bool boolean;
         ObjPair* pair;
         ObjFunction* function;
         ObjClosure* closure;
+        ObjNative* native;
+        ObjVector* vector;
+        ObjF64Vector* f64vector;
+        ObjU8Vector* u8vector;
+        ObjStringPort* port;
+        ObjSymbol* symbol;
+        ObjHashTable* hash_table;
+        ObjContinuation* continuation;
+        ObjGenerator* generator;
+        ObjThread* thread;
+        ObjChannel* channel;
     } as;
 } Value;
 
+// Arguments are a slice of the VM stack, valid only during the call
+typedef Value (*NativeFn)(VM* vm, int32_t arg_count, Value* args);
+
+struct ObjNative {
+    NativeFn function;
+    const char* name;
+    int32_t arity;      // -1 accepts any number of arguments
+    bool control;       // Sets up the stack and frames itself; the result is ignored
+};
+
 struct ObjPair {
     Value car;
     Value cdr;
 };
 
+// A string is either flat, with its characters NUL-terminated in chars, or
+// a rope: the concatenation of left and right, with chars NULL until
+// something needs the characters in one piece.
+struct ObjString {
+    uint32_t length;
+    uint32_t depth;        // 0 for flat strings, else 1 + the deeper half
+    char* chars;
+    ObjString* left;
+    ObjString* right;
+};
+
+struct ObjSymbol {
+    uint32_t length;
+    uint32_t hash;
+    char name[];
+};
+
+struct ObjStringPort {
+    uint32_t length;
+    uint32_t capacity;
+    char* chars;
+};
+
 struct ObjUpvalue {
     Value* location;
     Value closed;
     struct ObjUpvalue* next;
 };
 
+struct ObjVector {
+    uint32_t count;
+    Value items[];
+};
+
+// Homogeneous vectors keep raw elements so bulk operations can run over them
+struct ObjF64Vector {
+    uint32_t count;
+    double items[];
+};
+
+struct ObjU8Vector {
+    uint32_t count;
+    uint8_t items[];
+};
+
+typedef enum {
+    ENTRY_EMPTY,
+    ENTRY_LIVE,
+    ENTRY_TOMBSTONE,    // Deleted; probing continues past it
+} HashEntryState;
+
+typedef struct {
+    Value key;
+    Value value;
+    uint32_t hash;
+    uint8_t state;
+} HashEntry;
+
+// Open addressing with linear probing; capacity is a power of two
+struct ObjHashTable {
+    uint32_t count;     // Live entries
+    uint32_t used;      // Live entries plus tombstones
+    uint32_t capacity;
+    HashEntry* entries;
+};
+
 struct ObjClosure {
     ObjFunction* function;
     ObjUpvalue** upvalues;
     int upvalue_count;
 };
 
+// A call frame copied out of the VM, with its slots as an offset from the
+// base of the segment it was saved from
+typedef struct {
+    ObjClosure* closure;
+    const Bytecode* parent_code;
+    uint32_t ip;
+    int32_t slots;
+} SavedFrame;
+
+// The frames and stack values above some base, and where execution
+// continues when they are copied back
+typedef struct {
+    SavedFrame* frames;
+    int32_t frame_count;
+    int32_t frame_capacity;
+    Value* values;
+    int32_t value_count;
+    int32_t value_capacity;
+    const Bytecode* code;
+    uint32_t ip;
+} StackSegment;
+
+struct ObjContinuation {
+    uint32_t level;             // Id of the RunLevel it was captured in
+    ObjThread* thread;          // The green thread that captured it
+    StackSegment segment;       // That level's part of the stack
+    ObjGenerator* generator;    // Set for a yield, which saves nothing else
+};
+
+typedef enum {
+    GENERATOR_FRESH,
+    GENERATOR_RUNNING,
+    GENERATOR_SUSPENDED,
+    GENERATOR_DONE,
+} GeneratorState;
+
+struct ObjGenerator {
+    GeneratorState state;
+    ObjThread* thread;          // The green thread running it, while running
+    Value procedure;            // Called with yield when first resumed
+    Value result;               // What procedure returned, once done
+    ObjContinuation* yield;
+    StackSegment suspended;     // procedure's frames, while suspended
+
+    // The call that resumed it, while running. The resume's result goes in
+    // result_slot, and the generator's frames start at base_frame.
+    int32_t result_slot;
+    int32_t base_frame;
+    const Bytecode* return_code;
+    uint32_t return_ip;
+};
+
 // Type checking macros
 #define IS_NUMBER(value)  ((value).type == VAL_NUMBER)
 #define IS_STRING(value)  ((value).type == VAL_STRING)
@@ -68,24 +226,59 @@ struct ObjClosure {
 #define IS_NIL(value)     ((value).type == VAL_NIL)
 #define IS_FUNCTION(value) ((value).type == VAL_FUNCTION)
 #define IS_CLOSURE(value) ((value).type == VAL_CLOSURE)
+#define IS_NATIVE(value)  ((value).type == VAL_NATIVE)
+#define IS_VECTOR(value)  ((value).type == VAL_VECTOR)
+#define IS_F64VECTOR(value) ((value).type == VAL_F64VECTOR)
+#define IS_U8VECTOR(value) ((value).type == VAL_U8VECTOR)
+#define IS_STRING_PORT(value) ((value).type == VAL_STRING_PORT)
+#define IS_SYMBOL(value)  ((value).type == VAL_SYMBOL)
+#define IS_HASH_TABLE(value) ((value).type == VAL_HASH_TABLE)
+#define IS_CONTINUATION(value) ((value).type == VAL_CONTINUATION)
+#define IS_GENERATOR(value) ((value).type == VAL_GENERATOR)
+#define IS_THREAD(value)  ((value).type == VAL_THREAD)
+#define IS_CHANNEL(value) ((value).type == VAL_CHANNEL)
 
 // Value extraction macros
 #define AS_NUMBER(value)  ((value).as.number)
 #define AS_STRING(value)  ((value).as.string)
+#define AS_CSTRING(value) ((value).as.string->chars)   // Flat strings only
 #define AS_BOOL(value)    ((value).as.boolean)
 #define AS_PAIR(value)    ((value).as.pair)
 #define AS_FUNCTION(value) ((value).as.function)
 #define AS_CLOSURE(value) ((value).as.closure)
+#define AS_NATIVE(value)  ((value).as.native)
+#define AS_VECTOR(value)  ((value).as.vector)
+#define AS_F64VECTOR(value) ((value).as.f64vector)
+#define AS_U8VECTOR(value) ((value).as.u8vector)
+#define AS_STRING_PORT(value) ((value).as.port)
+#define AS_SYMBOL(value)  ((value).as.symbol)
+#define AS_HASH_TABLE(value) ((value).as.hash_table)
+#define AS_CONTINUATION(value) ((value).as.continuation)
+#define AS_GENERATOR(value) ((value).as.generator)
+#define AS_THREAD(value)  ((value).as.thread)
+#define AS_CHANNEL(value) ((value).as.channel)
 
 // Value construction macros
 #define NUMBER_VAL(value) ((Value){VAL_NUMBER, {.number = value}})
-#define STRING_VAL(value) ((Value){VAL_STRING, {.string = (char*)(value)}})
+#define STRING_VAL(object) ((Value){VAL_STRING, {.string = object}})
 #define BOOL_VAL(value)   ((Value){VAL_BOOL, {.boolean = value}})
 #define PAIR_VAL(pair)    ((Value){VAL_PAIR, {.pair = pair}})   
 #define FUNCTION_VAL(func) ((Value){VAL_FUNCTION, {.function = func}})
 #define CLOSURE_VAL(closure) ((Value){VAL_CLOSURE, {.closure = closure}})
+#define NATIVE_VAL(object) ((Value){VAL_NATIVE, {.native = object}})
+#define VECTOR_VAL(object) ((Value){VAL_VECTOR, {.vector = object}})
+#define F64VECTOR_VAL(object) ((Value){VAL_F64VECTOR, {.f64vector = object}})
+#define U8VECTOR_VAL(object) ((Value){VAL_U8VECTOR, {.u8vector = object}})
+#define STRING_PORT_VAL(object) ((Value){VAL_STRING_PORT, {.port = object}})
+#define SYMBOL_VAL(object) ((Value){VAL_SYMBOL, {.symbol = object}})
+#define HASH_TABLE_VAL(object) ((Value){VAL_HASH_TABLE, {.hash_table = object}})
+#define CONTINUATION_VAL(object) ((Value){VAL_CONTINUATION, {.continuation = object}})
+#define GENERATOR_VAL(object) ((Value){VAL_GENERATOR, {.generator = object}})
+#define THREAD_VAL(object) ((Value){VAL_THREAD, {.thread = object}})
+#define CHANNEL_VAL(object) ((Value){VAL_CHANNEL, {.channel = object}})
 #define NIL_VAL           ((Value){VAL_NIL, {.number = 0}})
 
 void print_value(Value value);
+void write_value(OutputBuffer* out, Value value);
 
 #endif // VALUE_H
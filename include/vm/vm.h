@@ -4,35 +4,169 @@
 #include "instruction.h"
 #include "value.h"
 #include "table.h"
+#include "output.h"
+#include "../utils/arena.h"
 #include <stdbool.h>
 #include <stdint.h>
+#include <setjmp.h>
 
 #define STACK_MAX 256
 #define FRAMES_MAX 64
+#define ERROR_MESSAGE_MAX 256
+#define CALL_CACHE_SIZE 256     // Power of two
+#define THREAD_BUDGET 10000     // Default instructions per turn of a green thread
 
 typedef struct {
     ObjClosure* closure;
-    Bytecode* parent_code;  // Parent function's bytecode
+    const Bytecode* parent_code;  // Parent function's bytecode
     uint32_t ip;  // Instruction index in parent bytecode
     Value* slots;
 } CallFrame;
 
+// A global that OP_CALL_GLOBAL found callable with arg_count arguments,
+// keyed by the call's name constant. Only valid while epoch is the VM's
+// program_epoch and the global's slot still has the version it had.
 typedef struct {
+    const ObjString* name;
+    Value callee;
+    int32_t arg_count;
+    int32_t slot;               // In the globals table
+    uint32_t version;
+    uint32_t epoch;
+} CallCacheEntry;
+
+// One activation of the interpreter loop. vm_execute starts one, and so does
+// each vm_call that a native makes into Scheme code. A continuation can
+// only return into a level that is still active, since the C frames of a
+// finished one are gone.
+typedef struct RunLevel {
+    struct RunLevel* outer;
+    jmp_buf jump;           // Where a continuation resumes from a deeper level
+    uint32_t id;
+    int32_t exit_depth;
+    int32_t frame_base;     // First frame and stack slot owned by this level
+    int32_t stack_base;
+    int32_t native_calls;   // VM's native_calls when the level started
+    jmp_buf* error_jump;
+} RunLevel;
+
+// A green thread's value stack and call frames. The storage of finished
+// threads is reused.
+typedef struct ThreadStack {
     CallFrame frames[FRAMES_MAX];
+    Value values[STACK_MAX];
+    struct ThreadStack* next_free;
+} ThreadStack;
+
+typedef struct {
+    ObjThread* head;
+    ObjThread* tail;
+} ThreadQueue;
+
+typedef enum {
+    THREAD_RUNNING,
+    THREAD_RUNNABLE,    // In the VM's run queue
+    THREAD_BLOCKED,     // In the queue of a channel or a thread it joins
+    THREAD_DONE,
+} ThreadState;
+
+// Green threads take turns on one VM, switching only between instructions
+// of the VM's outermost interpreter level. The running thread's stack,
+// frames and code position are the VM's; the others' are saved here.
+struct ObjThread {
+    ThreadState state;
+    ThreadStack* storage;       // NULL once done
+    int32_t stack_top;
+    int32_t frame_count;
+    const Bytecode* code;
+    uint32_t ip;
+    ObjUpvalue* open_upvalues;
+    int32_t frame_base;         // Where the outermost RunLevel starts in this
+    int32_t stack_base;         // thread's stack
+    Value procedure;            // Called when the thread first runs
+    bool started;
+    Value result;               // What procedure returned, once done
+    Value transfer;             // What it is sending, while blocked sending
+    ThreadQueue joiners;
+    ThreadQueue* waiting_in;
+    ObjThread* next;            // In the run queue or waiting_in
+};
+
+// One interpreter instance. Several VMs, one per thread, can execute the
+// same compiled program; each keeps its own stack, globals, heap and I/O
+// streams. The only write a VM makes to the bytecode it runs is quickening
+// an opcode into an equivalent variant, which is done atomically; anything
+// else learned about the bytecode, like call_cache, is kept in the VM.
+typedef struct VM {
+    CallFrame* frames;          // The running thread's
     int32_t frame_count;
 
-    Bytecode* code;
+    const Bytecode* code;
     uint32_t ip;
-    Value stack[STACK_MAX];
+    Value* stack;
     int32_t stack_top;
     bool trace_execution;  // Flag to enable/disable instruction tracing
     Table globals;
+    CallCacheEntry call_cache[CALL_CACHE_SIZE];
+    uint32_t program_epoch;     // Advanced by vm_execute
     ObjUpvalue* open_upvalues;
+    OutputBuffer out;      // display/newline output, flushed in large chunks
+    FILE* in;              // Source for read and read-line, stdin by default
+    Arena heap;            // Pairs, closures, upvalues and strings made at run time
+
+    RunLevel* run_level;        // Innermost, or NULL outside the interpreter
+    uint32_t run_level_count;
+    int32_t native_calls;       // Natives currently running
+
+    ObjThread* thread;          // Running
+    ObjThread main_thread;      // Runs the code vm_execute is given
+    ThreadStack main_stack;
+    ThreadQueue run_queue;
+    ThreadStack* free_stacks;
+    int32_t thread_budget;      // Instructions a thread runs before others get a turn
+
+    // When set, runtime errors unwind here instead of exiting the process
+    jmp_buf* error_jump;
+    char error_message[ERROR_MESSAGE_MAX];
 } VM;
 
 void init_vm(VM* vm);
-void free_vm(VM* vm);
-void vm_execute(VM* vm, Bytecode* bc);
+void free_vm(VM* vm);   // Also releases every object the VM allocated
+void vm_execute(VM* vm, const Bytecode* bc);
+
+// Calls a closure or native from C and returns its result. Reentrant, so
+// natives may call back into Scheme.
+Value vm_call(VM* vm, Value callee, int32_t arg_count, const Value* args);
+
+// Runs body so that a runtime error inside it returns false instead of
+// exiting. The stack, frames and code position are restored either way.
+bool vm_protect(VM* vm, void (*body)(VM* vm, void* data), void* data);
+
+// Records the message, then unwinds to error_jump or exits
+_Noreturn void runtime_error(VM* vm, const char* format, ...);
+
+// Calls callee with the arguments above it on the stack. A closure gets a
+// frame and runs once the interpreter loop continues.
+void call_value(VM* vm, Value callee, int32_t arg_count);
+
+// Moves the values of open upvalues at or above last into the upvalues
+void close_upvalues(VM* vm, Value* last);
+
+// Binds name to a C function in the VM's globals
+void define_native(VM* vm, const char* name, int32_t arity, NativeFn function);
+
+// Objects allocated in the VM's heap
+Value make_pair(VM* vm, Value car, Value cdr);
+Value make_string(VM* vm, const char* chars, size_t length);
+Value make_vector(VM* vm, uint32_t count, Value fill);
+Value make_f64vector(VM* vm, uint32_t count);
+Value make_u8vector(VM* vm, uint32_t count);
+
+// eqv?: numbers and strings compare by value, everything else by identity
+bool is_eqv(VM* vm, Value a, Value b);
+
+// Checks that index is an integer in [0, count) and returns it
+uint32_t vector_index(VM* vm, uint32_t count, Value index);
 
 void push(VM* vm, Value v);
 Value pop(VM* vm);
@@ -7,35 +7,50 @@
 #include "symbol_table.h"
 #include "error.h"
 #include "token.h"
+#include "scanner.h"
 
 
+// codegen inlines all of these, so their result types hold even if the
+// name is redefined as a global
 static const BuiltinInfo BUILTIN_TABLE[] = {
     // I/O procedures
-    {"display", 1, 1, VAL_ANY},
-    {"read", 0, 0, VAL_ANY},
-    {"read-line", 0, 0, VAL_ANY},
+    {"display", 1, 1, VAL_ANY, VAL_ANY},
+    {"read", 0, 0, VAL_ANY, VAL_ANY},
+    {"read-line", 0, 0, VAL_ANY, VAL_ANY},
+    {"flush-output", 0, 0, VAL_ANY, VAL_ANY},
 
     // Pair procedures
-    {"cons", 2, 2, VAL_ANY},
-    {"car", 1, 1, VAL_PAIR},
-    {"cdr", 1, 1, VAL_PAIR},
+    {"cons", 2, 2, VAL_ANY, VAL_PAIR},
+    {"car", 1, 1, VAL_PAIR, VAL_ANY},
+    {"cdr", 1, 1, VAL_PAIR, VAL_ANY},
+
+    // Equivalence
+    {"eq?", 2, 2, VAL_ANY, VAL_BOOL},
+    {"eqv?", 2, 2, VAL_ANY, VAL_BOOL},
+
+    // Vector procedures
+    {"make-vector", 1, 2, VAL_ANY, VAL_VECTOR},
+    {"vector", 0, -1, VAL_ANY, VAL_VECTOR},
+    {"vector-ref", 2, 2, VAL_ANY, VAL_ANY},
+    {"vector-set!", 3, 3, VAL_ANY, VAL_ANY},
+    {"vector-length", 1, 1, VAL_ANY, VAL_NUMBER},
 
     // Arithmetic operators
-    {"+", 0, -1, VAL_NUMBER},  // (+) => 0, (+ 1) => 1, (+ 1 2 3) => 6
-    {"-", 1, -1, VAL_NUMBER},  // (- 5) => -5, (- 10 3) => 7
-    {"*", 0, -1, VAL_NUMBER},  // (*) => 1
-    {"/", 1, -1, VAL_NUMBER},  // (/ 10) => 1/10, (/ 10 2) => 5
+    {"+", 0, -1, VAL_NUMBER, VAL_NUMBER},  // (+) => 0, (+ 1) => 1, (+ 1 2 3) => 6
+    {"-", 1, -1, VAL_NUMBER, VAL_NUMBER},  // (- 5) => -5, (- 10 3) => 7
+    {"*", 0, -1, VAL_NUMBER, VAL_NUMBER},  // (*) => 1
+    {"/", 1, -1, VAL_NUMBER, VAL_NUMBER},  // (/ 10) => 1/10, (/ 10 2) => 5
 
     // Comparison operators
-    {"<", 2, 2, VAL_NUMBER},
-    {">", 2, 2, VAL_NUMBER},
-    {"=", 2, 2, VAL_NUMBER},
-    {"<=", 2, 2, VAL_NUMBER},
-    {">=", 2, 2, VAL_NUMBER},
-    {"!=", 2, 2, VAL_NUMBER},
+    {"<", 2, 2, VAL_NUMBER, VAL_BOOL},
+    {">", 2, 2, VAL_NUMBER, VAL_BOOL},
+    {"=", 2, 2, VAL_NUMBER, VAL_BOOL},
+    {"<=", 2, 2, VAL_NUMBER, VAL_BOOL},
+    {">=", 2, 2, VAL_NUMBER, VAL_BOOL},
+    {"!=", 2, 2, VAL_NUMBER, VAL_BOOL},
 
     // Terminator
-    {NULL, 0, 0, VAL_ANY}
+    {NULL, 0, 0, VAL_ANY, VAL_ANY}
 };
 
 
@@ -61,29 +76,31 @@ static int count_args(AstNode* arg_list){
 }
 
 
+// Types are inferred bottom-up as nodes are analyzed. A let variable is
+// never reassigned, so it has the type of its initial value for its whole
+// scope; loop variables are typed only if every value they take agrees
+// (see analyze_loop). Parameters and globals stay VAL_ANY.
 static ValueType get_node_type(AstNode* node){
     if (node == NULL) return VAL_ANY;
 
-    switch(node->type){
-        case NODE_ATOM:
-            switch(node->token->type){
-                case TOKEN_DEC:
-                case TOKEN_REAL:
-                    return VAL_NUMBER;
-                case TOKEN_STR_LITERAL:
-                    return VAL_STRING;
-                case TOKEN_IDENTIFIER:
-                    return VAL_ANY;
-                default:
-                    return VAL_ANY;
-            }
-        case NODE_LIST:
-            return VAL_ANY;
-        case NODE_NIL:
-            return VAL_PAIR;
-        default:
-            return VAL_ANY;
+    // An empty list is accepted wherever a pair is
+    if (node->type == NODE_NIL) return VAL_PAIR;
+    return node->value_type;
+}
+
+
+static ValueType join_types(ValueType a, ValueType b){
+    return a == b ? a : VAL_ANY;
+}
+
+
+// The type of the last expression, or nil for an empty body
+static ValueType body_type(AstNode* body){
+    ValueType type = VAL_NIL;
+    for (; body && body->type != NODE_NIL; body = body->cdr) {
+        type = body->car->value_type;
     }
+    return type;
 }
 
 
@@ -92,8 +109,12 @@ static const char* type_to_string(ValueType type){
         case VAL_ANY: return "any";
         case VAL_NUMBER: return "number";
         case VAL_STRING: return "string";
+        case VAL_SYMBOL: return "symbol";
         case VAL_BOOL: return "boolean";
         case VAL_PAIR: return "pair";
+        case VAL_VECTOR: return "vector";
+        case VAL_F64VECTOR: return "f64vector";
+        case VAL_U8VECTOR: return "u8vector";
         case VAL_PROCEDURE: return "procedure";
         case VAL_NIL: return "nil";
         default: return "unknown";
@@ -115,6 +136,7 @@ static bool is_special_form(AstNode* operator) {
            type == TOKEN_BEGIN ||
            type == TOKEN_COND ||
            type == TOKEN_CASE ||
+           type == TOKEN_DO ||
            type == TOKEN_QUOTE ||
            type == TOKEN_QUASIQUOTE ||
            type == TOKEN_UNQUOTE ||
@@ -128,6 +150,8 @@ static bool is_special_form(AstNode* operator) {
 static void analyze_node(Analyzer* a, AstNode* node);
 static bool is_special_form(AstNode* operator);
 static void analyze_special_form(Analyzer* a, AstNode* node);
+static void analyze_named_let(Analyzer* a, AstNode* node);
+static void analyze_do(Analyzer* a, AstNode* node);
 static void analyze_builtin_call(Analyzer* a, AstNode* node);
 
 
@@ -135,27 +159,123 @@ static void analyze_quote(Analyzer* a, AstNode* node){
     int arg_count = count_args(node->cdr);
 
     if (arg_count != 1) {
-        report_error(node->line, node->column,
+        report_error(a->errors, node->line, node->column,
             "'quote' requires exactly 1 argument, got %d", arg_count);
         return;
     }
 }
 
 
+// Functions. codegen compiles each lambda, function define and let, except
+// a let inlined into a loop, into a function of its own, so each gets its
+// own slots and captures here.
+
+static void begin_function(Analyzer* a, FunctionState* function){
+    function->enclosing = a->function;
+    function->depth = a->function ? a->function->depth + 1 : 1;
+    function->local_count = 0;
+    function->capture_count = 0;
+    function->is_let = false;
+    a->function = function;
+}
+
+
+static void end_function(Analyzer* a, AstNode* form){
+    FunctionState* function = a->function;
+
+    form->capture_count = function->capture_count;
+    if (function->capture_count > 0) {
+        size_t size = sizeof(Capture) * function->capture_count;
+        form->captures = (Capture*)arena_alloc(a->scanner->arena, size);
+        memcpy(form->captures, function->captures, size);
+    }
+    a->function = function->enclosing;
+}
+
+
+// value is the initial value of a let variable, or NULL for a parameter
+static Symbol* declare_local(Analyzer* a, AstNode* name, AstNode* value){
+    Symbol* symbol = add_symbol(a->current_scope, name->token);
+    if (value) {
+        symbol->type = value->value_type;
+        symbol->return_type = value->return_type;
+    }
+
+    if (a->function->local_count == UINT8_MAX) {
+        report_error(a->errors, name->line, name->column, "Too many local variables in function");
+        return symbol;
+    }
+    symbol->depth = a->function->depth;
+    symbol->slot = a->function->local_count++;
+    return symbol;
+}
+
+
+static int add_capture(Analyzer* a, FunctionState* function, uint8_t index, bool is_local, AstNode* node){
+    for (int i = 0; i < function->capture_count; i++) {
+        Capture* capture = &function->captures[i];
+        if (capture->index == index && capture->is_local == is_local) {
+            return i;
+        }
+    }
+
+    if (function->capture_count == UINT8_MAX + 1) {
+        report_error(a->errors, node->line, node->column, "Too many captured variables in function");
+        return -1;
+    }
+
+    function->captures[function->capture_count].index = index;
+    function->captures[function->capture_count].is_local = is_local;
+    return function->capture_count++;
+}
+
+
+// Threads a captured local through every function between the one that
+// binds it and the one that refers to it. Lets alone do not mark it
+// captured: they have returned before the local can change.
+static int resolve_capture(Analyzer* a, FunctionState* function, Symbol* symbol, AstNode* node,
+                           bool escapes){
+    escapes |= !function->is_let;
+    if (function->enclosing->depth == symbol->depth) {
+        symbol->captured |= escapes;
+        return add_capture(a, function, (uint8_t)symbol->slot, true, node);
+    }
+
+    int index = resolve_capture(a, function->enclosing, symbol, node, escapes);
+    if (index == -1) return -1;
+    return add_capture(a, function, (uint8_t)index, false, node);
+}
+
+
+static void resolve_binding(Analyzer* a, AstNode* node, Symbol* symbol){
+    if (symbol->slot == -1) {
+        node->binding = BINDING_GLOBAL;
+    } else if (symbol->depth == a->function->depth) {
+        node->binding = BINDING_LOCAL;
+        node->slot = symbol->slot;
+    } else {
+        node->binding = BINDING_UPVALUE;
+        node->slot = resolve_capture(a, a->function, symbol, node, false);
+    }
+}
+
+
 static void analyze_lambda(Analyzer* a, AstNode* node){
     AstNode* args = node->cdr->car;
     AstNode* body = node->cdr->cdr;
 
     // Create new scope for lambda
+    FunctionState function;
+    begin_function(a, &function);
     Scope* lambda_scope = init_scope(a->current_scope);
     a->current_scope = lambda_scope;
 
     // Analyze arguments and add to scope
     while (args && args->type != NODE_NIL) {
         if (args->car->type != NODE_ATOM || args->car->token->type != TOKEN_IDENTIFIER) {
-            report_error(args->line, args->column, "Lambda arguments must be identifiers");
+            report_error(a->errors, args->line, args->column, "Lambda arguments must be identifiers");
         } else {
-            add_symbol(a->current_scope, args->car->token);
+            declare_local(a, args->car, NULL);
         }
         args = args->cdr;
     }
@@ -168,16 +288,23 @@ static void analyze_lambda(Analyzer* a, AstNode* node){
     // restore previous scope
     a->current_scope = lambda_scope->parent;
     free_scope(lambda_scope);
+    end_function(a, node);
+
+    node->value_type = VAL_PROCEDURE;
+    node->return_type = body_type(node->cdr->cdr);
 }
 
 
+// let is compiled as a call to a lambda: the values are evaluated in the
+// enclosing function, and the variables become the lambda's parameters
 static void analyze_let(Analyzer* a, AstNode* node) {
     AstNode* bindings = node->cdr->car;
     AstNode* body = node->cdr->cdr;
 
-    // Create a new scope
-    Scope* let_scope = init_scope(a->current_scope);
-    a->current_scope = let_scope;
+    if (bindings->type == NODE_ATOM && bindings->token->type == TOKEN_IDENTIFIER) {
+        analyze_named_let(a, node);
+        return;
+    }
 
     // Analyze bindings
     AstNode* current = bindings;
@@ -185,25 +312,34 @@ static void analyze_let(Analyzer* a, AstNode* node) {
         AstNode* pair = current->car;
         // Check syntax: (var val)
         if (count_args(pair) != 2) {
-             report_error(pair->line, pair->column, "Invalid let binding");
+             report_error(a->errors, pair->line, pair->column, "Invalid let binding");
              return;
         }
-        
-        AstNode* var = pair->car;
-        AstNode* val = pair->cdr->car;
-        
+
         // Analyze the value expression *in the PARENT scope*
         // (Scheme 'let' does not allow bindings to refer to each other)
-        a->current_scope = let_scope->parent; 
-        analyze_node(a, val);
-        a->current_scope = let_scope; // Switch back
+        analyze_node(a, pair->cdr->car);
 
-        // Add variable to the new scope
+        current = current->cdr;
+    }
+
+    // Create a new scope. A let inlined into a loop binds its variables in
+    // slots of the loop's function, which branches after it reuse.
+    FunctionState function;
+    int local_count = a->function ? a->function->local_count : 0;
+    if (!node->inlined) {
+        begin_function(a, &function);
+        function.is_let = true;
+    }
+    Scope* let_scope = init_scope(a->current_scope);
+    a->current_scope = let_scope;
+
+    // Add variables to the new scope
+    for (current = bindings; current && current->type != NODE_NIL; current = current->cdr) {
+        AstNode* var = current->car->car;
         if (var->type == NODE_ATOM && var->token->type == TOKEN_IDENTIFIER) {
-            add_symbol(a->current_scope, var->token);
+            declare_local(a, var, current->car->cdr->car);
         }
-
-        current = current->cdr;
     }
 
     // Analyze body
@@ -216,6 +352,294 @@ static void analyze_let(Analyzer* a, AstNode* node) {
     // Restore scope
     a->current_scope = let_scope->parent;
     free_scope(let_scope);
+    if (node->inlined) {
+        a->function->local_count = local_count;
+    } else {
+        end_function(a, node);
+    }
+
+    node->value_type = body_type(body);
+}
+
+
+// Loops. A named let or do is compiled like a let: a call of a function
+// whose parameters are the loop variables. Inside it, the next iteration
+// reassigns the variables and jumps back to the top, unless a nested
+// function captures one of them and must keep the values of its own
+// iteration. The slot after the variables is reserved for the function's
+// own closure, which is stored there when the loop also makes real calls
+// or when lets inlined into the loop take the slots after it.
+
+typedef struct {
+    AstNode* node;
+    AstNode* bindings;      // ((var init [step]) ...)
+    AstNode* name;          // Named let only
+    bool is_do;
+    int count;
+    ValueType types[UINT8_MAX];     // Assumed types of the variables
+    bool untyped[UINT8_MAX];        // Assumption broken by an assigned value
+} Loop;
+
+
+static AstNode* last_expr(AstNode* body){
+    AstNode* last = NULL;
+    for (; body && body->type != NODE_NIL; body = body->cdr) {
+        last = body->car;
+    }
+    return last;
+}
+
+
+static void check_loop_value(Loop* loop, int index, AstNode* value){
+    if (value->value_type != loop->types[index]) {
+        loop->untyped[index] = true;
+    }
+}
+
+
+// Marks the lets in tail position of a named let's body, so that calls of
+// the loop in their bodies are in the loop's function and can jump. Returns
+// whether there are any.
+static bool mark_tail_lets(AstNode* expr){
+    if (!expr || expr->type != NODE_LIST || expr->car->type != NODE_ATOM || !expr->cdr) {
+        return false;
+    }
+
+    AstNode* args = expr->cdr;
+    bool found = false;
+
+    switch (expr->car->token->type) {
+        case TOKEN_IF:
+            found = mark_tail_lets(get_arg(args, 1));
+            return mark_tail_lets(get_arg(args, 2)) || found;
+
+        case TOKEN_CASE:
+            args = args->cdr;
+            // Fall through
+        case TOKEN_COND:
+            for (; args && args->type != NODE_NIL; args = args->cdr) {
+                found |= mark_tail_lets(last_expr(args->car->cdr));
+            }
+            return found;
+
+        case TOKEN_AND:
+        case TOKEN_OR:
+            return mark_tail_lets(last_expr(args));
+
+        case TOKEN_LET:
+            if (!args->car || args->car->type == NODE_ATOM) return false;
+            expr->inlined = true;
+            mark_tail_lets(last_expr(args->cdr));
+            return true;
+
+        default:
+            return false;
+    }
+}
+
+
+// Marks the calls of the loop in tail position of expr, where nothing else
+// is left on the stack, and returns how many there are. Nested functions
+// are not entered: a jump cannot leave the function.
+static int mark_loop_jumps(Loop* loop, int self_slot, AstNode* expr){
+    if (!expr || expr->type != NODE_LIST || expr->car->type != NODE_ATOM) return 0;
+
+    AstNode* args = expr->cdr;
+    int jumps = 0;
+
+    switch (expr->car->token->type) {
+        case TOKEN_IF:
+            return mark_loop_jumps(loop, self_slot, get_arg(args, 1)) +
+                   mark_loop_jumps(loop, self_slot, get_arg(args, 2));
+
+        case TOKEN_CASE:
+            args = args->cdr;
+            // Fall through
+        case TOKEN_COND:
+            for (; args && args->type != NODE_NIL; args = args->cdr) {
+                jumps += mark_loop_jumps(loop, self_slot, last_expr(args->car->cdr));
+            }
+            return jumps;
+
+        case TOKEN_AND:
+        case TOKEN_OR:
+            return mark_loop_jumps(loop, self_slot, last_expr(args));
+
+        case TOKEN_LET:
+            return expr->inlined ? mark_loop_jumps(loop, self_slot, last_expr(args->cdr)) : 0;
+
+        case TOKEN_IDENTIFIER: {
+            AstNode* operator = expr->car;
+            if (operator->binding != BINDING_LOCAL || operator->slot != self_slot ||
+                count_args(args) != loop->count) {
+                return 0;
+            }
+
+            expr->loop_jump = true;
+            for (int i = 0; i < loop->count; i++, args = args->cdr) {
+                check_loop_value(loop, i, args->car);
+            }
+            return 1;
+        }
+
+        default:
+            return 0;
+    }
+}
+
+
+// One pass over the loop's function, assuming loop->types. Returns whether
+// the assumption held.
+static bool analyze_loop_pass(Analyzer* a, Loop* loop){
+    FunctionState function;
+    begin_function(a, &function);
+    Scope* loop_scope = init_scope(a->current_scope);
+    a->current_scope = loop_scope;
+
+    Symbol* vars[UINT8_MAX];
+    int i = 0;
+    for (AstNode* b = loop->bindings; b && b->type != NODE_NIL; b = b->cdr, i++) {
+        vars[i] = declare_local(a, b->car->car, b->car->cdr->car);
+        vars[i]->type = loop->types[i];
+        vars[i]->return_type = VAL_ANY;
+        loop->untyped[i] = false;
+    }
+
+    int self_slot = a->function->local_count++;
+    Symbol* self = NULL;
+    if (loop->name) {
+        self = add_symbol(a->current_scope, loop->name->token);
+        self->depth = a->function->depth;
+        self->slot = self_slot;
+        self->type = VAL_PROCEDURE;
+    }
+
+    bool captured = false;
+    bool escapes;
+    bool has_lets = false;
+
+    if (loop->is_do) {
+        AstNode* exit_clause = loop->node->cdr->cdr->car;
+        for (AstNode* e = exit_clause; e && e->type != NODE_NIL; e = e->cdr) {
+            analyze_node(a, e->car);
+        }
+        for (AstNode* e = loop->node->cdr->cdr->cdr; e && e->type != NODE_NIL; e = e->cdr) {
+            analyze_node(a, e->car);
+        }
+
+        i = 0;
+        for (AstNode* b = loop->bindings; b && b->type != NODE_NIL; b = b->cdr, i++) {
+            AstNode* step = b->car->cdr->cdr;
+            if (step && step->type != NODE_NIL) {
+                analyze_node(a, step->car);
+                check_loop_value(loop, i, step->car);
+            }
+        }
+
+        for (i = 0; i < loop->count; i++) captured |= vars[i]->captured;
+        loop->node->loop_jump = !captured;
+        escapes = captured;
+        loop->node->value_type = body_type(exit_clause->cdr);
+    } else {
+        AstNode* body = loop->node->cdr->cdr->cdr;
+        has_lets = mark_tail_lets(last_expr(body));
+        for (AstNode* e = body; e && e->type != NODE_NIL; e = e->cdr) {
+            analyze_node(a, e->car);
+        }
+
+        for (i = 0; i < loop->count; i++) captured |= vars[i]->captured;
+        int jumps = captured ? 0 : mark_loop_jumps(loop, self_slot, last_expr(body));
+        escapes = self->uses > jumps;
+        loop->node->value_type = body_type(body);
+
+        // Calls other than the loop's own jumps may pass anything
+        for (i = 0; escapes && i < loop->count; i++) {
+            loop->untyped[i] = true;
+        }
+    }
+    loop->node->slot = escapes || has_lets ? self_slot : -1;
+
+    a->current_scope = loop_scope->parent;
+    free_scope(loop_scope);
+    end_function(a, loop->node);
+
+    bool held = true;
+    for (i = 0; i < loop->count; i++) {
+        if (loop->untyped[i] && loop->types[i] != VAL_ANY) {
+            loop->types[i] = VAL_ANY;
+            held = false;
+        }
+    }
+    return held;
+}
+
+
+// Loop variables start with the types of their initial values. A pass that
+// finds a variable assigned a value of another type drops its type and
+// analyzes the body again, until the types are consistent.
+static void analyze_loop(Analyzer* a, Loop* loop){
+    loop->count = 0;
+    for (AstNode* b = loop->bindings; b && b->type != NODE_NIL; b = b->cdr) {
+        AstNode* binding = b->car;
+        int parts = count_args(binding);
+
+        if (binding->type != NODE_LIST || binding->car->type != NODE_ATOM ||
+            binding->car->token->type != TOKEN_IDENTIFIER ||
+            parts < 2 || parts > (loop->is_do ? 3 : 2)) {
+            report_error(a->errors, binding->line, binding->column,
+                        loop->is_do ? "Invalid do binding" : "Invalid let binding");
+            return;
+        }
+        if (loop->count == UINT8_MAX - 1) {
+            report_error(a->errors, binding->line, binding->column, "Too many loop variables");
+            return;
+        }
+
+        // Initial values are evaluated outside the loop
+        analyze_node(a, binding->cdr->car);
+        loop->types[loop->count] = binding->cdr->car->value_type;
+        if (loop->types[loop->count] == VAL_PROCEDURE) {
+            loop->types[loop->count] = VAL_ANY;
+        }
+        loop->count++;
+    }
+
+    while (!analyze_loop_pass(a, loop) && !had_error(a->errors)) {
+    }
+}
+
+
+// (let name ((var init) ...) body ...)
+static void analyze_named_let(Analyzer* a, AstNode* node){
+    if (count_args(node->cdr) < 3) {
+        report_error(a->errors, node->line, node->column,
+                    "Named 'let' requires a name, bindings and a body");
+        return;
+    }
+
+    Loop loop;
+    loop.node = node;
+    loop.name = node->cdr->car;
+    loop.bindings = node->cdr->cdr->car;
+    loop.is_do = false;
+    analyze_loop(a, &loop);
+}
+
+
+// (do ((var init [step]) ...) (test expr ...) command ...)
+static void analyze_do(Analyzer* a, AstNode* node){
+    if (count_args(node->cdr) < 2 || node->cdr->cdr->car->type != NODE_LIST) {
+        report_error(a->errors, node->line, node->column,
+                    "'do' requires bindings and a (test expr ...) clause");
+        return;
+    }
+
+    Loop loop;
+    loop.node = node;
+    loop.name = NULL;
+    loop.bindings = node->cdr->car;
+    loop.is_do = true;
+    analyze_loop(a, &loop);
 }
 
 
@@ -223,7 +647,7 @@ static void analyze_if(Analyzer* a, AstNode* node){
     int arg_count = count_args(node->cdr);
 
     if (arg_count < 2 || arg_count > 3) {
-        report_error(node->line, node->column,
+        report_error(a->errors, node->line, node->column,
             "'if' requires 2 or 3 arguments (condition then [else]), got %d", arg_count);
         return;
     }
@@ -235,17 +659,23 @@ static void analyze_if(Analyzer* a, AstNode* node){
     if (condition) analyze_node(a, condition);
     if (then_branch) analyze_node(a, then_branch);
     if (else_branch) analyze_node(a, else_branch);
+
+    node->value_type = join_types(then_branch->value_type,
+                                  else_branch ? else_branch->value_type : VAL_NIL);
 }
 
 
 static void analyze_cond(Analyzer* a, AstNode* node){
     AstNode* clauses = node->cdr;
+    ValueType type = VAL_NIL;   // The value when no clause matches
+    bool has_else = false;
+    bool typed = false;
 
     while (clauses && clauses->type != NODE_NIL){
         AstNode* clause = clauses->car;
 
         if(!clauses || clause->type != NODE_LIST || !clause->car){
-            report_error(node->line, node->column,
+            report_error(a->errors, node->line, node->column,
                         "Invalid 'cond' clause: Expected a list with at least a condition");
             return;
         }
@@ -261,7 +691,7 @@ static void analyze_cond(Analyzer* a, AstNode* node){
         } else {
             // 'else' is optional and must be last - check if there are more clauses
             if (clauses->cdr && clauses->cdr->type != NODE_NIL) {
-                report_error(condition->line, condition->column,
+                report_error(a->errors, condition->line, condition->column,
                              "'else' clause must be the last clause in 'cond'");
                 return;  // Stop processing after error
             }
@@ -273,9 +703,57 @@ static void analyze_cond(Analyzer* a, AstNode* node){
             result = result->cdr;
         }
 
+        ValueType clause_type = body_type(clause->cdr);
+        type = typed ? join_types(type, clause_type) : clause_type;
+        typed = true;
+        has_else = is_else;
+
         clauses = clauses->cdr;
     }
 
+    node->value_type = has_else ? type : join_types(type, VAL_NIL);
+}
+
+
+// (case key ((datum ...) expr ...) ... (else expr ...)); the data are
+// quoted, so only the key and the clause bodies are analyzed
+static void analyze_case(Analyzer* a, AstNode* node){
+    AstNode* args = node->cdr;
+
+    if (!args || args->type == NODE_NIL){
+        report_error(a->errors, node->line, node->column, "'case' requires a key expression");
+        return;
+    }
+
+    analyze_node(a, args->car);
+
+    for (AstNode* clauses = args->cdr; clauses && clauses->type != NODE_NIL; clauses = clauses->cdr){
+        AstNode* clause = clauses->car;
+
+        if (clause->type != NODE_LIST || !clause->car){
+            report_error(a->errors, node->line, node->column,
+                        "Invalid 'case' clause: Expected a list of data followed by expressions");
+            return;
+        }
+
+        AstNode* data = clause->car;
+        bool is_else = (data->type == NODE_ATOM && data->token->type == TOKEN_ELSE);
+
+        if (is_else && clauses->cdr && clauses->cdr->type != NODE_NIL){
+            report_error(a->errors, data->line, data->column,
+                        "'else' clause must be the last clause in 'case'");
+            return;
+        }
+        if (!is_else && data->type != NODE_LIST && data->type != NODE_NIL){
+            report_error(a->errors, data->line, data->column,
+                        "'case' clause must start with a list of data");
+            return;
+        }
+
+        for (AstNode* body = clause->cdr; body && body->type != NODE_NIL; body = body->cdr){
+            analyze_node(a, body->car);
+        }
+    }
 }
 
 
@@ -287,19 +765,22 @@ static void analyze_define(Analyzer* a, AstNode* node){
         AstNode* name_node = first_arg->car;
 
         if(name_node->type != NODE_ATOM || name_node->token->type != TOKEN_IDENTIFIER){
-            report_error(first_arg->line, first_arg->column, "Invalid function name");
+            report_error(a->errors, first_arg->line, first_arg->column, "Invalid function name");
             return;
         }
 
+        // define always binds a global, even inside a function body
         add_symbol(a->current_scope, name_node->token);
 
+        FunctionState function;
+        begin_function(a, &function);
         Scope* func_scope = init_scope(a->current_scope);
         a->current_scope = func_scope;
 
         AstNode* params = first_arg->cdr;
         while(params && params->type != NODE_NIL){
             if(params->car->type == NODE_ATOM && params->car->token->type == TOKEN_IDENTIFIER){
-                add_symbol(func_scope, params->car->token);
+                declare_local(a, params->car, NULL);
             }
             params = params->cdr;
         }
@@ -312,12 +793,13 @@ static void analyze_define(Analyzer* a, AstNode* node){
 
         a->current_scope = func_scope->parent;
         free_scope(func_scope);
+        end_function(a, node);
         
         return;
     } else {
         
         if (count_args(args) != 2){
-            report_error(node->line, node->column,
+            report_error(a->errors, node->line, node->column,
                         "'define' requires 2 arguments (variable expression), got %d", count_args(args));
             return;
         }
@@ -326,7 +808,7 @@ static void analyze_define(Analyzer* a, AstNode* node){
         AstNode* expr = args->cdr->car;
 
         if (var->type != NODE_ATOM || var->token->type != TOKEN_IDENTIFIER){
-            report_error(var->line, var->column,
+            report_error(a->errors, var->line, var->column,
                         "'define' requires an identifier as the first argument");
             return;
         }
@@ -339,6 +821,35 @@ static void analyze_define(Analyzer* a, AstNode* node){
 }
 
 
+// Only globals may be assigned: inferred types rely on locals never changing
+static void analyze_set(Analyzer* a, AstNode* node){
+    AstNode* args = node->cdr;
+
+    if (count_args(args) != 2){
+        report_error(a->errors, node->line, node->column,
+                    "'set!' requires 2 arguments (variable expression), got %d", count_args(args));
+        return;
+    }
+
+    AstNode* var = args->car;
+    if (var->type != NODE_ATOM || var->token->type != TOKEN_IDENTIFIER){
+        report_error(a->errors, var->line, var->column,
+                    "'set!' requires an identifier as the first argument");
+        return;
+    }
+
+    analyze_node(a, var);
+    if (had_error(a->errors)) return;
+    if (var->binding != BINDING_GLOBAL){
+        report_error(a->errors, var->line, var->column,
+                    "'set!' of local variable '%s' is not supported", var->token->lexeme);
+        return;
+    }
+
+    analyze_node(a, args->cdr->car);
+}
+
+
 static void analyze_op(Analyzer* a, AstNode* node){
     AstNode* args = node->cdr;
 
@@ -361,6 +872,9 @@ static void analyze_special_form(Analyzer* a, AstNode* node) {
         case TOKEN_COND:
             analyze_cond(a, node);
             break;
+        case TOKEN_CASE:
+            analyze_case(a, node);
+            break;
         case TOKEN_AND:
         case TOKEN_OR:
             analyze_op(a, node);
@@ -368,6 +882,9 @@ static void analyze_special_form(Analyzer* a, AstNode* node) {
         case TOKEN_DEFINE:
             analyze_define(a, node);
             break;
+        case TOKEN_SET:
+            analyze_set(a, node);
+            break;
         case TOKEN_QUOTE:
             analyze_quote(a, node);
             break;
@@ -377,15 +894,18 @@ static void analyze_special_form(Analyzer* a, AstNode* node) {
         case TOKEN_LET:
             analyze_let(a, node);
             break;
+        case TOKEN_DO:
+            analyze_do(a, node);
+            break;
         case TOKEN_LET_STAR:
         case TOKEN_LETREC:
         case TOKEN_LETREC_STAR:
             // Placeholder: analyze_let(a, node);
-            report_error(node->line, node->column, 
+            report_error(a->errors, node->line, node->column, 
                         "'let' special form not yet implemented in analyzer");
             break;
         default:
-            report_error(node->line, node->column, 
+            report_error(a->errors, node->line, node->column, 
                         "Special form not yet implemented");
     }
 }
@@ -395,20 +915,23 @@ static void analyze_builtin_call(Analyzer* a, AstNode* node) {
     AstNode* operator = node->car;
     AstNode* arg = node->cdr;
 
-    if (operator && operator->type == NODE_ATOM && operator->token->type == TOKEN_IDENTIFIER) {
+    // A local variable may shadow the builtin's name
+    if (operator && operator->type == NODE_ATOM && operator->token->type == TOKEN_IDENTIFIER &&
+        operator->binding == BINDING_GLOBAL) {
         const BuiltinInfo* info = get_builtin_info(operator->token->lexeme);
 
         if(info) {
             int arg_count = count_args(arg);
+            node->value_type = info->result_type;
 
             if(info->min_arity != -1 && arg_count < info->min_arity){
-                report_error(operator->line, operator->column, 
+                report_error(a->errors, operator->line, operator->column, 
                              "Too few arguments to '%s'. Expected at least %d, got %d.",
                              info->name, info->min_arity, arg_count);
             }
 
             if(info->max_arity != -1 && arg_count > info->max_arity){
-                report_error(operator->line, operator->column, 
+                report_error(a->errors, operator->line, operator->column, 
                              "Too many arguments to '%s'. Expected at most %d, got %d.",
                              info->name, info->max_arity, arg_count);
             }
@@ -420,7 +943,7 @@ static void analyze_builtin_call(Analyzer* a, AstNode* node) {
                 while(temp_arg && temp_arg->type != NODE_NIL){
                     ValueType arg_type = get_node_type(temp_arg->car);
                     if(arg_type != VAL_ANY && arg_type != info->arg_type){
-                        report_error(temp_arg->car->line, temp_arg->car->column, 
+                        report_error(a->errors, temp_arg->car->line, temp_arg->car->column, 
                                      "Argument %d to '%s' has incorrect type. Expected %s, got %s.",
                                      position, info->name, type_to_string(info->arg_type), type_to_string(arg_type));
                     }
@@ -433,30 +956,27 @@ static void analyze_builtin_call(Analyzer* a, AstNode* node) {
 }
 
 
-static Token* create_builtin_token(const char* name){
-    Token* t = (Token*)malloc(sizeof(Token));
-
-    if (!t){
-        exit(1);
-    }
-
-    t->lexeme = strdup(name);
-    t->type = TOKEN_IDENTIFIER;
-    return t;
+static Token* create_builtin_token(Analyzer* a, const char* name){
+    // Interned in the scanner's table so lookups match source identifiers by id
+    return create_symbol_token(&a->arena, intern_name(a->scanner, name));
 }
 
 
-Analyzer* init_analyzer() {
+Analyzer* init_analyzer(Parser* p) {
 
     Analyzer* a = (Analyzer*)malloc(sizeof(Analyzer));
+    a->scanner = &p->scanner;
+    a->errors = p->errors;
 
     a->current_scope = init_scope(NULL);
+    a->function = NULL;
 
     a->builtin_token_count = 0;
+    init_arena(&a->arena);
 
     const char* builtins[] = {
         // I/O procedures
-        "display", "newline", "read", "write", "print",
+        "display", "newline", "read", "read-line", "write", "print", "flush-output",
         
         // Arithmetic operators
         "+", "-", "*", "/", "modulo", "remainder", "quotient",
@@ -467,7 +987,38 @@ Analyzer* init_analyzer() {
         
         // List manipulation
         "car", "cdr", "cons", "list", "append", "reverse", "length",
-        "map", "filter", "reduce", "apply",
+        "map", "filter", "reduce", "apply", "memq", "memv", "member", "assq", "assv", "assoc",
+
+        // Vectors
+        "make-vector", "vector", "vector-ref", "vector-set!", "vector-length", "vector?",
+
+        // Strings and string ports
+        "string-length", "string-append", "string=?", "number->string",
+        "symbol->string", "string->symbol",
+        "open-output-string", "write-string", "get-output-string",
+
+        // Hash tables
+        "make-hash-table", "hash-table?", "hash-table-set!", "hash-table-ref",
+        "hash-table-ref/default", "hash-table-contains?", "hash-table-update!/default",
+        "hash-table-delete!", "hash-table-count", "hash-table-keys", "hash-table-values",
+        "hash-table->alist", "hash-table-walk",
+
+        // Continuations and generators
+        "call/cc", "call-with-current-continuation", "make-generator", "generator?",
+
+        // Green threads and channels
+        "spawn", "thread?", "thread-join", "thread-yield",
+        "make-channel", "channel?", "channel-send", "channel-receive",
+
+        // Homogeneous numeric vectors
+        "make-f64vector", "f64vector", "f64vector-ref", "f64vector-set!", "f64vector-length",
+        "f64vector?", "f64vector-sum", "f64vector-dot", "f64vector-add", "f64vector-mul",
+        "f64vector-scale", "f64vector-min", "f64vector-max", "f64vector-fill!",
+        "f64vector-copy", "f64vector->list", "list->f64vector",
+        "make-u8vector", "u8vector", "u8vector-ref", "u8vector-set!", "u8vector-length",
+        "u8vector?", "u8vector-sum", "u8vector-dot", "u8vector-add", "u8vector-mul",
+        "u8vector-scale", "u8vector-min", "u8vector-max", "u8vector-fill!",
+        "u8vector-copy", "u8vector->list", "list->u8vector",
         
         // Type predicates
         "null?", "pair?", "list?", "symbol?", "number?", "integer?",
@@ -486,7 +1037,7 @@ Analyzer* init_analyzer() {
     };
 
     for(int i = 0; builtins[i] != NULL; i++){
-        Token* t = create_builtin_token(builtins[i]);
+        Token* t = create_builtin_token(a, builtins[i]);
         add_symbol(a->current_scope, t);
 
         if(a->builtin_token_count < MAX_BUILTINS){
@@ -498,13 +1049,18 @@ Analyzer* init_analyzer() {
 }
 
 
-void free_analyzer(Analyzer* a) {
-    for(int i = 0; i < a->builtin_token_count;i++){
-        free(a->builtin_tokens[i]->lexeme);
-        free(a->builtin_tokens[i]);
+void declare_global(Analyzer* a, const char* name) {
+    Scope* global = a->current_scope;
+    while (global->parent) {
+        global = global->parent;
     }
+    add_symbol(global, create_builtin_token(a, name));
+}
+
 
+void free_analyzer(Analyzer* a) {
     free_scope(a->current_scope);
+    free_arena(&a->arena);
 
     free(a);
 }
@@ -512,21 +1068,46 @@ void free_analyzer(Analyzer* a) {
 
 bool analyze_ast(Analyzer* a, AstNode* root){
     analyze_node(a, root);
-    return !had_error();
+    return !had_error(a->errors);
 }
 
 
 static void analyze_node(Analyzer* a, AstNode* node){
-    if (node == NULL || node->type == NODE_NIL) return;
+    if (node == NULL) return;
 
     switch(node->type){
+        case NODE_NIL:
+            break;
+
         case NODE_ATOM:{
             if(node->token->type == TOKEN_IDENTIFIER){
                 Symbol* sym = find_symbol(a->current_scope, node->token);
                 if (!sym){
-                    report_error(node->line, node->column, 
+                    report_error(a->errors, node->line, node->column, 
                                 "Undefined identifier: %s", node->token->lexeme);
+                } else {
+                    sym->uses++;
+                    resolve_binding(a, node, sym);
+                    node->value_type = sym->type;
+                    node->return_type = sym->return_type;
                 }
+                break;
+            }
+
+            switch(node->token->type){
+                case TOKEN_DEC:
+                case TOKEN_REAL:
+                    node->value_type = VAL_NUMBER;
+                    break;
+                case TOKEN_STR_LITERAL:
+                    node->value_type = VAL_STRING;
+                    break;
+                case TOKEN_TRUE:
+                case TOKEN_FALSE:
+                    node->value_type = VAL_BOOL;
+                    break;
+                default:
+                    break;
             }
             break;
         }
@@ -541,12 +1122,17 @@ static void analyze_node(Analyzer* a, AstNode* node){
                 return;
             }
 
-            analyze_builtin_call(a, node);
-
             while(arg && arg->type != NODE_NIL){
                 analyze_node(a, arg->car);
                 arg = arg->cdr;
             }
+
+            // Calling a local bound to a lambda, or a lambda directly
+            if (operator->value_type == VAL_PROCEDURE) {
+                node->value_type = operator->return_type;
+            }
+
+            analyze_builtin_call(a, node);
             break;
         }
     }
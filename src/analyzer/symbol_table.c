@@ -1,7 +1,6 @@
 #include <string.h>
 #include <stdlib.h>
 #include "../../include/analyzer/symbol_table.h"
-#include "utils/hash.h"
 
 #define INITIAL_CAPACITY 8
 
@@ -31,28 +30,35 @@ void free_scope(Scope* s){
 }
 
 
-bool add_symbol(Scope* s, Token* t){
-    unsigned int hash = hash_string(t->lexeme, strlen(t->lexeme));
-    unsigned int index = hash % s->capacity;
+Symbol* add_symbol(Scope* s, Token* t){
+    unsigned int index = t->hash % s->capacity;
 
     Symbol* new_symbol = (Symbol*)malloc(sizeof(Symbol));
-    new_symbol->token = t;
+    new_symbol->name = t->lexeme;
+    new_symbol->id = t->symbol;
+    new_symbol->hash = t->hash;
     new_symbol->state = SYMBOL_DECLARED;
+    new_symbol->depth = 0;
+    new_symbol->slot = -1;
+    new_symbol->type = VAL_ANY;
+    new_symbol->return_type = VAL_ANY;
+    new_symbol->uses = 0;
+    new_symbol->captured = false;
     new_symbol->next = s->table[index];
     s->table[index] = new_symbol;
     s->count++;
 
-    return true;
+    return new_symbol;
 }
 
 
 static Symbol* find_in_scope(Scope* s, Token* t){
-    unsigned int hash = hash_string(t->lexeme, strlen(t->lexeme));
-    unsigned int index = hash % s->capacity;
+    unsigned int index = t->hash % s->capacity;
 
+    // Names are interned by the scanner, so equal names have equal ids
     Symbol* sym = s->table[index];
     while(sym){
-        if(strcmp(t->lexeme, sym->token->lexeme) == 0){
+        if(t->symbol == sym->id){
             return sym;
         }
 
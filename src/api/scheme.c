@@ -0,0 +1,235 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "scheme.h"
+#include "parser/parser.h"
+#include "analyzer/analyzer.h"
+#include "codegen/codegen.h"
+#include "utils/arena.h"
+#include "utils/buffer.h"
+#include "utils/error.h"
+#include "utils/memory.h"
+
+// A VM plus a front end that stays alive with it, like the REPL: names the
+// VM has defined remain visible to everything compiled later.
+struct SchemeVM {
+    VM vm;
+    ErrorContext errors;
+    Arena arena;
+    Parser* parser;
+    Analyzer* analyzer;
+};
+
+struct SchemeProgram {
+    Bytecode* code;
+};
+
+
+SchemeVM* scheme_new(void) {
+    SchemeVM* s = (SchemeVM*)reallocate(NULL, 0, sizeof(SchemeVM));
+    init_vm(&s->vm);
+    init_error(&s->errors, "<embedded>");
+    s->errors.quiet = true;     // Never write to the host's stderr
+    init_arena(&s->arena);
+    s->parser = init_parser(NULL, &s->arena, &s->errors);
+    s->analyzer = init_analyzer(s->parser);
+    return s;
+}
+
+
+void scheme_free(SchemeVM* s) {
+    if (!s) return;
+
+    free_vm(&s->vm);
+    free_parser(s->parser);
+    free_analyzer(s->analyzer);
+    free_arena(&s->arena);
+    cleanup_error(&s->errors);
+    reallocate(s, sizeof(SchemeVM), 0);
+}
+
+
+SchemeProgram* scheme_compile(SchemeVM* s, const char* source, size_t length) {
+    Parser* p = s->parser;
+    clear_errors(&s->errors);
+    scan_text(&p->scanner, source, length);
+    reset_parser(p);
+
+    AstNode** forms = NULL;
+    int count = 0;
+    int capacity = 0;
+    while (p->current != NULL) {
+        AstNode* ast = parse_expression(p);
+        if (!ast) break;
+
+        if (count == capacity) {
+            int old_capacity = capacity;
+            capacity = GROW_CAPACITY(old_capacity);
+            forms = GROW_ARRAY(AstNode*, forms, old_capacity, capacity);
+        }
+        forms[count++] = ast;
+    }
+
+    for (int i = 0; i < count && !had_error(&s->errors); i++) {
+        analyze_ast(s->analyzer, forms[i]);
+    }
+
+    Bytecode* code = NULL;
+    if (!had_error(&s->errors)) {
+        code = compile_program(&s->arena, &s->errors, forms, count);
+        if (had_error(&s->errors)) {
+            free_bytecode(code);
+            free(code);
+            code = NULL;
+        }
+    }
+
+    // The bytecode owns its strings; drop the AST and the borrowed source
+    FREE_ARRAY(AstNode*, forms, capacity);
+    reset_arena(&s->arena);
+    scan_text(&p->scanner, "", 0);
+
+    if (!code) {
+        if (s->errors.first_message[0] != '\0') {
+            snprintf(s->vm.error_message, sizeof(s->vm.error_message),
+                     "%s", s->errors.first_message);
+        } else {
+            snprintf(s->vm.error_message, sizeof(s->vm.error_message),
+                     "%s: compilation failed", s->errors.filename);
+        }
+        return NULL;
+    }
+
+    SchemeProgram* program = (SchemeProgram*)reallocate(NULL, 0, sizeof(SchemeProgram));
+    program->code = code;
+    return program;
+}
+
+
+void scheme_free_program(SchemeProgram* program) {
+    if (!program) return;
+
+    free_bytecode(program->code);
+    free(program->code);
+    reallocate(program, sizeof(SchemeProgram), 0);
+}
+
+
+typedef struct {
+    const Bytecode* code;
+    Value result;
+} RunRequest;
+
+
+static void run_body(VM* vm, void* data) {
+    RunRequest* request = (RunRequest*)data;
+    int32_t base = vm->stack_top;
+
+    vm_execute(vm, request->code);
+
+    // Top-level code leaves the value of its last form on the stack
+    request->result = vm->stack_top > base ? pop(vm) : NIL_VAL;
+    vm->stack_top = base;
+}
+
+
+bool scheme_run(SchemeVM* s, const SchemeProgram* program, Value* result) {
+    RunRequest request = {program->code, NIL_VAL};
+    bool ok = vm_protect(&s->vm, run_body, &request);
+    flush_output(&s->vm.out);
+
+    if (ok && result) *result = request.result;
+    return ok;
+}
+
+
+bool scheme_eval(SchemeVM* s, const char* source, Value* result) {
+    SchemeProgram* program = scheme_compile(s, source, strlen(source));
+    if (!program) return false;
+
+    bool ok = scheme_run(s, program, result);
+    scheme_free_program(program);
+    return ok;
+}
+
+
+bool scheme_load_file(SchemeVM* s, const char* path) {
+    FILE* file = fopen(path, "r");
+    if (!file) {
+        snprintf(s->vm.error_message, sizeof(s->vm.error_message),
+                 "Could not open file '%s'", path);
+        return false;
+    }
+
+    SourceBuffer source;
+    init_source(&source);
+    bool loaded = load_source(&source, file);
+    fclose(file);
+    if (!loaded) {
+        snprintf(s->vm.error_message, sizeof(s->vm.error_message),
+                 "Error reading from file '%s'", path);
+        return false;
+    }
+
+    const char* filename = s->errors.filename;
+    s->errors.filename = path;
+    SchemeProgram* program = scheme_compile(s, source.data, source.length);
+    s->errors.filename = filename;
+    free_source(&source);
+
+    if (!program) return false;
+
+    bool ok = scheme_run(s, program, NULL);
+    scheme_free_program(program);
+    return ok;
+}
+
+
+bool scheme_get_global(SchemeVM* s, const char* name, Value* value) {
+    return table_get(&s->vm.globals, name, value);
+}
+
+
+typedef struct {
+    Value procedure;
+    int32_t arg_count;
+    const Value* args;
+    Value result;
+} CallRequest;
+
+
+static void call_body(VM* vm, void* data) {
+    CallRequest* request = (CallRequest*)data;
+    request->result = vm_call(vm, request->procedure, request->arg_count, request->args);
+}
+
+
+bool scheme_call(SchemeVM* s, Value procedure, int32_t arg_count, const Value* args, Value* result) {
+    CallRequest request = {procedure, arg_count, args, NIL_VAL};
+    bool ok = vm_protect(&s->vm, call_body, &request);
+    flush_output(&s->vm.out);
+
+    if (ok && result) *result = request.result;
+    return ok;
+}
+
+
+void scheme_define_native(SchemeVM* s, const char* name, int32_t arity, NativeFn function) {
+    define_native(&s->vm, name, arity, function);
+    declare_global(s->analyzer, name);
+}
+
+
+void scheme_set_thread_budget(SchemeVM* s, int32_t budget) {
+    s->vm.thread_budget = budget > 0 ? budget : 1;
+}
+
+
+const char* scheme_error(const SchemeVM* s) {
+    return s->vm.error_message;
+}
+
+
+VM* scheme_vm(SchemeVM* s) {
+    return &s->vm;
+}
@@ -7,29 +7,43 @@
 #include "parser/parser.h"
 #include "codegen/codegen.h"
 #include "instruction.h"
+#include "rope.h"
+#include "symbol.h"
 #include "token.h"
 #include "utils/error.h"
 #include "value.h"
 
+// Pending forward jumps are chained through their operands until patched.
+// Operands are 16 bits wide, so the end marker must fit in one.
+#define JUMP_CHAIN_END UINT16_MAX
+
 
 static void codegen_atom(Compiler* compiler, AstNode* ast);
 static void codegen_list(Compiler* compiler, AstNode* ast);
 static bool codegen_builtin(Compiler* compiler, const char* op, AstNode* args);
 static void codegen_if(Compiler* compiler, AstNode* ast);
 static void codegen_cond(Compiler* compiler, AstNode* ast);
+static void codegen_case(Compiler* compiler, AstNode* ast);
 static void codegen_and(Compiler* compiler, AstNode* ast);
 static void codegen_or(Compiler* compiler, AstNode* ast);
 static void codegen_define(Compiler* compiler, AstNode* ast);
+static void codegen_set(Compiler* compiler, AstNode* ast);
 static void codegen_quote(Compiler* compiler, AstNode* ast);
 static void codegen_lambda(Compiler* compiler, AstNode* ast);
-static ObjFunction* compile_function_obj(Compiler* compiler, AstNode* args, AstNode* body);
+static void codegen_named_let(Compiler* compiler, AstNode* ast);
+static void codegen_do(Compiler* compiler, AstNode* ast);
+static void codegen_loop_jump(Compiler* compiler, AstNode* steps);
+static void codegen_sequence(Compiler* compiler, AstNode* body);
+static ObjFunction* compile_function_obj(Compiler* compiler, AstNode* form, AstNode* args, AstNode* body);
 
 
 static void init_compiler(Compiler* compiler, Compiler* parent, int type){
     compiler->enclosing = parent;
+    compiler->arena = parent ? parent->arena : NULL;
+    compiler->errors = parent ? parent->errors : NULL;
     compiler->function = NULL;
-    compiler->local_count = 0;
-    compiler->scope_depth = 0;
+    compiler->loop_start = -1;
+    compiler->let_slots = 0;
 }
 
 
@@ -38,51 +52,14 @@ static Bytecode* current_chunk(Compiler* compiler){
 }
 
 
-static int resolve_local(Compiler* compiler, const char* name) {
-    for (int i = compiler->local_count - 1; i >= 0; i--) {
-        Local* local = &compiler->locals[i];
-        if (strcmp(name, local->name) == 0) {
-            return i;
-        }
-    }
-    return -1;
+static void emit_call(Bytecode* bc, int arg_count){
+    emit_instruction(bc, OP_CALL, arg_count);
 }
 
-static int add_upvalue(Compiler* compiler, uint8_t index, bool is_local) {
-    int upvalue_count = compiler->function->upvalue_count;
-
-    for (int i = 0; i < upvalue_count; i++) {
-        Upvalue* upvalue = &compiler->upvalues[i];
-        if (upvalue->index == index && upvalue->is_local == is_local) {
-            return i;
-        }
-    }
-
-    if (upvalue_count == UINT8_MAX + 1) {
-        // Too many closures!
-        return -1;
-    }
 
-    compiler->upvalues[upvalue_count].is_local = is_local;
-    compiler->upvalues[upvalue_count].index = index;
-    return compiler->function->upvalue_count++;
-}
-
-static int resolve_upvalue(Compiler* compiler, const char* name) {
-    if (compiler->enclosing == NULL) return -1;
-
-    int local = resolve_local(compiler->enclosing, name);
-    if (local != -1) {
-        compiler->enclosing->locals[local].is_captured = true;
-        return add_upvalue(compiler, (uint8_t)local, true);
-    }
-
-    int upvalue = resolve_upvalue(compiler->enclosing, name);
-    if (upvalue != -1) {
-        return add_upvalue(compiler, (uint8_t)upvalue, false);
-    }
-
-    return -1;
+// Constants must not point into the arena, which is released after compilation
+static Value copy_string(const char* chars){
+    return STRING_VAL(allocate_string(chars, strlen(chars)));
 }
 
 
@@ -91,6 +68,24 @@ static void codegen_let(Compiler* compiler, AstNode* ast) {
     AstNode* bindings = ast->cdr->car;
     AstNode* body = ast->cdr->cdr;
 
+    if (bindings->type == NODE_ATOM) {
+        codegen_named_let(compiler, ast);
+        return;
+    }
+
+    // Inlined into a loop: each value lands in the next slot of the loop's
+    // function, where the analyzer put the variable
+    if (ast->inlined) {
+        int count = 0;
+        for (; bindings && bindings->type != NODE_NIL; bindings = bindings->cdr, count++) {
+            codegen_expr(compiler, bindings->car->cdr->car);
+        }
+        compiler->let_slots += count;
+        codegen_sequence(compiler, body);
+        compiler->let_slots -= count;
+        return;
+    }
+
     // Build the argument list for the lambda first
     AstNode* args_head = NULL;
     AstNode* args_tail = NULL;
@@ -102,7 +97,7 @@ static void codegen_let(Compiler* compiler, AstNode* ast) {
         AstNode* var = pair->car; // The variable name node
         
         // Create a new cons node for this argument
-        AstNode* new_node = malloc(sizeof(AstNode));
+        AstNode* new_node = ARENA_NEW(compiler->arena, AstNode);
         new_node->type = NODE_LIST;
         new_node->car = var; 
         new_node->cdr = NULL;
@@ -124,14 +119,14 @@ static void codegen_let(Compiler* compiler, AstNode* ast) {
     
     // Terminate the list
     if (args_tail) {
-        args_tail->cdr = create_nil_node();
+        args_tail->cdr = nil_node();
     } else {
-        args_head = create_nil_node();
+        args_head = nil_node();
     }
 
     // Compile the implicit Lambda
     // This pushes the function object onto the stack FIRST
-    compile_function_obj(compiler, args_head, body);
+    compile_function_obj(compiler, ast, args_head, body);
 
     // Compile the values (arguments)
     // These are pushed onto the stack AFTER the function
@@ -146,7 +141,7 @@ static void codegen_let(Compiler* compiler, AstNode* ast) {
     }
 
     // Emit Call
-    emit_instruction(bc, OP_CALL, binding_count);
+    emit_call(bc, binding_count);
 }    
 
 
@@ -168,7 +163,7 @@ static void codegen_atom(Compiler* compiler, AstNode* ast){
         }
 
         case TOKEN_STR_LITERAL: {
-            int idx = add_constant(bc, STRING_VAL(token->lexeme));
+            int idx = add_constant(bc, copy_string(token->lexeme));
             emit_instruction(bc, OP_CONSTANT, idx);
             break;
         }
@@ -186,25 +181,25 @@ static void codegen_atom(Compiler* compiler, AstNode* ast){
         }
 
         case TOKEN_IDENTIFIER: {
-            const char* var_name = token->lexeme;
-            
-            int local_idx = resolve_local(compiler, var_name);
-            if (local_idx != -1) {
-                emit_instruction(bc, OP_GET_LOCAL, local_idx);
-            } else {
-                int upvalue_idx = resolve_upvalue(compiler, var_name);
-                if (upvalue_idx != -1) {
-                    emit_instruction(bc, OP_GET_UPVALUE, upvalue_idx);
-                } else {
-                    int idx = add_constant(bc, STRING_VAL(var_name));
+            // Resolved by the analyzer
+            switch (ast->binding) {
+                case BINDING_LOCAL:
+                    emit_instruction(bc, OP_GET_LOCAL, ast->slot);
+                    break;
+                case BINDING_UPVALUE:
+                    emit_instruction(bc, OP_GET_UPVALUE, ast->slot);
+                    break;
+                default: {
+                    int idx = add_constant(bc, copy_string(token->lexeme));
                     emit_instruction(bc, OP_GET_GLOBAL, idx);
+                    break;
                 }
             }
             break;
         }
 
         default:
-            report_error(ast->line, ast->column, 
+            report_error(compiler->errors, ast->line, ast->column, 
                         "Code generation error: Unknown atom type");
             break;
     }
@@ -229,6 +224,11 @@ static void codegen_list(Compiler* compiler, AstNode* ast){
             return;
         }
 
+        if (type == TOKEN_CASE) {
+            codegen_case(compiler, ast);
+            return;
+        }
+
         if (type == TOKEN_AND){
             codegen_and(compiler, ast);
             return;
@@ -244,6 +244,11 @@ static void codegen_list(Compiler* compiler, AstNode* ast){
             return;
         }
 
+        if (type == TOKEN_SET) {
+            codegen_set(compiler, ast);
+            return;
+        }
+
         if (type == TOKEN_QUOTE) {
             codegen_quote(compiler, ast);
             return;
@@ -258,6 +263,17 @@ static void codegen_list(Compiler* compiler, AstNode* ast){
             codegen_let(compiler, ast);
             return;
         }
+
+        if (type == TOKEN_DO) {
+            codegen_do(compiler, ast);
+            return;
+        }
+    }
+
+    // The next iteration of the enclosing loop
+    if (ast->loop_jump) {
+        codegen_loop_jump(compiler, ast->cdr);
+        return;
     }
 
     // Prepare for Function Call
@@ -267,13 +283,30 @@ static void codegen_list(Compiler* compiler, AstNode* ast){
     
     AstNode* args = ast->cdr;
     
-    // Builtin Optimization
-    if (car != NULL && car->type == NODE_ATOM && car->token->type == TOKEN_IDENTIFIER) {
+    // Builtin Optimization, unless a local variable shadows the builtin
+    if (car != NULL && car->type == NODE_ATOM && car->token->type == TOKEN_IDENTIFIER &&
+        car->binding == BINDING_GLOBAL) {
         if (codegen_builtin(compiler, car->token->lexeme, args)) {
             return;
         }
     }
 
+    // A global is looked up when it is called, through the VM's call cache
+    if (car != NULL && car->type == NODE_ATOM && car->token->type == TOKEN_IDENTIFIER &&
+        car->binding == BINDING_GLOBAL) {
+        Bytecode* bc = current_chunk(compiler);
+        int arg_count = 0;
+        for (AstNode* temp = args; temp && temp->type != NODE_NIL; temp = temp->cdr) {
+            codegen_expr(compiler, temp->car);
+            arg_count++;
+        }
+
+        int name_idx = add_constant(bc, copy_string(car->token->lexeme));
+        emit_instruction(bc, OP_CALL_GLOBAL, name_idx);
+        emit_instruction(bc, OP_ARG_COUNT, arg_count);
+        return;
+    }
+
     // Generic Function Call
     // Compile the function/operator
     codegen_expr(compiler, car);
@@ -288,7 +321,7 @@ static void codegen_list(Compiler* compiler, AstNode* ast){
     }
     
     // Emit CALL
-    emit_instruction(current_chunk(compiler), OP_CALL, arg_count);
+    emit_call(current_chunk(compiler), arg_count);
 }
 
 
@@ -317,45 +350,50 @@ static bool codegen_builtin(Compiler* compiler, const char* op, AstNode* args) {
         } else {
             // - and / require at least 1 argument
             if (arg_count == 0) {
-                report_error(args ? args->line : -1, args ? args->column : -1,
+                report_error(compiler->errors, args ? args->line : -1, args ? args->column : -1,
                             "Operator '%s' requires at least 1 argument, got 0", op);
                 return true; // Error handled
             }
         }
         
-        codegen_expr(compiler, args->car);
-        
-        // If only one argument for - or /, apply unary operation
-        if (arg_count == 1 && (strcmp(op, "-") == 0 || strcmp(op, "/") == 0)) {
-            if (strcmp(op, "-") == 0) {
-                // (- x) => 0 - x
-                int zero_idx = add_constant(bc, NUMBER_VAL(0.0));
-                emit_instruction(bc, OP_CONSTANT, zero_idx);
-                emit_instruction(bc, OP_SUB, 0);
-            } else {
-                // (/ x) => 1 / x
-                int one_idx = add_constant(bc, NUMBER_VAL(1.0));
-                emit_instruction(bc, OP_CONSTANT, one_idx);
-                emit_instruction(bc, OP_DIV, 0);
-            }
+        // Operands the analyzer proved are numbers skip the type check
+        Opcode checked, unchecked;
+        double identity;
+        if (strcmp(op, "+") == 0) {
+            checked = OP_ADD; unchecked = OP_ADD_NUMBER; identity = 0.0;
+        } else if (strcmp(op, "-") == 0) {
+            checked = OP_SUB; unchecked = OP_SUB_NUMBER; identity = 0.0;
+        } else if (strcmp(op, "*") == 0) {
+            checked = OP_MUL; unchecked = OP_MUL_NUMBER; identity = 1.0;
+        } else {
+            checked = OP_DIV; unchecked = OP_DIV_NUMBER; identity = 1.0;
+        }
+
+        if (arg_count == 1) {
+            // (- x) => 0 - x and (/ x) => 1 / x. (+ x) and (* x) also go
+            // through the operator, so a non-number is still an error.
+            bool unary = strcmp(op, "-") == 0 || strcmp(op, "/") == 0;
+            int idx = add_constant(bc, NUMBER_VAL(identity));
+
+            if (unary) emit_instruction(bc, OP_CONSTANT, idx);
+            codegen_expr(compiler, args->car);
+            if (!unary) emit_instruction(bc, OP_CONSTANT, idx);
+
+            emit_instruction(bc, args->car->value_type == VAL_NUMBER ? unchecked : checked, 0);
             return true;
         }
-        
-        args = args->cdr;
-        while (args && args->type != NODE_NIL) {
+
+        codegen_expr(compiler, args->car);
+        bool left_is_number = args->car->value_type == VAL_NUMBER;
+
+        for (args = args->cdr; args && args->type != NODE_NIL; args = args->cdr) {
             codegen_expr(compiler, args->car);
-            
-            if (strcmp(op, "+") == 0) {
-                emit_instruction(bc, OP_ADD, 0);
-            } else if (strcmp(op, "-") == 0) {
-                emit_instruction(bc, OP_SUB, 0);
-            } else if (strcmp(op, "*") == 0) {
-                emit_instruction(bc, OP_MUL, 0);
-            } else if (strcmp(op, "/") == 0) {
-                emit_instruction(bc, OP_DIV, 0);
-            }
-            
-            args = args->cdr;
+
+            bool unchecked_ok = left_is_number && args->car->value_type == VAL_NUMBER;
+            emit_instruction(bc, unchecked_ok ? unchecked : checked, 0);
+
+            // Every partial result is a number
+            left_is_number = true;
         }
         return true;
     }
@@ -365,12 +403,12 @@ static bool codegen_builtin(Compiler* compiler, const char* op, AstNode* args) {
         
         // Validate we have exactly 2 arguments
         if (args == NULL || args->type == NODE_NIL) {
-            report_error(args ? args->line : -1, args ? args->column : -1,
+            report_error(compiler->errors, args ? args->line : -1, args ? args->column : -1,
                         "Operator '%s' requires 2 arguments, got 0", op);
             return true;
         }
         if (args->cdr == NULL || args->cdr->type == NODE_NIL) {
-            report_error(args->line, args->column,
+            report_error(compiler->errors, args->line, args->column,
                         "Operator '%s' requires 2 arguments, got 1", op);
             return true;
         }
@@ -378,27 +416,30 @@ static bool codegen_builtin(Compiler* compiler, const char* op, AstNode* args) {
         codegen_expr(compiler, args->car);
         
         codegen_expr(compiler, args->cdr->car);
+
+        bool numbers = args->car->value_type == VAL_NUMBER &&
+                       args->cdr->car->value_type == VAL_NUMBER;
         
         // Emit the appropriate instruction based on operator
         if (strcmp(op, "<") == 0) {
-            emit_instruction(bc, OP_LESS, 0);
+            emit_instruction(bc, numbers ? OP_LESS_NUMBER : OP_LESS, 0);
         } else if (strcmp(op, ">") == 0) {
-            emit_instruction(bc, OP_GREATER, 0);
+            emit_instruction(bc, numbers ? OP_GREATER_NUMBER : OP_GREATER, 0);
         } else if (strcmp(op, "=") == 0) {
-            emit_instruction(bc, OP_EQUAL, 0);
+            emit_instruction(bc, numbers ? OP_EQUAL_NUMBER : OP_EQUAL, 0);
         } else if (strcmp(op, "<=") == 0) {
-            emit_instruction(bc, OP_LESS_EQUAL, 0);
+            emit_instruction(bc, numbers ? OP_LESS_EQUAL_NUMBER : OP_LESS_EQUAL, 0);
         } else if (strcmp(op, ">=") == 0) {
-            emit_instruction(bc, OP_GREATER_EQUAL, 0);
+            emit_instruction(bc, numbers ? OP_GREATER_EQUAL_NUMBER : OP_GREATER_EQUAL, 0);
         } else if (strcmp(op, "!=") == 0) {
-            emit_instruction(bc, OP_NOT_EQUAL, 0);
+            emit_instruction(bc, numbers ? OP_NOT_EQUAL_NUMBER : OP_NOT_EQUAL, 0);
         }
         return true;
     }
     else if (strcmp(op, "display") == 0) {
         // display takes one argument
         if (args == NULL || args->type == NODE_NIL) {
-            report_error(args ? args->line : -1, args ? args->column : -1,
+            report_error(compiler->errors, args ? args->line : -1, args ? args->column : -1,
                         "Function 'display' requires 1 argument, got 0");
             return true;
         }
@@ -412,7 +453,7 @@ static bool codegen_builtin(Compiler* compiler, const char* op, AstNode* args) {
     }
     else if (strcmp(op, "read") == 0) {
         if (args != NULL && args->type != NODE_NIL) {
-            report_error(args->line, args->column,
+            report_error(compiler->errors, args->line, args->column,
                         "Function 'read' requires 0 arguments, got %d", 
                         (int)(args->cdr && args->cdr->type != NODE_NIL ? 2 : 1));
             return true;
@@ -423,7 +464,7 @@ static bool codegen_builtin(Compiler* compiler, const char* op, AstNode* args) {
     }
     else if (strcmp(op, "read-line") == 0) {
         if (args != NULL && args->type != NODE_NIL) {
-            report_error(args->line, args->column,
+            report_error(compiler->errors, args->line, args->column,
                         "Function 'read-line' requires 0 arguments, got %d", 
                         (int)(args->cdr && args->cdr->type != NODE_NIL ? 2 : 1));
             return true;
@@ -434,7 +475,7 @@ static bool codegen_builtin(Compiler* compiler, const char* op, AstNode* args) {
     }
     else if (strcmp(op, "newline") == 0) {
         if (args != NULL && args->type != NODE_NIL) {
-            report_error(args->line, args->column,
+            report_error(compiler->errors, args->line, args->column,
                         "Function 'newline' requires 0 arguments, got %d", 
                         (int)(args->cdr && args->cdr->type != NODE_NIL ? 2 : 1));
             return true;
@@ -443,6 +484,17 @@ static bool codegen_builtin(Compiler* compiler, const char* op, AstNode* args) {
         emit_instruction(bc, OP_NEWLINE, 0);
         return true;
     }
+    else if (strcmp(op, "flush-output") == 0) {
+        if (args != NULL && args->type != NODE_NIL) {
+            report_error(compiler->errors, args->line, args->column,
+                        "Function 'flush-output' requires 0 arguments, got %d", 
+                        (int)(args->cdr && args->cdr->type != NODE_NIL ? 2 : 1));
+            return true;
+        }
+        
+        emit_instruction(bc, OP_FLUSH_OUTPUT, 0);
+        return true;
+    }
     else if (strcmp(op, "cons") == 0) {
         AstNode* arg1 = args;
         AstNode* arg2 = args->cdr;
@@ -467,6 +519,36 @@ static bool codegen_builtin(Compiler* compiler, const char* op, AstNode* args) {
         emit_instruction(bc, OP_CDR, 0);
         return true;
     }
+    else if (strcmp(op, "eq?") == 0 || strcmp(op, "eqv?") == 0) {
+        // Arity was checked by the analyzer against BUILTIN_TABLE
+        codegen_expr(compiler, args->car);
+        codegen_expr(compiler, args->cdr->car);
+        emit_instruction(bc, OP_EQV, 0);
+        return true;
+    }
+    else if (strcmp(op, "make-vector") == 0 || strcmp(op, "vector") == 0 ||
+             strcmp(op, "vector-ref") == 0 || strcmp(op, "vector-set!") == 0 ||
+             strcmp(op, "vector-length") == 0) {
+        // Arity was checked by the analyzer against BUILTIN_TABLE
+        int arg_count = 0;
+        for (AstNode* arg = args; arg && arg->type != NODE_NIL; arg = arg->cdr) {
+            codegen_expr(compiler, arg->car);
+            arg_count++;
+        }
+
+        if (strcmp(op, "make-vector") == 0) {
+            emit_instruction(bc, OP_MAKE_VECTOR, arg_count);
+        } else if (strcmp(op, "vector") == 0) {
+            emit_instruction(bc, OP_VECTOR, arg_count);
+        } else if (strcmp(op, "vector-ref") == 0) {
+            emit_instruction(bc, OP_VECTOR_REF, 0);
+        } else if (strcmp(op, "vector-set!") == 0) {
+            emit_instruction(bc, OP_VECTOR_SET, 0);
+        } else {
+            emit_instruction(bc, OP_VECTOR_LENGTH, 0);
+        }
+        return true;
+    }
     
     return false;
 }
@@ -483,16 +565,17 @@ static Value ast_to_value(AstNode* node) {
                 case TOKEN_REAL:
                     return NUMBER_VAL(node->token->real_value);
                 case TOKEN_STR_LITERAL:
-                    return STRING_VAL(node->token->lexeme);
+                    return copy_string(node->token->lexeme);
                 case TOKEN_TRUE:
                     return BOOL_VAL(true);
                 case TOKEN_FALSE:
                     return BOOL_VAL(false);
-                case TOKEN_IDENTIFIER:
-                    // For now, symbols are just strings in our VM
-                    return STRING_VAL(node->token->lexeme);
                 default:
-                    // Should not happen for valid AST
+                    // Quoted identifiers and keywords are symbols
+                    if (node->token->symbol != NO_SYMBOL) {
+                        const char* name = node->token->lexeme;
+                        return SYMBOL_VAL(intern_symbol_object(name, strlen(name)));
+                    }
                     return NIL_VAL;
             }
         
@@ -535,7 +618,7 @@ static void codegen_or(Compiler* compiler, AstNode* ast){
         return;
     }
 
-    int last_jump = -1;
+    int last_jump = JUMP_CHAIN_END;
 
     while(args->cdr && args->cdr->type != NODE_NIL){
         codegen_expr(compiler, args->car);
@@ -548,7 +631,7 @@ static void codegen_or(Compiler* compiler, AstNode* ast){
 
     codegen_expr(compiler, args->car);
 
-    while (last_jump != -1) {
+    while (last_jump != JUMP_CHAIN_END) {
         int next_jump = bc->instructions[last_jump].operand;
         patch_jump(bc, last_jump, bc->count);
         last_jump = next_jump;
@@ -566,7 +649,7 @@ static void codegen_and(Compiler* compiler, AstNode* ast){
         return;
     }
     
-    int last_jump = -1;
+    int last_jump = JUMP_CHAIN_END;
 
     while(args->cdr && args->cdr->type != NODE_NIL){
         AstNode* arg = args->car;
@@ -586,7 +669,7 @@ static void codegen_and(Compiler* compiler, AstNode* ast){
     codegen_expr(compiler, args->car);
 
     // Walk the chain and patch everything to HERE
-    while (last_jump != -1) {
+    while (last_jump != JUMP_CHAIN_END) {
         int next_jump = bc->instructions[last_jump].operand;
         patch_jump(bc, last_jump, bc->count);
         last_jump = next_jump;
@@ -598,7 +681,7 @@ static void codegen_cond(Compiler* compiler, AstNode* ast){
     Bytecode* bc = current_chunk(compiler);
     AstNode* clauses = ast->cdr;
 
-    int last_exit_jump = -1;
+    int last_exit_jump = JUMP_CHAIN_END;
     bool has_else = false;
 
     while(clauses && clauses->type != NODE_NIL){
@@ -657,7 +740,90 @@ static void codegen_cond(Compiler* compiler, AstNode* ast){
         emit_instruction(bc, OP_CONSTANT, idx);
     }
 
-    while (last_exit_jump != -1) {
+    while (last_exit_jump != JUMP_CHAIN_END) {
+        int next_jump = bc->instructions[last_exit_jump].operand;
+        patch_jump(bc, last_exit_jump, bc->count);
+        last_exit_jump = next_jump;
+    }
+}
+
+
+// Emits a clause body, leaving the value of its last expression
+static void codegen_sequence(Compiler* compiler, AstNode* body){
+    Bytecode* bc = current_chunk(compiler);
+
+    if (!body || body->type == NODE_NIL){
+        int idx = add_constant(bc, NIL_VAL);
+        emit_instruction(bc, OP_CONSTANT, idx);
+        return;
+    }
+
+    for (; body && body->type != NODE_NIL; body = body->cdr){
+        codegen_expr(compiler, body->car);
+        if (body->cdr && body->cdr->type != NODE_NIL){
+            emit_instruction(bc, OP_POP, 0);
+        }
+    }
+}
+
+
+// The key stays on the stack while each datum is compared to it with
+// OP_EQV_CONSTANT, so symbols match by pointer. A matching clause pops the
+// test result and the key before running its body.
+static void codegen_case(Compiler* compiler, AstNode* ast){
+    Bytecode* bc = current_chunk(compiler);
+    AstNode* clauses = ast->cdr->cdr;
+
+    int last_exit_jump = JUMP_CHAIN_END;
+    bool has_else = false;
+
+    codegen_expr(compiler, ast->cdr->car);
+
+    for (; clauses && clauses->type != NODE_NIL; clauses = clauses->cdr){
+        AstNode* clause = clauses->car;
+        AstNode* data = clause->car;
+
+        if (data->type == NODE_ATOM && data->token->type == TOKEN_ELSE){
+            has_else = true;
+            emit_instruction(bc, OP_POP, 0);
+            codegen_sequence(compiler, clause->cdr);
+            break;
+        }
+
+        int match_jump = JUMP_CHAIN_END;
+        for (AstNode* datum = data; datum && datum->type != NODE_NIL; datum = datum->cdr){
+            int idx = add_constant(bc, ast_to_value(datum->car));
+            emit_instruction(bc, OP_EQV_CONSTANT, idx);
+            emit_instruction(bc, OP_JUMP_IF_TRUE_OR_POP, match_jump);
+            match_jump = bc->count - 1;
+        }
+
+        int next_clause_jump = bc->count;
+        emit_instruction(bc, OP_JUMP, 0);
+
+        while (match_jump != JUMP_CHAIN_END) {
+            int next_jump = bc->instructions[match_jump].operand;
+            patch_jump(bc, match_jump, bc->count);
+            match_jump = next_jump;
+        }
+
+        emit_instruction(bc, OP_POP, 0);
+        emit_instruction(bc, OP_POP, 0);
+        codegen_sequence(compiler, clause->cdr);
+
+        emit_instruction(bc, OP_JUMP, last_exit_jump);
+        last_exit_jump = bc->count - 1;
+
+        patch_jump(bc, next_clause_jump, bc->count);
+    }
+
+    if (!has_else) {
+        emit_instruction(bc, OP_POP, 0);
+        int idx = add_constant(bc, NIL_VAL);
+        emit_instruction(bc, OP_CONSTANT, idx);
+    }
+
+    while (last_exit_jump != JUMP_CHAIN_END) {
         int next_jump = bc->instructions[last_exit_jump].operand;
         patch_jump(bc, last_exit_jump, bc->count);
         last_exit_jump = next_jump;
@@ -672,7 +838,7 @@ static void codegen_if(Compiler* compiler, AstNode* ast){
     AstNode* else_branch = get_arg(ast->cdr, 2);
 
     if(!condition || !then_branch){
-        report_error(ast->line, ast->column,
+        report_error(compiler->errors, ast->line, ast->column,
                     "'if' expression requires at least condition and then-branch");
         return;
     }
@@ -703,30 +869,52 @@ static void codegen_if(Compiler* compiler, AstNode* ast){
 }
 
 
-static ObjFunction* compile_function_obj(Compiler* current, AstNode* args, AstNode* body){
+// form is the lambda, define, let or loop that the analyzer annotated with
+// the function's captures
+static void begin_function(Compiler* current, Compiler* compiler, AstNode* form, int arity){
     // Create a new Compiler for this function
-    Compiler compiler;
-    init_compiler(&compiler, current, 0);
-    
-    // Create the function object
-    compiler.function = malloc(sizeof(ObjFunction));
-    compiler.function->arity = 0;
-    compiler.function->upvalue_count = 0;
-    compiler.function->name = NULL; // Anonymous
-    compiler.function->chunk = malloc(sizeof(Bytecode));
-    init_bytecode(compiler.function->chunk);
-    
-    // Parse arguments
-    while (args && args->type != NODE_NIL) {
-        compiler.function->arity++;
-        if (compiler.local_count < UINT8_MAX) {
-            Local* local = &compiler.locals[compiler.local_count++];
-            local->name = args->car->token->lexeme;
-            local->depth = 1;
-            local->is_captured = false;
-        }
-        args = args->cdr;
+    init_compiler(compiler, current, 0);
+
+    // Create the function object. Parameters take the first local slots.
+    compiler->function = malloc(sizeof(ObjFunction));
+    compiler->function->arity = arity;
+    compiler->function->upvalue_count = form->capture_count;
+    compiler->function->name = NULL; // Anonymous
+    compiler->function->chunk = malloc(sizeof(Bytecode));
+    init_bytecode(compiler->function->chunk);
+}
+
+
+static ObjFunction* end_function(Compiler* current, Compiler* compiler, AstNode* form){
+    // Emit Return
+    emit_instruction(current_chunk(compiler), OP_RETURN, 0);
+
+    // Emit Closure instruction in the PARENT chunk
+    Bytecode* parent_bc = current_chunk(current);
+    int constant = add_constant(parent_bc, FUNCTION_VAL(compiler->function));
+    emit_instruction(parent_bc, OP_CLOSURE, constant);
+
+    // Emit upvalue operands
+    for (int i = 0; i < form->capture_count; i++) {
+        emit_instruction(parent_bc, form->captures[i].is_local ? 1 : 0, form->captures[i].index);
+    }
+
+    return compiler->function;
+}
+
+
+static int count_list(AstNode* list){
+    int count = 0;
+    for (; list && list->type != NODE_NIL; list = list->cdr) {
+        count++;
     }
+    return count;
+}
+
+
+static ObjFunction* compile_function_obj(Compiler* current, AstNode* form, AstNode* args, AstNode* body){
+    Compiler compiler;
+    begin_function(current, &compiler, form, count_list(args));
     
     // Compile Body
     while (body && body->type != NODE_NIL) {
@@ -737,21 +925,130 @@ static ObjFunction* compile_function_obj(Compiler* current, AstNode* args, AstNo
         }
         body = body->cdr;
     }
-    
-    // Emit Return
-    emit_instruction(current_chunk(&compiler), OP_RETURN, 0);
 
-    // Emit Closure instruction in the PARENT chunk
-    Bytecode* parent_bc = current_chunk(current);
-    int constant = add_constant(parent_bc, FUNCTION_VAL(compiler.function));
-    emit_instruction(parent_bc, OP_CLOSURE, constant);
+    return end_function(current, &compiler, form);
+}
 
-    // Emit upvalue operands
-    for (int i = 0; i < compiler.function->upvalue_count; i++) {
-        emit_instruction(parent_bc, compiler.upvalues[i].is_local ? 1 : 0, compiler.upvalues[i].index);
+
+// Loops. The analyzer made a named let or do a function of the loop
+// variables, as for let, whose slot after the variables holds its own
+// closure when form->slot is set. loop_jump marks the calls that can go
+// back to the top instead.
+
+// Emits the closure of the loop function, compiled by emit_body, and the
+// call that starts the loop with the initial values
+static void compile_loop(Compiler* current, AstNode* form, AstNode* bindings,
+                         void (*emit_body)(Compiler* compiler, AstNode* form)){
+    Compiler compiler;
+    int count = count_list(bindings);
+    begin_function(current, &compiler, form, count);
+
+    if (form->slot >= 0) {
+        emit_instruction(current_chunk(&compiler), OP_GET_CALLEE, 0);
     }
+    compiler.loop_start = current_chunk(&compiler)->count;
+    emit_body(&compiler, form);
+    end_function(current, &compiler, form);
 
-    return compiler.function;
+    for (; bindings && bindings->type != NODE_NIL; bindings = bindings->cdr) {
+        codegen_expr(current, bindings->car->cdr->car);
+    }
+    emit_call(current_chunk(current), count);
+}
+
+
+// Assigns the loop variables the values of steps, where a NULL step leaves
+// the variable as it is, and jumps back to the top. The values are all
+// evaluated before any variable changes. The variables of inlined lets are
+// dropped first, closing any a closure captured.
+static void codegen_loop_jump(Compiler* compiler, AstNode* steps){
+    Bytecode* bc = current_chunk(compiler);
+    bool changed[UINT8_MAX];
+    int count = 0;
+
+    for (; steps && steps->type != NODE_NIL; steps = steps->cdr, count++) {
+        AstNode* step = steps->car;
+        changed[count] = step && !(step->type == NODE_ATOM && step->binding == BINDING_LOCAL &&
+                                   step->slot == count);
+        if (changed[count]) codegen_expr(compiler, step);
+    }
+
+    for (int slot = count - 1; slot >= 0; slot--) {
+        if (!changed[slot]) continue;
+        emit_instruction(bc, OP_SET_LOCAL, slot);
+        emit_instruction(bc, OP_POP, 0);
+    }
+    for (int i = 0; i < compiler->let_slots; i++) {
+        emit_instruction(bc, OP_CLOSE_UPVALUE, 0);
+    }
+    emit_instruction(bc, OP_JUMP, compiler->loop_start);
+}
+
+
+static void emit_named_let_body(Compiler* compiler, AstNode* form){
+    codegen_sequence(compiler, form->cdr->cdr->cdr);
+}
+
+
+static void codegen_named_let(Compiler* compiler, AstNode* ast){
+    compile_loop(compiler, ast, ast->cdr->cdr->car, emit_named_let_body);
+}
+
+
+// test, then either the results and a return or the commands and the steps
+static void emit_do_body(Compiler* compiler, AstNode* form){
+    Bytecode* bc = current_chunk(compiler);
+    AstNode* bindings = form->cdr->car;
+    AstNode* exit_clause = form->cdr->cdr->car;
+    int count = count_list(bindings);
+
+    codegen_expr(compiler, exit_clause->car);
+    int body_jump = bc->count;
+    emit_instruction(bc, OP_JUMP_IF_FALSE, 0);
+    codegen_sequence(compiler, exit_clause->cdr);
+    emit_instruction(bc, OP_RETURN, 0);
+    patch_jump(bc, body_jump, bc->count);
+
+    for (AstNode* command = form->cdr->cdr->cdr; command && command->type != NODE_NIL;
+         command = command->cdr) {
+        codegen_expr(compiler, command->car);
+        emit_instruction(bc, OP_POP, 0);
+    }
+
+    // A variable without a step keeps its value
+    AstNode* steps = nil_node();
+    for (int i = count - 1; i >= 0; i--) {
+        AstNode* binding = get_arg(bindings, i);
+        AstNode* step = ARENA_NEW(compiler->arena, AstNode);
+        *step = *steps;
+        step->type = NODE_LIST;
+        step->car = count_list(binding) == 3 ? binding->cdr->cdr->car : NULL;
+        step->cdr = steps;
+        steps = step;
+    }
+
+    if (form->loop_jump) {
+        codegen_loop_jump(compiler, steps);
+        return;
+    }
+
+    // A nested function captured a variable, so each iteration gets fresh
+    // ones from a call of the loop itself, bounded by the call depth
+    emit_instruction(bc, OP_GET_LOCAL, form->slot);
+    int slot = 0;
+    for (; steps->type != NODE_NIL; steps = steps->cdr, slot++) {
+        if (steps->car) {
+            codegen_expr(compiler, steps->car);
+        } else {
+            emit_instruction(bc, OP_GET_LOCAL, slot);
+        }
+    }
+    emit_call(bc, count);
+}
+
+
+static void codegen_do(Compiler* compiler, AstNode* ast){
+    compile_loop(compiler, ast, ast->cdr->car, emit_do_body);
 }
 
 
@@ -765,11 +1062,11 @@ static void codegen_define(Compiler* compiler, AstNode* ast){
         AstNode* func_args = func_head->cdr;
         AstNode* func_body = args->cdr;
 
-        ObjFunction* function = compile_function_obj(compiler, func_args, func_body);
+        ObjFunction* function = compile_function_obj(compiler, ast, func_args, func_body);
         function->name = strdup(func_name);
 
 
-        int name_idx = add_constant(bc, STRING_VAL(func_name));
+        int name_idx = add_constant(bc, copy_string(func_name));
         emit_instruction(bc, OP_DEFINE_GLOBAL, name_idx);
     } else {
         const char* var_name = args->car->token->lexeme;
@@ -778,7 +1075,7 @@ static void codegen_define(Compiler* compiler, AstNode* ast){
 
         codegen_expr(compiler, value_node);
 
-        int name_idx = add_constant(bc, STRING_VAL(var_name));
+        int name_idx = add_constant(bc, copy_string(var_name));
 
         emit_instruction(bc, OP_DEFINE_GLOBAL, name_idx);
     }
@@ -786,16 +1083,35 @@ static void codegen_define(Compiler* compiler, AstNode* ast){
 }
 
 
+// The analyzer only lets set! through for globals
+static void codegen_set(Compiler* compiler, AstNode* ast){
+    Bytecode* bc = current_chunk(compiler);
+    AstNode* args = ast->cdr;
+
+    codegen_expr(compiler, args->cdr->car);
+
+    int name_idx = add_constant(bc, copy_string(args->car->token->lexeme));
+    emit_instruction(bc, OP_SET_GLOBAL, name_idx);
+}
+
+
 static void codegen_lambda(Compiler* current, AstNode* ast) {
     AstNode* args = ast->cdr->car;
     AstNode* body = ast->cdr->cdr;
 
-    compile_function_obj(current, args, body);
+    compile_function_obj(current, ast, args, body);
 }
 
 
 void codegen_expr(Compiler* compiler, AstNode* ast){
-    if (ast == NULL || ast->type == NODE_NIL) {
+    if (ast == NULL) {
+        return;
+    }
+
+    // A literal () expression
+    if (ast->type == NODE_NIL) {
+        Bytecode* bc = current_chunk(compiler);
+        emit_instruction(bc, OP_CONSTANT, add_constant(bc, NIL_VAL));
         return;
     }
 
@@ -809,16 +1125,18 @@ void codegen_expr(Compiler* compiler, AstNode* ast){
             break;
         
         default:
-            report_error(ast->line, ast->column,
+            report_error(compiler->errors, ast->line, ast->column,
                         "Code generation error: Unknown node type");
             break;
     }
 }
 
 
-Bytecode* compile(AstNode* ast) {
+Bytecode* compile(Arena* arena, ErrorContext* errors, AstNode* ast) {
     Compiler compiler;
     init_compiler(&compiler, NULL, 0);
+    compiler.arena = arena;
+    compiler.errors = errors;
     
     // Create top-level script function
     compiler.function = malloc(sizeof(ObjFunction));
@@ -832,12 +1150,17 @@ Bytecode* compile(AstNode* ast) {
 
     emit_instruction(current_chunk(&compiler), OP_HALT, 0);
 
-    return compiler.function->chunk;
+    // The script function is only a holder for its chunk
+    Bytecode* chunk = compiler.function->chunk;
+    free(compiler.function);
+    return chunk;
 }
 
-Bytecode* compile_program(AstNode** nodes, int count) {
+Bytecode* compile_program(Arena* arena, ErrorContext* errors, AstNode** nodes, int count) {
     Compiler compiler;
     init_compiler(&compiler, NULL, 0);
+    compiler.arena = arena;
+    compiler.errors = errors;
     
     // Create top-level script function
     compiler.function = malloc(sizeof(ObjFunction));
@@ -857,5 +1180,8 @@ Bytecode* compile_program(AstNode** nodes, int count) {
 
     emit_instruction(current_chunk(&compiler), OP_HALT, 0);
 
-    return compiler.function->chunk;
+    // The script function is only a holder for its chunk
+    Bytecode* chunk = compiler.function->chunk;
+    free(compiler.function);
+    return chunk;
 }
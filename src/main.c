@@ -1,9 +1,14 @@
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <pthread.h>
 #include "scanner/scanner.h"
 #include "scanner/token.h"
 #include "utils/buffer.h"
 #include "utils/error.h"
+#include "utils/arena.h"
+#include "utils/memory.h"
 #include "parser/parser.h"
 #include "analyzer/analyzer.h"
 #include "vm/vm.h"
@@ -12,47 +17,173 @@
 #include "vm/debug.h"
 #include "codegen/codegen.h"
 
-int main(int argc, char *argv[]) {
-    // Run VM test first
-    
-    if (argc != 2) {
-        fprintf(stderr, "Usage: %s <filename>\n", argv[0]);
-        return 1;
-    }
+// Reads, analyzes, compiles and runs one top-level form at a time against a
+// single VM. Each form's AST is released as soon as it has been compiled, so
+// output starts immediately and front-end memory stays bounded.
+static int run_streaming(Parser* p, Analyzer* a) {
+    VM vm;
+    init_vm(&vm);
 
-    init_error(argv[1]);
-    FILE *file = fopen(argv[1], "r");
-    if (!file) {
-        report_error(0, 0, "Could not open file '%s'", argv[1]);
-        return 1;
+    while (p->current != NULL) {
+        AstNode* ast = parse_expression(p);
+        if (!ast || !analyze_ast(a, ast)) {
+            break;
+        }
+
+        Bytecode* chunk = compile(p->arena, p->errors, ast);
+        release_parsed(p);
+        if (had_error(p->errors)) {
+            free_bytecode(chunk);
+            free(chunk);
+            break;
+        }
+
+        vm_execute(&vm, chunk);
+
+        // Discard the form's value; globals it defined live on in the VM
+        if (vm.stack_top > 0) {
+            pop(&vm);
+        }
+        free_bytecode(chunk);
+        free(chunk);
     }
 
-    Parser* p = init_parser(file);
-    if (!p) {
-        fprintf(stderr, "Failed to initialize parser\n");
-        fclose(file);
-        return 1;
+    free_vm(&vm);
+    return had_error(p->errors) ? 1 : 0;
+}
+
+
+// Tracks open parentheses across the lines of one REPL entry
+static int paren_depth(const char* text, size_t length, int depth, bool* in_string) {
+    for (size_t i = 0; i < length; i++) {
+        char c = text[i];
+        if (*in_string) {
+            if (c == '"') *in_string = false;
+        } else if (c == '"') {
+            *in_string = true;
+        } else if (c == ';') {
+            while (i < length && text[i] != '\n') i++;
+        } else if (c == '(') {
+            depth++;
+        } else if (c == ')') {
+            depth--;
+        }
     }
+    return depth;
+}
 
-    Analyzer* a = init_analyzer();
-    if (!a){
-        fprintf(stderr, "Failed to initialize analyzer\n");
-        fclose(file);
-        return 1;
+
+// Reads lines until every open parenthesis is closed. Returns NULL at end of input.
+static char* read_entry(size_t* length) {
+    size_t capacity = 0;
+    char* text = NULL;
+    char line[1024];
+    int depth = 0;
+    bool in_string = false;
+
+    *length = 0;
+    printf("> ");
+    fflush(stdout);
+
+    while (fgets(line, sizeof(line), stdin)) {
+        size_t line_length = strlen(line);
+        if (*length + line_length + 1 > capacity) {
+            size_t old_capacity = capacity;
+            capacity = GROW_CAPACITY(old_capacity + line_length);
+            text = GROW_ARRAY(char, text, old_capacity, capacity);
+        }
+        memcpy(text + *length, line, line_length + 1);
+        *length += line_length;
+
+        depth = paren_depth(line, line_length, depth, &in_string);
+        bool line_done = line_length > 0 && line[line_length - 1] == '\n';
+        if (line_done && depth <= 0 && !in_string) {
+            return text;
+        }
+
+        if (line_done) {
+            printf("... ");
+            fflush(stdout);
+        }
     }
 
-    // Check for errors during scanning initialization
-    if (had_error()) {
-        fprintf(stderr, "\nCompilation failed with errors.\n");
-        cleanup_scanner();
-        fclose(file);
-        return 1;
+    // End of input: run whatever was typed last, if anything
+    if (*length > 0) return text;
+    free(text);
+    return NULL;
+}
+
+
+static void execute_chunk(VM* vm, void* chunk) {
+    vm_execute(vm, (const Bytecode*)chunk);
+}
+
+
+// Interactive session: one VM, one analyzer scope chain and one globals
+// table live across entries. Each entry is compiled into its own chunk and
+// run right away; functions defined earlier are reached through the globals.
+static int run_repl(void) {
+    ErrorContext errors;
+    init_error(&errors, "<repl>");
+
+    Arena arena;
+    init_arena(&arena);
+    Parser* p = init_parser(NULL, &arena, &errors);
+    Analyzer* a = init_analyzer(p);
+
+    VM vm;
+    init_vm(&vm);
+
+    size_t length;
+    char* entry;
+    while ((entry = read_entry(&length)) != NULL) {
+        clear_errors(&errors);
+        scan_text(&p->scanner, entry, length);
+        reset_parser(p);
+
+        while (p->current != NULL) {
+            AstNode* ast = parse_expression(p);
+            if (!ast || !analyze_ast(a, ast)) break;
+
+            Bytecode* chunk = compile(&arena, &errors, ast);
+            release_parsed(p);
+            bool failed = false;
+            if (!had_error(&errors)) {
+                if (vm_protect(&vm, execute_chunk, chunk)) {
+                    Value result = vm.stack_top > 0 ? pop(&vm) : NIL_VAL;
+                    if (!IS_NIL(result)) {
+                        write_value(&vm.out, result);
+                        output_char(&vm.out, '\n');
+                    }
+                } else {
+                    // The VM is back where the entry started; skip the rest of it
+                    fprintf(stderr, "Runtime error: %s\n", vm.error_message);
+                    failed = true;
+                }
+            }
+            free_bytecode(chunk);
+            free(chunk);
+            if (failed) break;
+        }
+
+        flush_output(&vm.out);
+        reset_arena(&arena);
+        free(entry);
     }
 
-    // Parse and print AST
-    printf("Parsing file: %s\n", argv[1]);
-    printf("=================\n\n");
-    
+    printf("\n");
+    free_vm(&vm);
+    free_parser(p);
+    free_analyzer(a);
+    free_arena(&arena);
+    cleanup_error(&errors);
+    return 0;
+}
+
+
+// Parses, analyzes and compiles a whole file into one chunk. Returns NULL
+// if analysis fails. The AST stays in the parser's arena for the caller to free.
+static Bytecode* compile_file(Parser* p, Analyzer* a, ErrorContext* errors, bool verbose) {
     // PHASE 1: Parse all expressions into array
     int expr_capacity = 100;
     AstNode** expressions = malloc(sizeof(AstNode*) * expr_capacity);  // Initial capacity
@@ -77,32 +208,213 @@ int main(int argc, char *argv[]) {
         expressions[expr_count++] = ast;
     }
     
-    printf("Parsed %d expressions\n\n", expr_count);
+    if (verbose) {
+        printf("Parsed %d expressions\n\n", expr_count);
 
-    // PHASE 2: Analyze all expressions
-    printf("=== Semantic Analysis ===\n");
+        // PHASE 2: Analyze all expressions
+        printf("=== Semantic Analysis ===\n");
+    }
     for (int i = 0; i < expr_count; i++) {
         if (!analyze_ast(a, expressions[i])) {
             fprintf(stderr, "Failed to analyze expression %d\n", i);
-            // Clean up and exit
-            for (int j = 0; j < expr_count; j++) {
-                free_ast(expressions[j]);
-            }
             free(expressions);
-            cleanup_scanner();
-            free_parser(p);
-            free_analyzer(a);
-            fclose(file);
-            return 1;
+            return NULL;
         }
     }
-    printf("Analysis complete\n\n");
 
-    // PHASE 3: Compile all expressions into single bytecode chunk
-    printf("=== Code Generation ===\n");
-    Bytecode* program = compile_program(expressions, expr_count);
-    
-    printf("Generated bytecode for %d expressions\n\n", expr_count);
+    if (verbose) {
+        printf("Analysis complete\n\n");
+
+        // PHASE 3: Compile all expressions into single bytecode chunk
+        printf("=== Code Generation ===\n");
+    }
+    Bytecode* program = compile_program(p->arena, errors, expressions, expr_count);
+    free(expressions);
+
+    if (verbose) {
+        printf("Generated bytecode for %d expressions\n\n", expr_count);
+    }
+    return program;
+}
+
+
+typedef struct {
+    const Bytecode* program;    // Shared by every worker, never written
+    const char* input_path;
+    FILE* output;               // Collected once all workers are done
+    bool failed;
+    char error[ERROR_MESSAGE_MAX];
+} Worker;
+
+
+static void* run_worker(void* arg) {
+    Worker* w = (Worker*)arg;
+
+    FILE* input = fopen(w->input_path, "r");
+    w->output = tmpfile();
+    if (!input || !w->output) {
+        w->failed = true;
+        snprintf(w->error, sizeof(w->error), "could not open the input or its output");
+        if (input) fclose(input);
+        return NULL;
+    }
+
+    // A runtime error ends this input's run only; what it printed is kept
+    VM vm;
+    init_vm(&vm);
+    vm.in = input;
+    vm.out.sink = w->output;
+    if (!vm_protect(&vm, execute_chunk, (void*)w->program)) {
+        w->failed = true;
+        snprintf(w->error, sizeof(w->error), "%s", vm.error_message);
+    }
+    flush_output(&vm.out);
+    free_vm(&vm);
+
+    fclose(input);
+    return NULL;
+}
+
+
+// Runs one compiled program once per input file, each on its own thread with
+// its own VM. Outputs are printed afterwards in the order the inputs were given.
+static int run_parallel(const Bytecode* program, char** inputs, int input_count) {
+    Worker* workers = calloc(input_count, sizeof(Worker));
+    pthread_t* threads = malloc(sizeof(pthread_t) * input_count);
+    int status = 0;
+
+    for (int i = 0; i < input_count; i++) {
+        workers[i].program = program;
+        workers[i].input_path = inputs[i];
+        if (pthread_create(&threads[i], NULL, run_worker, &workers[i]) != 0) {
+            fprintf(stderr, "Could not start a thread for '%s'\n", inputs[i]);
+            exit(1);
+        }
+    }
+
+    for (int i = 0; i < input_count; i++) {
+        pthread_join(threads[i], NULL);
+    }
+
+    for (int i = 0; i < input_count; i++) {
+        Worker* w = &workers[i];
+        printf("=== %s ===\n", w->input_path);
+        if (w->output) {
+            char chunk[4096];
+            size_t bytes;
+            rewind(w->output);
+            while ((bytes = fread(chunk, 1, sizeof(chunk), w->output)) > 0) {
+                fwrite(chunk, 1, bytes, stdout);
+            }
+            fclose(w->output);
+        }
+        if (w->failed) {
+            fflush(stdout);
+            fprintf(stderr, "Error running '%s': %s\n", w->input_path, w->error);
+            status = 1;
+        }
+    }
+
+    free(threads);
+    free(workers);
+    return status;
+}
+
+
+int main(int argc, char *argv[]) {
+    if (argc == 1) {
+        return run_repl();
+    }
+
+    bool streaming = argc == 3 && strcmp(argv[1], "--stream") == 0;
+    bool parallel = argc >= 4 && strcmp(argv[1], "--parallel") == 0;
+
+    if (argc != 2 && !streaming && !parallel) {
+        fprintf(stderr, "Usage: %s [--stream] [<filename>]\n", argv[0]);
+        fprintf(stderr, "       %s --parallel <filename> <input>...\n", argv[0]);
+        return 1;
+    }
+
+    const char* filename = parallel ? argv[2] : argv[argc - 1];
+    ErrorContext errors;
+    init_error(&errors, filename);
+    FILE *file = fopen(filename, "r");
+    if (!file) {
+        report_error(&errors, 0, 0, "Could not open file '%s'", filename);
+        return 1;
+    }
+
+    // Owns all tokens, AST nodes and compiler temporaries of this file
+    Arena arena;
+    init_arena(&arena);
+
+    Parser* p = init_parser(file, &arena, &errors);
+    if (!p) {
+        fprintf(stderr, "Failed to initialize parser\n");
+        fclose(file);
+        return 1;
+    }
+
+    Analyzer* a = init_analyzer(p);
+    if (!a){
+        fprintf(stderr, "Failed to initialize analyzer\n");
+        fclose(file);
+        return 1;
+    }
+
+    // Check for errors during scanning initialization
+    if (had_error(&errors)) {
+        fprintf(stderr, "\nCompilation failed with errors.\n");
+        free_parser(p);
+        free_analyzer(a);
+        free_arena(&arena);
+        cleanup_error(&errors);
+        fclose(file);
+        return 1;
+    }
+
+    if (streaming) {
+        int status = run_streaming(p, a);
+        free_parser(p);
+        free_analyzer(a);
+        free_arena(&arena);
+        cleanup_error(&errors);
+        fclose(file);
+        return status;
+    }
+
+    if (parallel) {
+        Bytecode* program = compile_file(p, a, &errors, false);
+        free_arena(&arena);
+
+        int status = program ? run_parallel(program, argv + 3, argc - 3) : 1;
+        if (program) {
+            free_bytecode(program);
+            free(program);
+        }
+        free_parser(p);
+        free_analyzer(a);
+        cleanup_error(&errors);
+        fclose(file);
+        return status;
+    }
+
+    // Parse and print AST
+    printf("Parsing file: %s\n", filename);
+    printf("=================\n\n");
+
+    Bytecode* program = compile_file(p, a, &errors, true);
+
+    // The bytecode holds its own copies; drop the whole front end in one go
+    free_arena(&arena);
+
+    if (!program) {
+        free_parser(p);
+        free_analyzer(a);
+        cleanup_error(&errors);
+        fclose(file);
+        return 1;
+    }
 
     // Optional: disassemble to see generated bytecode
     disassemble_bytecode(program, "Complete Program");
@@ -118,16 +430,12 @@ int main(int argc, char *argv[]) {
     free_vm(&vm);
     free_bytecode(program);
     free(program);
-    
-    for (int i = 0; i < expr_count; i++) {
-        free_ast(expressions[i]);
-    }
-    free(expressions);
 
-    cleanup_scanner();
     free_parser(p);
     free_analyzer(a);
     fclose(file);
 
-    return had_error() ? 1 : 0;
+    int status = had_error(&errors) ? 1 : 0;
+    cleanup_error(&errors);
+    return status;
 }
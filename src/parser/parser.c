@@ -3,36 +3,40 @@
 #include "../../include/scanner/scanner.h"
 #include "../../include/scanner/token.h"
 #include "../../include/utils/error.h"
-#include "../../include/utils/buffer.h"
 #include "../../include/parser/parser.h"
 
 
-Parser* init_parser(FILE* file) {
+static AstNode NIL_NODE = {NODE_NIL, NULL, NULL, NULL, -1, -1, BINDING_NONE, -1, false, false, NULL, 0, VAL_NIL, VAL_ANY};
+
+
+Parser* init_parser(FILE* file, Arena* arena, ErrorContext* errors) {
     Parser* p = (Parser*)malloc(sizeof(Parser));
     p->file = file;
+    p->arena = arena;
+    p->errors = errors;
     p->panic_mode = false;
 
-    init_scanner(file);
+    init_scanner(&p->scanner, file, arena, errors);
 
-    p->current = next_token();
-    p->next = next_token();
+    p->current = next_token(&p->scanner);
+    p->next = next_token(&p->scanner);
 
     return p;
 }
 
 
+void reset_parser(Parser* p) {
+    p->panic_mode = false;
+    p->current = next_token(&p->scanner);
+    p->next = next_token(&p->scanner);
+}
+
+
 void free_parser(Parser* p) {
     if (!p) return;
-    
-    // Free current and next tokens if they exist
-    if (p->current) {
-        free_token(p->current);
-    }
-    if (p->next) {
-        free_token(p->next);
-    }
-    
-    // Free the parser structure itself
+
+    // Tokens belong to the arena, which the caller releases
+    cleanup_scanner(&p->scanner);
     free(p);
 }
 
@@ -56,15 +60,28 @@ static void synchronize(Parser* p){
 }
 
 
-AstNode* create_nil_node() {
-    AstNode* nil = (AstNode*)malloc(sizeof(AstNode));
-    nil->type = NODE_NIL;
-    nil->token = NULL;
-    nil->car = NULL;
-    nil->cdr = NULL;
-    nil->line = -1;    // NIL has no source location
-    nil->column = -1;
-    return nil;
+AstNode* nil_node(void) {
+    return &NIL_NODE;
+}
+
+
+static AstNode* new_node(Parser* p, NodeType type, int line, int column) {
+    AstNode* node = ARENA_NEW(p->arena, AstNode);
+    node->type = type;
+    node->token = NULL;
+    node->car = NULL;
+    node->cdr = NULL;
+    node->line = line;
+    node->column = column;
+    node->binding = BINDING_NONE;
+    node->slot = -1;
+    node->loop_jump = false;
+    node->inlined = false;
+    node->captures = NULL;
+    node->capture_count = 0;
+    node->value_type = VAL_ANY;
+    node->return_type = VAL_ANY;
+    return node;
 }
 
 
@@ -80,7 +97,7 @@ Token* advance(Parser* p) {
 
     Token* temp = p->current;
     p->current = p->next;
-    p->next = next_token();
+    p->next = next_token(&p->scanner);
 
     return temp;
 }
@@ -100,11 +117,11 @@ Token* expect(Parser* p, TokenType type) {
     if (!match(p, type)) {
         if (!p->panic_mode) {
             if (!p->current) {
-                report_error(get_current_line(), get_current_column(),
+                report_error(p->errors, get_current_line(&p->scanner), get_current_column(&p->scanner),
                             "Unexpected end of file. Expected '%s'",
                             token_type_to_string(type));
             } else {
-                report_error(get_current_line(), get_current_column(),
+                report_error(p->errors, get_current_line(&p->scanner), get_current_column(&p->scanner),
                             "Expected '%s' but got '%s'",
                             token_type_to_string(type),
                             token_type_to_string(p->current->type));
@@ -118,13 +135,9 @@ Token* expect(Parser* p, TokenType type) {
 
 
 AstNode* parse_atom(Parser* p){
-    AstNode* node = (AstNode*)malloc(sizeof(AstNode));
-    node->type = NODE_ATOM;
+    // Copy position from token
+    AstNode* node = new_node(p, NODE_ATOM, p->current->line, p->current->column);
     node->token = p->current;
-    node->car = NULL;
-    node->cdr = NULL;
-    node->line = p->current->line;      // Copy position from token
-    node->column = p->current->column;
     advance(p);
     
     return node;
@@ -133,14 +146,14 @@ AstNode* parse_atom(Parser* p){
 
 AstNode* parse_expression(Parser* p){
     if (!p->current) {
-        report_error(get_current_line(), get_current_column(),
+        report_error(p->errors, get_current_line(&p->scanner), get_current_column(&p->scanner),
                     "Unexpected end of file while parsing expression");
         return NULL;
     }
     
     if (match(p, TOKEN_RPAREN)) {
         if (!p->panic_mode) {
-            report_error(get_current_line(), get_current_column(),
+            report_error(p->errors, get_current_line(&p->scanner), get_current_column(&p->scanner),
                     "Unexpected ')'. Expected an expression");
             p->panic_mode = true;
         }
@@ -154,38 +167,25 @@ AstNode* parse_expression(Parser* p){
         AstNode* quoted_expr = parse_expression(p);  // Parse the expression to quote
         
         if (!quoted_expr) {
-            free_token(quote_token);
             return NULL;
         }
         
         // Build (quote expr) as a list
-        AstNode* quote_list = (AstNode*)malloc(sizeof(AstNode));
-        quote_list->type = NODE_LIST;
-        quote_list->line = quote_token->line;
-        quote_list->column = quote_token->column;
+        AstNode* quote_list = new_node(p, NODE_LIST, quote_token->line, quote_token->column);
         
         // Create the 'quote' atom
-        AstNode* quote_atom = (AstNode*)malloc(sizeof(AstNode));
-        quote_atom->type = NODE_ATOM;
-        quote_atom->token = create_token("quote", TOKEN_QUOTE);
-        quote_atom->car = NULL;
-        quote_atom->cdr = NULL;
-        quote_atom->line = quote_token->line;
-        quote_atom->column = quote_token->column;
+        AstNode* quote_atom = new_node(p, NODE_ATOM, quote_token->line, quote_token->column);
+        quote_atom->token = create_symbol_token(p->arena, intern_name(&p->scanner, "quote"));
         
         // Build cons structure: (quote . (expr . ()))
         quote_list->car = quote_atom;
         
-        AstNode* expr_list = (AstNode*)malloc(sizeof(AstNode));
-        expr_list->type = NODE_LIST;
+        AstNode* expr_list = new_node(p, NODE_LIST, quoted_expr->line, quoted_expr->column);
         expr_list->car = quoted_expr;
-        expr_list->cdr = create_nil_node();
-        expr_list->line = quoted_expr->line;
-        expr_list->column = quoted_expr->column;
+        expr_list->cdr = nil_node();
         
         quote_list->cdr = expr_list;
         
-        free_token(quote_token);
         return quote_list;
     }
     
@@ -207,29 +207,25 @@ AstNode* parse_list(Parser* p){
     // Check for empty list ()
     if (match(p, TOKEN_RPAREN)) {
         advance(p);
-        return create_nil_node();
+        return nil_node();
     }
     
-    AstNode* node = (AstNode*)malloc(sizeof(AstNode));
-    node->type = NODE_LIST;
-    node->token = NULL;
-    node->line = start_token->line;      // Copy position from opening paren
-    node->column = start_token->column;
+    // Copy position from opening paren
+    AstNode* node = new_node(p, NODE_LIST, start_token->line, start_token->column);
     node->car = parse_expression(p);
     
     if (!node->car) {
-        free(node);
         return NULL;
     }
     
-    node->cdr = create_nil_node();
+    node->cdr = nil_node();
 
     AstNode* current_list_node = node;
 
     while(!match(p, TOKEN_RPAREN)){
         // Check for unexpected EOF
         if (!p->current) {
-            report_error(get_current_line(), get_current_column(),
+            report_error(p->errors, get_current_line(&p->scanner), get_current_column(&p->scanner),
                         "Unexpected end of file. Expected ')' to close list");
             return NULL;
         }
@@ -240,7 +236,6 @@ AstNode* parse_list(Parser* p){
             AstNode* tail = parse_expression(p);
             if (!tail) return NULL;
 
-            free_ast(current_list_node->cdr);
             current_list_node->cdr = tail;
 
             if (!expect(p, TOKEN_RPAREN)) {
@@ -258,12 +253,10 @@ AstNode* parse_list(Parser* p){
         }
         
         // Create a new list node to hold this argument
-        AstNode* new_list_node = (AstNode*)malloc(sizeof(AstNode));
-        new_list_node->type = NODE_LIST;
+        // Inherit position from argument
+        AstNode* new_list_node = new_node(p, NODE_LIST, arg->line, arg->column);
         new_list_node->car = arg;
-        new_list_node->cdr = create_nil_node();
-        new_list_node->line = arg->line;      // Inherit position from argument
-        new_list_node->column = arg->column;
+        new_list_node->cdr = nil_node();
         
         // Link it to the previous node's cdr
         current_list_node->cdr = new_list_node;
@@ -279,24 +272,28 @@ AstNode* parse_list(Parser* p){
     return node;
 }
 
-void free_ast(AstNode* node){
-    if (!node) return;
+static Token* carry_token(Parser* p, const Token* saved) {
+    Token* t = ARENA_NEW(p->arena, Token);
+    *t = *saved;
 
-    switch (node->type) {
-        case NODE_NIL:
-            free(node);
-            return;
-        case NODE_ATOM:
-            if (node->token) free_token(node->token);
-            free(node);
-            return;
-        case NODE_LIST:
-            free_ast(node->car);
-            free_ast(node->cdr);
-            free(node);
-            return;
+    // String literals are the only lexemes stored in the arena; re-slice
+    // them from the source, skipping the quotes
+    if (t->type == TOKEN_STR_LITERAL) {
+        t->lexeme = arena_strndup(p->arena, p->scanner.source.data + t->offset + 1, t->length - 2);
     }
-    
+    return t;
+}
+
+
+void release_parsed(Parser* p) {
+    Token current, next;
+    if (p->current) current = *p->current;
+    if (p->next) next = *p->next;
+
+    reset_arena(p->arena);
+
+    if (p->current) p->current = carry_token(p, &current);
+    if (p->next) p->next = carry_token(p, &next);
 }
 
 
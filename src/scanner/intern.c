@@ -0,0 +1,98 @@
+#include <stdlib.h>
+#include <string.h>
+#include "scanner/intern.h"
+#include "utils/memory.h"
+
+#define INTERN_MAX_LOAD 0.75
+
+
+void init_intern_table(InternTable* table) {
+    table->symbols = NULL;
+    table->count = 1;   // Reserve NO_SYMBOL
+    table->capacity = 0;
+    table->slots = NULL;
+    table->slot_capacity = 0;
+}
+
+
+void free_intern_table(InternTable* table) {
+    for (int32_t i = 1; i < table->count; i++) {
+        free(table->symbols[i].name);
+    }
+    FREE_ARRAY(InternedSymbol, table->symbols, table->capacity);
+    FREE_ARRAY(uint32_t, table->slots, table->slot_capacity);
+    init_intern_table(table);
+}
+
+
+static uint32_t* find_slot(InternTable* table, const char* chars, uint32_t length, uint32_t hash) {
+    uint32_t mask = (uint32_t)table->slot_capacity - 1;
+    uint32_t index = hash & mask;
+
+    for (;;) {
+        uint32_t* slot = &table->slots[index];
+        if (*slot == NO_SYMBOL) return slot;
+
+        InternedSymbol* symbol = &table->symbols[*slot];
+        if (symbol->hash == hash && symbol->length == length &&
+            memcmp(symbol->name, chars, length) == 0) {
+            return slot;
+        }
+
+        index = (index + 1) & mask;
+    }
+}
+
+
+static void grow_slots(InternTable* table) {
+    int32_t old_capacity = table->slot_capacity;
+    uint32_t* old_slots = table->slots;
+
+    table->slot_capacity = GROW_CAPACITY(old_capacity);
+    table->slots = (uint32_t*)calloc(table->slot_capacity, sizeof(uint32_t));
+
+    // Ids are stable, only their slots move
+    for (int32_t i = 1; i < table->count; i++) {
+        InternedSymbol* symbol = &table->symbols[i];
+        *find_slot(table, symbol->name, symbol->length, symbol->hash) = symbol->id;
+    }
+
+    FREE_ARRAY(uint32_t, old_slots, old_capacity);
+}
+
+
+const InternedSymbol* intern_symbol(InternTable* table, const char* chars, uint32_t length, uint32_t hash) {
+    if (table->count + 1 > table->slot_capacity * INTERN_MAX_LOAD) {
+        grow_slots(table);
+    }
+
+    uint32_t* slot = find_slot(table, chars, length, hash);
+    if (*slot != NO_SYMBOL) {
+        return &table->symbols[*slot];
+    }
+
+    if (table->capacity < table->count + 1) {
+        int32_t old_capacity = table->capacity;
+        table->capacity = GROW_CAPACITY(old_capacity);
+        table->symbols = GROW_ARRAY(InternedSymbol, table->symbols,
+                                    old_capacity, table->capacity);
+    }
+
+    InternedSymbol* symbol = &table->symbols[table->count];
+    symbol->name = (char*)reallocate(NULL, 0, length + 1);
+    memcpy(symbol->name, chars, length);
+    symbol->name[length] = '\0';
+    symbol->length = length;
+    symbol->hash = hash;
+    symbol->id = (uint32_t)table->count++;
+    symbol->type = check_keyword(symbol->name);
+
+    *slot = symbol->id;
+    return symbol;
+}
+
+
+const InternedSymbol* get_interned(InternTable* table, uint32_t id) {
+    if (id == NO_SYMBOL || (int32_t)id >= table->count) return NULL;
+    return &table->symbols[id];
+}
@@ -4,180 +4,278 @@
 #include <string.h>
 #include "scanner/scanner.h"
 #include "scanner/token.h"
+#include "scanner/intern.h"
 #include "utils/buffer.h"
 #include "utils/error.h"
+#include "utils/hash.h"
 
 #define MAX_LEXEME_SIZE 256
 
 // Forward declarations for internal functions
-static Token* process_number(void);
-static Token* process_string_literal(void);
-static Token* process_identifier(void);
-static Token* try_keywords(const char* lexeme);
+static Token* process_number(Scanner* s);
+static Token* process_string_literal(Scanner* s);
+static Token* process_identifier(Scanner* s);
+static Token* make_identifier(Scanner* s, const char* name);
+
+
+static inline bool is_at_end(const Scanner* s) {
+    return s->current >= s->source.data + s->source.length;
+}
+
+// '\0' stands in for end of input
+static inline char peek(const Scanner* s) {
+    return is_at_end(s) ? '\0' : *s->current;
+}
+
+// '<', '>' and '/' may continue an identifier, as in list->vector
+static inline bool is_identifier_char(char c) {
+    return isalnum((unsigned char)c) || (c != '\0' && strchr("?!*=-_<>/", c));
+}
+
+
+uint32_t get_current_line(const Scanner* s) {
+    return s->line;
+}
+
+uint32_t get_current_column(const Scanner* s) {
+    return (uint32_t)(s->current - s->line_start);
+}
+
+uint32_t get_current_offset(const Scanner* s) {
+    return (uint32_t)(s->current - s->source.data);
+}
+
 
 // Processing functions implementations
-static Token* process_number(void) {
-    int start = *get_buffer_pos();
+static Token* process_number(Scanner* s) {
+    const char* start = s->current;
     TokenType type = TOKEN_DEC;
-    
-    if (peek_char() == '-') get_next_char();
-    
-    while(isdigit(peek_char())) {
-        get_next_char();
+
+    if (peek(s) == '-') s->current++;
+
+    while(isdigit((unsigned char)peek(s))) {
+        s->current++;
     }
 
-    if(peek_char() == '.') {
-        get_next_char();
+    if(peek(s) == '.') {
+        s->current++;
         type = TOKEN_REAL;
-        while(isdigit(peek_char())) {
-            get_next_char();
+        while(isdigit((unsigned char)peek(s))) {
+            s->current++;
         }
     }
 
-    int length = *get_buffer_pos() - start;
+    size_t length = (size_t)(s->current - start);
     if(length >= MAX_LEXEME_SIZE) {
-        report_error(get_current_line(), get_current_column(), "Number too long");
+        report_error(s->errors, get_current_line(s), get_current_column(s), "Number too long");
         return NULL;
     }
 
-    char* number = strndup(get_current_buffer() + start, length);
-    Token* t = create_token(number, type);
-    free(number);
-    return t;
+    // The source is not NUL-terminated, so conversion needs a bounded copy
+    char number[MAX_LEXEME_SIZE];
+    memcpy(number, start, length);
+    number[length] = '\0';
+    return create_token(s->arena, number, type);
 }
 
-static Token* process_string_literal(void) {
-    uint32_t start_line = get_current_line();
-    uint32_t start_column = get_current_column();
-    get_next_char(); // Skip opening quote
-    int start = *get_buffer_pos();
+static Token* process_string_literal(Scanner* s) {
+    uint32_t start_line = get_current_line(s);
+    uint32_t start_column = get_current_column(s);
+    s->current++; // Skip opening quote
+    const char* start = s->current;
 
-    while(peek_char() != '"' && peek_char() != '\n' && peek_char() != EOF) {
-        get_next_char();
+    while(peek(s) != '"' && peek(s) != '\n' && !is_at_end(s)) {
+        s->current++;
     }
 
-    if(peek_char() == '\n' || peek_char() == EOF) {
-        report_error(start_line, start_column, "Unterminated string literal");
+    if(peek(s) == '\n' || is_at_end(s)) {
+        report_error(s->errors, start_line, start_column, "Unterminated string literal");
         return NULL;
     }
 
-    int length = *get_buffer_pos() - start;
-    char* string = strndup(get_current_buffer() + start, length);
-    get_next_char(); // Skip closing quote
+    size_t length = (size_t)(s->current - start);
+    s->current++; // Skip closing quote
 
-    Token* t = create_token(string, TOKEN_STR_LITERAL);
-    free(string);
-    return t;
+    char* string = arena_strndup(s->arena, start, length);
+    return create_token(s->arena, string, TOKEN_STR_LITERAL);
 }
 
-static Token* process_identifier(void) {
-    int start = *get_buffer_pos();
+static Token* process_identifier(Scanner* s) {
+    const char* start = s->current;
+    uint32_t hash = FNV_OFFSET_BASIS;
 
-    while(isalnum(peek_char()) || strchr("?!*=-_", peek_char())) {
-        get_next_char();
+    while(is_identifier_char(peek(s))) {
+        hash = HASH_STEP(hash, *s->current);
+        s->current++;
     }
-    
-    int length = *get_buffer_pos() - start;
-    char* string = strndup(get_current_buffer() + start, length);
 
-    Token* t = try_keywords(string);
-    free(string);
-    return t;
+    // Interned straight from the source slice; keywords carry their token type
+    uint32_t length = (uint32_t)(s->current - start);
+    return create_symbol_token(s->arena, intern_symbol(&s->interner, start, length, hash));
+}
+
+
+static Token* make_identifier(Scanner* s, const char* name) {
+    return create_symbol_token(s->arena, intern_name(s, name));
+}
+
+
+const InternedSymbol* intern_name(Scanner* s, const char* name) {
+    uint32_t length = (uint32_t)strlen(name);
+    return intern_symbol(&s->interner, name, length, hash_string(name, length));
 }
 
 
-static Token* try_keywords(const char* lexeme) {
-    if (!lexeme) return NULL;
-    TokenType type = check_keyword(lexeme);
-    return create_token(lexeme, type);
+// Skips whitespace and comments, counting lines as it goes
+static void skip_whitespace(Scanner* s) {
+    for (;;) {
+        char c = peek(s);
+        switch (c) {
+            case '\n':
+                s->current++;
+                s->line++;
+                s->line_start = s->current;
+                break;
+            case ' ':
+            case '\t':
+            case '\r':
+            case '\v':
+            case '\f':
+                s->current++;
+                break;
+            case ';':
+                // Comment - skip until end of line
+                while (peek(s) != '\n' && !is_at_end(s)) {
+                    s->current++;
+                }
+                break;
+            default:
+                return;
+        }
+    }
 }
 
-Token* next_token(void) {
-    char c = skip_whitespace();
-    if (c == EOF) return NULL;
 
-    // Consume the character we peeked at
-    get_next_char();
+static Token* scan_token(Scanner* s) {
+    char c = *s->current++;
 
-    if (c == '(') return create_token("(", TOKEN_LPAREN);
-    if (c == ')') return create_token(")", TOKEN_RPAREN);
-    if (c == '`') return create_token("`", TOKEN_BACKQUOTE);
-    if (c == ',') return create_token(",", TOKEN_COMMA);
-    if (c == '.') return create_token(".", TOKEN_DOT);
+    if (c == '(') return create_token(s->arena, "(", TOKEN_LPAREN);
+    if (c == ')') return create_token(s->arena, ")", TOKEN_RPAREN);
+    if (c == '`') return create_token(s->arena, "`", TOKEN_BACKQUOTE);
+    if (c == ',') return create_token(s->arena, ",", TOKEN_COMMA);
+    if (c == '.') return create_token(s->arena, ".", TOKEN_DOT);
 
-    if (c == '+') return create_token("+", TOKEN_IDENTIFIER);
-    if (c == '*') return create_token("*", TOKEN_IDENTIFIER);
-    if (c == '/') return create_token("/", TOKEN_IDENTIFIER);
-    if (c == '=') return create_token("=", TOKEN_IDENTIFIER);
+    if (c == '+') return make_identifier(s, "+");
+    if (c == '*') return make_identifier(s, "*");
+    if (c == '/') return make_identifier(s, "/");
+    if (c == '=') return make_identifier(s, "=");
 
     if (c == '-') {
-        if (isdigit(peek_char())) {
-            return process_number();
+        if (isdigit((unsigned char)peek(s))) {
+            s->current--; // Keep the sign for process_number
+            return process_number(s);
         }
-        return create_token("-", TOKEN_IDENTIFIER);
+        return make_identifier(s, "-");
     }
 
     if (c == '<') {
-        if (peek_char() == '=') {
-            get_next_char();
-            return create_token("<=", TOKEN_IDENTIFIER);
+        if (peek(s) == '=') {
+            s->current++;
+            return make_identifier(s, "<=");
         }
-        return create_token("<", TOKEN_IDENTIFIER);
+        return make_identifier(s, "<");
     }
 
     if (c == '>') {
-        if (peek_char() == '=') {
-            get_next_char();
-            return create_token(">=", TOKEN_IDENTIFIER);
+        if (peek(s) == '=') {
+            s->current++;
+            return make_identifier(s, ">=");
         }
-        return create_token(">", TOKEN_IDENTIFIER);
-    }
-
-    if (c == ';') {
-        // Comment - skip until end of line
-        while (peek_char() != '\n' && peek_char() != EOF) {
-            get_next_char();
-        }
-        return next_token();
+        return make_identifier(s, ">");
     }
 
     if (c == '\'') {
-        return create_token("'", TOKEN_QUOTE_MARK);
+        return create_token(s->arena, "'", TOKEN_QUOTE_MARK);
     }
 
     if (c == '#') {
-        switch (get_next_char()){
+        switch (peek(s)){
             case 't':
-                return create_token("#t", TOKEN_TRUE);
+                s->current++;
+                return create_token(s->arena, "#t", TOKEN_TRUE);
             case 'f':
-                return create_token("#f", TOKEN_FALSE);
+                s->current++;
+                return create_token(s->arena, "#f", TOKEN_FALSE);
         }
     }
 
-    if (isdigit(c)) {
-        unget_char(); // Put the digit back for process_number to read
-        return process_number();
+    if (isdigit((unsigned char)c)) {
+        s->current--; // Put the digit back for process_number to read
+        return process_number(s);
     }
 
     if (c == '"') {
-        unget_char(); // Put the quote back for process_string_literal to read
-        return process_string_literal();
+        s->current--; // Put the quote back for process_string_literal to read
+        return process_string_literal(s);
     }
 
-    if (isalpha(c) || strchr("?!*=-_", c)) {
-        unget_char(); // Put the character back for process_identifier to read
-        return process_identifier();
+    if (isalpha((unsigned char)c) || (c != '\0' && strchr("?!*=-_", c))) {
+        s->current--; // Put the character back for process_identifier to read
+        return process_identifier(s);
     }
 
-    report_error(get_current_line(), get_current_column(), "Unexpected character '%c'", c);
+    report_error(s->errors, get_current_line(s), get_current_column(s), "Unexpected character '%c'", c);
     return NULL;
 }
 
-void init_scanner(FILE *file) {
-    init_buffer(file);
+
+Token* next_token(Scanner* s) {
+    skip_whitespace(s);
+    if (is_at_end(s)) return NULL;
+
+    // Every token records the slice of source it was scanned from
+    const char* start = s->current;
+    Token* t = scan_token(s);
+    if (t) {
+        t->line = get_current_line(s);
+        t->column = get_current_column(s);
+        t->offset = (uint32_t)(start - s->source.data);
+        t->length = (uint32_t)(s->current - start);
+    }
+    return t;
+}
+
+static void reset_cursor(Scanner* s) {
+    s->current = s->source.data;
+    s->line_start = s->source.data;
+    s->line = 1;
 }
 
-void cleanup_scanner(void) {
-    cleanup_buffer();
-    cleanup_error();
+void init_scanner(Scanner* s, FILE *file, Arena* token_arena, ErrorContext* errors) {
+    s->arena = token_arena;
+    s->errors = errors;
+    errors->source = &s->source;
+    init_intern_table(&s->interner);
+
+    init_source(&s->source);
+    if (file && !load_source(&s->source, file)) {
+        report_error(errors, 0, 0, "Error reading from file");
+    }
+    reset_cursor(s);
+}
+
+void scan_text(Scanner* s, const char* text, size_t length) {
+    use_source(&s->source, text, length);
+    reset_cursor(s);
+}
+
+void cleanup_scanner(Scanner* s) {
+    if (s->errors && s->errors->source == &s->source) {
+        s->errors->source = NULL;
+    }
+    free_source(&s->source);
+    free_intern_table(&s->interner);
+    s->arena = NULL;
+    s->errors = NULL;
+    reset_cursor(s);
 }
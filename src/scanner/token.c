@@ -2,41 +2,37 @@
 #include <string.h>
 #include <stdio.h>
 #include "token.h"
-#include "utils/buffer.h"  // For get_current_line() and get_current_column()
+#include "intern.h"
 
 
-Token* create_token(const char* lexeme, TokenType type) {
-    Token* temp = malloc(sizeof(Token));
-    if (!temp) {
-        fprintf(stderr, "Memory allocation failed for token\n");
-        exit(1);
-    }
+Token* create_token(Arena* arena, const char* lexeme, TokenType type) {
+    Token* temp = ARENA_NEW(arena, Token);
 
     temp->type = type;
-    temp->line = get_current_line();
-    temp->column = get_current_column();
+    temp->line = 0;     // The scanner stamps the position of scanned tokens
+    temp->column = 0;
+    temp->offset = 0;
+    temp->length = 0;
+    temp->symbol = NO_SYMBOL;
+    temp->hash = 0;
     
     if(type == TOKEN_DEC) {
         temp->int_value = strtoll(lexeme, NULL, 10);
     } else if(type == TOKEN_REAL) {
         temp->real_value = atof(lexeme);
     } else {
-        temp->lexeme = strdup(lexeme);
-        if (!temp->lexeme) {
-            fprintf(stderr, "Memory allocation failed for lexeme\n");
-            free(temp);
-            exit(1);
-        }
+        temp->lexeme = (char*)lexeme;
     }
     return temp;
 }
 
 
-void free_token(Token* t) {
-    if(t->type != TOKEN_DEC && t->type != TOKEN_REAL) {
-        free(t->lexeme);
-    }
-    free(t);
+Token* create_symbol_token(Arena* arena, const InternedSymbol* symbol) {
+    Token* temp = create_token(arena, symbol->name, symbol->type);
+    temp->length = symbol->length;
+    temp->symbol = symbol->id;
+    temp->hash = symbol->hash;
+    return temp;
 }
 
 
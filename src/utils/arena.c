@@ -0,0 +1,88 @@
+#include <string.h>
+#include "utils/arena.h"
+#include "utils/memory.h"
+
+#define ALIGN_UP(size) (((size) + ARENA_ALIGNMENT - 1) & ~(size_t)(ARENA_ALIGNMENT - 1))
+
+
+void init_arena(Arena* arena) {
+    arena->head = NULL;
+}
+
+
+void free_arena(Arena* arena) {
+    ArenaBlock* block = arena->head;
+    while (block) {
+        ArenaBlock* next = block->next;
+        reallocate(block, sizeof(ArenaBlock) + block->capacity, 0);
+        block = next;
+    }
+    arena->head = NULL;
+}
+
+
+void reset_arena(Arena* arena) {
+    // Keep the first regular-sized block; oversized ones are not worth holding
+    ArenaBlock* keep = NULL;
+    ArenaBlock* block = arena->head;
+    while (block) {
+        ArenaBlock* next = block->next;
+        if (!keep && block->capacity == ARENA_BLOCK_SIZE) {
+            keep = block;
+        } else {
+            reallocate(block, sizeof(ArenaBlock) + block->capacity, 0);
+        }
+        block = next;
+    }
+
+    if (keep) {
+        keep->next = NULL;
+        keep->used = 0;
+    }
+    arena->head = keep;
+}
+
+
+static ArenaBlock* new_block(size_t capacity, ArenaBlock* next) {
+    ArenaBlock* block = (ArenaBlock*)reallocate(NULL, 0, sizeof(ArenaBlock) + capacity);
+    block->next = next;
+    block->used = 0;
+    block->capacity = capacity;
+    return block;
+}
+
+
+void* arena_alloc(Arena* arena, size_t size) {
+    size = ALIGN_UP(size);
+    ArenaBlock* block = arena->head;
+
+    if (block == NULL || block->capacity - block->used < size) {
+        if (size > ARENA_BLOCK_SIZE / 4) {
+            // Oversized requests get their own block behind the current one,
+            // so the space left in the current block is not wasted
+            ArenaBlock* big = new_block(size, block ? block->next : NULL);
+            if (block) {
+                block->next = big;
+            } else {
+                arena->head = big;
+            }
+            big->used = size;
+            return big->data;
+        }
+
+        block = new_block(ARENA_BLOCK_SIZE, block);
+        arena->head = block;
+    }
+
+    void* result = block->data + block->used;
+    block->used += size;
+    return result;
+}
+
+
+char* arena_strndup(Arena* arena, const char* chars, size_t length) {
+    char* copy = (char*)arena_alloc(arena, length + 1);
+    memcpy(copy, chars, length);
+    copy[length] = '\0';
+    return copy;
+}
@@ -1,124 +1,101 @@
 #include <stdio.h>
-#include <ctype.h>
+#include <stdlib.h>
 #include "utils/buffer.h"
-#include "utils/error.h"
-
-static char buffers[2][BUFFER_SIZE];
-static int current_buffer_idx = 0;
-static int32_t buffer_pos = 0;
-static int buffer_limits[2] = {0, 0};
-static int eof_reached = 0;
-static FILE *file_handle = NULL;
-
-// Position tracking
-static uint32_t current_line = 1;
-static uint32_t current_column = 0;
-
-// Forward declaration
-static int fill_buffer(int buffer_num);
-
-void init_buffer(FILE* file) {
-    file_handle = file;
-    current_buffer_idx = 0;
-    buffer_pos = 0;
-    buffer_limits[0] = buffer_limits[1] = 0;
-    eof_reached = 0;
-    current_line = 1;
-    current_column = 0;
-    fill_buffer(0);
-}
+#include "utils/memory.h"
 
-int fill_buffer(int buffer_num) {
-    if (!file_handle) return -1;
-    size_t bytes_read = fread(buffers[buffer_num], 1, BUFFER_SIZE - 1, file_handle);
-    if (bytes_read < BUFFER_SIZE - 1) {
-        if (ferror(file_handle)) {
-            report_error(current_line, current_column, "Error reading from file");
-            return -1;
-        }
-        eof_reached = 1;
-    }
-    buffers[buffer_num][bytes_read] = '\0';
-    buffer_limits[buffer_num] = bytes_read;
-    return bytes_read;
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/mman.h>
+#include <sys/stat.h>
+#define HAVE_MMAP 1
+#endif
+
+
+void init_source(SourceBuffer* source) {
+    source->data = "";
+    source->length = 0;
+    source->capacity = 0;
+    source->mapped = false;
 }
 
-char get_next_char(void) {
-    if (buffer_pos >= buffer_limits[current_buffer_idx]) {
-        if (eof_reached) {
-            return EOF;
-        }
-        current_buffer_idx = 1 - current_buffer_idx;
-        buffer_pos = 0;
-        if (fill_buffer(current_buffer_idx) <= 0) {
-            return EOF;
-        }
-    }
-    
-    char c = buffers[current_buffer_idx][buffer_pos++];
-    if (c == '\n') {
-        current_line++;
-        current_column = 0;
-    } else {
-        current_column++;
-    }
-    return c;
+
+#ifdef HAVE_MMAP
+static bool map_source(SourceBuffer* source, FILE* file) {
+    int fd = fileno(file);
+    struct stat info;
+    if (fd < 0 || fstat(fd, &info) != 0) return false;
+    if (!S_ISREG(info.st_mode) || info.st_size <= 0) return false;
+
+    void* mapped = mmap(NULL, (size_t)info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (mapped == MAP_FAILED) return false;
+
+    // The scanner makes a single forward pass
+    madvise(mapped, (size_t)info.st_size, MADV_SEQUENTIAL);
+
+    source->data = (const char*)mapped;
+    source->length = (size_t)info.st_size;
+    source->mapped = true;
+    return true;
 }
+#endif
 
-void unget_char(void) {
-    if (buffer_pos > 0) {
-        buffer_pos--;
-        char c = buffers[current_buffer_idx][buffer_pos];
-        if (c == '\n') {
-            current_line--;
-            // Column restoration is complex, so just set to 0 for simplicity
-            current_column = 0;
-        } else if (current_column > 0) {
-            current_column--;
+
+static bool read_source(SourceBuffer* source, FILE* file) {
+    char* data = NULL;
+    size_t length = 0;
+    size_t capacity = 0;
+
+    for (;;) {
+        if (capacity - length < READ_CHUNK_SIZE) {
+            size_t old_capacity = capacity;
+            capacity = capacity < READ_CHUNK_SIZE ? READ_CHUNK_SIZE * 2 : capacity * 2;
+            data = (char*)reallocate(data, old_capacity, capacity);
         }
-    }
-}
 
-char peek_char(void) {
-    if (buffer_pos >= buffer_limits[current_buffer_idx]) {
-        if (eof_reached) return EOF;
-        return EOF; 
+        size_t bytes_read = fread(data + length, 1, capacity - length, file);
+        length += bytes_read;
+        if (bytes_read == 0) break;
     }
-    return buffers[current_buffer_idx][buffer_pos];
-}
 
-char skip_whitespace(void) {
-    char c;
-    while (isspace(c = peek_char()) && c != EOF) {
-        get_next_char(); // Consume the whitespace
+    if (ferror(file)) {
+        reallocate(data, capacity, 0);
+        return false;
     }
-    // Return the first non-whitespace character without consuming it
-    return c;
-}
 
-uint32_t get_current_line(void) {
-    return current_line;
+    source->data = data;
+    source->length = length;
+    source->capacity = capacity;
+    source->mapped = false;
+    return true;
 }
 
-uint32_t get_current_column(void) {
-    return current_column;
-}
 
-char* get_current_buffer(void) {
-    return buffers[current_buffer_idx];
-}
+// Returns false when the file could not be read; the source is left empty
+bool load_source(SourceBuffer* source, FILE* file) {
+    free_source(source);
+    if (!file) return false;
 
-int32_t* get_buffer_pos(void) {
-    return &buffer_pos;
+#ifdef HAVE_MMAP
+    if (map_source(source, file)) return true;
+#endif
+    return read_source(source, file);
 }
 
-void cleanup_buffer(void) {
-    file_handle = NULL;
-    current_buffer_idx = 0;
-    buffer_pos = 0;
-    buffer_limits[0] = buffer_limits[1] = 0;
-    eof_reached = 0;
-    current_line = 1;
-    current_column = 0;
+
+void use_source(SourceBuffer* source, const char* text, size_t length) {
+    free_source(source);
+    source->data = text;
+    source->length = length;
 }
 
+
+void free_source(SourceBuffer* source) {
+#ifdef HAVE_MMAP
+    if (source->mapped) {
+        munmap((void*)source->data, source->length);
+    }
+#endif
+    if (source->capacity > 0) {
+        reallocate((void*)source->data, source->capacity, 0);
+    }
+    init_source(source);
+}
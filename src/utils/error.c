@@ -2,80 +2,133 @@
 #include <stdlib.h>
 #include <string.h>
 #include <stdarg.h>
+#include <stdint.h>
 #include "utils/error.h"
-#include "utils/buffer.h" // For position tracking
+#include "utils/memory.h"
 
-#define MAX_LINES 10000
-#define MAX_LINE_LENGTH 256
+void init_error(ErrorContext *errors, const char *fname) {
+    errors->filename = fname;
+    errors->source = NULL;
+    errors->had_error = false;
+    errors->quiet = false;
+    errors->first_message[0] = '\0';
+    errors->indexed_source = NULL;
+    errors->line_starts = NULL;
+    errors->line_count = 0;
+    errors->line_capacity = 0;
+}
+
+static void free_line_index(ErrorContext *errors) {
+    FREE_ARRAY(uint32_t, errors->line_starts, errors->line_capacity);
+    errors->line_starts = NULL;
+    errors->line_count = 0;
+    errors->line_capacity = 0;
+    errors->indexed_source = NULL;
+}
+
+static void add_line_start(ErrorContext *errors, uint32_t offset) {
+    if (errors->line_capacity < errors->line_count + 1) {
+        size_t old_capacity = errors->line_capacity;
+        errors->line_capacity = GROW_CAPACITY(old_capacity);
+        errors->line_starts = GROW_ARRAY(uint32_t, errors->line_starts,
+                                         old_capacity, errors->line_capacity);
+    }
+    errors->line_starts[errors->line_count++] = offset;
+}
 
-static const char *filename;
-static char *source_lines[MAX_LINES];
-static int line_count = 0;
-static bool error_flag = false;
+// Indexes the source the scanner is currently reading, unless already done
+static void build_line_index(ErrorContext *errors) {
+    const char *source = errors->source->data;
+    size_t length = errors->source->length;
+    if (source == errors->indexed_source) return;
 
-void init_error(const char *fname) {
-    filename = fname;
-    error_flag = false;
-    line_count = 0;
+    free_line_index(errors);
+    errors->indexed_source = source;
 
-    FILE *file = fopen(filename, "r");
-    if (!file) {
-        fprintf(stderr, "Error: Could not open file '%s'.\n", filename);
-        exit(1);
+    add_line_start(errors, 0);
+    const char *end = source + length;
+    for (const char *p = source; (p = memchr(p, '\n', end - p)) != NULL; ) {
+        p++;
+        add_line_start(errors, (uint32_t)(p - source));
     }
+}
 
-    char buffer[MAX_LINE_LENGTH];
-    while (line_count < MAX_LINES && fgets(buffer, sizeof(buffer), file)) {
-        source_lines[line_count] = strdup(buffer);
-        if (!source_lines[line_count]) {
-            fprintf(stderr, "Error: Memory allocation failed.\n");
-            exit(1);
-        }
-        line_count++;
+static void print_source_line(ErrorContext *errors, int line, int column) {
+    if (!errors->source) return;
+
+    build_line_index(errors);
+    if (line <= 0 || (size_t)line > errors->line_count) return;
+
+    const char *source = errors->source->data;
+    size_t length = errors->source->length;
+    size_t start = errors->line_starts[line - 1];
+    size_t end = (size_t)line < errors->line_count ? errors->line_starts[line] : length;
+
+    // Drop the line terminator; it is printed explicitly below
+    while (end > start && (source[end - 1] == '\n' || source[end - 1] == '\r')) {
+        end--;
     }
 
-    fclose(file);
+    fprintf(stderr, "%4d | ", line);
+    fwrite(source + start, 1, end - start, stderr);
+    fprintf(stderr, "\n");
+    if (column > 0) {
+        fprintf(stderr, "%*s^", column + 6, "");
+    }
+    fprintf(stderr, "\n");
 }
 
-static void vreport(int line, int column, const char *fmt, va_list args) {
-    error_flag = true;
-    fprintf(stderr, "%s:%d:%d: error: ", filename, line, column);
+static void vreport(ErrorContext *errors, int line, int column, const char *fmt, va_list args) {
+    if (!errors->had_error) {
+        va_list copy;
+        va_copy(copy, args);
+        int prefix = snprintf(errors->first_message, DIAGNOSTIC_MAX, "%s:%d:%d: ",
+                              errors->filename, line, column);
+        if (prefix >= 0 && prefix < DIAGNOSTIC_MAX) {
+            vsnprintf(errors->first_message + prefix, DIAGNOSTIC_MAX - prefix, fmt, copy);
+        }
+        va_end(copy);
+    }
+
+    errors->had_error = true;
+    if (errors->quiet) return;
+
+    fprintf(stderr, "%s:%d:%d: error: ", errors->filename, line, column);
     vfprintf(stderr, fmt, args);
     fprintf(stderr, "\n");
 
-    if (line > 0 && line <= line_count) {
-        fprintf(stderr, "%4d | %s", line, source_lines[line - 1]);
-        if (column > 0) {
-            fprintf(stderr, "%*s^", column + 6, "");
-        }
-        fprintf(stderr, "\n");
+    if (line > 0) {
+        print_source_line(errors, line, column);
     }
 }
 
-void report_error(int line, int column, const char *message, ...) {
+void report_error(ErrorContext *errors, int line, int column, const char *message, ...) {
     va_list args;
     va_start(args, message);
-    vreport(line, column, message, args);
+    vreport(errors, line, column, message, args);
     va_end(args);
 }
 
-void error(int line, const char *message, ...) {
+void error(ErrorContext *errors, int line, const char *message, ...) {
     va_list args;
     va_start(args, message);
-    vreport(line, 0, message, args);
+    vreport(errors, line, 0, message, args);
     va_end(args);
 }
 
-bool had_error(void) {
-    return error_flag;
+bool had_error(const ErrorContext *errors) {
+    return errors->had_error;
 }
 
-void cleanup_error(void) {
-    for (int i = 0; i < line_count; i++) {
-        free(source_lines[i]);
-        source_lines[i] = NULL;
-    }
-    line_count = 0;
-    error_flag = false;
-    filename = NULL;
+void clear_errors(ErrorContext *errors) {
+    free_line_index(errors);
+    errors->had_error = false;
+    errors->first_message[0] = '\0';
+}
+
+void cleanup_error(ErrorContext *errors) {
+    free_line_index(errors);
+    errors->had_error = false;
+    errors->source = NULL;
+    errors->filename = NULL;
 }
@@ -1,10 +1,9 @@
 #include "utils/hash.h"
 
 uint32_t hash_string(const char* key, int length) {
-    uint32_t hash = 2166136261u;
+    uint32_t hash = FNV_OFFSET_BASIS;
     for (int i = 0; i < length; i++) {
-        hash ^= (uint8_t)key[i];
-        hash *= 16777619;
+        hash = HASH_STEP(hash, key[i]);
     }
     return hash;
 }
@@ -0,0 +1,771 @@
+#include "vm/builtins.h"
+#include "vm/rope.h"
+#include "vm/symbol.h"
+#include "vm/table.h"
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+// Natives get their arguments as a slice of the VM stack. Calls in operator
+// position to the arithmetic, comparison, pair and I/O builtins are still
+// compiled to inline opcodes; these run when a builtin is used as a value.
+
+
+static double number_arg(VM* vm, const char* name, Value v) {
+    if (!IS_NUMBER(v)) {
+        runtime_error(vm, "%s: Type error: Expected number", name);
+    }
+    return AS_NUMBER(v);
+}
+
+
+static ObjPair* pair_arg(VM* vm, const char* name, Value v) {
+    if (!IS_PAIR(v)) {
+        runtime_error(vm, "%s: Type error: Expected pair", name);
+    }
+    return AS_PAIR(v);
+}
+
+
+static void require_args(VM* vm, const char* name, int32_t arg_count, int32_t min) {
+    if (arg_count < min) {
+        runtime_error(vm, "%s: expected at least %d arguments but got %d", name, min, arg_count);
+    }
+}
+
+
+static bool is_truthy(Value v) {
+    return !(IS_BOOL(v) && !AS_BOOL(v));
+}
+
+
+// Appends to a list under construction, keeping a pointer to the last cdr
+static void append_item(VM* vm, Value** tail, Value item) {
+    **tail = make_pair(vm, item, NIL_VAL);
+    *tail = &AS_PAIR(**tail)->cdr;
+}
+
+
+// I/O
+
+static Value native_display(VM* vm, int32_t arg_count, Value* args) {
+    (void)arg_count;
+    write_value(&vm->out, args[0]);
+    output_char(&vm->out, '\n');
+    return NIL_VAL;
+}
+
+static Value native_write(VM* vm, int32_t arg_count, Value* args) {
+    (void)arg_count;
+    if (IS_STRING(args[0])) {
+        output_char(&vm->out, '"');
+        write_value(&vm->out, args[0]);
+        output_char(&vm->out, '"');
+    } else {
+        write_value(&vm->out, args[0]);
+    }
+    output_char(&vm->out, '\n');
+    return NIL_VAL;
+}
+
+static Value native_newline(VM* vm, int32_t arg_count, Value* args) {
+    (void)arg_count; (void)args;
+    output_char(&vm->out, '\n');
+    return NIL_VAL;
+}
+
+static Value native_flush_output(VM* vm, int32_t arg_count, Value* args) {
+    (void)arg_count; (void)args;
+    flush_output(&vm->out);
+    return NIL_VAL;
+}
+
+static Value native_read(VM* vm, int32_t arg_count, Value* args) {
+    (void)arg_count; (void)args;
+    flush_output(&vm->out);
+    double num;
+    if (fscanf(vm->in, "%lf", &num) != 1) {
+        runtime_error(vm, "Failed to read number from input");
+    }
+    return NUMBER_VAL(num);
+}
+
+static Value native_read_line(VM* vm, int32_t arg_count, Value* args) {
+    (void)arg_count; (void)args;
+    flush_output(&vm->out);
+    char buffer[1024];
+    if (!fgets(buffer, sizeof(buffer), vm->in)) {
+        runtime_error(vm, "Failed to read line from input");
+    }
+    size_t len = strlen(buffer);
+    if (len > 0 && buffer[len - 1] == '\n') {
+        len--;
+    }
+    return make_string(vm, buffer, len);
+}
+
+
+// Arithmetic
+
+static Value native_add(VM* vm, int32_t arg_count, Value* args) {
+    double sum = 0;
+    for (int32_t i = 0; i < arg_count; i++) {
+        sum += number_arg(vm, "+", args[i]);
+    }
+    return NUMBER_VAL(sum);
+}
+
+static Value native_mul(VM* vm, int32_t arg_count, Value* args) {
+    double product = 1;
+    for (int32_t i = 0; i < arg_count; i++) {
+        product *= number_arg(vm, "*", args[i]);
+    }
+    return NUMBER_VAL(product);
+}
+
+static Value native_sub(VM* vm, int32_t arg_count, Value* args) {
+    require_args(vm, "-", arg_count, 1);
+    double result = number_arg(vm, "-", args[0]);
+    if (arg_count == 1) return NUMBER_VAL(-result);
+
+    for (int32_t i = 1; i < arg_count; i++) {
+        result -= number_arg(vm, "-", args[i]);
+    }
+    return NUMBER_VAL(result);
+}
+
+static Value native_div(VM* vm, int32_t arg_count, Value* args) {
+    require_args(vm, "/", arg_count, 1);
+    double result = number_arg(vm, "/", args[0]);
+    if (arg_count == 1) result = 1 / result;
+
+    for (int32_t i = 1; i < arg_count; i++) {
+        double divisor = number_arg(vm, "/", args[i]);
+        if (divisor == 0) {
+            runtime_error(vm, "Division by zero");
+        }
+        result /= divisor;
+    }
+    return NUMBER_VAL(result);
+}
+
+static Value native_quotient(VM* vm, int32_t arg_count, Value* args) {
+    (void)arg_count;
+    double a = number_arg(vm, "quotient", args[0]);
+    double b = number_arg(vm, "quotient", args[1]);
+    if (b == 0) runtime_error(vm, "Division by zero");
+    return NUMBER_VAL(trunc(a / b));
+}
+
+static Value native_remainder(VM* vm, int32_t arg_count, Value* args) {
+    (void)arg_count;
+    double a = number_arg(vm, "remainder", args[0]);
+    double b = number_arg(vm, "remainder", args[1]);
+    if (b == 0) runtime_error(vm, "Division by zero");
+    return NUMBER_VAL(fmod(a, b));
+}
+
+// Result takes the sign of the divisor
+static Value native_modulo(VM* vm, int32_t arg_count, Value* args) {
+    (void)arg_count;
+    double a = number_arg(vm, "modulo", args[0]);
+    double b = number_arg(vm, "modulo", args[1]);
+    if (b == 0) runtime_error(vm, "Division by zero");
+    double r = fmod(a, b);
+    if (r != 0 && (r < 0) != (b < 0)) r += b;
+    return NUMBER_VAL(r);
+}
+
+static Value native_abs(VM* vm, int32_t arg_count, Value* args) {
+    (void)arg_count;
+    return NUMBER_VAL(fabs(number_arg(vm, "abs", args[0])));
+}
+
+static Value native_sqrt(VM* vm, int32_t arg_count, Value* args) {
+    (void)arg_count;
+    return NUMBER_VAL(sqrt(number_arg(vm, "sqrt", args[0])));
+}
+
+static Value native_expt(VM* vm, int32_t arg_count, Value* args) {
+    (void)arg_count;
+    return NUMBER_VAL(pow(number_arg(vm, "expt", args[0]), number_arg(vm, "expt", args[1])));
+}
+
+static Value native_max(VM* vm, int32_t arg_count, Value* args) {
+    require_args(vm, "max", arg_count, 1);
+    double result = number_arg(vm, "max", args[0]);
+    for (int32_t i = 1; i < arg_count; i++) {
+        double n = number_arg(vm, "max", args[i]);
+        if (n > result) result = n;
+    }
+    return NUMBER_VAL(result);
+}
+
+static Value native_min(VM* vm, int32_t arg_count, Value* args) {
+    require_args(vm, "min", arg_count, 1);
+    double result = number_arg(vm, "min", args[0]);
+    for (int32_t i = 1; i < arg_count; i++) {
+        double n = number_arg(vm, "min", args[i]);
+        if (n < result) result = n;
+    }
+    return NUMBER_VAL(result);
+}
+
+
+// Comparisons hold pairwise along the whole argument list
+
+#define DEFINE_COMPARISON(fn, name, op)                                     \
+    static Value fn(VM* vm, int32_t arg_count, Value* args) {              \
+        require_args(vm, name, arg_count, 2);                              \
+        for (int32_t i = 1; i < arg_count; i++) {                          \
+            if (!(number_arg(vm, name, args[i - 1]) op                     \
+                  number_arg(vm, name, args[i]))) {                        \
+                return BOOL_VAL(false);                                    \
+            }                                                              \
+        }                                                                  \
+        return BOOL_VAL(true);                                             \
+    }
+
+DEFINE_COMPARISON(native_equal, "=", ==)
+DEFINE_COMPARISON(native_less, "<", <)
+DEFINE_COMPARISON(native_greater, ">", >)
+DEFINE_COMPARISON(native_less_equal, "<=", <=)
+DEFINE_COMPARISON(native_greater_equal, ">=", >=)
+
+#undef DEFINE_COMPARISON
+
+
+// Pairs and lists
+
+static Value native_cons(VM* vm, int32_t arg_count, Value* args) {
+    (void)arg_count;
+    return make_pair(vm, args[0], args[1]);
+}
+
+static Value native_car(VM* vm, int32_t arg_count, Value* args) {
+    (void)arg_count;
+    return pair_arg(vm, "car", args[0])->car;
+}
+
+static Value native_cdr(VM* vm, int32_t arg_count, Value* args) {
+    (void)arg_count;
+    return pair_arg(vm, "cdr", args[0])->cdr;
+}
+
+static Value native_list(VM* vm, int32_t arg_count, Value* args) {
+    Value list = NIL_VAL;
+    for (int32_t i = arg_count - 1; i >= 0; i--) {
+        list = make_pair(vm, args[i], list);
+    }
+    return list;
+}
+
+static Value native_length(VM* vm, int32_t arg_count, Value* args) {
+    (void)arg_count;
+    double length = 0;
+    for (Value v = args[0]; !IS_NIL(v); v = pair_arg(vm, "length", v)->cdr) {
+        length++;
+    }
+    return NUMBER_VAL(length);
+}
+
+static Value native_reverse(VM* vm, int32_t arg_count, Value* args) {
+    (void)arg_count;
+    Value result = NIL_VAL;
+    for (Value v = args[0]; !IS_NIL(v); v = AS_PAIR(v)->cdr) {
+        result = make_pair(vm, pair_arg(vm, "reverse", v)->car, result);
+    }
+    return result;
+}
+
+// Every list but the last is copied; the last is shared
+static Value native_append(VM* vm, int32_t arg_count, Value* args) {
+    if (arg_count == 0) return NIL_VAL;
+
+    Value result = NIL_VAL;
+    Value* tail = &result;
+    for (int32_t i = 0; i < arg_count - 1; i++) {
+        for (Value v = args[i]; !IS_NIL(v); v = AS_PAIR(v)->cdr) {
+            append_item(vm, &tail, pair_arg(vm, "append", v)->car);
+        }
+    }
+    *tail = args[arg_count - 1];
+    return result;
+}
+
+// (map f list1 list2 ...) stops at the end of the shortest list
+static Value native_map(VM* vm, int32_t arg_count, Value* args) {
+    require_args(vm, "map", arg_count, 2);
+    int32_t list_count = arg_count - 1;
+    if (list_count > 8) {
+        runtime_error(vm, "map: at most 8 lists are supported");
+    }
+
+    Value lists[8];
+    for (int32_t i = 0; i < list_count; i++) {
+        lists[i] = args[i + 1];
+    }
+
+    Value result = NIL_VAL;
+    Value* tail = &result;
+    for (;;) {
+        Value items[8];
+        for (int32_t i = 0; i < list_count; i++) {
+            if (IS_NIL(lists[i])) return result;
+            ObjPair* pair = pair_arg(vm, "map", lists[i]);
+            items[i] = pair->car;
+            lists[i] = pair->cdr;
+        }
+        append_item(vm, &tail, vm_call(vm, args[0], list_count, items));
+    }
+}
+
+static Value native_filter(VM* vm, int32_t arg_count, Value* args) {
+    (void)arg_count;
+    Value result = NIL_VAL;
+    Value* tail = &result;
+    for (Value v = args[1]; !IS_NIL(v); v = AS_PAIR(v)->cdr) {
+        Value item = pair_arg(vm, "filter", v)->car;
+        if (is_truthy(vm_call(vm, args[0], 1, &item))) {
+            append_item(vm, &tail, item);
+        }
+    }
+    return result;
+}
+
+// (reduce f initial list): initial if list is empty, else folds (f item acc)
+// starting from the first item
+static Value native_reduce(VM* vm, int32_t arg_count, Value* args) {
+    (void)arg_count;
+    Value list = args[2];
+    if (IS_NIL(list)) return args[1];
+
+    Value acc = pair_arg(vm, "reduce", list)->car;
+    for (Value v = AS_PAIR(list)->cdr; !IS_NIL(v); v = AS_PAIR(v)->cdr) {
+        Value call_args[2] = {pair_arg(vm, "reduce", v)->car, acc};
+        acc = vm_call(vm, args[0], 2, call_args);
+    }
+    return acc;
+}
+
+// (apply f a b list) calls (f a b . list)
+static Value native_apply(VM* vm, int32_t arg_count, Value* args) {
+    require_args(vm, "apply", arg_count, 2);
+
+    Value call_args[STACK_MAX];
+    int32_t count = 0;
+    for (int32_t i = 1; i < arg_count - 1; i++) {
+        call_args[count++] = args[i];
+    }
+    for (Value v = args[arg_count - 1]; !IS_NIL(v); v = AS_PAIR(v)->cdr) {
+        if (count == STACK_MAX) runtime_error(vm, "apply: too many arguments");
+        call_args[count++] = pair_arg(vm, "apply", v)->car;
+    }
+    return vm_call(vm, args[0], count, call_args);
+}
+
+
+// Vectors
+
+static ObjVector* vector_arg(VM* vm, const char* name, Value v) {
+    if (!IS_VECTOR(v)) {
+        runtime_error(vm, "%s: Type error: Expected vector", name);
+    }
+    return AS_VECTOR(v);
+}
+
+static Value native_make_vector(VM* vm, int32_t arg_count, Value* args) {
+    require_args(vm, "make-vector", arg_count, 1);
+    if (arg_count > 2) {
+        runtime_error(vm, "make-vector: expected at most 2 arguments but got %d", arg_count);
+    }
+    double length = number_arg(vm, "make-vector", args[0]);
+    if (length < 0 || length > UINT32_MAX || length != (double)(uint32_t)length) {
+        runtime_error(vm, "make-vector: invalid length %g", length);
+    }
+    return make_vector(vm, (uint32_t)length, arg_count == 2 ? args[1] : NUMBER_VAL(0));
+}
+
+static Value native_vector(VM* vm, int32_t arg_count, Value* args) {
+    Value vector = make_vector(vm, (uint32_t)arg_count, NIL_VAL);
+    memcpy(AS_VECTOR(vector)->items, args, sizeof(Value) * arg_count);
+    return vector;
+}
+
+static Value native_vector_ref(VM* vm, int32_t arg_count, Value* args) {
+    (void)arg_count;
+    ObjVector* vector = vector_arg(vm, "vector-ref", args[0]);
+    return vector->items[vector_index(vm, vector->count, args[1])];
+}
+
+static Value native_vector_set(VM* vm, int32_t arg_count, Value* args) {
+    (void)arg_count;
+    ObjVector* vector = vector_arg(vm, "vector-set!", args[0]);
+    vector->items[vector_index(vm, vector->count, args[1])] = args[2];
+    return NIL_VAL;
+}
+
+static Value native_vector_length(VM* vm, int32_t arg_count, Value* args) {
+    (void)arg_count;
+    return NUMBER_VAL(vector_arg(vm, "vector-length", args[0])->count);
+}
+
+
+// Strings. string-append builds ropes for long results; a string port
+// collects pieces into one buffer and is the cheaper choice in a loop.
+
+static ObjString* string_arg(VM* vm, const char* name, Value v) {
+    if (!IS_STRING(v)) {
+        runtime_error(vm, "%s: Type error: Expected string", name);
+    }
+    return AS_STRING(v);
+}
+
+static ObjStringPort* string_port_arg(VM* vm, const char* name, Value v) {
+    if (!IS_STRING_PORT(v)) {
+        runtime_error(vm, "%s: Type error: Expected string port", name);
+    }
+    return AS_STRING_PORT(v);
+}
+
+static Value native_string_length(VM* vm, int32_t arg_count, Value* args) {
+    (void)arg_count;
+    return NUMBER_VAL(string_arg(vm, "string-length", args[0])->length);
+}
+
+static Value native_string_append(VM* vm, int32_t arg_count, Value* args) {
+    if (arg_count == 0) return make_string(vm, "", 0);
+
+    Value result = STRING_VAL(string_arg(vm, "string-append", args[0]));
+    for (int32_t i = 1; i < arg_count; i++) {
+        result = string_append(vm, AS_STRING(result), string_arg(vm, "string-append", args[i]));
+    }
+    return result;
+}
+
+static Value native_string_equal(VM* vm, int32_t arg_count, Value* args) {
+    (void)arg_count;
+    ObjString* a = string_arg(vm, "string=?", args[0]);
+    ObjString* b = string_arg(vm, "string=?", args[1]);
+    return BOOL_VAL(string_equal(vm, a, b));
+}
+
+static Value native_number_to_string(VM* vm, int32_t arg_count, Value* args) {
+    (void)arg_count;
+    char digits[NUMBER_BUFFER_SIZE];
+    int length = format_number(digits, number_arg(vm, "number->string", args[0]));
+    return make_string(vm, digits, (size_t)length);
+}
+
+static Value native_open_output_string(VM* vm, int32_t arg_count, Value* args) {
+    (void)arg_count; (void)args;
+    return make_string_port(vm);
+}
+
+static Value native_write_string(VM* vm, int32_t arg_count, Value* args) {
+    (void)arg_count;
+    ObjString* string = string_arg(vm, "write-string", args[0]);
+    string_port_append_string(vm, string_port_arg(vm, "write-string", args[1]), string);
+    return NIL_VAL;
+}
+
+static Value native_get_output_string(VM* vm, int32_t arg_count, Value* args) {
+    (void)arg_count;
+    ObjStringPort* port = string_port_arg(vm, "get-output-string", args[0]);
+    return make_string(vm, port->chars, port->length);
+}
+
+
+// Predicates
+
+static Value native_is_vector(VM* vm, int32_t arg_count, Value* args) {
+    (void)vm; (void)arg_count;
+    return BOOL_VAL(IS_VECTOR(args[0]));
+}
+
+static Value native_is_null(VM* vm, int32_t arg_count, Value* args) {
+    (void)vm; (void)arg_count;
+    return BOOL_VAL(IS_NIL(args[0]));
+}
+
+static Value native_is_pair(VM* vm, int32_t arg_count, Value* args) {
+    (void)vm; (void)arg_count;
+    return BOOL_VAL(IS_PAIR(args[0]));
+}
+
+static Value native_is_list(VM* vm, int32_t arg_count, Value* args) {
+    (void)vm; (void)arg_count;
+    Value v = args[0];
+    while (IS_PAIR(v)) v = AS_PAIR(v)->cdr;
+    return BOOL_VAL(IS_NIL(v));
+}
+
+static Value native_is_number(VM* vm, int32_t arg_count, Value* args) {
+    (void)vm; (void)arg_count;
+    return BOOL_VAL(IS_NUMBER(args[0]));
+}
+
+static Value native_is_integer(VM* vm, int32_t arg_count, Value* args) {
+    (void)vm; (void)arg_count;
+    return BOOL_VAL(IS_NUMBER(args[0]) && AS_NUMBER(args[0]) == floor(AS_NUMBER(args[0])));
+}
+
+static Value native_is_string(VM* vm, int32_t arg_count, Value* args) {
+    (void)vm; (void)arg_count;
+    return BOOL_VAL(IS_STRING(args[0]));
+}
+
+static Value native_is_boolean(VM* vm, int32_t arg_count, Value* args) {
+    (void)vm; (void)arg_count;
+    return BOOL_VAL(IS_BOOL(args[0]));
+}
+
+static Value native_is_procedure(VM* vm, int32_t arg_count, Value* args) {
+    (void)vm; (void)arg_count;
+    return BOOL_VAL(IS_CLOSURE(args[0]) || IS_NATIVE(args[0]) || IS_FUNCTION(args[0]) ||
+                    IS_CONTINUATION(args[0]) || IS_GENERATOR(args[0]));
+}
+
+static Value native_is_atom(VM* vm, int32_t arg_count, Value* args) {
+    (void)vm; (void)arg_count;
+    return BOOL_VAL(!IS_PAIR(args[0]) && !IS_NIL(args[0]));
+}
+
+static Value native_not(VM* vm, int32_t arg_count, Value* args) {
+    (void)vm; (void)arg_count;
+    return BOOL_VAL(!is_truthy(args[0]));
+}
+
+static Value native_is_zero(VM* vm, int32_t arg_count, Value* args) {
+    (void)arg_count;
+    return BOOL_VAL(number_arg(vm, "zero?", args[0]) == 0);
+}
+
+static Value native_is_even(VM* vm, int32_t arg_count, Value* args) {
+    (void)arg_count;
+    return BOOL_VAL(fmod(number_arg(vm, "even?", args[0]), 2) == 0);
+}
+
+static Value native_is_odd(VM* vm, int32_t arg_count, Value* args) {
+    (void)arg_count;
+    return BOOL_VAL(fabs(fmod(number_arg(vm, "odd?", args[0]), 2)) == 1);
+}
+
+
+// Equality. Symbols are interned, so eq? on them is a pointer comparison.
+
+static bool is_equal(VM* vm, Value a, Value b) {
+    while (IS_PAIR(a) && IS_PAIR(b)) {
+        if (!is_equal(vm, AS_PAIR(a)->car, AS_PAIR(b)->car)) return false;
+        a = AS_PAIR(a)->cdr;
+        b = AS_PAIR(b)->cdr;
+    }
+
+    if (IS_VECTOR(a) && IS_VECTOR(b)) {
+        ObjVector* va = AS_VECTOR(a);
+        ObjVector* vb = AS_VECTOR(b);
+        if (va->count != vb->count) return false;
+        for (uint32_t i = 0; i < va->count; i++) {
+            if (!is_equal(vm, va->items[i], vb->items[i])) return false;
+        }
+        return true;
+    }
+
+    if (IS_F64VECTOR(a) && IS_F64VECTOR(b)) {
+        ObjF64Vector* va = AS_F64VECTOR(a);
+        ObjF64Vector* vb = AS_F64VECTOR(b);
+        if (va->count != vb->count) return false;
+        for (uint32_t i = 0; i < va->count; i++) {
+            if (va->items[i] != vb->items[i]) return false;
+        }
+        return true;
+    }
+
+    if (IS_U8VECTOR(a) && IS_U8VECTOR(b)) {
+        ObjU8Vector* va = AS_U8VECTOR(a);
+        ObjU8Vector* vb = AS_U8VECTOR(b);
+        return va->count == vb->count && memcmp(va->items, vb->items, va->count) == 0;
+    }
+    return is_eqv(vm, a, b);
+}
+
+// Searches of lists and association lists, by eqv? or equal?
+
+typedef bool (*Equivalence)(VM* vm, Value a, Value b);
+
+static Value find_member(VM* vm, const char* name, Value item, Value list, Equivalence same) {
+    for (Value v = list; !IS_NIL(v); v = AS_PAIR(v)->cdr) {
+        if (same(vm, item, pair_arg(vm, name, v)->car)) return v;
+    }
+    return BOOL_VAL(false);
+}
+
+static Value find_association(VM* vm, const char* name, Value key, Value alist, Equivalence same) {
+    for (Value v = alist; !IS_NIL(v); v = AS_PAIR(v)->cdr) {
+        Value entry = pair_arg(vm, name, v)->car;
+        if (same(vm, key, pair_arg(vm, name, entry)->car)) return entry;
+    }
+    return BOOL_VAL(false);
+}
+
+static Value native_memv(VM* vm, int32_t arg_count, Value* args) {
+    (void)arg_count;
+    return find_member(vm, "memv", args[0], args[1], is_eqv);
+}
+
+static Value native_member(VM* vm, int32_t arg_count, Value* args) {
+    (void)arg_count;
+    return find_member(vm, "member", args[0], args[1], is_equal);
+}
+
+static Value native_assv(VM* vm, int32_t arg_count, Value* args) {
+    (void)arg_count;
+    return find_association(vm, "assv", args[0], args[1], is_eqv);
+}
+
+static Value native_assoc(VM* vm, int32_t arg_count, Value* args) {
+    (void)arg_count;
+    return find_association(vm, "assoc", args[0], args[1], is_equal);
+}
+
+
+// Symbols
+
+static Value native_is_symbol(VM* vm, int32_t arg_count, Value* args) {
+    (void)vm; (void)arg_count;
+    return BOOL_VAL(IS_SYMBOL(args[0]));
+}
+
+static Value native_symbol_to_string(VM* vm, int32_t arg_count, Value* args) {
+    (void)arg_count;
+    if (!IS_SYMBOL(args[0])) {
+        runtime_error(vm, "symbol->string: Type error: Expected symbol");
+    }
+    return make_string(vm, AS_SYMBOL(args[0])->name, AS_SYMBOL(args[0])->length);
+}
+
+static Value native_string_to_symbol(VM* vm, int32_t arg_count, Value* args) {
+    (void)arg_count;
+    ObjString* string = string_arg(vm, "string->symbol", args[0]);
+    return SYMBOL_VAL(intern_symbol_object(string_chars(vm, string), string->length));
+}
+
+
+static Value native_is_eqv(VM* vm, int32_t arg_count, Value* args) {
+    (void)arg_count;
+    return BOOL_VAL(is_eqv(vm, args[0], args[1]));
+}
+
+static Value native_is_equal(VM* vm, int32_t arg_count, Value* args) {
+    (void)arg_count;
+    return BOOL_VAL(is_equal(vm, args[0], args[1]));
+}
+
+
+static ObjNative BUILTINS[] = {
+    // I/O procedures
+    {native_display, "display", 1, false},
+    {native_write, "write", 1, false},
+    {native_display, "print", 1, false},
+    {native_newline, "newline", 0, false},
+    {native_flush_output, "flush-output", 0, false},
+    {native_read, "read", 0, false},
+    {native_read_line, "read-line", 0, false},
+
+    // Arithmetic operators
+    {native_add, "+", -1, false},
+    {native_sub, "-", -1, false},
+    {native_mul, "*", -1, false},
+    {native_div, "/", -1, false},
+    {native_modulo, "modulo", 2, false},
+    {native_remainder, "remainder", 2, false},
+    {native_quotient, "quotient", 2, false},
+    {native_abs, "abs", 1, false},
+    {native_max, "max", -1, false},
+    {native_min, "min", -1, false},
+    {native_sqrt, "sqrt", 1, false},
+    {native_expt, "expt", 2, false},
+
+    // Comparison operators
+    {native_equal, "=", -1, false},
+    {native_less, "<", -1, false},
+    {native_greater, ">", -1, false},
+    {native_less_equal, "<=", -1, false},
+    {native_greater_equal, ">=", -1, false},
+
+    // List manipulation
+    {native_car, "car", 1, false},
+    {native_cdr, "cdr", 1, false},
+    {native_cons, "cons", 2, false},
+    {native_list, "list", -1, false},
+    {native_append, "append", -1, false},
+    {native_reverse, "reverse", 1, false},
+    {native_length, "length", 1, false},
+    {native_map, "map", -1, false},
+    {native_filter, "filter", 2, false},
+    {native_reduce, "reduce", 3, false},
+    {native_apply, "apply", -1, false},
+
+    // Vectors
+    {native_make_vector, "make-vector", -1, false},
+    {native_vector, "vector", -1, false},
+    {native_vector_ref, "vector-ref", 2, false},
+    {native_vector_set, "vector-set!", 3, false},
+    {native_vector_length, "vector-length", 1, false},
+
+    // Strings
+    {native_string_length, "string-length", 1, false},
+    {native_string_append, "string-append", -1, false},
+    {native_string_equal, "string=?", 2, false},
+    {native_number_to_string, "number->string", 1, false},
+    {native_open_output_string, "open-output-string", 0, false},
+    {native_write_string, "write-string", 2, false},
+    {native_get_output_string, "get-output-string", 1, false},
+
+    // Symbols
+    {native_symbol_to_string, "symbol->string", 1, false},
+    {native_string_to_symbol, "string->symbol", 1, false},
+
+    // Type predicates
+    {native_is_null, "null?", 1, false},
+    {native_is_vector, "vector?", 1, false},
+    {native_is_pair, "pair?", 1, false},
+    {native_is_list, "list?", 1, false},
+    {native_is_number, "number?", 1, false},
+    {native_is_integer, "integer?", 1, false},
+    {native_is_string, "string?", 1, false},
+    {native_is_boolean, "boolean?", 1, false},
+    {native_is_procedure, "procedure?", 1, false},
+    {native_is_atom, "atom?", 1, false},
+    {native_is_symbol, "symbol?", 1, false},
+
+    // Equality
+    {native_is_eqv, "eq?", 2, false},
+    {native_is_eqv, "eqv?", 2, false},
+    {native_memv, "memq", 2, false},
+    {native_memv, "memv", 2, false},
+    {native_member, "member", 2, false},
+    {native_assv, "assq", 2, false},
+    {native_assv, "assv", 2, false},
+    {native_assoc, "assoc", 2, false},
+    {native_is_equal, "equal?", 2, false},
+
+    // Logical
+    {native_not, "not", 1, false},
+
+    // Numeric predicates
+    {native_is_even, "even?", 1, false},
+    {native_is_odd, "odd?", 1, false},
+    {native_is_zero, "zero?", 1, false},
+};
+
+
+void register_builtins(VM* vm) {
+    for (size_t i = 0; i < sizeof(BUILTINS) / sizeof(BUILTINS[0]); i++) {
+        table_set(&vm->globals, BUILTINS[i].name, NATIVE_VAL(&BUILTINS[i]));
+    }
+    register_numvec_builtins(vm);
+    register_hash_table_builtins(vm);
+    register_control_builtins(vm);
+    register_thread_builtins(vm);
+}
@@ -0,0 +1,306 @@
+#include "vm/control.h"
+#include "vm/builtins.h"
+#include <string.h>
+
+
+// A generator's procedure is called with this as its return address, so
+// the generator learns that it is done. It is never quickened, so every VM
+// can share it.
+static Instruction GENERATOR_EXIT_CODE[] = {{OP_GENERATOR_RETURN, 0}};
+static Bytecode GENERATOR_EXIT = {GENERATOR_EXIT_CODE, 1, 1, NULL, 0, 0};
+
+
+// Control procedures move frames around, which is only possible when Scheme
+// code calls them: a native calling one through vm_call would have its C
+// frame skipped. Returns the level of the calling code.
+static RunLevel* calling_level(VM* vm, const char* name) {
+    RunLevel* level = vm->run_level;
+    if (level == NULL || vm->native_calls != level->native_calls) {
+        runtime_error(vm, "%s: cannot be called by a native procedure", name);
+    }
+    return level;
+}
+
+
+// Stack segments
+
+// Copies the frames from frame_base up and the values in [stack_base,
+// stack_top), and records the current code position
+static void save_segment(VM* vm, StackSegment* segment, int32_t frame_base,
+                         int32_t stack_base, int32_t stack_top) {
+    int32_t frame_count = vm->frame_count - frame_base;
+    int32_t value_count = stack_top - stack_base;
+
+    // A generator reuses its segment on every yield
+    if (segment->frame_capacity < frame_count) {
+        segment->frame_capacity = frame_count < 8 ? 8 : frame_count * 2;
+        segment->frames = arena_alloc(&vm->heap, sizeof(SavedFrame) * segment->frame_capacity);
+    }
+    if (segment->value_capacity < value_count) {
+        segment->value_capacity = value_count < 16 ? 16 : value_count * 2;
+        segment->values = arena_alloc(&vm->heap, sizeof(Value) * segment->value_capacity);
+    }
+
+    Value* base = &vm->stack[stack_base];
+    for (int32_t i = 0; i < frame_count; i++) {
+        CallFrame* frame = &vm->frames[frame_base + i];
+        SavedFrame* saved = &segment->frames[i];
+        saved->closure = frame->closure;
+        saved->parent_code = frame->parent_code;
+        saved->ip = frame->ip;
+        saved->slots = (int32_t)(frame->slots - base);
+    }
+    // values is still NULL when a segment has never held any
+    if (value_count > 0) {
+        memcpy(segment->values, base, sizeof(Value) * value_count);
+    }
+
+    segment->frame_count = frame_count;
+    segment->value_count = value_count;
+    segment->code = vm->code;
+    segment->ip = vm->ip;
+}
+
+
+// Puts a saved segment back on top of frame_base and stack_base, which
+// need not be where it was saved from, and continues where it left off
+static void restore_segment(VM* vm, const StackSegment* segment, int32_t frame_base,
+                            int32_t stack_base) {
+    if (frame_base + segment->frame_count > FRAMES_MAX) {
+        runtime_error(vm, "Stack Overflow");
+    }
+    if (stack_base + segment->value_count >= STACK_MAX) {
+        runtime_error(vm, "Stack overflow!");
+    }
+
+    Value* base = &vm->stack[stack_base];
+    for (int32_t i = 0; i < segment->frame_count; i++) {
+        const SavedFrame* saved = &segment->frames[i];
+        CallFrame* frame = &vm->frames[frame_base + i];
+        frame->closure = saved->closure;
+        frame->parent_code = saved->parent_code;
+        frame->ip = saved->ip;
+        frame->slots = base + saved->slots;
+    }
+    if (segment->value_count > 0) {
+        memcpy(base, segment->values, sizeof(Value) * segment->value_count);
+    }
+
+    vm->frame_count = frame_base + segment->frame_count;
+    vm->stack_top = stack_base + segment->value_count;
+    vm->code = segment->code;
+    vm->ip = segment->ip;
+}
+
+
+// Continuations
+
+// (call/cc procedure)
+static Value native_call_cc(VM* vm, int32_t arg_count, Value* args) {
+    (void)arg_count;
+    RunLevel* level = calling_level(vm, "call/cc");
+    Value procedure = args[0];
+
+    // Invoking the continuation returns from this call: its value replaces
+    // the callee, and execution continues after the call instruction
+    int32_t result_slot = vm->stack_top - 2;
+    ObjContinuation* continuation = ARENA_NEW(&vm->heap, ObjContinuation);
+    memset(continuation, 0, sizeof(ObjContinuation));
+    continuation->level = level->id;
+    continuation->thread = vm->thread;
+    save_segment(vm, &continuation->segment, level->frame_base, level->stack_base, result_slot);
+
+    // procedure is called in place of call/cc, so its result is call/cc's
+    vm->stack[result_slot] = procedure;
+    vm->stack[result_slot + 1] = CONTINUATION_VAL(continuation);
+    call_value(vm, procedure, 1);
+    return NIL_VAL;
+}
+
+
+static void yield_generator(VM* vm, ObjGenerator* generator, int32_t arg_count);
+
+void invoke_continuation(VM* vm, ObjContinuation* continuation, int32_t arg_count) {
+    if (continuation->generator) {
+        yield_generator(vm, continuation->generator, arg_count);
+        return;
+    }
+
+    if (arg_count != 1) {
+        runtime_error(vm, "continuation: expected 1 argument but got %d", arg_count);
+    }
+    if (continuation->thread != vm->thread) {
+        runtime_error(vm, "continuation: captured by another thread");
+    }
+
+    RunLevel* level = vm->run_level;
+    while (level != NULL && level->id != continuation->level) {
+        level = level->outer;
+    }
+    if (level == NULL) {
+        runtime_error(vm, "continuation: the code it returns to has finished running");
+    }
+
+    // Closures keep the values they captured; the frames get the saved ones
+    Value value = vm->stack[vm->stack_top - 1];
+    close_upvalues(vm, &vm->stack[level->stack_base]);
+    restore_segment(vm, &continuation->segment, level->frame_base, level->stack_base);
+    push(vm, value);
+
+    // Natives and deeper levels have C frames to skip
+    if (level != vm->run_level || vm->native_calls != level->native_calls) {
+        vm->run_level = level;
+        vm->native_calls = level->native_calls;
+        vm->error_jump = level->error_jump;
+        longjmp(level->jump, 1);
+    }
+}
+
+
+// Generators
+
+// (make-generator procedure): procedure is called with yield on the first
+// resume
+static Value native_make_generator(VM* vm, int32_t arg_count, Value* args) {
+    (void)arg_count;
+    if (!IS_CLOSURE(args[0]) || AS_CLOSURE(args[0])->function->arity != 1) {
+        runtime_error(vm, "make-generator: expected a procedure of one argument");
+    }
+
+    ObjGenerator* generator = ARENA_NEW(&vm->heap, ObjGenerator);
+    memset(generator, 0, sizeof(ObjGenerator));
+    generator->state = GENERATOR_FRESH;
+    generator->procedure = args[0];
+    generator->result = NIL_VAL;
+
+    generator->yield = ARENA_NEW(&vm->heap, ObjContinuation);
+    memset(generator->yield, 0, sizeof(ObjContinuation));
+    generator->yield->generator = generator;
+    return GENERATOR_VAL(generator);
+}
+
+
+static Value native_is_generator(VM* vm, int32_t arg_count, Value* args) {
+    (void)vm;
+    (void)arg_count;
+    return BOOL_VAL(IS_GENERATOR(args[0]));
+}
+
+
+// A running generator's procedure returns to GENERATOR_EXIT. If that frame
+// is gone, a continuation took control out of the generator.
+static bool still_running(VM* vm, ObjGenerator* generator) {
+    return generator->thread == vm->thread &&
+           generator->base_frame < vm->frame_count &&
+           vm->frames[generator->base_frame].parent_code == &GENERATOR_EXIT;
+}
+
+
+// (generator) or (generator value), where value is what yield returns
+void resume_generator(VM* vm, ObjGenerator* generator, int32_t arg_count) {
+    calling_level(vm, "generator");
+    if (arg_count > 1) {
+        runtime_error(vm, "generator: expected 0 or 1 arguments but got %d", arg_count);
+    }
+
+    Value sent = arg_count == 1 ? pop(vm) : NIL_VAL;
+    int32_t result_slot = vm->stack_top - 1;
+
+    if (generator->state == GENERATOR_RUNNING) {
+        if (generator->thread != vm->thread || still_running(vm, generator)) {
+            runtime_error(vm, "generator: already running");
+        }
+        generator->state = GENERATOR_DONE;
+    }
+    if (generator->state == GENERATOR_DONE) {
+        vm->stack[result_slot] = generator->result;
+        return;
+    }
+
+    generator->thread = vm->thread;
+    generator->result_slot = result_slot;
+    generator->base_frame = vm->frame_count;
+    generator->return_code = vm->code;
+    generator->return_ip = vm->ip;
+
+    if (generator->state == GENERATOR_FRESH) {
+        generator->state = GENERATOR_RUNNING;
+        push(vm, generator->procedure);
+        push(vm, CONTINUATION_VAL(generator->yield));
+        call_value(vm, generator->procedure, 1);
+
+        CallFrame* frame = &vm->frames[vm->frame_count - 1];
+        frame->parent_code = &GENERATOR_EXIT;
+        frame->ip = 0;
+        return;
+    }
+
+    // The suspended frames go above the generator, and yield returns sent
+    generator->state = GENERATOR_RUNNING;
+    restore_segment(vm, &generator->suspended, generator->base_frame, result_slot + 1);
+    push(vm, sent);
+}
+
+
+// (yield value): value is the result of the call that resumed the generator
+static void yield_generator(VM* vm, ObjGenerator* generator, int32_t arg_count) {
+    RunLevel* level = calling_level(vm, "yield");
+    if (arg_count > 1) {
+        runtime_error(vm, "yield: expected 0 or 1 arguments but got %d", arg_count);
+    }
+    if (generator->state != GENERATOR_RUNNING || !still_running(vm, generator)) {
+        runtime_error(vm, "yield: generator is not running");
+    }
+    if (level->frame_base > generator->base_frame) {
+        runtime_error(vm, "yield: cannot suspend a call made by a native procedure");
+    }
+
+    Value value = arg_count == 1 ? vm->stack[vm->stack_top - 1] : NIL_VAL;
+    int32_t base = generator->result_slot + 1;
+
+    // Everything above the generator, except this call of yield
+    save_segment(vm, &generator->suspended, generator->base_frame, base,
+                 vm->stack_top - arg_count - 1);
+    close_upvalues(vm, &vm->stack[base]);
+    generator->state = GENERATOR_SUSPENDED;
+
+    vm->frame_count = generator->base_frame;
+    vm->stack_top = generator->result_slot;
+    push(vm, value);
+    vm->code = generator->return_code;
+    vm->ip = generator->return_ip;
+}
+
+
+void finish_generator(VM* vm) {
+    Value result = pop(vm);
+
+    // The callee slot of the call that resumed it
+    Value callee = vm->stack[vm->stack_top - 1];
+    if (!IS_GENERATOR(callee)) {
+        runtime_error(vm, "generator: returned to a call it did not resume");
+    }
+
+    ObjGenerator* generator = AS_GENERATOR(callee);
+    generator->state = GENERATOR_DONE;
+    generator->result = result;
+
+    vm->stack[vm->stack_top - 1] = result;
+    vm->code = generator->return_code;
+    vm->ip = generator->return_ip;
+}
+
+
+static ObjNative CONTROL_BUILTINS[] = {
+    {native_call_cc, "call/cc", 1, true},
+    {native_call_cc, "call-with-current-continuation", 1, true},
+    {native_make_generator, "make-generator", 1, false},
+    {native_is_generator, "generator?", 1, false},
+};
+
+
+void register_control_builtins(VM* vm) {
+    for (size_t i = 0; i < sizeof(CONTROL_BUILTINS) / sizeof(CONTROL_BUILTINS[0]); i++) {
+        table_set(&vm->globals, CONTROL_BUILTINS[i].name, NATIVE_VAL(&CONTROL_BUILTINS[i]));
+    }
+}
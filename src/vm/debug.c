@@ -7,7 +7,7 @@ static int32_t simple_instruction(const char* name, int32_t offset) {
     return offset + 1;
 }
 
-static int32_t constant_instruction(const char* name, Bytecode* bc, int32_t offset) {
+static int32_t constant_instruction(const char* name, const Bytecode* bc, int32_t offset) {
     int32_t constant_index = bc->instructions[offset].operand;
     printf("%-16s %4d '", name, constant_index);
     print_value(bc->constants[constant_index]);
@@ -20,7 +20,7 @@ static int32_t jump_instruction(const char* name, int32_t offset, int32_t operan
     return offset + 1;
 }
 
-int32_t disassemble_instruction(Bytecode* bc, int32_t offset) {
+int32_t disassemble_instruction(const Bytecode* bc, int32_t offset) {
     printf("%04d ", offset);
     
     Instruction instr = bc->instructions[offset];
@@ -65,12 +65,51 @@ int32_t disassemble_instruction(Bytecode* bc, int32_t offset) {
         case OP_NOT_EQUAL:
             simple_instruction("OP_NOT_EQUAL", offset);
             break;
+        case OP_EQV:
+            simple_instruction("OP_EQV", offset);
+            break;
+        case OP_EQV_CONSTANT:
+            constant_instruction("OP_EQV_CONSTANT", bc, offset);
+            break;
+        case OP_ADD_NUMBER:
+            simple_instruction("OP_ADD_NUMBER", offset);
+            break;
+        case OP_SUB_NUMBER:
+            simple_instruction("OP_SUB_NUMBER", offset);
+            break;
+        case OP_MUL_NUMBER:
+            simple_instruction("OP_MUL_NUMBER", offset);
+            break;
+        case OP_DIV_NUMBER:
+            simple_instruction("OP_DIV_NUMBER", offset);
+            break;
+        case OP_EQUAL_NUMBER:
+            simple_instruction("OP_EQUAL_NUMBER", offset);
+            break;
+        case OP_GREATER_NUMBER:
+            simple_instruction("OP_GREATER_NUMBER", offset);
+            break;
+        case OP_LESS_NUMBER:
+            simple_instruction("OP_LESS_NUMBER", offset);
+            break;
+        case OP_NOT_EQUAL_NUMBER:
+            simple_instruction("OP_NOT_EQUAL_NUMBER", offset);
+            break;
+        case OP_GREATER_EQUAL_NUMBER:
+            simple_instruction("OP_GREATER_EQUAL_NUMBER", offset);
+            break;
+        case OP_LESS_EQUAL_NUMBER:
+            simple_instruction("OP_LESS_EQUAL_NUMBER", offset);
+            break;
         case OP_DISPLAY:
             simple_instruction("OP_DISPLAY", offset);
             break;
         case OP_NEWLINE:
             simple_instruction("OP_NEWLINE", offset);
             break;
+        case OP_FLUSH_OUTPUT:
+            simple_instruction("OP_FLUSH_OUTPUT", offset);
+            break;
         case OP_POP:
             simple_instruction("OP_POP", offset);
             break;
@@ -101,6 +140,21 @@ int32_t disassemble_instruction(Bytecode* bc, int32_t offset) {
         case OP_CDR:
             simple_instruction("OP_CDR", offset);
             break;
+        case OP_MAKE_VECTOR:
+            jump_instruction("OP_MAKE_VECTOR", offset, instr.operand);
+            break;
+        case OP_VECTOR:
+            jump_instruction("OP_VECTOR", offset, instr.operand);
+            break;
+        case OP_VECTOR_REF:
+            simple_instruction("OP_VECTOR_REF", offset);
+            break;
+        case OP_VECTOR_SET:
+            simple_instruction("OP_VECTOR_SET", offset);
+            break;
+        case OP_VECTOR_LENGTH:
+            simple_instruction("OP_VECTOR_LENGTH", offset);
+            break;
         case OP_CLOSURE: {
             uint8_t constant = bc->instructions[offset].operand;
             printf("%-16s %4d '", "OP_CLOSURE", constant);
@@ -120,6 +174,18 @@ int32_t disassemble_instruction(Bytecode* bc, int32_t offset) {
         case OP_CALL:
             jump_instruction("OP_CALL", offset, instr.operand);
             break;
+        case OP_CALL_CLOSURE:
+            jump_instruction("OP_CALL_CLOSURE", offset, instr.operand);
+            break;
+        case OP_CALL_NATIVE:
+            jump_instruction("OP_CALL_NATIVE", offset, instr.operand);
+            break;
+        case OP_CALL_GLOBAL:
+            constant_instruction("OP_CALL_GLOBAL", bc, offset);
+            break;
+        case OP_ARG_COUNT:
+            jump_instruction("OP_ARG_COUNT", offset, instr.operand);
+            break;
         case OP_RETURN:
             simple_instruction("OP_RETURN", offset);
             break;
@@ -138,13 +204,23 @@ int32_t disassemble_instruction(Bytecode* bc, int32_t offset) {
         case OP_CLOSE_UPVALUE:
             simple_instruction("OP_CLOSE_UPVALUE", offset);
             break;
+        case OP_GET_CALLEE:
+            simple_instruction("OP_GET_CALLEE", offset);
+            break;
+        case OP_GENERATOR_RETURN:
+            simple_instruction("OP_GENERATOR_RETURN", offset);
+            break;
+        case OP_THREAD_EXIT:
+            simple_instruction("OP_THREAD_EXIT", offset);
+            break;
         default:
             printf("Unknown opcode %d\n", instr.opcode);
-            return offset + 1;
+            break;
     }
+    return offset + 1;
 }
 
-void disassemble_bytecode(Bytecode* bc, const char* name) {
+void disassemble_bytecode(const Bytecode* bc, const char* name) {
     printf("== %s ==\n", name);
     
     for (int32_t i = 0; i < bc->count; i++) {
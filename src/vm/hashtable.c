@@ -0,0 +1,297 @@
+#include "vm/hashtable.h"
+#include "vm/builtins.h"
+#include "vm/rope.h"
+#include "vm/table.h"
+#include "utils/hash.h"
+#include <string.h>
+
+#define HASH_TABLE_MIN_CAPACITY 8
+#define HASH_TABLE_MAX_LOAD 0.75
+
+
+// Final mix of MurmurHash3, spreading pointer and double bits over the
+// low bits that pick the slot
+static uint32_t mix_bits(uint64_t bits) {
+    bits ^= bits >> 33;
+    bits *= 0xff51afd7ed558ccdULL;
+    bits ^= bits >> 33;
+    return (uint32_t)bits;
+}
+
+
+uint32_t hash_value(VM* vm, Value key) {
+    switch (key.type) {
+        case VAL_NUMBER: {
+            double number = AS_NUMBER(key);
+            if (number == 0) number = 0;    // -0.0 and 0.0 are eqv
+            uint64_t bits;
+            memcpy(&bits, &number, sizeof(bits));
+            return mix_bits(bits);
+        }
+        case VAL_STRING: {
+            ObjString* string = AS_STRING(key);
+            return hash_string(string_chars(vm, string), (int)string->length);
+        }
+        case VAL_SYMBOL:
+            return AS_SYMBOL(key)->hash;
+        case VAL_BOOL:
+            return AS_BOOL(key) ? 1 : 2;
+        case VAL_NIL:
+            return 3;
+        default:
+            // Every other type is an object compared by identity; all the
+            // union members are pointers, so any of them gives the address
+            return mix_bits((uint64_t)(uintptr_t)key.as.pair);
+    }
+}
+
+
+Value make_hash_table(VM* vm) {
+    ObjHashTable* table = ARENA_NEW(&vm->heap, ObjHashTable);
+    table->count = 0;
+    table->used = 0;
+    table->capacity = 0;
+    table->entries = NULL;
+    return HASH_TABLE_VAL(table);
+}
+
+
+// Returns the live entry for key, or else the slot an insert should use:
+// the first tombstone on the probe path, or the empty slot that ended it
+static HashEntry* find_entry(VM* vm, HashEntry* entries, uint32_t capacity, Value key, uint32_t hash) {
+    uint32_t index = hash & (capacity - 1);
+    HashEntry* tombstone = NULL;
+
+    for (;;) {
+        HashEntry* entry = &entries[index];
+        if (entry->state == ENTRY_EMPTY) {
+            return tombstone ? tombstone : entry;
+        }
+        if (entry->state == ENTRY_TOMBSTONE) {
+            if (!tombstone) tombstone = entry;
+        } else if (entry->hash == hash && is_eqv(vm, entry->key, key)) {
+            return entry;
+        }
+        index = (index + 1) & (capacity - 1);
+    }
+}
+
+
+// Rehashing drops the tombstones. The old array stays in the VM heap.
+static void resize(VM* vm, ObjHashTable* table, uint32_t capacity) {
+    HashEntry* entries = arena_alloc(&vm->heap, sizeof(HashEntry) * capacity);
+    memset(entries, 0, sizeof(HashEntry) * capacity);
+
+    for (uint32_t i = 0; i < table->capacity; i++) {
+        HashEntry* entry = &table->entries[i];
+        if (entry->state != ENTRY_LIVE) continue;
+        *find_entry(vm, entries, capacity, entry->key, entry->hash) = *entry;
+    }
+
+    table->entries = entries;
+    table->capacity = capacity;
+    table->used = table->count;
+}
+
+
+bool hash_table_get(VM* vm, ObjHashTable* table, Value key, Value* value) {
+    if (table->count == 0) return false;
+
+    HashEntry* entry = find_entry(vm, table->entries, table->capacity, key, hash_value(vm, key));
+    if (entry->state != ENTRY_LIVE) return false;
+
+    *value = entry->value;
+    return true;
+}
+
+
+void hash_table_set(VM* vm, ObjHashTable* table, Value key, Value value) {
+    uint32_t hash = hash_value(vm, key);
+
+    if (table->used + 1 > table->capacity * HASH_TABLE_MAX_LOAD) {
+        // Grow only when live entries fill half the table; otherwise
+        // rehashing at the same size is enough to clear the tombstones
+        uint32_t capacity = table->capacity < HASH_TABLE_MIN_CAPACITY ? HASH_TABLE_MIN_CAPACITY : table->capacity;
+        if (table->count + 1 > capacity / 2) capacity *= 2;
+        resize(vm, table, capacity);
+    }
+
+    HashEntry* entry = find_entry(vm, table->entries, table->capacity, key, hash);
+    if (entry->state != ENTRY_LIVE) {
+        if (entry->state == ENTRY_EMPTY) table->used++;
+        table->count++;
+        entry->key = key;
+        entry->hash = hash;
+        entry->state = ENTRY_LIVE;
+    }
+    entry->value = value;
+}
+
+
+bool hash_table_delete(VM* vm, ObjHashTable* table, Value key) {
+    if (table->count == 0) return false;
+
+    HashEntry* entry = find_entry(vm, table->entries, table->capacity, key, hash_value(vm, key));
+    if (entry->state != ENTRY_LIVE) return false;
+
+    entry->state = ENTRY_TOMBSTONE;
+    entry->key = NIL_VAL;
+    entry->value = NIL_VAL;
+    table->count--;
+    return true;
+}
+
+
+// Natives
+
+static ObjHashTable* hash_table_arg(VM* vm, const char* name, Value v) {
+    if (!IS_HASH_TABLE(v)) {
+        runtime_error(vm, "%s: Type error: Expected hash table", name);
+    }
+    return AS_HASH_TABLE(v);
+}
+
+static Value native_make_hash_table(VM* vm, int32_t arg_count, Value* args) {
+    (void)arg_count; (void)args;
+    return make_hash_table(vm);
+}
+
+static Value native_is_hash_table(VM* vm, int32_t arg_count, Value* args) {
+    (void)vm; (void)arg_count;
+    return BOOL_VAL(IS_HASH_TABLE(args[0]));
+}
+
+static Value native_hash_table_set(VM* vm, int32_t arg_count, Value* args) {
+    (void)arg_count;
+    hash_table_set(vm, hash_table_arg(vm, "hash-table-set!", args[0]), args[1], args[2]);
+    return NIL_VAL;
+}
+
+// (hash-table-ref table key [thunk]) calls thunk when key is missing
+static Value native_hash_table_ref(VM* vm, int32_t arg_count, Value* args) {
+    if (arg_count < 2 || arg_count > 3) {
+        runtime_error(vm, "hash-table-ref: expected 2 or 3 arguments but got %d", arg_count);
+    }
+    Value value;
+    if (hash_table_get(vm, hash_table_arg(vm, "hash-table-ref", args[0]), args[1], &value)) {
+        return value;
+    }
+    if (arg_count == 3) {
+        return vm_call(vm, args[2], 0, NULL);
+    }
+    runtime_error(vm, "hash-table-ref: key not found");
+}
+
+static Value native_hash_table_ref_default(VM* vm, int32_t arg_count, Value* args) {
+    (void)arg_count;
+    Value value;
+    if (hash_table_get(vm, hash_table_arg(vm, "hash-table-ref/default", args[0]), args[1], &value)) {
+        return value;
+    }
+    return args[2];
+}
+
+static Value native_hash_table_contains(VM* vm, int32_t arg_count, Value* args) {
+    (void)arg_count;
+    Value value;
+    return BOOL_VAL(hash_table_get(vm, hash_table_arg(vm, "hash-table-contains?", args[0]), args[1], &value));
+}
+
+// (hash-table-update!/default table key proc default) stores
+// (proc current-value), with default standing in for a missing value
+static Value native_hash_table_update_default(VM* vm, int32_t arg_count, Value* args) {
+    (void)arg_count;
+    ObjHashTable* table = hash_table_arg(vm, "hash-table-update!/default", args[0]);
+    Value value;
+    if (!hash_table_get(vm, table, args[1], &value)) {
+        value = args[3];
+    }
+    hash_table_set(vm, table, args[1], vm_call(vm, args[2], 1, &value));
+    return NIL_VAL;
+}
+
+static Value native_hash_table_delete(VM* vm, int32_t arg_count, Value* args) {
+    (void)arg_count;
+    hash_table_delete(vm, hash_table_arg(vm, "hash-table-delete!", args[0]), args[1]);
+    return NIL_VAL;
+}
+
+static Value native_hash_table_count(VM* vm, int32_t arg_count, Value* args) {
+    (void)arg_count;
+    return NUMBER_VAL(hash_table_arg(vm, "hash-table-count", args[0])->count);
+}
+
+typedef enum {
+    COLLECT_KEYS,
+    COLLECT_VALUES,
+    COLLECT_PAIRS,
+} CollectKind;
+
+static Value collect_entries(VM* vm, ObjHashTable* table, CollectKind kind) {
+    Value list = NIL_VAL;
+    for (uint32_t i = 0; i < table->capacity; i++) {
+        HashEntry* entry = &table->entries[i];
+        if (entry->state != ENTRY_LIVE) continue;
+
+        Value item = kind == COLLECT_KEYS ? entry->key :
+                     kind == COLLECT_VALUES ? entry->value :
+                     make_pair(vm, entry->key, entry->value);
+        list = make_pair(vm, item, list);
+    }
+    return list;
+}
+
+static Value native_hash_table_keys(VM* vm, int32_t arg_count, Value* args) {
+    (void)arg_count;
+    return collect_entries(vm, hash_table_arg(vm, "hash-table-keys", args[0]), COLLECT_KEYS);
+}
+
+static Value native_hash_table_values(VM* vm, int32_t arg_count, Value* args) {
+    (void)arg_count;
+    return collect_entries(vm, hash_table_arg(vm, "hash-table-values", args[0]), COLLECT_VALUES);
+}
+
+static Value native_hash_table_to_alist(VM* vm, int32_t arg_count, Value* args) {
+    (void)arg_count;
+    return collect_entries(vm, hash_table_arg(vm, "hash-table->alist", args[0]), COLLECT_PAIRS);
+}
+
+// Calls (proc key value) for each entry. proc may change the table; the
+// entry array is re-read on every step, but entries added or moved by a
+// resize may be skipped or visited twice.
+static Value native_hash_table_walk(VM* vm, int32_t arg_count, Value* args) {
+    (void)arg_count;
+    ObjHashTable* table = hash_table_arg(vm, "hash-table-walk", args[0]);
+    for (uint32_t i = 0; i < table->capacity; i++) {
+        HashEntry* entry = &table->entries[i];
+        if (entry->state != ENTRY_LIVE) continue;
+
+        Value pair[2] = {entry->key, entry->value};
+        vm_call(vm, args[1], 2, pair);
+    }
+    return NIL_VAL;
+}
+
+
+static ObjNative HASH_TABLE_BUILTINS[] = {
+    {native_make_hash_table, "make-hash-table", 0, false},
+    {native_is_hash_table, "hash-table?", 1, false},
+    {native_hash_table_set, "hash-table-set!", 3, false},
+    {native_hash_table_ref, "hash-table-ref", -1, false},
+    {native_hash_table_ref_default, "hash-table-ref/default", 3, false},
+    {native_hash_table_contains, "hash-table-contains?", 2, false},
+    {native_hash_table_update_default, "hash-table-update!/default", 4, false},
+    {native_hash_table_delete, "hash-table-delete!", 2, false},
+    {native_hash_table_count, "hash-table-count", 1, false},
+    {native_hash_table_keys, "hash-table-keys", 1, false},
+    {native_hash_table_values, "hash-table-values", 1, false},
+    {native_hash_table_to_alist, "hash-table->alist", 1, false},
+    {native_hash_table_walk, "hash-table-walk", 2, false},
+};
+
+
+void register_hash_table_builtins(VM* vm) {
+    for (size_t i = 0; i < sizeof(HASH_TABLE_BUILTINS) / sizeof(HASH_TABLE_BUILTINS[0]); i++) {
+        table_set(&vm->globals, HASH_TABLE_BUILTINS[i].name, NATIVE_VAL(&HASH_TABLE_BUILTINS[i]));
+    }
+}
@@ -0,0 +1,403 @@
+#include "vm/builtins.h"
+#include "vm/simd.h"
+#include "vm/table.h"
+
+// Homogeneous numeric vectors. Elements are stored unboxed, so the bulk
+// operations hand the raw arrays to the kernels in simd.c instead of
+// walking Values one at a time. Element-wise operations return a fresh
+// vector; only set! and fill! mutate.
+
+
+static double number_arg(VM* vm, const char* name, Value v) {
+    if (!IS_NUMBER(v)) {
+        runtime_error(vm, "%s: Type error: Expected number", name);
+    }
+    return AS_NUMBER(v);
+}
+
+
+static uint32_t length_arg(VM* vm, const char* name, Value v) {
+    double length = number_arg(vm, name, v);
+    if (length < 0 || length > UINT32_MAX || length != (double)(uint32_t)length) {
+        runtime_error(vm, "%s: invalid length %g", name, length);
+    }
+    return (uint32_t)length;
+}
+
+
+static uint8_t byte_arg(VM* vm, const char* name, Value v) {
+    double byte = number_arg(vm, name, v);
+    if (byte < 0 || byte > 255 || byte != (double)(uint8_t)byte) {
+        runtime_error(vm, "%s: %g is not a byte (an integer in [0, 255])", name, byte);
+    }
+    return (uint8_t)byte;
+}
+
+
+static ObjF64Vector* f64vector_arg(VM* vm, const char* name, Value v) {
+    if (!IS_F64VECTOR(v)) {
+        runtime_error(vm, "%s: Type error: Expected f64vector", name);
+    }
+    return AS_F64VECTOR(v);
+}
+
+
+static ObjU8Vector* u8vector_arg(VM* vm, const char* name, Value v) {
+    if (!IS_U8VECTOR(v)) {
+        runtime_error(vm, "%s: Type error: Expected u8vector", name);
+    }
+    return AS_U8VECTOR(v);
+}
+
+
+static void require_same_length(VM* vm, const char* name, uint32_t a, uint32_t b) {
+    if (a != b) {
+        runtime_error(vm, "%s: vectors differ in length (%u and %u)", name, a, b);
+    }
+}
+
+
+static void require_nonempty(VM* vm, const char* name, uint32_t count) {
+    if (count == 0) {
+        runtime_error(vm, "%s: vector is empty", name);
+    }
+}
+
+
+static void check_fill_args(VM* vm, const char* name, int32_t arg_count) {
+    if (arg_count < 1 || arg_count > 2) {
+        runtime_error(vm, "%s: expected 1 or 2 arguments but got %d", name, arg_count);
+    }
+}
+
+
+// f64vector
+
+static Value native_make_f64vector(VM* vm, int32_t arg_count, Value* args) {
+    check_fill_args(vm, "make-f64vector", arg_count);
+    uint32_t count = length_arg(vm, "make-f64vector", args[0]);
+    double fill = arg_count == 2 ? number_arg(vm, "make-f64vector", args[1]) : 0;
+
+    Value vector = make_f64vector(vm, count);
+    f64_fill(AS_F64VECTOR(vector)->items, fill, count);
+    return vector;
+}
+
+static Value native_f64vector(VM* vm, int32_t arg_count, Value* args) {
+    Value vector = make_f64vector(vm, (uint32_t)arg_count);
+    for (int32_t i = 0; i < arg_count; i++) {
+        AS_F64VECTOR(vector)->items[i] = number_arg(vm, "f64vector", args[i]);
+    }
+    return vector;
+}
+
+static Value native_f64vector_ref(VM* vm, int32_t arg_count, Value* args) {
+    (void)arg_count;
+    ObjF64Vector* vector = f64vector_arg(vm, "f64vector-ref", args[0]);
+    return NUMBER_VAL(vector->items[vector_index(vm, vector->count, args[1])]);
+}
+
+static Value native_f64vector_set(VM* vm, int32_t arg_count, Value* args) {
+    (void)arg_count;
+    ObjF64Vector* vector = f64vector_arg(vm, "f64vector-set!", args[0]);
+    uint32_t index = vector_index(vm, vector->count, args[1]);
+    vector->items[index] = number_arg(vm, "f64vector-set!", args[2]);
+    return NIL_VAL;
+}
+
+static Value native_f64vector_length(VM* vm, int32_t arg_count, Value* args) {
+    (void)arg_count;
+    return NUMBER_VAL(f64vector_arg(vm, "f64vector-length", args[0])->count);
+}
+
+static Value native_is_f64vector(VM* vm, int32_t arg_count, Value* args) {
+    (void)vm; (void)arg_count;
+    return BOOL_VAL(IS_F64VECTOR(args[0]));
+}
+
+static Value native_f64vector_sum(VM* vm, int32_t arg_count, Value* args) {
+    (void)arg_count;
+    ObjF64Vector* vector = f64vector_arg(vm, "f64vector-sum", args[0]);
+    return NUMBER_VAL(f64_sum(vector->items, vector->count));
+}
+
+static Value native_f64vector_dot(VM* vm, int32_t arg_count, Value* args) {
+    (void)arg_count;
+    ObjF64Vector* a = f64vector_arg(vm, "f64vector-dot", args[0]);
+    ObjF64Vector* b = f64vector_arg(vm, "f64vector-dot", args[1]);
+    require_same_length(vm, "f64vector-dot", a->count, b->count);
+    return NUMBER_VAL(f64_dot(a->items, b->items, a->count));
+}
+
+static Value native_f64vector_add(VM* vm, int32_t arg_count, Value* args) {
+    (void)arg_count;
+    ObjF64Vector* a = f64vector_arg(vm, "f64vector-add", args[0]);
+    ObjF64Vector* b = f64vector_arg(vm, "f64vector-add", args[1]);
+    require_same_length(vm, "f64vector-add", a->count, b->count);
+
+    Value result = make_f64vector(vm, a->count);
+    f64_add(AS_F64VECTOR(result)->items, a->items, b->items, a->count);
+    return result;
+}
+
+static Value native_f64vector_mul(VM* vm, int32_t arg_count, Value* args) {
+    (void)arg_count;
+    ObjF64Vector* a = f64vector_arg(vm, "f64vector-mul", args[0]);
+    ObjF64Vector* b = f64vector_arg(vm, "f64vector-mul", args[1]);
+    require_same_length(vm, "f64vector-mul", a->count, b->count);
+
+    Value result = make_f64vector(vm, a->count);
+    f64_mul(AS_F64VECTOR(result)->items, a->items, b->items, a->count);
+    return result;
+}
+
+static Value native_f64vector_scale(VM* vm, int32_t arg_count, Value* args) {
+    (void)arg_count;
+    ObjF64Vector* vector = f64vector_arg(vm, "f64vector-scale", args[0]);
+    double k = number_arg(vm, "f64vector-scale", args[1]);
+
+    Value result = make_f64vector(vm, vector->count);
+    f64_scale(AS_F64VECTOR(result)->items, vector->items, k, vector->count);
+    return result;
+}
+
+static Value native_f64vector_min(VM* vm, int32_t arg_count, Value* args) {
+    (void)arg_count;
+    ObjF64Vector* vector = f64vector_arg(vm, "f64vector-min", args[0]);
+    require_nonempty(vm, "f64vector-min", vector->count);
+    return NUMBER_VAL(f64_min(vector->items, vector->count));
+}
+
+static Value native_f64vector_max(VM* vm, int32_t arg_count, Value* args) {
+    (void)arg_count;
+    ObjF64Vector* vector = f64vector_arg(vm, "f64vector-max", args[0]);
+    require_nonempty(vm, "f64vector-max", vector->count);
+    return NUMBER_VAL(f64_max(vector->items, vector->count));
+}
+
+static Value native_f64vector_fill(VM* vm, int32_t arg_count, Value* args) {
+    (void)arg_count;
+    ObjF64Vector* vector = f64vector_arg(vm, "f64vector-fill!", args[0]);
+    f64_fill(vector->items, number_arg(vm, "f64vector-fill!", args[1]), vector->count);
+    return NIL_VAL;
+}
+
+static Value native_f64vector_copy(VM* vm, int32_t arg_count, Value* args) {
+    (void)arg_count;
+    ObjF64Vector* vector = f64vector_arg(vm, "f64vector-copy", args[0]);
+    Value copy = make_f64vector(vm, vector->count);
+    f64_copy(AS_F64VECTOR(copy)->items, vector->items, vector->count);
+    return copy;
+}
+
+static Value native_f64vector_to_list(VM* vm, int32_t arg_count, Value* args) {
+    (void)arg_count;
+    ObjF64Vector* vector = f64vector_arg(vm, "f64vector->list", args[0]);
+    Value list = NIL_VAL;
+    for (uint32_t i = vector->count; i > 0; i--) {
+        list = make_pair(vm, NUMBER_VAL(vector->items[i - 1]), list);
+    }
+    return list;
+}
+
+static Value native_list_to_f64vector(VM* vm, int32_t arg_count, Value* args) {
+    (void)arg_count;
+    uint32_t count = 0;
+    for (Value v = args[0]; IS_PAIR(v); v = AS_PAIR(v)->cdr) count++;
+
+    Value vector = make_f64vector(vm, count);
+    Value v = args[0];
+    for (uint32_t i = 0; i < count; i++, v = AS_PAIR(v)->cdr) {
+        AS_F64VECTOR(vector)->items[i] = number_arg(vm, "list->f64vector", AS_PAIR(v)->car);
+    }
+    return vector;
+}
+
+
+// u8vector
+
+static Value native_make_u8vector(VM* vm, int32_t arg_count, Value* args) {
+    check_fill_args(vm, "make-u8vector", arg_count);
+    uint32_t count = length_arg(vm, "make-u8vector", args[0]);
+    uint8_t fill = arg_count == 2 ? byte_arg(vm, "make-u8vector", args[1]) : 0;
+
+    Value vector = make_u8vector(vm, count);
+    u8_fill(AS_U8VECTOR(vector)->items, fill, count);
+    return vector;
+}
+
+static Value native_u8vector(VM* vm, int32_t arg_count, Value* args) {
+    Value vector = make_u8vector(vm, (uint32_t)arg_count);
+    for (int32_t i = 0; i < arg_count; i++) {
+        AS_U8VECTOR(vector)->items[i] = byte_arg(vm, "u8vector", args[i]);
+    }
+    return vector;
+}
+
+static Value native_u8vector_ref(VM* vm, int32_t arg_count, Value* args) {
+    (void)arg_count;
+    ObjU8Vector* vector = u8vector_arg(vm, "u8vector-ref", args[0]);
+    return NUMBER_VAL(vector->items[vector_index(vm, vector->count, args[1])]);
+}
+
+static Value native_u8vector_set(VM* vm, int32_t arg_count, Value* args) {
+    (void)arg_count;
+    ObjU8Vector* vector = u8vector_arg(vm, "u8vector-set!", args[0]);
+    uint32_t index = vector_index(vm, vector->count, args[1]);
+    vector->items[index] = byte_arg(vm, "u8vector-set!", args[2]);
+    return NIL_VAL;
+}
+
+static Value native_u8vector_length(VM* vm, int32_t arg_count, Value* args) {
+    (void)arg_count;
+    return NUMBER_VAL(u8vector_arg(vm, "u8vector-length", args[0])->count);
+}
+
+static Value native_is_u8vector(VM* vm, int32_t arg_count, Value* args) {
+    (void)vm; (void)arg_count;
+    return BOOL_VAL(IS_U8VECTOR(args[0]));
+}
+
+static Value native_u8vector_sum(VM* vm, int32_t arg_count, Value* args) {
+    (void)arg_count;
+    ObjU8Vector* vector = u8vector_arg(vm, "u8vector-sum", args[0]);
+    return NUMBER_VAL((double)u8_sum(vector->items, vector->count));
+}
+
+static Value native_u8vector_dot(VM* vm, int32_t arg_count, Value* args) {
+    (void)arg_count;
+    ObjU8Vector* a = u8vector_arg(vm, "u8vector-dot", args[0]);
+    ObjU8Vector* b = u8vector_arg(vm, "u8vector-dot", args[1]);
+    require_same_length(vm, "u8vector-dot", a->count, b->count);
+    return NUMBER_VAL((double)u8_dot(a->items, b->items, a->count));
+}
+
+static Value native_u8vector_add(VM* vm, int32_t arg_count, Value* args) {
+    (void)arg_count;
+    ObjU8Vector* a = u8vector_arg(vm, "u8vector-add", args[0]);
+    ObjU8Vector* b = u8vector_arg(vm, "u8vector-add", args[1]);
+    require_same_length(vm, "u8vector-add", a->count, b->count);
+
+    Value result = make_u8vector(vm, a->count);
+    u8_add(AS_U8VECTOR(result)->items, a->items, b->items, a->count);
+    return result;
+}
+
+static Value native_u8vector_mul(VM* vm, int32_t arg_count, Value* args) {
+    (void)arg_count;
+    ObjU8Vector* a = u8vector_arg(vm, "u8vector-mul", args[0]);
+    ObjU8Vector* b = u8vector_arg(vm, "u8vector-mul", args[1]);
+    require_same_length(vm, "u8vector-mul", a->count, b->count);
+
+    Value result = make_u8vector(vm, a->count);
+    u8_mul(AS_U8VECTOR(result)->items, a->items, b->items, a->count);
+    return result;
+}
+
+static Value native_u8vector_scale(VM* vm, int32_t arg_count, Value* args) {
+    (void)arg_count;
+    ObjU8Vector* vector = u8vector_arg(vm, "u8vector-scale", args[0]);
+    uint8_t k = byte_arg(vm, "u8vector-scale", args[1]);
+
+    Value result = make_u8vector(vm, vector->count);
+    u8_scale(AS_U8VECTOR(result)->items, vector->items, k, vector->count);
+    return result;
+}
+
+static Value native_u8vector_min(VM* vm, int32_t arg_count, Value* args) {
+    (void)arg_count;
+    ObjU8Vector* vector = u8vector_arg(vm, "u8vector-min", args[0]);
+    require_nonempty(vm, "u8vector-min", vector->count);
+    return NUMBER_VAL(u8_min(vector->items, vector->count));
+}
+
+static Value native_u8vector_max(VM* vm, int32_t arg_count, Value* args) {
+    (void)arg_count;
+    ObjU8Vector* vector = u8vector_arg(vm, "u8vector-max", args[0]);
+    require_nonempty(vm, "u8vector-max", vector->count);
+    return NUMBER_VAL(u8_max(vector->items, vector->count));
+}
+
+static Value native_u8vector_fill(VM* vm, int32_t arg_count, Value* args) {
+    (void)arg_count;
+    ObjU8Vector* vector = u8vector_arg(vm, "u8vector-fill!", args[0]);
+    u8_fill(vector->items, byte_arg(vm, "u8vector-fill!", args[1]), vector->count);
+    return NIL_VAL;
+}
+
+static Value native_u8vector_copy(VM* vm, int32_t arg_count, Value* args) {
+    (void)arg_count;
+    ObjU8Vector* vector = u8vector_arg(vm, "u8vector-copy", args[0]);
+    Value copy = make_u8vector(vm, vector->count);
+    u8_copy(AS_U8VECTOR(copy)->items, vector->items, vector->count);
+    return copy;
+}
+
+static Value native_u8vector_to_list(VM* vm, int32_t arg_count, Value* args) {
+    (void)arg_count;
+    ObjU8Vector* vector = u8vector_arg(vm, "u8vector->list", args[0]);
+    Value list = NIL_VAL;
+    for (uint32_t i = vector->count; i > 0; i--) {
+        list = make_pair(vm, NUMBER_VAL(vector->items[i - 1]), list);
+    }
+    return list;
+}
+
+static Value native_list_to_u8vector(VM* vm, int32_t arg_count, Value* args) {
+    (void)arg_count;
+    uint32_t count = 0;
+    for (Value v = args[0]; IS_PAIR(v); v = AS_PAIR(v)->cdr) count++;
+
+    Value vector = make_u8vector(vm, count);
+    Value v = args[0];
+    for (uint32_t i = 0; i < count; i++, v = AS_PAIR(v)->cdr) {
+        AS_U8VECTOR(vector)->items[i] = byte_arg(vm, "list->u8vector", AS_PAIR(v)->car);
+    }
+    return vector;
+}
+
+
+static ObjNative NUMVEC_BUILTINS[] = {
+    {native_make_f64vector, "make-f64vector", -1, false},
+    {native_f64vector, "f64vector", -1, false},
+    {native_f64vector_ref, "f64vector-ref", 2, false},
+    {native_f64vector_set, "f64vector-set!", 3, false},
+    {native_f64vector_length, "f64vector-length", 1, false},
+    {native_is_f64vector, "f64vector?", 1, false},
+    {native_f64vector_sum, "f64vector-sum", 1, false},
+    {native_f64vector_dot, "f64vector-dot", 2, false},
+    {native_f64vector_add, "f64vector-add", 2, false},
+    {native_f64vector_mul, "f64vector-mul", 2, false},
+    {native_f64vector_scale, "f64vector-scale", 2, false},
+    {native_f64vector_min, "f64vector-min", 1, false},
+    {native_f64vector_max, "f64vector-max", 1, false},
+    {native_f64vector_fill, "f64vector-fill!", 2, false},
+    {native_f64vector_copy, "f64vector-copy", 1, false},
+    {native_f64vector_to_list, "f64vector->list", 1, false},
+    {native_list_to_f64vector, "list->f64vector", 1, false},
+
+    {native_make_u8vector, "make-u8vector", -1, false},
+    {native_u8vector, "u8vector", -1, false},
+    {native_u8vector_ref, "u8vector-ref", 2, false},
+    {native_u8vector_set, "u8vector-set!", 3, false},
+    {native_u8vector_length, "u8vector-length", 1, false},
+    {native_is_u8vector, "u8vector?", 1, false},
+    {native_u8vector_sum, "u8vector-sum", 1, false},
+    {native_u8vector_dot, "u8vector-dot", 2, false},
+    {native_u8vector_add, "u8vector-add", 2, false},
+    {native_u8vector_mul, "u8vector-mul", 2, false},
+    {native_u8vector_scale, "u8vector-scale", 2, false},
+    {native_u8vector_min, "u8vector-min", 1, false},
+    {native_u8vector_max, "u8vector-max", 1, false},
+    {native_u8vector_fill, "u8vector-fill!", 2, false},
+    {native_u8vector_copy, "u8vector-copy", 1, false},
+    {native_u8vector_to_list, "u8vector->list", 1, false},
+    {native_list_to_u8vector, "list->u8vector", 1, false},
+};
+
+
+void register_numvec_builtins(VM* vm) {
+    for (size_t i = 0; i < sizeof(NUMVEC_BUILTINS) / sizeof(NUMVEC_BUILTINS[0]); i++) {
+        table_set(&vm->globals, NUMVEC_BUILTINS[i].name, NATIVE_VAL(&NUMVEC_BUILTINS[i]));
+    }
+}
@@ -0,0 +1,208 @@
+#include "vm/output.h"
+#include "utils/memory.h"
+#include <math.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+// 2^53: every integer below this is exactly representable as a double
+#define MAX_EXACT_INTEGER 9007199254740992.0
+#define MAX_FRACTION_DIGITS 17
+
+static const char DIGIT_PAIRS[] =
+    "00010203040506070809"
+    "10111213141516171819"
+    "20212223242526272829"
+    "30313233343536373839"
+    "40414243444546474849"
+    "50515253545556575859"
+    "60616263646566676869"
+    "70717273747576777879"
+    "80818283848586878889"
+    "90919293949596979899";
+
+static const double POWERS_OF_TEN[] = {
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8,
+    1e9, 1e10, 1e11, 1e12, 1e13, 1e14, 1e15, 1e16, 1e17
+};
+
+static const uint64_t INT_POWERS_OF_TEN[] = {
+    1ull, 10ull, 100ull, 1000ull, 10000ull, 100000ull, 1000000ull,
+    10000000ull, 100000000ull, 1000000000ull, 10000000000ull,
+    100000000000ull, 1000000000000ull, 10000000000000ull,
+    100000000000000ull, 1000000000000000ull, 10000000000000000ull,
+    100000000000000000ull
+};
+
+
+void init_output(OutputBuffer* out, FILE* sink) {
+    out->data = (char*)reallocate(NULL, 0, OUTPUT_BUFFER_SIZE);
+    out->count = 0;
+    out->capacity = OUTPUT_BUFFER_SIZE;
+    out->sink = sink;
+}
+
+
+// Hand buffered bytes to the sink without forcing the stdio layer to flush
+static void drain_output(OutputBuffer* out) {
+    if (out->count == 0) return;
+    fwrite(out->data, 1, out->count, out->sink);
+    out->count = 0;
+}
+
+
+void flush_output(OutputBuffer* out) {
+    if (!out->sink) return;
+    drain_output(out);
+    fflush(out->sink);
+}
+
+
+void free_output(OutputBuffer* out) {
+    flush_output(out);
+    reallocate(out->data, out->capacity, 0);
+    out->data = NULL;
+    out->count = 0;
+    out->capacity = 0;
+}
+
+
+void output_char(OutputBuffer* out, char c) {
+    if (out->count == out->capacity) {
+        drain_output(out);
+    }
+    out->data[out->count++] = c;
+}
+
+
+void output_string(OutputBuffer* out, const char* chars, size_t length) {
+    if (length > out->capacity - out->count) {
+        drain_output(out);
+
+        // Too big to ever fit, skip the copy
+        if (length >= out->capacity) {
+            fwrite(chars, 1, length, out->sink);
+            return;
+        }
+    }
+    memcpy(out->data + out->count, chars, length);
+    out->count += length;
+}
+
+
+void output_cstring(OutputBuffer* out, const char* chars) {
+    output_string(out, chars, strlen(chars));
+}
+
+
+void output_integer(OutputBuffer* out, int64_t value) {
+    char digits[NUMBER_BUFFER_SIZE];
+    int length = format_integer(digits, value);
+    output_string(out, digits, length);
+}
+
+
+void output_number(OutputBuffer* out, double value) {
+    char digits[NUMBER_BUFFER_SIZE];
+    int length = format_number(digits, value);
+    output_string(out, digits, length);
+}
+
+
+// Writes the decimal digits of n right-aligned, ending just before end
+static char* write_digits(char* end, uint64_t n) {
+    char* p = end;
+    while (n >= 100) {
+        p -= 2;
+        memcpy(p, &DIGIT_PAIRS[(n % 100) * 2], 2);
+        n /= 100;
+    }
+    if (n >= 10) {
+        p -= 2;
+        memcpy(p, &DIGIT_PAIRS[n * 2], 2);
+    } else {
+        *--p = (char)('0' + n);
+    }
+    return p;
+}
+
+
+int format_integer(char* dst, int64_t value) {
+    char digits[NUMBER_BUFFER_SIZE];
+    char* end = digits + sizeof(digits);
+    uint64_t magnitude = value < 0 ? -(uint64_t)value : (uint64_t)value;
+
+    char* start = write_digits(end, magnitude);
+    if (value < 0) *--start = '-';
+
+    int length = (int)(end - start);
+    memcpy(dst, start, length);
+    dst[length] = '\0';
+    return length;
+}
+
+
+// Renders scaled / 10^fraction_digits in fixed notation
+static int format_fixed(char* dst, bool negative, uint64_t scaled, int fraction_digits) {
+    uint64_t divisor = INT_POWERS_OF_TEN[fraction_digits];
+    uint64_t integer_part = scaled / divisor;
+    uint64_t fraction_part = scaled % divisor;
+
+    char* p = dst;
+    if (negative) *p++ = '-';
+    p += format_integer(p, (int64_t)integer_part);
+    *p++ = '.';
+
+    // Fraction digits keep their leading zeros
+    char* fraction_end = p + fraction_digits;
+    char* fraction_start = write_digits(fraction_end, fraction_part);
+    while (fraction_start > p) {
+        *--fraction_start = '0';
+    }
+    *fraction_end = '\0';
+    return (int)(fraction_end - dst);
+}
+
+
+static int copy_literal(char* dst, const char* literal) {
+    int length = (int)strlen(literal);
+    memcpy(dst, literal, length + 1);
+    return length;
+}
+
+
+// Shortest representation that reads back as exactly the same double
+int format_number(char* dst, double value) {
+    if (isnan(value)) return copy_literal(dst, "nan");
+    if (isinf(value)) return copy_literal(dst, value < 0 ? "-inf" : "inf");
+    if (value == 0) return copy_literal(dst, signbit(value) ? "-0" : "0");
+
+    double magnitude = fabs(value);
+
+    if (magnitude < MAX_EXACT_INTEGER && value == (double)(int64_t)value) {
+        return format_integer(dst, (int64_t)value);
+    }
+
+    // Fast path: find the fewest fraction digits d such that the decimal
+    // round(|v| * 10^d) / 10^d converts back to |v|. Both operands of the
+    // division are exact doubles, so the check matches what strtod reads.
+    if (magnitude >= 1e-4 && magnitude < 1e15) {
+        for (int digits = 1; digits <= MAX_FRACTION_DIGITS; digits++) {
+            double scaled = magnitude * POWERS_OF_TEN[digits];
+            if (scaled >= MAX_EXACT_INTEGER) break;
+
+            uint64_t candidate = (uint64_t)(scaled + 0.5);
+            if ((double)candidate / POWERS_OF_TEN[digits] == magnitude) {
+                return format_fixed(dst, value < 0, candidate, digits);
+            }
+        }
+    }
+
+    // Slow path for extreme exponents and long mantissas
+    int length = 0;
+    for (int precision = 15; precision <= 17; precision++) {
+        length = snprintf(dst, NUMBER_BUFFER_SIZE, "%.*g", precision, value);
+        if (strtod(dst, NULL) == value) break;
+    }
+    return length;
+}
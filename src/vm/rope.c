@@ -0,0 +1,151 @@
+#include "vm/rope.h"
+#include "utils/memory.h"
+#include <string.h>
+
+#define STRING_PORT_INITIAL_CAPACITY 64
+
+
+ObjString* allocate_string(const char* chars, size_t length) {
+    ObjString* string = (ObjString*)reallocate(NULL, 0, sizeof(ObjString) + length + 1);
+    string->length = (uint32_t)length;
+    string->depth = 0;
+    string->chars = (char*)(string + 1);
+    string->left = NULL;
+    string->right = NULL;
+    memcpy(string->chars, chars, length);
+    string->chars[length] = '\0';
+    return string;
+}
+
+
+void copy_string_chars(char* dst, const ObjString* string) {
+    if (string->chars) {
+        memcpy(dst, string->chars, string->length);
+        return;
+    }
+    copy_string_chars(dst, string->left);
+    copy_string_chars(dst + string->left->length, string->right);
+}
+
+
+static ObjString* concat_flat(VM* vm, const ObjString* a, const ObjString* b) {
+    uint32_t length = a->length + b->length;
+    ObjString* string = arena_alloc(&vm->heap, sizeof(ObjString) + length + 1);
+    string->length = length;
+    string->depth = 0;
+    string->chars = (char*)(string + 1);
+    string->left = NULL;
+    string->right = NULL;
+
+    copy_string_chars(string->chars, a);
+    copy_string_chars(string->chars + a->length, b);
+    string->chars[length] = '\0';
+    return string;
+}
+
+
+static ObjString* make_rope(VM* vm, ObjString* left, ObjString* right) {
+    ObjString* rope = ARENA_NEW(&vm->heap, ObjString);
+    rope->length = left->length + right->length;
+    rope->depth = 1 + (left->depth > right->depth ? left->depth : right->depth);
+    rope->chars = NULL;
+    rope->left = left;
+    rope->right = right;
+    return rope;
+}
+
+
+Value string_append(VM* vm, ObjString* a, ObjString* b) {
+    if (a->length == 0) return STRING_VAL(b);
+    if (b->length == 0) return STRING_VAL(a);
+
+    uint64_t length = (uint64_t)a->length + b->length;
+    if (length > UINT32_MAX) {
+        runtime_error(vm, "string-append: result is too long");
+    }
+
+    if (length < ROPE_MIN_LENGTH) {
+        return STRING_VAL(concat_flat(vm, a, b));
+    }
+
+    // A short piece appended to a rope joins its last leaf instead of
+    // adding a level, so building up text a few characters at a time
+    // still yields leaves of useful size
+    if (!a->chars && a->right->chars && a->right->length + b->length < ROPE_MIN_LENGTH) {
+        return STRING_VAL(make_rope(vm, a->left, concat_flat(vm, a->right, b)));
+    }
+
+    ObjString* rope = make_rope(vm, a, b);
+    if (rope->depth > ROPE_MAX_DEPTH) {
+        string_chars(vm, rope);
+    }
+    return STRING_VAL(rope);
+}
+
+
+const char* string_chars(VM* vm, ObjString* string) {
+    if (!string->chars) {
+        char* chars = arena_alloc(&vm->heap, string->length + 1);
+        copy_string_chars(chars, string);
+        chars[string->length] = '\0';
+
+        // The halves may still be shared by other ropes; this one no
+        // longer needs them
+        string->chars = chars;
+        string->depth = 0;
+        string->left = NULL;
+        string->right = NULL;
+    }
+    return string->chars;
+}
+
+
+bool string_equal(VM* vm, ObjString* a, ObjString* b) {
+    if (a == b) return true;
+    if (a->length != b->length) return false;
+    return memcmp(string_chars(vm, a), string_chars(vm, b), a->length) == 0;
+}
+
+
+Value make_string_port(VM* vm) {
+    ObjStringPort* port = ARENA_NEW(&vm->heap, ObjStringPort);
+    port->length = 0;
+    port->capacity = STRING_PORT_INITIAL_CAPACITY;
+    port->chars = arena_alloc(&vm->heap, port->capacity);
+    return STRING_PORT_VAL(port);
+}
+
+
+// Makes room for length more characters. The old buffer stays in the heap
+// until the VM is freed; doubling keeps that waste below the final size.
+static char* reserve(VM* vm, ObjStringPort* port, size_t length) {
+    uint64_t needed = (uint64_t)port->length + length;
+    if (needed > UINT32_MAX) {
+        runtime_error(vm, "String port is too large");
+    }
+
+    if (needed > port->capacity) {
+        uint64_t capacity = port->capacity;
+        while (capacity < needed) capacity *= 2;
+        if (capacity > UINT32_MAX) capacity = UINT32_MAX;
+
+        char* chars = arena_alloc(&vm->heap, capacity);
+        memcpy(chars, port->chars, port->length);
+        port->chars = chars;
+        port->capacity = (uint32_t)capacity;
+    }
+
+    char* end = port->chars + port->length;
+    port->length = (uint32_t)needed;
+    return end;
+}
+
+
+void string_port_append(VM* vm, ObjStringPort* port, const char* chars, size_t length) {
+    memcpy(reserve(vm, port, length), chars, length);
+}
+
+
+void string_port_append_string(VM* vm, ObjStringPort* port, const ObjString* string) {
+    copy_string_chars(reserve(vm, port, string->length), string);
+}
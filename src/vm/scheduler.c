@@ -0,0 +1,440 @@
+#include "vm/scheduler.h"
+#include "vm/builtins.h"
+#include <poll.h>
+#include <stdio.h>
+#include <string.h>
+
+
+// A spawned thread's procedure is called with this as its return address,
+// so the scheduler learns that the thread is done. Never quickened, so every
+// VM can share it.
+static Instruction THREAD_EXIT_CODE[] = {{OP_THREAD_EXIT, 0}};
+static Bytecode THREAD_EXIT = {THREAD_EXIT_CODE, 1, 1, NULL, 0, 0};
+
+
+void init_threads(VM* vm) {
+    ObjThread* main = &vm->main_thread;
+    memset(main, 0, sizeof(ObjThread));
+    main->state = THREAD_RUNNING;
+    main->started = true;
+    main->storage = &vm->main_stack;
+    main->procedure = NIL_VAL;
+    main->result = NIL_VAL;
+    main->transfer = NIL_VAL;
+
+    vm->thread = main;
+    vm->stack = vm->main_stack.values;
+    vm->frames = vm->main_stack.frames;
+    vm->run_queue.head = NULL;
+    vm->run_queue.tail = NULL;
+    vm->free_stacks = NULL;
+    vm->thread_budget = THREAD_BUDGET;
+}
+
+
+// Queues
+
+static void enqueue(ThreadQueue* queue, ObjThread* thread) {
+    thread->next = NULL;
+    if (queue->tail != NULL) {
+        queue->tail->next = thread;
+    } else {
+        queue->head = thread;
+    }
+    queue->tail = thread;
+}
+
+
+static ObjThread* dequeue(ThreadQueue* queue) {
+    ObjThread* thread = queue->head;
+    if (thread != NULL) {
+        queue->head = thread->next;
+        if (queue->head == NULL) {
+            queue->tail = NULL;
+        }
+        thread->next = NULL;
+    }
+    return thread;
+}
+
+
+static void remove_thread(ThreadQueue* queue, ObjThread* thread) {
+    ObjThread* previous = NULL;
+    for (ObjThread* t = queue->head; t != NULL; previous = t, t = t->next) {
+        if (t != thread) continue;
+
+        if (previous != NULL) {
+            previous->next = t->next;
+        } else {
+            queue->head = t->next;
+        }
+        if (queue->tail == t) {
+            queue->tail = previous;
+        }
+        t->next = NULL;
+        return;
+    }
+}
+
+
+// Switching
+
+// The level threads switch in, if the running code is directly in it
+static RunLevel* switch_level(VM* vm) {
+    RunLevel* level = vm->run_level;
+    if (level == NULL || level->exit_depth >= 0 || vm->native_calls != level->native_calls) {
+        return NULL;
+    }
+    return level;
+}
+
+
+bool threads_waiting(VM* vm) {
+    return vm->run_queue.head != NULL && switch_level(vm) != NULL;
+}
+
+
+static void save_thread(VM* vm) {
+    ObjThread* thread = vm->thread;
+    thread->stack_top = vm->stack_top;
+    thread->frame_count = vm->frame_count;
+    thread->code = vm->code;
+    thread->ip = vm->ip;
+    thread->open_upvalues = vm->open_upvalues;
+    thread->frame_base = vm->run_level->frame_base;
+    thread->stack_base = vm->run_level->stack_base;
+}
+
+
+static void load_thread(VM* vm, ObjThread* thread) {
+    thread->state = THREAD_RUNNING;
+    vm->thread = thread;
+    vm->stack = thread->storage->values;
+    vm->frames = thread->storage->frames;
+    vm->stack_top = thread->stack_top;
+    vm->frame_count = thread->frame_count;
+    vm->code = thread->code;
+    vm->ip = thread->ip;
+    vm->open_upvalues = thread->open_upvalues;
+}
+
+
+// The outermost level starts at a different place in each thread's stack
+static void switch_to(VM* vm, ObjThread* thread) {
+    load_thread(vm, thread);
+    vm->run_level->frame_base = thread->frame_base;
+    vm->run_level->stack_base = thread->stack_base;
+}
+
+
+// Switches to the front of the run queue. The running thread has already
+// been queued, blocked or ended.
+static void run_next(VM* vm) {
+    ObjThread* next = dequeue(&vm->run_queue);
+    if (next == NULL) {
+        // Nothing runs, so the main thread is blocked as well. Report it
+        // from there, where vm_execute was called.
+        next = &vm->main_thread;
+        remove_thread(next->waiting_in, next);
+        next->waiting_in = NULL;
+        switch_to(vm, next);
+        runtime_error(vm, "deadlock: every thread is waiting");
+    }
+
+    switch_to(vm, next);
+    if (!next->started) {
+        next->started = true;
+        call_value(vm, next->procedure, 0);
+    }
+}
+
+
+void yield_thread(VM* vm) {
+    save_thread(vm);
+    vm->thread->state = THREAD_RUNNABLE;
+    enqueue(&vm->run_queue, vm->thread);
+    run_next(vm);
+}
+
+
+// Puts the running thread in queue until another thread wakes it. The
+// call that blocked has already returned; its result slot is filled in by
+// wake.
+static void block(VM* vm, ThreadQueue* queue) {
+    save_thread(vm);
+    vm->thread->state = THREAD_BLOCKED;
+    vm->thread->waiting_in = queue;
+    enqueue(queue, vm->thread);
+    run_next(vm);
+}
+
+
+static void wake(VM* vm, ObjThread* thread, Value result) {
+    thread->storage->values[thread->stack_top - 1] = result;
+    thread->waiting_in = NULL;
+    thread->state = THREAD_RUNNABLE;
+    enqueue(&vm->run_queue, thread);
+}
+
+
+// Ends the running thread, and lets the threads joining it go on
+static void end_thread(VM* vm, Value result) {
+    ObjThread* thread = vm->thread;
+    close_upvalues(vm, vm->stack);
+    thread->state = THREAD_DONE;
+    thread->result = result;
+
+    ObjThread* joiner;
+    while ((joiner = dequeue(&thread->joiners)) != NULL) {
+        wake(vm, joiner, result);
+    }
+
+    if (thread != &vm->main_thread) {
+        thread->storage->next_free = vm->free_stacks;
+        vm->free_stacks = thread->storage;
+        thread->storage = NULL;
+    }
+}
+
+
+void finish_thread(VM* vm) {
+    end_thread(vm, pop(vm));
+    run_next(vm);
+}
+
+
+void recover_thread(VM* vm, ObjThread* thread) {
+    if (vm->thread == thread) return;
+
+    end_thread(vm, NIL_VAL);
+    if (thread->state == THREAD_RUNNABLE) {
+        remove_thread(&vm->run_queue, thread);
+    } else if (thread->state == THREAD_BLOCKED) {
+        remove_thread(thread->waiting_in, thread);
+        thread->waiting_in = NULL;
+    }
+    load_thread(vm, thread);
+}
+
+
+bool input_ready(VM* vm) {
+    // Streams without a descriptor never wait. Data stdio has already
+    // buffered is not seen here; the read happens once no thread can run.
+    struct pollfd input = {fileno(vm->in), POLLIN, 0};
+    if (input.fd < 0) return true;
+
+    // An error counts as ready, so the read reports it
+    return poll(&input, 1, 0) != 0;
+}
+
+
+// Natives
+
+// Blocking natives finish their call themselves: the result replaces the
+// callee, as a return would leave it
+static void finish_call(VM* vm, int32_t arg_count, Value result) {
+    vm->stack_top -= arg_count;
+    vm->stack[vm->stack_top - 1] = result;
+}
+
+
+static void check_can_block(VM* vm, const char* name) {
+    if (switch_level(vm) == NULL) {
+        runtime_error(vm, "%s: cannot wait inside a call made by a native procedure", name);
+    }
+}
+
+
+static ObjChannel* channel_arg(VM* vm, const char* name, Value value) {
+    if (!IS_CHANNEL(value)) {
+        runtime_error(vm, "%s: expected a channel", name);
+    }
+    return AS_CHANNEL(value);
+}
+
+
+// A thread with storage for its stack, and nothing else set
+static ObjThread* new_thread(VM* vm) {
+    ObjThread* thread = ARENA_NEW(&vm->heap, ObjThread);
+    memset(thread, 0, sizeof(ObjThread));
+
+    if (vm->free_stacks != NULL) {
+        thread->storage = vm->free_stacks;
+        vm->free_stacks = vm->free_stacks->next_free;
+    } else {
+        thread->storage = ARENA_NEW(&vm->heap, ThreadStack);
+    }
+    return thread;
+}
+
+
+// (spawn procedure): procedure is called with no arguments in a new thread
+static Value native_spawn(VM* vm, int32_t arg_count, Value* args) {
+    (void)arg_count;
+    if (!IS_CLOSURE(args[0]) || AS_CLOSURE(args[0])->function->arity != 0) {
+        runtime_error(vm, "spawn: expected a procedure of no arguments");
+    }
+
+    // The first switch to it calls procedure, as if from THREAD_EXIT
+    ObjThread* thread = new_thread(vm);
+    thread->storage->values[0] = args[0];
+    thread->stack_top = 1;
+    thread->code = &THREAD_EXIT;
+    thread->procedure = args[0];
+    thread->result = NIL_VAL;
+    thread->transfer = NIL_VAL;
+    thread->state = THREAD_RUNNABLE;
+    enqueue(&vm->run_queue, thread);
+    return THREAD_VAL(thread);
+}
+
+
+static Value native_is_thread(VM* vm, int32_t arg_count, Value* args) {
+    (void)vm;
+    (void)arg_count;
+    return BOOL_VAL(IS_THREAD(args[0]));
+}
+
+
+// (thread-join thread): waits for thread to finish and returns its result
+static Value native_thread_join(VM* vm, int32_t arg_count, Value* args) {
+    if (!IS_THREAD(args[0])) {
+        runtime_error(vm, "thread-join: expected a thread");
+    }
+
+    ObjThread* thread = AS_THREAD(args[0]);
+    if (thread->state == THREAD_DONE) {
+        finish_call(vm, arg_count, thread->result);
+        return NIL_VAL;
+    }
+    if (thread == vm->thread) {
+        runtime_error(vm, "thread-join: a thread cannot wait for itself");
+    }
+
+    check_can_block(vm, "thread-join");
+    finish_call(vm, arg_count, NIL_VAL);
+    block(vm, &thread->joiners);
+    return NIL_VAL;
+}
+
+
+static Value native_thread_yield(VM* vm, int32_t arg_count, Value* args) {
+    (void)args;
+    finish_call(vm, arg_count, NIL_VAL);
+    if (threads_waiting(vm)) {
+        yield_thread(vm);
+    }
+    return NIL_VAL;
+}
+
+
+// (make-channel) or (make-channel capacity)
+static Value native_make_channel(VM* vm, int32_t arg_count, Value* args) {
+    if (arg_count > 1) {
+        runtime_error(vm, "make-channel: expected 0 or 1 arguments but got %d", arg_count);
+    }
+
+    int32_t capacity = 0;
+    if (arg_count == 1) {
+        double n = IS_NUMBER(args[0]) ? AS_NUMBER(args[0]) : -1;
+        if (n < 0 || n > INT32_MAX / (int32_t)sizeof(Value) || n != (double)(int32_t)n) {
+            runtime_error(vm, "make-channel: capacity must be a non-negative integer");
+        }
+        capacity = (int32_t)n;
+    }
+
+    ObjChannel* channel = ARENA_NEW(&vm->heap, ObjChannel);
+    memset(channel, 0, sizeof(ObjChannel));
+    channel->capacity = capacity;
+    if (capacity > 0) {
+        channel->buffer = arena_alloc(&vm->heap, sizeof(Value) * capacity);
+    }
+    return CHANNEL_VAL(channel);
+}
+
+
+static Value native_is_channel(VM* vm, int32_t arg_count, Value* args) {
+    (void)vm;
+    (void)arg_count;
+    return BOOL_VAL(IS_CHANNEL(args[0]));
+}
+
+
+// (channel-send channel value): waits only while the buffer is full and no
+// thread is receiving
+static Value native_channel_send(VM* vm, int32_t arg_count, Value* args) {
+    ObjChannel* channel = channel_arg(vm, "channel-send", args[0]);
+    Value value = args[1];
+
+    ObjThread* receiver = dequeue(&channel->receivers);
+    if (receiver != NULL) {
+        wake(vm, receiver, value);
+    } else if (channel->count < channel->capacity) {
+        channel->buffer[(channel->head + channel->count) % channel->capacity] = value;
+        channel->count++;
+    } else {
+        check_can_block(vm, "channel-send");
+        vm->thread->transfer = value;
+        finish_call(vm, arg_count, NIL_VAL);
+        block(vm, &channel->senders);
+        return NIL_VAL;
+    }
+
+    finish_call(vm, arg_count, NIL_VAL);
+    return NIL_VAL;
+}
+
+
+// (channel-receive channel): the oldest value sent, waiting for one if
+// there is none
+static Value native_channel_receive(VM* vm, int32_t arg_count, Value* args) {
+    ObjChannel* channel = channel_arg(vm, "channel-receive", args[0]);
+    Value value;
+
+    if (channel->count > 0) {
+        value = channel->buffer[channel->head];
+        channel->head = (channel->head + 1) % channel->capacity;
+        channel->count--;
+
+        // The first waiting sender gets the room that was made
+        ObjThread* sender = dequeue(&channel->senders);
+        if (sender != NULL) {
+            channel->buffer[(channel->head + channel->count) % channel->capacity] = sender->transfer;
+            channel->count++;
+            sender->transfer = NIL_VAL;
+            wake(vm, sender, NIL_VAL);
+        }
+    } else if (channel->senders.head != NULL) {
+        ObjThread* sender = dequeue(&channel->senders);
+        value = sender->transfer;
+        sender->transfer = NIL_VAL;
+        wake(vm, sender, NIL_VAL);
+    } else {
+        check_can_block(vm, "channel-receive");
+        finish_call(vm, arg_count, NIL_VAL);
+        block(vm, &channel->receivers);
+        return NIL_VAL;
+    }
+
+    finish_call(vm, arg_count, value);
+    return NIL_VAL;
+}
+
+
+static ObjNative THREAD_BUILTINS[] = {
+    {native_spawn, "spawn", 1, false},
+    {native_is_thread, "thread?", 1, false},
+    {native_thread_join, "thread-join", 1, true},
+    {native_thread_yield, "thread-yield", 0, true},
+    {native_make_channel, "make-channel", -1, false},
+    {native_is_channel, "channel?", 1, false},
+    {native_channel_send, "channel-send", 2, true},
+    {native_channel_receive, "channel-receive", 1, true},
+};
+
+
+void register_thread_builtins(VM* vm) {
+    for (size_t i = 0; i < sizeof(THREAD_BUILTINS) / sizeof(THREAD_BUILTINS[0]); i++) {
+        table_set(&vm->globals, THREAD_BUILTINS[i].name, NATIVE_VAL(&THREAD_BUILTINS[i]));
+    }
+}
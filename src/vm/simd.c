@@ -0,0 +1,656 @@
+#include "vm/simd.h"
+#include <stdbool.h>
+#include <string.h>
+
+// Each kernel has a scalar version and, on x86 with GCC or Clang, SSE2 and
+// AVX2 versions compiled for their target and picked at run time, so the
+// binary still runs on CPUs without AVX2.
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+#define HAVE_X86_SIMD 1
+#include <immintrin.h>
+#define TARGET_SSE2 __attribute__((target("sse2")))
+#define TARGET_AVX2 __attribute__((target("avx2")))
+
+static inline bool has_sse2(void) {
+    return __builtin_cpu_supports("sse2");
+}
+
+static inline bool has_avx2(void) {
+    return __builtin_cpu_supports("avx2");
+}
+#endif
+
+
+// Scalar kernels
+
+static double f64_sum_scalar(const double* a, size_t n) {
+    double sum = 0;
+    for (size_t i = 0; i < n; i++) sum += a[i];
+    return sum;
+}
+
+static double f64_dot_scalar(const double* a, const double* b, size_t n) {
+    double sum = 0;
+    for (size_t i = 0; i < n; i++) sum += a[i] * b[i];
+    return sum;
+}
+
+static double f64_min_scalar(const double* a, size_t n) {
+    double result = a[0];
+    for (size_t i = 1; i < n; i++) if (a[i] < result) result = a[i];
+    return result;
+}
+
+static double f64_max_scalar(const double* a, size_t n) {
+    double result = a[0];
+    for (size_t i = 1; i < n; i++) if (a[i] > result) result = a[i];
+    return result;
+}
+
+static void f64_add_scalar(double* dst, const double* a, const double* b, size_t n) {
+    for (size_t i = 0; i < n; i++) dst[i] = a[i] + b[i];
+}
+
+static void f64_mul_scalar(double* dst, const double* a, const double* b, size_t n) {
+    for (size_t i = 0; i < n; i++) dst[i] = a[i] * b[i];
+}
+
+static void f64_scale_scalar(double* dst, const double* a, double k, size_t n) {
+    for (size_t i = 0; i < n; i++) dst[i] = a[i] * k;
+}
+
+static void f64_fill_scalar(double* dst, double value, size_t n) {
+    for (size_t i = 0; i < n; i++) dst[i] = value;
+}
+
+static void f64_copy_scalar(double* dst, const double* a, size_t n) {
+    memcpy(dst, a, sizeof(double) * n);
+}
+
+static uint64_t u8_sum_scalar(const uint8_t* a, size_t n) {
+    uint64_t sum = 0;
+    for (size_t i = 0; i < n; i++) sum += a[i];
+    return sum;
+}
+
+static uint64_t u8_dot_scalar(const uint8_t* a, const uint8_t* b, size_t n) {
+    uint64_t sum = 0;
+    for (size_t i = 0; i < n; i++) sum += (uint64_t)a[i] * b[i];
+    return sum;
+}
+
+static uint8_t u8_min_scalar(const uint8_t* a, size_t n) {
+    uint8_t result = a[0];
+    for (size_t i = 1; i < n; i++) if (a[i] < result) result = a[i];
+    return result;
+}
+
+static uint8_t u8_max_scalar(const uint8_t* a, size_t n) {
+    uint8_t result = a[0];
+    for (size_t i = 1; i < n; i++) if (a[i] > result) result = a[i];
+    return result;
+}
+
+static void u8_add_scalar(uint8_t* dst, const uint8_t* a, const uint8_t* b, size_t n) {
+    for (size_t i = 0; i < n; i++) dst[i] = (uint8_t)(a[i] + b[i]);
+}
+
+static void u8_mul_scalar(uint8_t* dst, const uint8_t* a, const uint8_t* b, size_t n) {
+    for (size_t i = 0; i < n; i++) dst[i] = (uint8_t)(a[i] * b[i]);
+}
+
+static void u8_scale_scalar(uint8_t* dst, const uint8_t* a, uint8_t k, size_t n) {
+    for (size_t i = 0; i < n; i++) dst[i] = (uint8_t)(a[i] * k);
+}
+
+static void u8_fill_scalar(uint8_t* dst, uint8_t value, size_t n) {
+    memset(dst, value, n);
+}
+
+static void u8_copy_scalar(uint8_t* dst, const uint8_t* a, size_t n) {
+    memcpy(dst, a, n);
+}
+
+
+#ifdef HAVE_X86_SIMD
+
+// SSE2 kernels, two lanes of double or sixteen bytes per register
+
+TARGET_SSE2 static double f64_sum_sse2(const double* a, size_t n) {
+    __m128d acc0 = _mm_setzero_pd();
+    __m128d acc1 = _mm_setzero_pd();
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        acc0 = _mm_add_pd(acc0, _mm_loadu_pd(a + i));
+        acc1 = _mm_add_pd(acc1, _mm_loadu_pd(a + i + 2));
+    }
+    double lanes[2];
+    _mm_storeu_pd(lanes, _mm_add_pd(acc0, acc1));
+    return lanes[0] + lanes[1] + f64_sum_scalar(a + i, n - i);
+}
+
+TARGET_SSE2 static double f64_dot_sse2(const double* a, const double* b, size_t n) {
+    __m128d acc0 = _mm_setzero_pd();
+    __m128d acc1 = _mm_setzero_pd();
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        acc0 = _mm_add_pd(acc0, _mm_mul_pd(_mm_loadu_pd(a + i), _mm_loadu_pd(b + i)));
+        acc1 = _mm_add_pd(acc1, _mm_mul_pd(_mm_loadu_pd(a + i + 2), _mm_loadu_pd(b + i + 2)));
+    }
+    double lanes[2];
+    _mm_storeu_pd(lanes, _mm_add_pd(acc0, acc1));
+    return lanes[0] + lanes[1] + f64_dot_scalar(a + i, b + i, n - i);
+}
+
+TARGET_SSE2 static double f64_min_sse2(const double* a, size_t n) {
+    if (n < 2) return f64_min_scalar(a, n);
+    __m128d acc = _mm_loadu_pd(a);
+    size_t i = 2;
+    for (; i + 2 <= n; i += 2) {
+        acc = _mm_min_pd(acc, _mm_loadu_pd(a + i));
+    }
+    double lanes[2];
+    _mm_storeu_pd(lanes, acc);
+    double result = lanes[0] < lanes[1] ? lanes[0] : lanes[1];
+    return i < n && a[i] < result ? a[i] : result;
+}
+
+TARGET_SSE2 static double f64_max_sse2(const double* a, size_t n) {
+    if (n < 2) return f64_max_scalar(a, n);
+    __m128d acc = _mm_loadu_pd(a);
+    size_t i = 2;
+    for (; i + 2 <= n; i += 2) {
+        acc = _mm_max_pd(acc, _mm_loadu_pd(a + i));
+    }
+    double lanes[2];
+    _mm_storeu_pd(lanes, acc);
+    double result = lanes[0] > lanes[1] ? lanes[0] : lanes[1];
+    return i < n && a[i] > result ? a[i] : result;
+}
+
+TARGET_SSE2 static void f64_add_sse2(double* dst, const double* a, const double* b, size_t n) {
+    size_t i = 0;
+    for (; i + 2 <= n; i += 2) {
+        _mm_storeu_pd(dst + i, _mm_add_pd(_mm_loadu_pd(a + i), _mm_loadu_pd(b + i)));
+    }
+    f64_add_scalar(dst + i, a + i, b + i, n - i);
+}
+
+TARGET_SSE2 static void f64_mul_sse2(double* dst, const double* a, const double* b, size_t n) {
+    size_t i = 0;
+    for (; i + 2 <= n; i += 2) {
+        _mm_storeu_pd(dst + i, _mm_mul_pd(_mm_loadu_pd(a + i), _mm_loadu_pd(b + i)));
+    }
+    f64_mul_scalar(dst + i, a + i, b + i, n - i);
+}
+
+TARGET_SSE2 static void f64_scale_sse2(double* dst, const double* a, double k, size_t n) {
+    __m128d factor = _mm_set1_pd(k);
+    size_t i = 0;
+    for (; i + 2 <= n; i += 2) {
+        _mm_storeu_pd(dst + i, _mm_mul_pd(_mm_loadu_pd(a + i), factor));
+    }
+    f64_scale_scalar(dst + i, a + i, k, n - i);
+}
+
+TARGET_SSE2 static void f64_fill_sse2(double* dst, double value, size_t n) {
+    __m128d v = _mm_set1_pd(value);
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        _mm_storeu_pd(dst + i, v);
+        _mm_storeu_pd(dst + i + 2, v);
+    }
+    f64_fill_scalar(dst + i, value, n - i);
+}
+
+TARGET_SSE2 static void f64_copy_sse2(double* dst, const double* a, size_t n) {
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        _mm_storeu_pd(dst + i, _mm_loadu_pd(a + i));
+        _mm_storeu_pd(dst + i + 2, _mm_loadu_pd(a + i + 2));
+    }
+    f64_copy_scalar(dst + i, a + i, n - i);
+}
+
+// psadbw against zero sums each 8-byte half into a 64-bit lane
+TARGET_SSE2 static uint64_t u8_sum_sse2(const uint8_t* a, size_t n) {
+    __m128i zero = _mm_setzero_si128();
+    __m128i acc = _mm_setzero_si128();
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        __m128i bytes = _mm_loadu_si128((const __m128i*)(a + i));
+        acc = _mm_add_epi64(acc, _mm_sad_epu8(bytes, zero));
+    }
+    uint64_t lanes[2];
+    _mm_storeu_si128((__m128i*)lanes, acc);
+    return lanes[0] + lanes[1] + u8_sum_scalar(a + i, n - i);
+}
+
+TARGET_SSE2 static uint8_t u8_min_sse2(const uint8_t* a, size_t n) {
+    if (n < 16) return u8_min_scalar(a, n);
+    __m128i acc = _mm_loadu_si128((const __m128i*)a);
+    size_t i = 16;
+    for (; i + 16 <= n; i += 16) {
+        acc = _mm_min_epu8(acc, _mm_loadu_si128((const __m128i*)(a + i)));
+    }
+    uint8_t lanes[16];
+    _mm_storeu_si128((__m128i*)lanes, acc);
+    uint8_t result = u8_min_scalar(lanes, 16);
+    if (i < n) {
+        uint8_t tail = u8_min_scalar(a + i, n - i);
+        if (tail < result) result = tail;
+    }
+    return result;
+}
+
+TARGET_SSE2 static uint8_t u8_max_sse2(const uint8_t* a, size_t n) {
+    if (n < 16) return u8_max_scalar(a, n);
+    __m128i acc = _mm_loadu_si128((const __m128i*)a);
+    size_t i = 16;
+    for (; i + 16 <= n; i += 16) {
+        acc = _mm_max_epu8(acc, _mm_loadu_si128((const __m128i*)(a + i)));
+    }
+    uint8_t lanes[16];
+    _mm_storeu_si128((__m128i*)lanes, acc);
+    uint8_t result = u8_max_scalar(lanes, 16);
+    if (i < n) {
+        uint8_t tail = u8_max_scalar(a + i, n - i);
+        if (tail > result) result = tail;
+    }
+    return result;
+}
+
+TARGET_SSE2 static void u8_add_sse2(uint8_t* dst, const uint8_t* a, const uint8_t* b, size_t n) {
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        __m128i x = _mm_loadu_si128((const __m128i*)(a + i));
+        __m128i y = _mm_loadu_si128((const __m128i*)(b + i));
+        _mm_storeu_si128((__m128i*)(dst + i), _mm_add_epi8(x, y));
+    }
+    u8_add_scalar(dst + i, a + i, b + i, n - i);
+}
+
+// x86 has no byte multiply: widen to 16-bit lanes, multiply there, then keep
+// the low byte of each product (and with 0xff, so packus never saturates)
+TARGET_SSE2 static uint64_t u8_dot_sse2(const uint8_t* a, const uint8_t* b, size_t n) {
+    __m128i zero = _mm_setzero_si128();
+    __m128i acc = _mm_setzero_si128();
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        __m128i x = _mm_loadu_si128((const __m128i*)(a + i));
+        __m128i y = _mm_loadu_si128((const __m128i*)(b + i));
+        // pmaddwd adds adjacent products into 32-bit lanes; widen before adding up
+        __m128i sums = _mm_add_epi32(_mm_madd_epi16(_mm_unpacklo_epi8(x, zero), _mm_unpacklo_epi8(y, zero)),
+                                     _mm_madd_epi16(_mm_unpackhi_epi8(x, zero), _mm_unpackhi_epi8(y, zero)));
+        acc = _mm_add_epi64(acc, _mm_unpacklo_epi32(sums, zero));
+        acc = _mm_add_epi64(acc, _mm_unpackhi_epi32(sums, zero));
+    }
+    uint64_t lanes[2];
+    _mm_storeu_si128((__m128i*)lanes, acc);
+    return lanes[0] + lanes[1] + u8_dot_scalar(a + i, b + i, n - i);
+}
+
+TARGET_SSE2 static void u8_mul_sse2(uint8_t* dst, const uint8_t* a, const uint8_t* b, size_t n) {
+    __m128i zero = _mm_setzero_si128();
+    __m128i low_byte = _mm_set1_epi16(0xff);
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        __m128i x = _mm_loadu_si128((const __m128i*)(a + i));
+        __m128i y = _mm_loadu_si128((const __m128i*)(b + i));
+        __m128i lo = _mm_mullo_epi16(_mm_unpacklo_epi8(x, zero), _mm_unpacklo_epi8(y, zero));
+        __m128i hi = _mm_mullo_epi16(_mm_unpackhi_epi8(x, zero), _mm_unpackhi_epi8(y, zero));
+        _mm_storeu_si128((__m128i*)(dst + i),
+                         _mm_packus_epi16(_mm_and_si128(lo, low_byte), _mm_and_si128(hi, low_byte)));
+    }
+    u8_mul_scalar(dst + i, a + i, b + i, n - i);
+}
+
+TARGET_SSE2 static void u8_scale_sse2(uint8_t* dst, const uint8_t* a, uint8_t k, size_t n) {
+    __m128i zero = _mm_setzero_si128();
+    __m128i low_byte = _mm_set1_epi16(0xff);
+    __m128i factor = _mm_set1_epi16(k);
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        __m128i x = _mm_loadu_si128((const __m128i*)(a + i));
+        __m128i lo = _mm_mullo_epi16(_mm_unpacklo_epi8(x, zero), factor);
+        __m128i hi = _mm_mullo_epi16(_mm_unpackhi_epi8(x, zero), factor);
+        _mm_storeu_si128((__m128i*)(dst + i),
+                         _mm_packus_epi16(_mm_and_si128(lo, low_byte), _mm_and_si128(hi, low_byte)));
+    }
+    u8_scale_scalar(dst + i, a + i, k, n - i);
+}
+
+TARGET_SSE2 static void u8_fill_sse2(uint8_t* dst, uint8_t value, size_t n) {
+    __m128i v = _mm_set1_epi8((char)value);
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        _mm_storeu_si128((__m128i*)(dst + i), v);
+    }
+    u8_fill_scalar(dst + i, value, n - i);
+}
+
+TARGET_SSE2 static void u8_copy_sse2(uint8_t* dst, const uint8_t* a, size_t n) {
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        _mm_storeu_si128((__m128i*)(dst + i), _mm_loadu_si128((const __m128i*)(a + i)));
+    }
+    u8_copy_scalar(dst + i, a + i, n - i);
+}
+
+
+// AVX2 kernels, four lanes of double or thirty-two bytes per register
+
+TARGET_AVX2 static double f64_sum_avx2(const double* a, size_t n) {
+    __m256d acc0 = _mm256_setzero_pd();
+    __m256d acc1 = _mm256_setzero_pd();
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        acc0 = _mm256_add_pd(acc0, _mm256_loadu_pd(a + i));
+        acc1 = _mm256_add_pd(acc1, _mm256_loadu_pd(a + i + 4));
+    }
+    double lanes[4];
+    _mm256_storeu_pd(lanes, _mm256_add_pd(acc0, acc1));
+    return (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]) + f64_sum_scalar(a + i, n - i);
+}
+
+TARGET_AVX2 static double f64_dot_avx2(const double* a, const double* b, size_t n) {
+    __m256d acc0 = _mm256_setzero_pd();
+    __m256d acc1 = _mm256_setzero_pd();
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        acc0 = _mm256_add_pd(acc0, _mm256_mul_pd(_mm256_loadu_pd(a + i), _mm256_loadu_pd(b + i)));
+        acc1 = _mm256_add_pd(acc1, _mm256_mul_pd(_mm256_loadu_pd(a + i + 4), _mm256_loadu_pd(b + i + 4)));
+    }
+    double lanes[4];
+    _mm256_storeu_pd(lanes, _mm256_add_pd(acc0, acc1));
+    return (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]) + f64_dot_scalar(a + i, b + i, n - i);
+}
+
+TARGET_AVX2 static double f64_min_avx2(const double* a, size_t n) {
+    if (n < 4) return f64_min_scalar(a, n);
+    __m256d acc = _mm256_loadu_pd(a);
+    size_t i = 4;
+    for (; i + 4 <= n; i += 4) {
+        acc = _mm256_min_pd(acc, _mm256_loadu_pd(a + i));
+    }
+    double lanes[4];
+    _mm256_storeu_pd(lanes, acc);
+    double result = f64_min_scalar(lanes, 4);
+    if (i < n) {
+        double tail = f64_min_scalar(a + i, n - i);
+        if (tail < result) result = tail;
+    }
+    return result;
+}
+
+TARGET_AVX2 static double f64_max_avx2(const double* a, size_t n) {
+    if (n < 4) return f64_max_scalar(a, n);
+    __m256d acc = _mm256_loadu_pd(a);
+    size_t i = 4;
+    for (; i + 4 <= n; i += 4) {
+        acc = _mm256_max_pd(acc, _mm256_loadu_pd(a + i));
+    }
+    double lanes[4];
+    _mm256_storeu_pd(lanes, acc);
+    double result = f64_max_scalar(lanes, 4);
+    if (i < n) {
+        double tail = f64_max_scalar(a + i, n - i);
+        if (tail > result) result = tail;
+    }
+    return result;
+}
+
+TARGET_AVX2 static void f64_add_avx2(double* dst, const double* a, const double* b, size_t n) {
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        _mm256_storeu_pd(dst + i, _mm256_add_pd(_mm256_loadu_pd(a + i), _mm256_loadu_pd(b + i)));
+    }
+    f64_add_scalar(dst + i, a + i, b + i, n - i);
+}
+
+TARGET_AVX2 static void f64_mul_avx2(double* dst, const double* a, const double* b, size_t n) {
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        _mm256_storeu_pd(dst + i, _mm256_mul_pd(_mm256_loadu_pd(a + i), _mm256_loadu_pd(b + i)));
+    }
+    f64_mul_scalar(dst + i, a + i, b + i, n - i);
+}
+
+TARGET_AVX2 static void f64_scale_avx2(double* dst, const double* a, double k, size_t n) {
+    __m256d factor = _mm256_set1_pd(k);
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        _mm256_storeu_pd(dst + i, _mm256_mul_pd(_mm256_loadu_pd(a + i), factor));
+    }
+    f64_scale_scalar(dst + i, a + i, k, n - i);
+}
+
+TARGET_AVX2 static void f64_fill_avx2(double* dst, double value, size_t n) {
+    __m256d v = _mm256_set1_pd(value);
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        _mm256_storeu_pd(dst + i, v);
+        _mm256_storeu_pd(dst + i + 4, v);
+    }
+    f64_fill_scalar(dst + i, value, n - i);
+}
+
+TARGET_AVX2 static void f64_copy_avx2(double* dst, const double* a, size_t n) {
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        _mm256_storeu_pd(dst + i, _mm256_loadu_pd(a + i));
+        _mm256_storeu_pd(dst + i + 4, _mm256_loadu_pd(a + i + 4));
+    }
+    f64_copy_scalar(dst + i, a + i, n - i);
+}
+
+TARGET_AVX2 static uint64_t u8_sum_avx2(const uint8_t* a, size_t n) {
+    __m256i zero = _mm256_setzero_si256();
+    __m256i acc = _mm256_setzero_si256();
+    size_t i = 0;
+    for (; i + 32 <= n; i += 32) {
+        __m256i bytes = _mm256_loadu_si256((const __m256i*)(a + i));
+        acc = _mm256_add_epi64(acc, _mm256_sad_epu8(bytes, zero));
+    }
+    uint64_t lanes[4];
+    _mm256_storeu_si256((__m256i*)lanes, acc);
+    return lanes[0] + lanes[1] + lanes[2] + lanes[3] + u8_sum_scalar(a + i, n - i);
+}
+
+TARGET_AVX2 static uint8_t u8_min_avx2(const uint8_t* a, size_t n) {
+    if (n < 32) return u8_min_scalar(a, n);
+    __m256i acc = _mm256_loadu_si256((const __m256i*)a);
+    size_t i = 32;
+    for (; i + 32 <= n; i += 32) {
+        acc = _mm256_min_epu8(acc, _mm256_loadu_si256((const __m256i*)(a + i)));
+    }
+    uint8_t lanes[32];
+    _mm256_storeu_si256((__m256i*)lanes, acc);
+    uint8_t result = u8_min_scalar(lanes, 32);
+    if (i < n) {
+        uint8_t tail = u8_min_scalar(a + i, n - i);
+        if (tail < result) result = tail;
+    }
+    return result;
+}
+
+TARGET_AVX2 static uint8_t u8_max_avx2(const uint8_t* a, size_t n) {
+    if (n < 32) return u8_max_scalar(a, n);
+    __m256i acc = _mm256_loadu_si256((const __m256i*)a);
+    size_t i = 32;
+    for (; i + 32 <= n; i += 32) {
+        acc = _mm256_max_epu8(acc, _mm256_loadu_si256((const __m256i*)(a + i)));
+    }
+    uint8_t lanes[32];
+    _mm256_storeu_si256((__m256i*)lanes, acc);
+    uint8_t result = u8_max_scalar(lanes, 32);
+    if (i < n) {
+        uint8_t tail = u8_max_scalar(a + i, n - i);
+        if (tail > result) result = tail;
+    }
+    return result;
+}
+
+TARGET_AVX2 static void u8_add_avx2(uint8_t* dst, const uint8_t* a, const uint8_t* b, size_t n) {
+    size_t i = 0;
+    for (; i + 32 <= n; i += 32) {
+        __m256i x = _mm256_loadu_si256((const __m256i*)(a + i));
+        __m256i y = _mm256_loadu_si256((const __m256i*)(b + i));
+        _mm256_storeu_si256((__m256i*)(dst + i), _mm256_add_epi8(x, y));
+    }
+    u8_add_scalar(dst + i, a + i, b + i, n - i);
+}
+
+// Unpack and pack both work within each 128-bit half, so the bytes come
+// back out in their original order
+TARGET_AVX2 static uint64_t u8_dot_avx2(const uint8_t* a, const uint8_t* b, size_t n) {
+    __m256i zero = _mm256_setzero_si256();
+    __m256i acc = _mm256_setzero_si256();
+    size_t i = 0;
+    for (; i + 32 <= n; i += 32) {
+        __m256i x = _mm256_loadu_si256((const __m256i*)(a + i));
+        __m256i y = _mm256_loadu_si256((const __m256i*)(b + i));
+        __m256i sums = _mm256_add_epi32(
+            _mm256_madd_epi16(_mm256_unpacklo_epi8(x, zero), _mm256_unpacklo_epi8(y, zero)),
+            _mm256_madd_epi16(_mm256_unpackhi_epi8(x, zero), _mm256_unpackhi_epi8(y, zero)));
+        acc = _mm256_add_epi64(acc, _mm256_unpacklo_epi32(sums, zero));
+        acc = _mm256_add_epi64(acc, _mm256_unpackhi_epi32(sums, zero));
+    }
+    uint64_t lanes[4];
+    _mm256_storeu_si256((__m256i*)lanes, acc);
+    return lanes[0] + lanes[1] + lanes[2] + lanes[3] + u8_dot_scalar(a + i, b + i, n - i);
+}
+
+TARGET_AVX2 static void u8_mul_avx2(uint8_t* dst, const uint8_t* a, const uint8_t* b, size_t n) {
+    __m256i zero = _mm256_setzero_si256();
+    __m256i low_byte = _mm256_set1_epi16(0xff);
+    size_t i = 0;
+    for (; i + 32 <= n; i += 32) {
+        __m256i x = _mm256_loadu_si256((const __m256i*)(a + i));
+        __m256i y = _mm256_loadu_si256((const __m256i*)(b + i));
+        __m256i lo = _mm256_mullo_epi16(_mm256_unpacklo_epi8(x, zero), _mm256_unpacklo_epi8(y, zero));
+        __m256i hi = _mm256_mullo_epi16(_mm256_unpackhi_epi8(x, zero), _mm256_unpackhi_epi8(y, zero));
+        _mm256_storeu_si256((__m256i*)(dst + i),
+                            _mm256_packus_epi16(_mm256_and_si256(lo, low_byte), _mm256_and_si256(hi, low_byte)));
+    }
+    u8_mul_scalar(dst + i, a + i, b + i, n - i);
+}
+
+TARGET_AVX2 static void u8_scale_avx2(uint8_t* dst, const uint8_t* a, uint8_t k, size_t n) {
+    __m256i zero = _mm256_setzero_si256();
+    __m256i low_byte = _mm256_set1_epi16(0xff);
+    __m256i factor = _mm256_set1_epi16(k);
+    size_t i = 0;
+    for (; i + 32 <= n; i += 32) {
+        __m256i x = _mm256_loadu_si256((const __m256i*)(a + i));
+        __m256i lo = _mm256_mullo_epi16(_mm256_unpacklo_epi8(x, zero), factor);
+        __m256i hi = _mm256_mullo_epi16(_mm256_unpackhi_epi8(x, zero), factor);
+        _mm256_storeu_si256((__m256i*)(dst + i),
+                            _mm256_packus_epi16(_mm256_and_si256(lo, low_byte), _mm256_and_si256(hi, low_byte)));
+    }
+    u8_scale_scalar(dst + i, a + i, k, n - i);
+}
+
+TARGET_AVX2 static void u8_fill_avx2(uint8_t* dst, uint8_t value, size_t n) {
+    __m256i v = _mm256_set1_epi8((char)value);
+    size_t i = 0;
+    for (; i + 32 <= n; i += 32) {
+        _mm256_storeu_si256((__m256i*)(dst + i), v);
+    }
+    u8_fill_scalar(dst + i, value, n - i);
+}
+
+TARGET_AVX2 static void u8_copy_avx2(uint8_t* dst, const uint8_t* a, size_t n) {
+    size_t i = 0;
+    for (; i + 32 <= n; i += 32) {
+        _mm256_storeu_si256((__m256i*)(dst + i), _mm256_loadu_si256((const __m256i*)(a + i)));
+    }
+    u8_copy_scalar(dst + i, a + i, n - i);
+}
+
+// Picks the widest kernel the CPU supports
+#define DISPATCH(name, ...)                                   \
+    do {                                                      \
+        if (has_avx2()) return name##_avx2(__VA_ARGS__);      \
+        if (has_sse2()) return name##_sse2(__VA_ARGS__);      \
+        return name##_scalar(__VA_ARGS__);                    \
+    } while (0)
+
+#else
+
+#define DISPATCH(name, ...) return name##_scalar(__VA_ARGS__)
+
+#endif // HAVE_X86_SIMD
+
+
+double f64_sum(const double* a, size_t n) {
+    DISPATCH(f64_sum, a, n);
+}
+
+double f64_dot(const double* a, const double* b, size_t n) {
+    DISPATCH(f64_dot, a, b, n);
+}
+
+double f64_min(const double* a, size_t n) {
+    DISPATCH(f64_min, a, n);
+}
+
+double f64_max(const double* a, size_t n) {
+    DISPATCH(f64_max, a, n);
+}
+
+void f64_add(double* dst, const double* a, const double* b, size_t n) {
+    DISPATCH(f64_add, dst, a, b, n);
+}
+
+void f64_mul(double* dst, const double* a, const double* b, size_t n) {
+    DISPATCH(f64_mul, dst, a, b, n);
+}
+
+void f64_scale(double* dst, const double* a, double k, size_t n) {
+    DISPATCH(f64_scale, dst, a, k, n);
+}
+
+void f64_fill(double* dst, double value, size_t n) {
+    DISPATCH(f64_fill, dst, value, n);
+}
+
+void f64_copy(double* dst, const double* a, size_t n) {
+    DISPATCH(f64_copy, dst, a, n);
+}
+
+uint64_t u8_sum(const uint8_t* a, size_t n) {
+    DISPATCH(u8_sum, a, n);
+}
+
+uint8_t u8_min(const uint8_t* a, size_t n) {
+    DISPATCH(u8_min, a, n);
+}
+
+uint8_t u8_max(const uint8_t* a, size_t n) {
+    DISPATCH(u8_max, a, n);
+}
+
+void u8_add(uint8_t* dst, const uint8_t* a, const uint8_t* b, size_t n) {
+    DISPATCH(u8_add, dst, a, b, n);
+}
+
+uint64_t u8_dot(const uint8_t* a, const uint8_t* b, size_t n) {
+    DISPATCH(u8_dot, a, b, n);
+}
+
+void u8_mul(uint8_t* dst, const uint8_t* a, const uint8_t* b, size_t n) {
+    DISPATCH(u8_mul, dst, a, b, n);
+}
+
+void u8_scale(uint8_t* dst, const uint8_t* a, uint8_t k, size_t n) {
+    DISPATCH(u8_scale, dst, a, k, n);
+}
+
+void u8_fill(uint8_t* dst, uint8_t value, size_t n) {
+    DISPATCH(u8_fill, dst, value, n);
+}
+
+void u8_copy(uint8_t* dst, const uint8_t* a, size_t n) {
+    DISPATCH(u8_copy, dst, a, n);
+}
@@ -0,0 +1,76 @@
+#include "vm/symbol.h"
+#include "utils/hash.h"
+#include "utils/memory.h"
+#include <pthread.h>
+#include <string.h>
+
+#define SYMBOL_TABLE_MAX_LOAD 0.75
+
+// Open addressing over symbol pointers; capacity is always a power of two
+typedef struct {
+    ObjSymbol** slots;
+    uint32_t count;
+    uint32_t capacity;
+} SymbolTable;
+
+static SymbolTable symbols = {NULL, 0, 0};
+static pthread_mutex_t symbols_lock = PTHREAD_MUTEX_INITIALIZER;
+
+
+static ObjSymbol** find_slot(ObjSymbol** slots, uint32_t capacity,
+                             const char* chars, uint32_t length, uint32_t hash) {
+    uint32_t index = hash & (capacity - 1);
+    for (;;) {
+        ObjSymbol** slot = &slots[index];
+        ObjSymbol* symbol = *slot;
+        if (symbol == NULL) return slot;
+        if (symbol->hash == hash && symbol->length == length &&
+            memcmp(symbol->name, chars, length) == 0) {
+            return slot;
+        }
+        index = (index + 1) & (capacity - 1);
+    }
+}
+
+
+static void grow_symbols(void) {
+    uint32_t capacity = symbols.capacity < 64 ? 64 : symbols.capacity * 2;
+    ObjSymbol** slots = (ObjSymbol**)reallocate(NULL, 0, sizeof(ObjSymbol*) * capacity);
+    memset(slots, 0, sizeof(ObjSymbol*) * capacity);
+
+    for (uint32_t i = 0; i < symbols.capacity; i++) {
+        ObjSymbol* symbol = symbols.slots[i];
+        if (symbol == NULL) continue;
+        *find_slot(slots, capacity, symbol->name, symbol->length, symbol->hash) = symbol;
+    }
+
+    FREE_ARRAY(ObjSymbol*, symbols.slots, symbols.capacity);
+    symbols.slots = slots;
+    symbols.capacity = capacity;
+}
+
+
+ObjSymbol* intern_symbol_object(const char* chars, size_t length) {
+    uint32_t hash = hash_string(chars, (int)length);
+
+    pthread_mutex_lock(&symbols_lock);
+    if (symbols.count + 1 > symbols.capacity * SYMBOL_TABLE_MAX_LOAD) {
+        grow_symbols();
+    }
+
+    ObjSymbol** slot = find_slot(symbols.slots, symbols.capacity, chars, (uint32_t)length, hash);
+    if (*slot == NULL) {
+        ObjSymbol* symbol = (ObjSymbol*)reallocate(NULL, 0, sizeof(ObjSymbol) + length + 1);
+        symbol->length = (uint32_t)length;
+        symbol->hash = hash;
+        memcpy(symbol->name, chars, length);
+        symbol->name[length] = '\0';
+
+        *slot = symbol;
+        symbols.count++;
+    }
+    ObjSymbol* symbol = *slot;
+    pthread_mutex_unlock(&symbols_lock);
+
+    return symbol;
+}
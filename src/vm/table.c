@@ -5,88 +5,239 @@
 #include "stdint.h"
 #include "string.h"
 
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+// Control bytes. A full slot holds h2, the low 7 bits of its hash, so only
+// the two markers have the top bit set.
+#define CONTROL_EMPTY   0x80
+#define CONTROL_DELETED 0xFE
+
+#define H1(hash) ((hash) >> 7)
+#define H2(hash) ((uint8_t)((hash) & 0x7F))
+
+// At most 7/8 of the slots, counting deleted ones, are in use
+#define MAX_FILLED(capacity) ((capacity) - (capacity) / 8)
+
+// Bit i is set when slot pos + i of the group starting at pos matches
+typedef uint32_t GroupMask;
+
+
+static inline GroupMask match_byte(const uint8_t* group, uint8_t byte) {
+#ifdef __SSE2__
+    __m128i control = _mm_loadu_si128((const __m128i*)group);
+    return (GroupMask)_mm_movemask_epi8(_mm_cmpeq_epi8(control, _mm_set1_epi8((char)byte)));
+#else
+    GroupMask mask = 0;
+    for (int i = 0; i < TABLE_GROUP_WIDTH; i++) {
+        if (group[i] == byte) mask |= (GroupMask)1 << i;
+    }
+    return mask;
+#endif
+}
+
+
+// Empty or deleted: the slots with the top bit set
+static inline GroupMask match_free(const uint8_t* group) {
+#ifdef __SSE2__
+    return (GroupMask)_mm_movemask_epi8(_mm_loadu_si128((const __m128i*)group));
+#else
+    GroupMask mask = 0;
+    for (int i = 0; i < TABLE_GROUP_WIDTH; i++) {
+        if (group[i] & 0x80) mask |= (GroupMask)1 << i;
+    }
+    return mask;
+#endif
+}
+
+
+static inline int lowest_bit(GroupMask mask) {
+#if defined(__GNUC__) || defined(__clang__)
+    return __builtin_ctz(mask);
+#else
+    int bit = 0;
+    while (!(mask & 1)) {
+        mask >>= 1;
+        bit++;
+    }
+    return bit;
+#endif
+}
+
+
+// The first group is mirrored after the last slot, so a group can be
+// loaded at any position without wrapping
+static inline void set_control(Table* table, int index, uint8_t byte) {
+    table->control[index] = byte;
+    if (index < TABLE_GROUP_WIDTH) {
+        table->control[table->capacity + index] = byte;
+    }
+}
+
+
 void init_table(Table* table) {
     table->count = 0;
     table->capacity = 0;
+    table->growth_left = 0;
+    table->control = NULL;
     table->entries = NULL;
+    table->last_version = 0;
 }
 
 
 void free_table(Table* table) {
     for (int i = 0; i < table->capacity; i++) {
-        free(table->entries[i].key);
+        if (!(table->control[i] & 0x80)) {
+            TableEntry* entry = &table->entries[i];
+            reallocate(entry->key, entry->length + 1, 0);
+        }
     }
-    free(table->entries);
+    FREE_ARRAY(uint8_t, table->control, table->capacity ? table->capacity + TABLE_GROUP_WIDTH : 0);
+    FREE_ARRAY(TableEntry, table->entries, table->capacity);
+    init_table(table);
 }
 
 
-static TableEntry* find_entry(TableEntry* entries, int capacity, const char* key){
-    uint32_t hash = hash_string(key, strlen(key));
-    uint32_t index = hash % capacity;
+// Groups are probed at triangular offsets, which visits every group of a
+// power-of-two table before repeating
+static TableEntry* find_entry(const Table* table, const char* key, uint32_t length, uint32_t hash) {
+    uint32_t mask = (uint32_t)table->capacity - 1;
+    uint32_t pos = H1(hash) & mask;
+    uint8_t h2 = H2(hash);
+
+    for (uint32_t stride = TABLE_GROUP_WIDTH;; stride += TABLE_GROUP_WIDTH) {
+        const uint8_t* group = table->control + pos;
 
-    for (;;) {
-        TableEntry* entry = &entries[index];
-        if (entry->key == NULL) return entry;
+        for (GroupMask match = match_byte(group, h2); match; match &= match - 1) {
+            TableEntry* entry = &table->entries[(pos + lowest_bit(match)) & mask];
+            if (entry->hash == hash && entry->length == length &&
+                memcmp(entry->key, key, length) == 0) {
+                return entry;
+            }
+        }
 
-        if (strcmp(entry->key, key) == 0) return entry;
+        // An empty slot ends the probe sequence: the key would be here
+        if (match_byte(group, CONTROL_EMPTY)) return NULL;
 
-        index = (index + 1) % capacity;
+        pos = (pos + stride) & mask;
     }
 }
 
 
-static void adjust_capacity(Table* table, int capacity){
+static int find_free_slot(const Table* table, uint32_t hash) {
+    uint32_t mask = (uint32_t)table->capacity - 1;
+    uint32_t pos = H1(hash) & mask;
 
-    TableEntry* entries = (TableEntry*)calloc(capacity, sizeof(TableEntry));
+    for (uint32_t stride = TABLE_GROUP_WIDTH;; stride += TABLE_GROUP_WIDTH) {
+        GroupMask free_slots = match_free(table->control + pos);
+        if (free_slots) {
+            return (int)((pos + lowest_bit(free_slots)) & mask);
+        }
+        pos = (pos + stride) & mask;
+    }
+}
 
-    int old_capacity = table->capacity;
-    table->count = 0;
 
-    for(int i = 0; i < old_capacity; i++){
-        TableEntry* entry = &table->entries[i];
-        if (entry->key == NULL) continue;
+static void resize(Table* table, int capacity) {
+    Table resized;
+    resized.count = table->count;
+    resized.capacity = capacity;
+    resized.growth_left = MAX_FILLED(capacity) - table->count;
+    resized.control = (uint8_t*)reallocate(NULL, 0, capacity + TABLE_GROUP_WIDTH);
+    resized.entries = (TableEntry*)reallocate(NULL, 0, sizeof(TableEntry) * capacity);
+    resized.last_version = table->last_version;
+    memset(resized.control, CONTROL_EMPTY, capacity + TABLE_GROUP_WIDTH);
+    memset(resized.entries, 0, sizeof(TableEntry) * capacity);
 
-        TableEntry* dest = find_entry(entries, capacity, entry->key);
-        dest->key = entry->key;
-        dest->value = entry->value;
-        table->count++;
+    // Entries move as they are, keeping their key copies
+    for (int i = 0; i < table->capacity; i++) {
+        if (table->control[i] & 0x80) continue;
+
+        TableEntry* entry = &table->entries[i];
+        int index = find_free_slot(&resized, entry->hash);
+        set_control(&resized, index, H2(entry->hash));
+        resized.entries[index] = *entry;
     }
 
-    FREE_ARRAY(TableEntry, table->entries, old_capacity);
-    table->entries = entries;
-    table->capacity = capacity;
-    
+    FREE_ARRAY(uint8_t, table->control, table->capacity ? table->capacity + TABLE_GROUP_WIDTH : 0);
+    FREE_ARRAY(TableEntry, table->entries, table->capacity);
+    *table = resized;
 }
 
+
 bool table_set(Table* table, const char* key, Value value) {
-    
-    if(table->count + 1 > table->capacity * 0.75){
-        int old_capacity = table->capacity;
-        int new_capacity = GROW_CAPACITY(old_capacity);
-        adjust_capacity(table, new_capacity);
+    uint32_t length = (uint32_t)strlen(key);
+    uint32_t hash = hash_string(key, (int)length);
+
+    if (table->capacity > 0) {
+        TableEntry* entry = find_entry(table, key, length, hash);
+        if (entry) {
+            entry->value = value;
+            entry->version = ++table->last_version;
+            return false;
+        }
     }
 
-    TableEntry* entry = find_entry(table->entries, table->capacity, key);
-    bool is_new_key = entry->key == NULL;
-
-    if(is_new_key){
-        table->count++;
-        entry->key = strdup(key);
+    if (table->growth_left == 0) {
+        // Double when live entries fill more than half of the usable
+        // slots; otherwise deleted slots are what ran out, and rehashing at
+        // the same size reclaims them
+        int capacity = table->capacity == 0 ? TABLE_GROUP_WIDTH : table->capacity;
+        if (table->count + 1 > MAX_FILLED(capacity) / 2) capacity *= 2;
+        resize(table, capacity);
     }
-    
-    entry->value = value;
-    return is_new_key;
 
+    int index = find_free_slot(table, hash);
+    if (table->control[index] == CONTROL_EMPTY) table->growth_left--;
+    set_control(table, index, H2(hash));
+
+    TableEntry* entry = &table->entries[index];
+    entry->key = (char*)reallocate(NULL, 0, length + 1);
+    memcpy(entry->key, key, length + 1);
+    entry->hash = hash;
+    entry->length = length;
+    entry->version = ++table->last_version;
+    entry->value = value;
+    table->count++;
+    return true;
 }
 
+
 bool table_get(Table* table, const char* key, Value* value){
     if (table->count == 0) return false;
 
-    TableEntry* entry = find_entry(table->entries, table->capacity, key);
-    if (entry->key == NULL) return false;
+    uint32_t length = (uint32_t)strlen(key);
+    TableEntry* entry = find_entry(table, key, length, hash_string(key, (int)length));
+    if (entry == NULL) return false;
 
     *value = entry->value;
     return true;
 }
 
 
+bool table_delete(Table* table, const char* key) {
+    if (table->count == 0) return false;
+
+    uint32_t length = (uint32_t)strlen(key);
+    TableEntry* entry = find_entry(table, key, length, hash_string(key, (int)length));
+    if (entry == NULL) return false;
+
+    reallocate(entry->key, entry->length + 1, 0);
+    entry->key = NULL;
+    entry->version = 0;
+
+    // The slot stays deleted rather than empty so probes keep going past it
+    set_control(table, (int)(entry - table->entries), CONTROL_DELETED);
+    table->count--;
+    return true;
+}
+
+
+int table_find(Table* table, const char* key) {
+    if (table->count == 0) return -1;
+
+    uint32_t length = (uint32_t)strlen(key);
+    TableEntry* entry = find_entry(table, key, length, hash_string(key, (int)length));
+    return entry ? (int)(entry - table->entries) : -1;
+}
@@ -1,13 +1,38 @@
 #include "vm/value.h"
 #include <stdio.h>
 
+
+// Ropes are printed leaf by leaf rather than flattened first
+static void print_string(const ObjString* string) {
+    if (string->chars) {
+        fwrite(string->chars, 1, string->length, stdout);
+        return;
+    }
+    print_string(string->left);
+    print_string(string->right);
+}
+
+
+static void write_string(OutputBuffer* out, const ObjString* string) {
+    if (string->chars) {
+        output_string(out, string->chars, string->length);
+        return;
+    }
+    write_string(out, string->left);
+    write_string(out, string->right);
+}
+
+
 void print_value(Value value) {
     switch (value.type) {
-        case VAL_NUMBER:
-            printf("%g", AS_NUMBER(value));
+        case VAL_NUMBER: {
+            char digits[NUMBER_BUFFER_SIZE];
+            format_number(digits, AS_NUMBER(value));
+            fputs(digits, stdout);
             break;
+        }
         case VAL_STRING:
-            printf("%s", AS_STRING(value));
+            print_string(AS_STRING(value));
             break;
         case VAL_BOOL:
             printf(AS_BOOL(value) ? "#t" : "#f");
@@ -27,11 +52,11 @@ void print_value(Value value) {
                 printf(" . ");
                 print_value(current);
             }
-            
+
             printf(")");
             break;
         }
-            
+
         case VAL_NIL:
             printf("()");
             break;
@@ -41,6 +66,168 @@ void print_value(Value value) {
         case VAL_CLOSURE:
             printf("<fn %s>", AS_CLOSURE(value)->function->name ? AS_CLOSURE(value)->function->name : "lambda");
             break;
+        case VAL_NATIVE:
+            printf("<native %s>", AS_NATIVE(value)->name);
+            break;
+        case VAL_VECTOR: {
+            ObjVector* vector = AS_VECTOR(value);
+            printf("#(");
+            for (uint32_t i = 0; i < vector->count; i++) {
+                if (i > 0) printf(" ");
+                print_value(vector->items[i]);
+            }
+            printf(")");
+            break;
+        }
+        case VAL_F64VECTOR: {
+            ObjF64Vector* vector = AS_F64VECTOR(value);
+            printf("#f64(");
+            for (uint32_t i = 0; i < vector->count; i++) {
+                char digits[NUMBER_BUFFER_SIZE];
+                format_number(digits, vector->items[i]);
+                printf(i > 0 ? " %s" : "%s", digits);
+            }
+            printf(")");
+            break;
+        }
+        case VAL_U8VECTOR: {
+            ObjU8Vector* vector = AS_U8VECTOR(value);
+            printf("#u8(");
+            for (uint32_t i = 0; i < vector->count; i++) {
+                printf(i > 0 ? " %u" : "%u", vector->items[i]);
+            }
+            printf(")");
+            break;
+        }
+        case VAL_STRING_PORT:
+            printf("<string-port>");
+            break;
+        case VAL_SYMBOL:
+            fwrite(AS_SYMBOL(value)->name, 1, AS_SYMBOL(value)->length, stdout);
+            break;
+        case VAL_HASH_TABLE:
+            printf("<hash-table %u>", AS_HASH_TABLE(value)->count);
+            break;
+        case VAL_CONTINUATION:
+            printf("<continuation>");
+            break;
+        case VAL_GENERATOR:
+            printf("<generator>");
+            break;
+        case VAL_THREAD:
+            printf("<thread>");
+            break;
+        case VAL_CHANNEL:
+            printf("<channel>");
+            break;
+        default:
+            break;
     }
 }
 
+
+// Same rendering as print_value, but into a VM output buffer
+void write_value(OutputBuffer* out, Value value) {
+    switch (value.type) {
+        case VAL_NUMBER:
+            output_number(out, AS_NUMBER(value));
+            break;
+        case VAL_STRING:
+            write_string(out, AS_STRING(value));
+            break;
+        case VAL_BOOL:
+            output_string(out, AS_BOOL(value) ? "#t" : "#f", 2);
+            break;
+        case VAL_PAIR:{
+            output_char(out, '(');
+            write_value(out, AS_PAIR(value)->car);
+
+            Value current = AS_PAIR(value)->cdr;
+            while(IS_PAIR(current)){
+                output_char(out, ' ');
+                write_value(out, AS_PAIR(current)->car);
+                current = AS_PAIR(current)->cdr;
+            }
+
+            if(!IS_NIL(current)){
+                output_string(out, " . ", 3);
+                write_value(out, current);
+            }
+
+            output_char(out, ')');
+            break;
+        }
+
+        case VAL_NIL:
+            output_string(out, "()", 2);
+            break;
+        case VAL_FUNCTION:
+        case VAL_CLOSURE: {
+            ObjFunction* function = IS_FUNCTION(value) ? AS_FUNCTION(value) : AS_CLOSURE(value)->function;
+            output_string(out, "<fn ", 4);
+            output_cstring(out, function->name ? function->name : "lambda");
+            output_char(out, '>');
+            break;
+        }
+        case VAL_NATIVE:
+            output_string(out, "<native ", 8);
+            output_cstring(out, AS_NATIVE(value)->name);
+            output_char(out, '>');
+            break;
+        case VAL_VECTOR: {
+            ObjVector* vector = AS_VECTOR(value);
+            output_string(out, "#(", 2);
+            for (uint32_t i = 0; i < vector->count; i++) {
+                if (i > 0) output_char(out, ' ');
+                write_value(out, vector->items[i]);
+            }
+            output_char(out, ')');
+            break;
+        }
+        case VAL_F64VECTOR: {
+            ObjF64Vector* vector = AS_F64VECTOR(value);
+            output_string(out, "#f64(", 5);
+            for (uint32_t i = 0; i < vector->count; i++) {
+                if (i > 0) output_char(out, ' ');
+                output_number(out, vector->items[i]);
+            }
+            output_char(out, ')');
+            break;
+        }
+        case VAL_U8VECTOR: {
+            ObjU8Vector* vector = AS_U8VECTOR(value);
+            output_string(out, "#u8(", 4);
+            for (uint32_t i = 0; i < vector->count; i++) {
+                if (i > 0) output_char(out, ' ');
+                output_number(out, vector->items[i]);
+            }
+            output_char(out, ')');
+            break;
+        }
+        case VAL_STRING_PORT:
+            output_cstring(out, "<string-port>");
+            break;
+        case VAL_SYMBOL:
+            output_string(out, AS_SYMBOL(value)->name, AS_SYMBOL(value)->length);
+            break;
+        case VAL_HASH_TABLE:
+            output_string(out, "<hash-table ", 12);
+            output_integer(out, AS_HASH_TABLE(value)->count);
+            output_char(out, '>');
+            break;
+        case VAL_CONTINUATION:
+            output_cstring(out, "<continuation>");
+            break;
+        case VAL_GENERATOR:
+            output_cstring(out, "<generator>");
+            break;
+        case VAL_THREAD:
+            output_cstring(out, "<thread>");
+            break;
+        case VAL_CHANNEL:
+            output_cstring(out, "<channel>");
+            break;
+        default:
+            break;
+    }
+}
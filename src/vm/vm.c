@@ -2,6 +2,10 @@
 #include "instruction.h"
 #include "value.h"
 #include "vm/debug.h"
+#include "vm/builtins.h"
+#include "vm/rope.h"
+#include "vm/control.h"
+#include "vm/scheduler.h"
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -9,42 +13,61 @@
 #include <string.h>
 
 // Runtime error reporting
-static void runtime_error(VM* vm, const char* format, ...) {
+void runtime_error(VM* vm, const char* format, ...) {
     va_list args;
     va_start(args, format);
-    
-    fprintf(stderr, "Runtime error at instruction %d: ", vm->ip);
-    vfprintf(stderr, format, args);
-    fprintf(stderr, "\n");
-    
+    vsnprintf(vm->error_message, sizeof(vm->error_message), format, args);
     va_end(args);
+
+    // Keep program output ordered before the diagnostic
+    flush_output(&vm->out);
+
+    if (vm->error_jump) {
+        longjmp(*vm->error_jump, 1);
+    }
+
+    fprintf(stderr, "Runtime error at instruction %d: %s\n", vm->ip, vm->error_message);
+    exit(1);
 }
 
 void init_vm(VM* vm) {
+    init_threads(vm);
     vm->stack_top = 0;
+    vm->frame_count = 0;
     vm->ip = 0;
     vm->code = NULL;
     vm->trace_execution = false;  // Tracing disabled by default
     vm->open_upvalues = NULL;
     init_table(&vm->globals);
+    memset(vm->call_cache, 0, sizeof(vm->call_cache));
+    vm->program_epoch = 0;
+    init_output(&vm->out, stdout);
+    vm->in = stdin;
+    init_arena(&vm->heap);
+    vm->run_level = NULL;
+    vm->run_level_count = 0;
+    vm->native_calls = 0;
+    vm->error_jump = NULL;
+    vm->error_message[0] = '\0';
+    register_builtins(vm);
 }
 
 void free_vm(VM* vm) {
     free_table(&vm->globals);
+    free_output(&vm->out);
+    free_arena(&vm->heap);
 }
 
 void push(VM* vm, Value v) {
     if (vm->stack_top >= STACK_MAX) {
-        fprintf(stderr, "Stack overflow!\n");
-        exit(1);
+        runtime_error(vm, "Stack overflow!");
     }
     vm->stack[vm->stack_top++] = v;
 }
 
 Value pop(VM* vm) {
     if (vm->stack_top <= 0) {
-        fprintf(stderr, "Stack underflow!\n");
-        exit(1);
+        runtime_error(vm, "Stack underflow!");
     }
     return vm->stack[--vm->stack_top];
 }
@@ -60,20 +83,141 @@ static Value pop_number(VM* vm) {
         runtime_error(vm, "Type error: Expected number, got %s", 
                      IS_STRING(v) ? "string" : 
                      IS_BOOL(v) ? "boolean" : "other");
-        exit(1);
     }
     return v;
 }
 
+// Checks the top two values, the operands of a binary numeric opcode
+static void check_numbers(VM* vm) {
+    if (vm->stack_top < 2) {
+        runtime_error(vm, "Stack underflow!");
+    }
+    for (int32_t distance = 0; distance < 2; distance++) {
+        Value v = peek_stack(vm, distance);
+        if (!IS_NUMBER(v)) {
+            runtime_error(vm, "Type error: Expected number, got %s",
+                         IS_STRING(v) ? "string" :
+                         IS_BOOL(v) ? "boolean" : "other");
+        }
+    }
+}
+
 static Value pop_any(VM* vm) {
     return pop(vm);
 }
 
 
-static ObjClosure* new_closure(ObjFunction* function){
-    ObjClosure* closure = malloc(sizeof(ObjClosure));
+Value make_pair(VM* vm, Value car, Value cdr) {
+    ObjPair* pair = ARENA_NEW(&vm->heap, ObjPair);
+    pair->car = car;
+    pair->cdr = cdr;
+    return PAIR_VAL(pair);
+}
+
+
+Value make_string(VM* vm, const char* chars, size_t length) {
+    if (length > UINT32_MAX) {
+        runtime_error(vm, "String is too long");
+    }
+    ObjString* string = arena_alloc(&vm->heap, sizeof(ObjString) + length + 1);
+    string->length = (uint32_t)length;
+    string->depth = 0;
+    string->chars = (char*)(string + 1);
+    string->left = NULL;
+    string->right = NULL;
+    memcpy(string->chars, chars, length);
+    string->chars[length] = '\0';
+    return STRING_VAL(string);
+}
+
+
+Value make_vector(VM* vm, uint32_t count, Value fill) {
+    ObjVector* vector = arena_alloc(&vm->heap, sizeof(ObjVector) + sizeof(Value) * count);
+    vector->count = count;
+    for (uint32_t i = 0; i < count; i++) {
+        vector->items[i] = fill;
+    }
+    return VECTOR_VAL(vector);
+}
+
+
+// Elements are left uninitialized; callers fill them
+Value make_f64vector(VM* vm, uint32_t count) {
+    ObjF64Vector* vector = arena_alloc(&vm->heap, sizeof(ObjF64Vector) + sizeof(double) * count);
+    vector->count = count;
+    return F64VECTOR_VAL(vector);
+}
+
+
+Value make_u8vector(VM* vm, uint32_t count) {
+    ObjU8Vector* vector = arena_alloc(&vm->heap, sizeof(ObjU8Vector) + count);
+    vector->count = count;
+    return U8VECTOR_VAL(vector);
+}
+
+
+bool is_eqv(VM* vm, Value a, Value b) {
+    if (a.type != b.type) return false;
+
+    switch (a.type) {
+        case VAL_NUMBER:   return AS_NUMBER(a) == AS_NUMBER(b);
+        case VAL_BOOL:     return AS_BOOL(a) == AS_BOOL(b);
+        case VAL_NIL:      return true;
+        case VAL_STRING:   return string_equal(vm, AS_STRING(a), AS_STRING(b));
+        case VAL_PAIR:     return AS_PAIR(a) == AS_PAIR(b);
+        case VAL_FUNCTION: return AS_FUNCTION(a) == AS_FUNCTION(b);
+        case VAL_CLOSURE:  return AS_CLOSURE(a) == AS_CLOSURE(b);
+        case VAL_NATIVE:   return AS_NATIVE(a) == AS_NATIVE(b);
+        case VAL_VECTOR:   return AS_VECTOR(a) == AS_VECTOR(b);
+        case VAL_F64VECTOR: return AS_F64VECTOR(a) == AS_F64VECTOR(b);
+        case VAL_U8VECTOR: return AS_U8VECTOR(a) == AS_U8VECTOR(b);
+        case VAL_STRING_PORT: return AS_STRING_PORT(a) == AS_STRING_PORT(b);
+        case VAL_SYMBOL:   return AS_SYMBOL(a) == AS_SYMBOL(b);
+        case VAL_HASH_TABLE: return AS_HASH_TABLE(a) == AS_HASH_TABLE(b);
+        case VAL_CONTINUATION: return AS_CONTINUATION(a) == AS_CONTINUATION(b);
+        case VAL_GENERATOR: return AS_GENERATOR(a) == AS_GENERATOR(b);
+        case VAL_THREAD:   return AS_THREAD(a) == AS_THREAD(b);
+        case VAL_CHANNEL:  return AS_CHANNEL(a) == AS_CHANNEL(b);
+        default:           return false;
+    }
+}
+
+
+uint32_t vector_index(VM* vm, uint32_t count, Value index) {
+    if (!IS_NUMBER(index)) {
+        runtime_error(vm, "Type error: Vector index must be a number");
+    }
+    double i = AS_NUMBER(index);
+    if (i < 0 || i >= count || i != (double)(uint32_t)i) {
+        runtime_error(vm, "Vector index %g out of range [0, %u)", i, count);
+    }
+    return (uint32_t)i;
+}
+
+
+static ObjVector* pop_vector(VM* vm) {
+    Value v = pop(vm);
+    if (!IS_VECTOR(v)) {
+        runtime_error(vm, "Type error: Expected vector");
+    }
+    return AS_VECTOR(v);
+}
+
+
+void define_native(VM* vm, const char* name, int32_t arity, NativeFn function) {
+    ObjNative* native = ARENA_NEW(&vm->heap, ObjNative);
+    native->function = function;
+    native->name = arena_strndup(&vm->heap, name, strlen(name));
+    native->arity = arity;
+    native->control = false;
+    table_set(&vm->globals, name, NATIVE_VAL(native));
+}
+
+
+static ObjClosure* new_closure(VM* vm, ObjFunction* function){
+    ObjClosure* closure = ARENA_NEW(&vm->heap, ObjClosure);
     closure->function = function;
-    closure->upvalues = malloc(sizeof(ObjUpvalue*) * function->upvalue_count);
+    closure->upvalues = arena_alloc(&vm->heap, sizeof(ObjUpvalue*) * function->upvalue_count);
     closure->upvalue_count = function->upvalue_count;
     return closure;
 }
@@ -91,7 +235,7 @@ static ObjUpvalue* capture_upvalue(VM* vm, Value* local) {
         return upvalue;
     }
 
-    ObjUpvalue* created_upvalue = malloc(sizeof(ObjUpvalue));
+    ObjUpvalue* created_upvalue = ARENA_NEW(&vm->heap, ObjUpvalue);
     created_upvalue->location = local;
     created_upvalue->closed = NIL_VAL;
     created_upvalue->next = upvalue;
@@ -105,7 +249,7 @@ static ObjUpvalue* capture_upvalue(VM* vm, Value* local) {
     return created_upvalue;
 }
 
-static void close_upvalues(VM* vm, Value* last) {
+void close_upvalues(VM* vm, Value* last) {
     while (vm->open_upvalues != NULL && vm->open_upvalues->location >= last) {
         ObjUpvalue* upvalue = vm->open_upvalues;
         upvalue->closed = *upvalue->location;
@@ -115,15 +259,126 @@ static void close_upvalues(VM* vm, Value* last) {
 }
 
 
-void vm_execute(VM* vm, Bytecode* bc) {
-    vm->code = bc;
+// Natives run in place on their stack slice; closures get a new frame and
+// their body runs when the interpreter loop continues
+static void call_native(VM* vm, ObjNative* native, int32_t arg_count) {
+    Value* args = &vm->stack[vm->stack_top - arg_count];
+    if (native->control) {
+        native->function(vm, arg_count, args);
+        return;
+    }
+
+    vm->native_calls++;
+    Value result = native->function(vm, arg_count, args);
+    vm->native_calls--;
+    vm->stack_top -= arg_count + 1;
+    push(vm, result);
+}
+
+
+// The arguments are already on the stack, above the closure
+static void call_closure(VM* vm, ObjClosure* closure, int32_t arg_count) {
+    if (vm->frame_count == FRAMES_MAX){
+        runtime_error(vm, "Stack Overflow");
+    }
+
+    CallFrame* frame = &vm->frames[vm->frame_count++];
+    frame->closure = closure;
+    frame->parent_code = vm->code;  // Save parent bytecode
+    frame->ip = vm->ip;  // Store instruction index in parent bytecode
+    frame->slots = &vm->stack[vm->stack_top - arg_count];
+
+    vm->code = closure->function->chunk;
     vm->ip = 0;
+}
+
+
+// Name constants are heap allocated, so the low bits of their addresses are
+// always zero
+#define CALL_CACHE_INDEX(name) (((uintptr_t)(name) >> 4) & (CALL_CACHE_SIZE - 1))
+
+
+// OP_CALL_GLOBAL pushes no callee before the arguments. Sliding them up to
+// make room for it gives the frame the layout OP_CALL's has.
+static inline void insert_callee(VM* vm, Value callee, int32_t arg_count) {
+    push(vm, NIL_VAL);
+    Value* args = &vm->stack[vm->stack_top - 1 - arg_count];
+    for (int32_t i = arg_count; i > 0; i--) {
+        args[i] = args[i - 1];
+    }
+    args[0] = callee;
+}
+
+
+void call_value(VM* vm, Value callee, int32_t arg_count) {
+    if (IS_CONTINUATION(callee)) {
+        invoke_continuation(vm, AS_CONTINUATION(callee), arg_count);
+        return;
+    }
+
+    if (IS_GENERATOR(callee)) {
+        resume_generator(vm, AS_GENERATOR(callee), arg_count);
+        return;
+    }
+
+    if (IS_NATIVE(callee)) {
+        ObjNative* native = AS_NATIVE(callee);
+        if (native->arity >= 0 && arg_count != native->arity) {
+            runtime_error(vm, "%s: expected %d arguments but got %d", native->name, native->arity, arg_count);
+        }
+        call_native(vm, native, arg_count);
+        return;
+    }
+
+    if (!IS_CLOSURE(callee)) {
+        runtime_error(vm, "Attempted to call a non-function value");
+    }
+
+    ObjClosure* closure = AS_CLOSURE(callee);
+
+    if(arg_count != closure->function->arity) {
+        runtime_error(vm, "Expected %d arguments but got %d", closure->function->arity, arg_count);
+    }
+
+    call_closure(vm, closure, arg_count);
+}
+
+
+// Quickening: a generic instruction that has run once rewrites its opcode to
+// a variant specialized for what it saw, and the variant rewrites it back
+// when its guard fails. Bytecode may be shared by VMs on several threads,
+// so opcodes are loaded and stored atomically; every variant behaves like
+// the generic instruction, so any interleaving of rewrites is correct.
+static inline uint8_t load_opcode(const Bytecode* bc, uint32_t index) {
+    return __atomic_load_n(&bc->instructions[index].opcode, __ATOMIC_RELAXED);
+}
+
+static inline void quicken(const Bytecode* bc, uint32_t index, Opcode opcode) {
+    __atomic_store_n(&bc->instructions[index].opcode, (uint8_t)opcode, __ATOMIC_RELAXED);
+}
+
 
-    bc = vm->code;
+static void run(VM* vm, int32_t exit_depth) {
+    const Bytecode* bc = vm->code;
+
+    // Kept in a local, which is cheaper to count down than a VM field. A
+    // thread that starts running mid-turn gets what is left of the turn.
+    int32_t ticks = vm->thread_budget;
     
     while (vm->ip < bc->count) {
+        // The running thread's turn is over when its budget is spent
+        if (--ticks <= 0) {
+            ticks = vm->thread_budget;
+            if (threads_waiting(vm)) {
+                yield_thread(vm);
+                bc = vm->code;
+                continue;
+            }
+        }
+
         // Trace execution if enabled
         if (vm->trace_execution) {
+            flush_output(&vm->out);
             printf("          ");
             for (int32_t i = 0; i < vm->stack_top; i++) {
                 printf("[ ");
@@ -134,7 +389,9 @@ void vm_execute(VM* vm, Bytecode* bc) {
             disassemble_instruction(bc, vm->ip);
         }
         
-        Instruction instr = bc->instructions[vm->ip++];
+        Instruction instr;
+        instr.opcode = load_opcode(bc, vm->ip);
+        instr.operand = bc->instructions[vm->ip++].operand;
         
         switch (instr.opcode) {
             case OP_CONSTANT:
@@ -142,13 +399,18 @@ void vm_execute(VM* vm, Bytecode* bc) {
                 break;
                 
             case OP_DISPLAY:
-                print_value(pop(vm));
-                printf("\n");
+                write_value(&vm->out, pop(vm));
+                output_char(&vm->out, '\n');
                 push(vm, NIL_VAL);
                 break;
 
             case OP_NEWLINE:
-                printf("\n");
+                output_char(&vm->out, '\n');
+                push(vm, NIL_VAL);
+                break;
+
+            case OP_FLUSH_OUTPUT:
+                flush_output(&vm->out);
                 push(vm, NIL_VAL);
                 break;
 
@@ -156,10 +418,7 @@ void vm_execute(VM* vm, Bytecode* bc) {
                 Value cdr = pop(vm);
                 Value car = pop(vm);
                 
-                ObjPair* pair = malloc(sizeof(ObjPair));
-                pair->car = car;
-                pair->cdr = cdr;
-                push(vm, PAIR_VAL(pair));
+                push(vm, make_pair(vm, car, cdr));
                 break;
             }
 
@@ -169,7 +428,6 @@ void vm_execute(VM* vm, Bytecode* bc) {
                     runtime_error(vm, "Type error: Expected pair, got %s", 
                                  IS_STRING(pair) ? "string" : 
                                  IS_BOOL(pair) ? "boolean" : "other");
-                    exit(1);
                 }
                 push(vm, AS_PAIR(pair)->car);
                 break;
@@ -181,119 +439,190 @@ void vm_execute(VM* vm, Bytecode* bc) {
                     runtime_error(vm, "Type error: Expected pair, got %s", 
                                  IS_STRING(pair) ? "string" : 
                                  IS_BOOL(pair) ? "boolean" : "other");
-                    exit(1);
                 }
                 push(vm, AS_PAIR(pair)->cdr);
                 break;
             }
+
+            case OP_MAKE_VECTOR: {
+                Value fill = instr.operand == 2 ? pop(vm) : NUMBER_VAL(0);
+                double length = AS_NUMBER(pop_number(vm));
+                if (length < 0 || length > UINT32_MAX || length != (double)(uint32_t)length) {
+                    runtime_error(vm, "make-vector: invalid length %g", length);
+                }
+                push(vm, make_vector(vm, (uint32_t)length, fill));
+                break;
+            }
+
+            case OP_VECTOR: {
+                uint32_t count = instr.operand;
+                Value vector = make_vector(vm, count, NIL_VAL);
+                memcpy(AS_VECTOR(vector)->items, &vm->stack[vm->stack_top - count], sizeof(Value) * count);
+                vm->stack_top -= count;
+                push(vm, vector);
+                break;
+            }
+
+            case OP_VECTOR_REF: {
+                Value index = pop(vm);
+                ObjVector* vector = pop_vector(vm);
+                push(vm, vector->items[vector_index(vm, vector->count, index)]);
+                break;
+            }
+
+            case OP_VECTOR_SET: {
+                Value value = pop(vm);
+                Value index = pop(vm);
+                ObjVector* vector = pop_vector(vm);
+                vector->items[vector_index(vm, vector->count, index)] = value;
+                push(vm, NIL_VAL);
+                break;
+            }
+
+            case OP_VECTOR_LENGTH:
+                push(vm, NUMBER_VAL(pop_vector(vm)->count));
+                break;
                 
             case OP_READ: {
+                // Other threads run until the input arrives; the read is
+                // retried when this thread's turn comes round again
+                if (threads_waiting(vm) && !input_ready(vm)) {
+                    vm->ip--;
+                    yield_thread(vm);
+                    bc = vm->code;
+                    break;
+                }
+
+                // Prompts written before the read must be visible
+                flush_output(&vm->out);
                 double num;
-                if (scanf("%lf", &num) == 1) {
+                if (fscanf(vm->in, "%lf", &num) == 1) {
                     push(vm, NUMBER_VAL(num));
                 } else {
                     runtime_error(vm, "Failed to read number from input");
-                    exit(1);
                 }
                 break;
             }
                 
             case OP_READ_LINE: {
+                if (threads_waiting(vm) && !input_ready(vm)) {
+                    vm->ip--;
+                    yield_thread(vm);
+                    bc = vm->code;
+                    break;
+                }
+
+                flush_output(&vm->out);
                 char buffer[1024];
-                if (fgets(buffer, sizeof(buffer), stdin)) {
+                if (fgets(buffer, sizeof(buffer), vm->in)) {
                     // Remove trailing newline if present
                     size_t len = strlen(buffer);
                     if (len > 0 && buffer[len - 1] == '\n') {
                         buffer[len - 1] = '\0';
                     }
-                    // Allocate and store string
-                    char* str = strdup(buffer);
-                    if (!str) {
-                        runtime_error(vm, "Memory allocation failed");
-                        exit(1);
-                    }
-                    push(vm, STRING_VAL(str));
+                    push(vm, make_string(vm, buffer, strlen(buffer)));
                 } else {
                     runtime_error(vm, "Failed to read line from input");
-                    exit(1);
                 }
                 break;
             }
                 
-            case OP_ADD: {
-                Value b = pop_number(vm);
-                Value a = pop_number(vm);
-                push(vm, NUMBER_VAL(AS_NUMBER(a) + AS_NUMBER(b)));
+            // The result replaces the left operand in place. The generic
+            // opcodes check both tags first; the _NUMBER variants are only
+            // emitted for operands the analyzer proved are numbers.
+#define NUMBER_OP(result_val, op) \
+    do { \
+        Value* left = &vm->stack[vm->stack_top - 2]; \
+        *left = result_val(AS_NUMBER(*left) op AS_NUMBER(vm->stack[vm->stack_top - 1])); \
+        vm->stack_top--; \
+    } while (0)
+
+            case OP_ADD:
+                check_numbers(vm);
+                // Fall through
+            case OP_ADD_NUMBER:
+                NUMBER_OP(NUMBER_VAL, +);
                 break;
-            }
 
-            case OP_SUB: {
-                Value b = pop_number(vm);
-                Value a = pop_number(vm);
-                push(vm, NUMBER_VAL(AS_NUMBER(a) - AS_NUMBER(b)));
+            case OP_SUB:
+                check_numbers(vm);
+                // Fall through
+            case OP_SUB_NUMBER:
+                NUMBER_OP(NUMBER_VAL, -);
                 break;
-            }
 
-            case OP_MUL: {
-                Value b = pop_number(vm);
-                Value a = pop_number(vm);
-                push(vm, NUMBER_VAL(AS_NUMBER(a) * AS_NUMBER(b)));
+            case OP_MUL:
+                check_numbers(vm);
+                // Fall through
+            case OP_MUL_NUMBER:
+                NUMBER_OP(NUMBER_VAL, *);
                 break;
-            }
 
-            case OP_DIV: {
-                Value b = pop_number(vm);
-                Value a = pop_number(vm);
-                if (AS_NUMBER(b) == 0) {
-                    runtime_error(vm, "Division by zero");
-                    exit(1);
-                }
-                push(vm, NUMBER_VAL(AS_NUMBER(a) / AS_NUMBER(b)));
+            case OP_EQUAL:
+                check_numbers(vm);
+                // Fall through
+            case OP_EQUAL_NUMBER:
+                NUMBER_OP(BOOL_VAL, ==);
                 break;
-            }
 
-            case OP_LESS: {
-                Value b = pop_number(vm);
-                Value a = pop_number(vm);
-                push(vm, BOOL_VAL(AS_NUMBER(a) < AS_NUMBER(b)));
+            case OP_GREATER:
+                check_numbers(vm);
+                // Fall through
+            case OP_GREATER_NUMBER:
+                NUMBER_OP(BOOL_VAL, >);
                 break;
-            }
 
-            case OP_GREATER: {
-                Value b = pop_number(vm);
-                Value a = pop_number(vm);
-                push(vm, BOOL_VAL(AS_NUMBER(a) > AS_NUMBER(b)));
+            case OP_LESS:
+                check_numbers(vm);
+                // Fall through
+            case OP_LESS_NUMBER:
+                NUMBER_OP(BOOL_VAL, <);
                 break;
-            }
 
-            case OP_EQUAL: {
-                Value b = pop_number(vm);
-                Value a = pop_number(vm);
-                push(vm, BOOL_VAL(AS_NUMBER(a) == AS_NUMBER(b)));
+            case OP_NOT_EQUAL:
+                check_numbers(vm);
+                // Fall through
+            case OP_NOT_EQUAL_NUMBER:
+                NUMBER_OP(BOOL_VAL, !=);
                 break;
-            }
 
-            case OP_LESS_EQUAL: {
-                Value b = pop_number(vm);
-                Value a = pop_number(vm);
-                push(vm, BOOL_VAL(AS_NUMBER(a) <= AS_NUMBER(b)));
+            case OP_GREATER_EQUAL:
+                check_numbers(vm);
+                // Fall through
+            case OP_GREATER_EQUAL_NUMBER:
+                NUMBER_OP(BOOL_VAL, >=);
                 break;
-            }
 
-            case OP_GREATER_EQUAL: {
-                Value b = pop_number(vm);
-                Value a = pop_number(vm);
-                push(vm, BOOL_VAL(AS_NUMBER(a) >= AS_NUMBER(b)));
+            case OP_LESS_EQUAL:
+                check_numbers(vm);
+                // Fall through
+            case OP_LESS_EQUAL_NUMBER:
+                NUMBER_OP(BOOL_VAL, <=);
+                break;
+
+            case OP_DIV:
+                check_numbers(vm);
+                // Fall through
+            case OP_DIV_NUMBER:
+                if (AS_NUMBER(vm->stack[vm->stack_top - 1]) == 0) {
+                    runtime_error(vm, "Division by zero");
+                }
+                NUMBER_OP(NUMBER_VAL, /);
                 break;
-            }
 
-            case OP_NOT_EQUAL: {
-                Value b = pop_number(vm);
-                Value a = pop_number(vm);
-                push(vm, BOOL_VAL(AS_NUMBER(a) != AS_NUMBER(b)));
+#undef NUMBER_OP
+
+            case OP_EQV: {
+                Value b = pop_any(vm);
+                Value a = pop_any(vm);
+                push(vm, BOOL_VAL(is_eqv(vm, a, b)));
                 break;
             }
 
+            case OP_EQV_CONSTANT:
+                push(vm, BOOL_VAL(is_eqv(vm, peek_stack(vm, 0), bc->constants[instr.operand])));
+                break;
+
             case OP_JUMP_IF_FALSE: {
                 Value condition = pop_any(vm);
                 if (IS_BOOL(condition) && !AS_BOOL(condition)) {
@@ -307,6 +636,14 @@ void vm_execute(VM* vm, Bytecode* bc) {
                 break;
 
             case OP_HALT:
+                // The program ends once no other thread can run
+                if (threads_waiting(vm)) {
+                    vm->ip--;
+                    yield_thread(vm);
+                    bc = vm->code;
+                    break;
+                }
+                flush_output(&vm->out);
                 return;
 
             case OP_POP:
@@ -338,10 +675,9 @@ void vm_execute(VM* vm, Bytecode* bc) {
                 
                 if (!IS_STRING(name_val)) {
                     runtime_error(vm, "Fatal: Variable name is not a string");
-                    exit(1);
                 }
                 
-                char* name = AS_STRING(name_val);
+                const char* name = AS_CSTRING(name_val);
                 Value value = pop_any(vm);
                 table_set(&vm->globals, name, value);
                 push(vm, NIL_VAL);
@@ -353,14 +689,12 @@ void vm_execute(VM* vm, Bytecode* bc) {
                 
                 if (!IS_STRING(name_val)) {
                     runtime_error(vm, "Fatal: Variable name is not a string");
-                    exit(1);
                 }
                 
-                char* name = AS_STRING(name_val);
+                const char* name = AS_CSTRING(name_val);
                 Value value;
                 if (!table_get(&vm->globals, name, &value)) {
                     runtime_error(vm, "Undefined variable '%s'", name);
-                    exit(1);
                 }
                 push(vm, value);
                 break;
@@ -371,16 +705,14 @@ void vm_execute(VM* vm, Bytecode* bc) {
                 
                 if (!IS_STRING(name_val)) {
                     runtime_error(vm, "Fatal: Variable name is not a string");
-                    exit(1);
                 }
                 
-                char* name = AS_STRING(name_val);
+                const char* name = AS_CSTRING(name_val);
                 Value value = pop_any(vm);
                 
                 Value dummy;
                 if (!table_get(&vm->globals, name, &dummy)) {
                     runtime_error(vm, "Undefined variable '%s'", name);
-                    exit(1);
                 }
                 
                 table_set(&vm->globals, name, value);
@@ -392,7 +724,7 @@ void vm_execute(VM* vm, Bytecode* bc) {
                 Value function_val = bc->constants[instr.operand];
                 ObjFunction* function = AS_FUNCTION(function_val);
 
-                ObjClosure* closure = new_closure(function);
+                ObjClosure* closure = new_closure(vm, function);
                 push(vm, CLOSURE_VAL(closure));
 
                 for (int i = 0; i < closure->upvalue_count; i++) {
@@ -412,36 +744,89 @@ void vm_execute(VM* vm, Bytecode* bc) {
             }
 
             case OP_CALL: {
-                int arg_count = instr.operand;
+                int32_t arg_count = instr.operand;
+                uint32_t call_ip = vm->ip - 1;
+                Value callee = peek_stack(vm, arg_count);
+                call_value(vm, callee, arg_count);
+
+                // The call was valid, so specialize it on the callee's type
+                if (IS_CLOSURE(callee)) {
+                    quicken(bc, call_ip, OP_CALL_CLOSURE);
+                } else if (IS_NATIVE(callee)) {
+                    quicken(bc, call_ip, OP_CALL_NATIVE);
+                }
+                bc = vm->code; // Update local bytecode pointer
+                break;
+            }
 
-                Value func_val = peek_stack(vm, arg_count);
+            case OP_CALL_CLOSURE: {
+                int32_t arg_count = instr.operand;
+                Value callee = peek_stack(vm, arg_count);
 
-                if (!IS_CLOSURE(func_val)) {
-                    runtime_error(vm, "Attempted to call a non-function value");
-                    exit(1);
+                if (IS_CLOSURE(callee) && AS_CLOSURE(callee)->function->arity == arg_count) {
+                    call_closure(vm, AS_CLOSURE(callee), arg_count);
+                } else {
+                    quicken(bc, vm->ip - 1, OP_CALL);
+                    call_value(vm, callee, arg_count);
                 }
+                bc = vm->code;
+                break;
+            }
 
-                ObjClosure* closure = AS_CLOSURE(func_val);
-
-                if(arg_count != closure->function->arity) {
-                    runtime_error(vm, "Expected %d arguments but got %d", closure->function->arity, arg_count);
-                    exit(1);
+            case OP_CALL_GLOBAL: {
+                ObjString* name = AS_STRING(bc->constants[instr.operand]);
+                int32_t arg_count = bc->instructions[vm->ip++].operand;
+                CallCacheEntry* entry = &vm->call_cache[CALL_CACHE_INDEX(name)];
+
+                // A hit was checked when it was cached: call it as it is
+                if (entry->name == name && entry->epoch == vm->program_epoch &&
+                    entry->arg_count == arg_count &&
+                    vm->globals.entries[entry->slot].version == entry->version) {
+                    insert_callee(vm, entry->callee, arg_count);
+                    if (IS_CLOSURE(entry->callee)) {
+                        call_closure(vm, AS_CLOSURE(entry->callee), arg_count);
+                    } else {
+                        call_native(vm, AS_NATIVE(entry->callee), arg_count);
+                    }
+                    bc = vm->code;
+                    break;
                 }
 
-                if (vm->frame_count == FRAMES_MAX){
-                    runtime_error(vm, "Stack Overflow");
-                    exit(1);
+                int32_t slot = table_find(&vm->globals, name->chars);
+                if (slot < 0) {
+                    runtime_error(vm, "Undefined variable '%s'", name->chars);
                 }
+                Value callee = vm->globals.entries[slot].value;
+                uint32_t version = vm->globals.entries[slot].version;
+                insert_callee(vm, callee, arg_count);
+                call_value(vm, callee, arg_count);
+
+                // The call was valid. A native has already run by now; if it
+                // changed the global, the entry is stale from the start.
+                if (IS_CLOSURE(callee) || IS_NATIVE(callee)) {
+                    entry->name = name;
+                    entry->callee = callee;
+                    entry->arg_count = arg_count;
+                    entry->slot = slot;
+                    entry->version = version;
+                    entry->epoch = vm->program_epoch;
+                }
+                bc = vm->code;
+                break;
+            }
 
-                CallFrame* frame = &vm->frames[vm->frame_count++];
-                frame->closure = closure;
-                frame->parent_code = vm->code;  // Save parent bytecode
-                frame->ip = vm->ip;  // Store instruction index in parent bytecode
-                frame->slots = &vm->stack[vm->stack_top - arg_count];
+            case OP_CALL_NATIVE: {
+                int32_t arg_count = instr.operand;
+                Value callee = peek_stack(vm, arg_count);
 
-                vm->code = closure->function->chunk;
-                vm->ip = 0;
-                bc = vm->code; // Update local bytecode pointer
+                if (IS_NATIVE(callee) && (AS_NATIVE(callee)->arity < 0 ||
+                                          AS_NATIVE(callee)->arity == arg_count)) {
+                    call_native(vm, AS_NATIVE(callee), arg_count);
+                } else {
+                    quicken(bc, vm->ip - 1, OP_CALL);
+                    call_value(vm, callee, arg_count);
+                }
+                bc = vm->code;
                 break;
             }
 
@@ -450,10 +835,6 @@ void vm_execute(VM* vm, Bytecode* bc) {
 
                 CallFrame* frame = &vm->frames[vm->frame_count - 1];
                 vm->frame_count--;
-                
-                if (vm->frame_count == 0){
-                    return;
-                }
 
                 vm->code = frame->parent_code;  // Restore parent bytecode
                 
@@ -467,6 +848,11 @@ void vm_execute(VM* vm, Bytecode* bc) {
                 push(vm, result);
                 close_upvalues(vm, frame->slots);
                 bc = vm->code; // Update local bytecode pointer
+
+                // Back in the C caller of vm_call
+                if (vm->frame_count == exit_depth) {
+                    return;
+                }
                 break;
             }
 
@@ -505,10 +891,115 @@ void vm_execute(VM* vm, Bytecode* bc) {
                 push(vm, NIL_VAL);
                 break;
             }
+
+            case OP_GENERATOR_RETURN:
+                finish_generator(vm);
+                bc = vm->code;
+                break;
+
+            case OP_THREAD_EXIT:
+                finish_thread(vm);
+                bc = vm->code;
+                break;
+
+            case OP_GET_CALLEE: {
+                ObjClosure* closure = vm->frames[vm->frame_count - 1].closure;
+                push(vm, CLOSURE_VAL(closure));
+                break;
+            }
                 
             default:
-                fprintf(stderr, "Unknown opcode: %d\n", instr.opcode);
-                exit(1);
+                runtime_error(vm, "Unknown opcode: %d", instr.opcode);
         }
     }
+
+    flush_output(&vm->out);
+}
+
+
+static void run_level(VM* vm, int32_t exit_depth, int32_t frame_base, int32_t stack_base) {
+    RunLevel level;
+    level.outer = vm->run_level;
+    level.id = ++vm->run_level_count;
+    level.exit_depth = exit_depth;
+    level.frame_base = frame_base;
+    level.stack_base = stack_base;
+    level.native_calls = vm->native_calls;
+    level.error_jump = vm->error_jump;
+    vm->run_level = &level;
+
+    // A continuation of this level invoked from a deeper one jumps back here
+    // after restoring the VM, and the loop carries on from where it left it
+    setjmp(level.jump);
+    run(vm, exit_depth);
+
+    vm->run_level = level.outer;
+}
+
+
+void vm_execute(VM* vm, const Bytecode* bc) {
+    // The constants call_cache is keyed by may have been freed with an
+    // earlier program, and their addresses reused
+    vm->program_epoch++;
+    vm->code = bc;
+    vm->ip = 0;
+    run_level(vm, -1, vm->frame_count, vm->stack_top);
+}
+
+
+Value vm_call(VM* vm, Value callee, int32_t arg_count, const Value* args) {
+    const Bytecode* code = vm->code;
+    uint32_t ip = vm->ip;
+    int32_t depth = vm->frame_count;
+    int32_t stack_base = vm->stack_top;
+
+    push(vm, callee);
+    for (int32_t i = 0; i < arg_count; i++) {
+        push(vm, args[i]);
+    }
+
+    call_value(vm, callee, arg_count);
+    if (vm->frame_count > depth) {
+        run_level(vm, depth, depth, stack_base);
+    }
+
+    vm->code = code;
+    vm->ip = ip;
+    return pop(vm);
+}
+
+
+bool vm_protect(VM* vm, void (*body)(VM* vm, void* data), void* data) {
+    const Bytecode* code = vm->code;
+    uint32_t ip = vm->ip;
+    int32_t stack_top = vm->stack_top;
+    int32_t frame_count = vm->frame_count;
+    RunLevel* level = vm->run_level;
+    int32_t native_calls = vm->native_calls;
+    ObjThread* thread = vm->thread;
+    jmp_buf* enclosing = vm->error_jump;
+    jmp_buf jump;
+
+    vm->error_jump = &jump;
+    if (setjmp(jump) != 0) {
+        recover_thread(vm, thread);
+
+        // Closures that escaped the failed call keep their captured values
+        close_upvalues(vm, &vm->stack[stack_top]);
+        vm->stack_top = stack_top;
+        vm->frame_count = frame_count;
+        vm->run_level = level;
+        vm->native_calls = native_calls;
+        vm->code = code;
+        vm->ip = ip;
+        vm->error_jump = enclosing;
+        return false;
+    }
+
+    body(vm, data);
+
+    vm->code = code;
+    vm->ip = ip;
+    vm->error_jump = enclosing;
+    return true;
 }
@@ -0,0 +1,57 @@
+// Builtins as first-class native procedures: passed to and called by
+// other procedures, stored in data, and applied to argument lists
+
+#include "test.h"
+
+static void test_values(SchemeVM* vm) {
+    EXPECT_TRUE(vm, "(procedure? car)");
+    EXPECT_TRUE(vm, "(procedure? +)");
+    EXPECT_TRUE(vm, "(let ((f car)) (= (f '(7 8)) 7))");
+    EXPECT_TRUE(vm, "(define plus +) (= (plus 1 2 3) 6)");
+    EXPECT_TRUE(vm, "(= ((car (list * +)) 3 4) 12)");
+    EXPECT_TRUE(vm, "(eq? car car)");
+}
+
+static void test_map(SchemeVM* vm) {
+    EXPECT_TRUE(vm, "(equal? (map car '((1 2) (3 4))) '(1 3))");
+    EXPECT_TRUE(vm, "(equal? (map + '(1 2 3) '(10 20 30)) '(11 22 33))");
+    EXPECT_TRUE(vm, "(equal? (map (lambda (x) (* x x)) '(1 2 3)) '(1 4 9))");
+    EXPECT_TRUE(vm, "(equal? (map cons '(1 2) '(a b)) '((1 . a) (2 . b)))");
+    EXPECT_TRUE(vm, "(equal? (filter odd? '(1 2 3 4 5)) '(1 3 5))");
+    EXPECT_TRUE(vm, "(equal? (filter (lambda (x) (> x 2)) '(1 2 3 4)) '(3 4))");
+    EXPECT_NUMBER(vm, "(reduce + 0 '(1 2 3 4))", 10);
+    EXPECT_NUMBER(vm, "(reduce max 0 '(3 9 2))", 9);
+
+    // A closure that calls a native that calls a closure
+    EXPECT_TRUE(vm, "(define (twice f) (lambda (x) (f (f x))))"
+                    "(equal? (map (twice (lambda (x) (+ x 1))) '(1 2)) '(3 4))");
+    EXPECT_TRUE(vm, "(equal? (map (lambda (l) (map - l)) '((1 2) (3))) '((-1 -2) (-3)))");
+}
+
+static void test_apply(SchemeVM* vm) {
+    EXPECT_NUMBER(vm, "(apply + '(1 2 3))", 6);
+    EXPECT_NUMBER(vm, "(apply + 1 2 '(3 4))", 10);
+    EXPECT_NUMBER(vm, "(apply max '(4 8 2))", 8);
+    EXPECT_NUMBER(vm, "(apply (lambda (a b) (- a b)) '(10 3))", 7);
+    EXPECT_TRUE(vm, "(equal? (apply map list '((1 2) (3 4))) '((1 3) (2 4)))");
+    EXPECT_TRUE(vm, "(equal? (apply apply (list + '(1 2))) 3)");
+}
+
+static void test_errors(SchemeVM* vm) {
+    EXPECT_ERROR(vm, "(map car '(1 2))", "Expected pair");
+    EXPECT_ERROR(vm, "(apply car '(1 2))", "car: expected 1 arguments but got 2");
+    EXPECT_ERROR(vm, "(define f car) (f)", "car: expected 1 arguments but got 0");
+    EXPECT_ERROR(vm, "(map (lambda (x y) x) '(1 2))", "Expected 2 arguments but got 1");
+    EXPECT_ERROR(vm, "(apply 5 '())", "Attempted to call a non-function value");
+    EXPECT_NUMBER(vm, "(apply + '(1 1))", 2);
+}
+
+int main(void) {
+    SchemeVM* vm = scheme_new();
+    test_values(vm);
+    test_map(vm);
+    test_apply(vm);
+    test_errors(vm);
+    scheme_free(vm);
+    return test_summary("builtin_test");
+}
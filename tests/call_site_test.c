@@ -0,0 +1,65 @@
+// Call sites that specialize themselves: an OP_CALL rewrites itself for the
+// first callee it sees and must fall back when a later callee differs
+
+#include "test.h"
+
+static void test_callee_changes(SchemeVM* vm) {
+    scheme_eval(vm,
+        "(define (call1 f x) (f x))"
+        "(define (call2 f x y) (f x y))"
+        "(define (double x) (* x 2))"
+        "(define (square x) (* x x))",
+        NULL);
+
+    // The same site sees a closure, a closure of another function, a native,
+    // and a closure again
+    EXPECT_NUMBER(vm, "(call1 double 5)", 10);
+    EXPECT_NUMBER(vm, "(call1 double 6)", 12);
+    EXPECT_NUMBER(vm, "(call1 square 5)", 25);
+    EXPECT_NUMBER(vm, "(call1 car '(7 8))", 7);
+    EXPECT_NUMBER(vm, "(call1 length '(1 2 3))", 3);
+    EXPECT_NUMBER(vm, "(call1 double 7)", 14);
+    EXPECT_NUMBER(vm, "(call1 (lambda (x) (- x)) 7)", -7);
+
+    // Natives with fixed and variable arity at one site
+    EXPECT_NUMBER(vm, "(call2 + 1 2)", 3);
+    EXPECT_NUMBER(vm, "(call2 max 1 2)", 2);
+    EXPECT_TRUE(vm, "(equal? (call2 cons 1 2) '(1 . 2))");
+    EXPECT_NUMBER(vm, "(call2 (lambda (a b) (- a b)) 1 2)", -1);
+}
+
+// A site specialized on a function still sees each closure's own upvalues
+static void test_closures_of_one_function(SchemeVM* vm) {
+    scheme_eval(vm, "(define (adder n) (lambda (x) (+ x n)))", NULL);
+    EXPECT_NUMBER(vm, "(call1 (adder 1) 10)", 11);
+    EXPECT_NUMBER(vm, "(call1 (adder 100) 10)", 110);
+    EXPECT_NUMBER(vm,
+        "(do ((i 0 (+ i 1)) (sum 0 (+ sum (call1 (adder i) 0)))) ((= i 100) sum))",
+        4950);
+}
+
+// A specialized site must still report a callee that does not fit
+static void test_errors_after_specializing(SchemeVM* vm) {
+    EXPECT_NUMBER(vm, "(call1 double 1)", 2);
+    EXPECT_ERROR(vm, "(call1 5 1)", "Attempted to call a non-function value");
+    EXPECT_ERROR(vm, "(call1 (lambda (a b) a) 1)", "Expected 2 arguments but got 1");
+    EXPECT_NUMBER(vm, "(call1 double 2)", 4);
+
+    EXPECT_NUMBER(vm, "(call1 car '(1))", 1);
+    EXPECT_ERROR(vm, "(call1 cons 1)", "cons: expected 2 arguments but got 1");
+    EXPECT_ERROR(vm, "(call1 \"str\" 1)", "Attempted to call a non-function value");
+    EXPECT_NUMBER(vm, "(call1 car '(3))", 3);
+
+    // A native that fails inside a specialized site
+    EXPECT_ERROR(vm, "(call1 car 5)", "Expected pair");
+    EXPECT_NUMBER(vm, "(call1 square 3)", 9);
+}
+
+int main(void) {
+    SchemeVM* vm = scheme_new();
+    test_callee_changes(vm);
+    test_closures_of_one_function(vm);
+    test_errors_after_specializing(vm);
+    scheme_free(vm);
+    return test_summary("call_site_test");
+}
@@ -0,0 +1,116 @@
+// call/cc and generators, which copy stack segments in and out of the VM
+
+#include "test.h"
+
+static void test_escape(SchemeVM* vm) {
+    EXPECT_NUMBER(vm, "(+ 1 (call/cc (lambda (k) (+ 10 (k 2)))))", 3);
+    EXPECT_NUMBER(vm, "(call-with-current-continuation (lambda (k) 5))", 5);
+
+    // Captured with nothing on the stack below it
+    EXPECT_NUMBER(vm, "(call/cc (lambda (k) (+ 1 (k 42))))", 42);
+
+    // Out of nested calls
+    scheme_eval(vm,
+        "(define (search tree target k)"
+        "  (if (pair? tree)"
+        "      (or (search (car tree) target k) (search (cdr tree) target k))"
+        "      (if (equal? tree target) (k 'found) #f)))", NULL);
+    EXPECT_TRUE(vm, "(equal? (call/cc (lambda (k) (search '(1 (2 (3 4)) 5) 4 k) 'missing)) 'found)");
+    EXPECT_TRUE(vm, "(equal? (call/cc (lambda (k) (search '(1 (2 (3 4)) 5) 9 k) 'missing)) 'missing)");
+
+    // Out of a native's call into Scheme
+    EXPECT_TRUE(vm,
+        "(equal? (call/cc (lambda (k) (map (lambda (x) (if (= x 2) (k 'escaped) x)) '(1 2 3))))"
+        "        'escaped)");
+}
+
+static void test_reentry(SchemeVM* vm) {
+    // Back into a form that has already returned, while its program runs
+    EXPECT_TRUE(vm,
+        "(define k #f)"
+        "(define n 0)"
+        "(define r (+ 100 (call/cc (lambda (c) (set! k c) 0))))"
+        "(set! n (+ n 1))"
+        "(if (< n 3) (k n) #f)"
+        "(equal? (list n r) '(3 102))");
+
+    // Back into a map that has returned: its native call level is gone
+    EXPECT_ERROR(vm,
+        "(define saved #f)"
+        "(define count 0)"
+        "(define result (map (lambda (x) (call/cc (lambda (c) (if (= x 2) (set! saved c) #f) x))) '(1 2 3)))"
+        "(set! count (+ count 1))"
+        "(if (< count 2) (saved 10) result)",
+        "continuation: the code it returns to has finished running");
+
+    // Into a program that has finished
+    scheme_eval(vm, "(define later #f) (+ 1 (call/cc (lambda (c) (set! later c) 1)))", NULL);
+    EXPECT_ERROR(vm, "(later 5)", "continuation: the code it returns to has finished running");
+    EXPECT_ERROR(vm, "(call/cc (lambda (c) (c 1 2)))", "continuation: expected 1 argument but got 2");
+}
+
+static void test_generators(SchemeVM* vm) {
+    scheme_eval(vm,
+        "(define squares (make-generator (lambda (yield)"
+        "  (do ((i 0 (+ i 1))) ((= i 3) 'done) (yield (* i i))))))", NULL);
+    EXPECT_TRUE(vm, "(generator? squares)");
+    EXPECT_NUMBER(vm, "(squares)", 0);
+    EXPECT_NUMBER(vm, "(squares)", 1);
+    EXPECT_NUMBER(vm, "(squares)", 4);
+
+    // Exhausted: every call returns the procedure's result
+    EXPECT_TRUE(vm, "(equal? (squares) 'done)");
+    EXPECT_TRUE(vm, "(equal? (squares) 'done)");
+
+    // (generator value) makes yield return value
+    scheme_eval(vm,
+        "(define total (make-generator (lambda (yield)"
+        "  (let loop ((sum 0)) (loop (+ sum (yield sum)))))))", NULL);
+    EXPECT_NUMBER(vm, "(total)", 0);
+    EXPECT_NUMBER(vm, "(total 5)", 5);
+    EXPECT_NUMBER(vm, "(total 10)", 15);
+    EXPECT_TRUE(vm, "(equal? (list (total 1) (total 2) (total 3)) '(16 18 21))");
+
+    // Yielding from nested Scheme calls inside the generator
+    EXPECT_TRUE(vm,
+        "(define (walk tree yield)"
+        "  (if (pair? tree) (or (walk (car tree) yield) (walk (cdr tree) yield))"
+        "      (if (null? tree) #f (and (yield tree) #f))))"
+        "(define leaves (make-generator (lambda (yield) (walk '(1 (2 3) (4)) yield) 'end)))"
+        "(equal? (list (leaves) (leaves) (leaves) (leaves) (leaves)) '(1 2 3 4 end))");
+
+    EXPECT_ERROR(vm, "(define self #f) (set! self (make-generator (lambda (yield) (self)))) (self)",
+                 "generator: already running");
+    EXPECT_ERROR(vm, "(make-generator (lambda () 1))",
+                 "make-generator: expected a procedure of one argument");
+    EXPECT_ERROR(vm, "(squares 1 2)", "generator: expected 0 or 1 arguments but got 2");
+}
+
+// Natives cannot run control procedures or be suspended
+static void test_native_callers(SchemeVM* vm) {
+    EXPECT_ERROR(vm, "(map call/cc (list (lambda (k) 1)))",
+                 "call/cc: cannot be called by a native procedure");
+    EXPECT_ERROR(vm, "(apply call/cc (list (lambda (k) 1)))",
+                 "call/cc: cannot be called by a native procedure");
+    EXPECT_ERROR(vm,
+        "(define mapped (make-generator (lambda (yield) (map yield '(1 2)))))"
+        "(mapped)",
+        "yield: cannot be called by a native procedure");
+    EXPECT_ERROR(vm,
+        "(define mapped2 (make-generator (lambda (yield) (map (lambda (x) (yield x)) '(1 2)))))"
+        "(mapped2)",
+        "yield: cannot suspend a call made by a native procedure");
+
+    // The VM is still usable
+    EXPECT_NUMBER(vm, "(call/cc (lambda (k) (k 7)))", 7);
+}
+
+int main(void) {
+    SchemeVM* vm = scheme_new();
+    test_escape(vm);
+    test_reentry(vm);
+    test_generators(vm);
+    test_native_callers(vm);
+    scheme_free(vm);
+    return test_summary("control_test");
+}
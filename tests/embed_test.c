@@ -0,0 +1,126 @@
+// The embedding API: results, errors that leave the VM usable, host
+// natives, and compiled programs shared between VMs
+
+#define _POSIX_C_SOURCE 200809L
+#include <unistd.h>
+#include "test.h"
+
+static Value host_double(VM* vm, int32_t arg_count, Value* args) {
+    (void)arg_count;
+    if (!IS_NUMBER(args[0])) runtime_error(vm, "host-double: expected a number");
+    return NUMBER_VAL(AS_NUMBER(args[0]) * 2);
+}
+
+static void test_results(SchemeVM* vm) {
+    EXPECT_NUMBER(vm, "(+ 1 2)", 3);
+    EXPECT_NUMBER(vm, "(define x 10) (define (f y) (* x y)) (f 4)", 40);
+    EXPECT_NUMBER(vm, "(f 5)", 50);
+
+    Value result = NUMBER_VAL(1);
+    CHECK(scheme_eval(vm, "", &result) && IS_NIL(result));
+    CHECK(scheme_eval(vm, "(define unused 1)", NULL));
+}
+
+static void test_runtime_errors(SchemeVM* vm) {
+    EXPECT_ERROR(vm, "(car '())", "Expected pair");
+    EXPECT_ERROR(vm, "(vector-ref (make-vector 2 0) 9)", "out of range");
+
+    // Forms before the error have run
+    scheme_eval(vm, "(define (first p) (car p))", NULL);
+    EXPECT_ERROR(vm, "(define before 1) (first 5) (define after 2)", "Expected pair");
+    EXPECT_NUMBER(vm, "before", 1);
+    Value value;
+    CHECK(!scheme_get_global(vm, "after", &value));
+
+    // From deep inside nested calls and a native's call into Scheme
+    scheme_eval(vm, "(define (dive n) (if (= n 0) (car n) (+ 1 (dive (- n 1)))))", NULL);
+    EXPECT_ERROR(vm, "(dive 30)", "Expected pair");
+    EXPECT_ERROR(vm, "(map (lambda (n) (dive n)) '(1 2))", "Expected pair");
+
+    // Every error unwinds completely, so the stack never fills up
+    for (int i = 0; i < 200; i++) {
+        scheme_eval(vm, "(dive 30)", NULL);
+    }
+    EXPECT_NUMBER(vm, "(define (depth n) (if (= n 0) 0 (+ 1 (depth (- n 1))))) (depth 40)", 40);
+}
+
+static void test_compile_errors(SchemeVM* vm) {
+    // Diagnostics go to scheme_error, never to the host's stderr
+    fflush(stderr);
+    int saved_stderr = dup(STDERR_FILENO);
+    FILE* captured = tmpfile();
+    dup2(fileno(captured), STDERR_FILENO);
+
+    Value result;
+    bool ok = scheme_eval(vm, "(define x (+ 1 2)\n(car", &result);
+    bool undefined = scheme_eval(vm, "(no-such-function 1)", &result);
+    const char* message = scheme_error(vm);
+    bool names_it = strstr(message, "<embedded>:1:") != NULL &&
+                    strstr(message, "Undefined identifier: no-such-function") != NULL;
+
+    fflush(stderr);
+    dup2(saved_stderr, STDERR_FILENO);
+    close(saved_stderr);
+    long written = ftell(captured);
+    fclose(captured);
+
+    CHECK(!ok);
+    CHECK(!undefined);
+    CHECK(names_it);
+    CHECK(written == 0);
+
+    EXPECT_ERROR(vm, "(+ 1", "Expected ')' to close list");
+    EXPECT_NUMBER(vm, "(+ 2 2)", 4);
+}
+
+static void test_calls(SchemeVM* vm) {
+    Value f, result;
+    Value args[2] = {NUMBER_VAL(3), NUMBER_VAL(4)};
+
+    CHECK(scheme_eval(vm, "(define (add a b) (+ a b))", NULL));
+    CHECK(scheme_get_global(vm, "add", &f));
+    CHECK(scheme_call(vm, f, 2, args, &result) && AS_NUMBER(result) == 7);
+
+    CHECK(!scheme_call(vm, f, 1, args, &result));
+    CHECK(strstr(scheme_error(vm), "Expected 2 arguments but got 1") != NULL);
+    CHECK(!scheme_call(vm, NUMBER_VAL(1), 0, NULL, &result));
+    CHECK(!scheme_get_global(vm, "never-defined", &f));
+
+    // Host natives are first-class procedures and may fail like builtins
+    scheme_define_native(vm, "host-double", 1, host_double);
+    EXPECT_NUMBER(vm, "(host-double 21)", 42);
+    EXPECT_TRUE(vm, "(equal? (map host-double '(1 2 3)) '(2 4 6))");
+    EXPECT_ERROR(vm, "(host-double \"a\")", "host-double: expected a number");
+    EXPECT_ERROR(vm, "(host-double 1 2)", "host-double: expected 1 arguments but got 2");
+    CHECK(scheme_get_global(vm, "host-double", &f));
+    CHECK(scheme_call(vm, f, 1, args, &result) && AS_NUMBER(result) == 6);
+}
+
+static void test_programs(SchemeVM* vm) {
+    SchemeProgram* program = scheme_compile(vm, "(* 6 7)", 7);
+    CHECK(program != NULL);
+    if (program) {
+        SchemeVM* other = scheme_new();
+        Value a, b;
+        CHECK(scheme_run(vm, program, &a) && AS_NUMBER(a) == 42);
+        CHECK(scheme_run(other, program, &b) && AS_NUMBER(b) == 42);
+        CHECK(scheme_run(vm, program, &a) && AS_NUMBER(a) == 42);
+        scheme_free(other);
+        scheme_free_program(program);
+    }
+
+    CHECK(scheme_compile(vm, "(car", 4) == NULL);
+    CHECK(!scheme_load_file(vm, "/nonexistent/file.scm"));
+    CHECK(strstr(scheme_error(vm), "Could not open file") != NULL);
+}
+
+int main(void) {
+    SchemeVM* vm = scheme_new();
+    test_results(vm);
+    test_runtime_errors(vm);
+    test_compile_errors(vm);
+    test_calls(vm);
+    test_programs(vm);
+    scheme_free(vm);
+    return test_summary("embed_test");
+}
@@ -0,0 +1,111 @@
+// OP_CALL_GLOBAL and the VM's call cache, which must notice every change to
+// a global between two calls through the same site. Each case runs as one
+// program, so only the change itself, not the start of a new program, can
+// invalidate the cached callee.
+
+#include "test.h"
+
+static Value host_two(VM* vm, int32_t arg_count, Value* args) {
+    (void)vm;
+    (void)arg_count;
+    (void)args;
+    return NUMBER_VAL(2);
+}
+
+static void test_emitted(void) {
+    CHECK(count_opcode("(define (f) 1) (define (g) (f))", OP_CALL_GLOBAL) == 1);
+    CHECK(count_opcode("(define (g f) (f))", OP_CALL_GLOBAL) == 0);
+
+    // The argument count follows as a word of its own kind, not as an
+    // instruction that could be mistaken for a constant load
+    CHECK(count_opcode("(define (f x) x) (define (g) (f (f 1)))", OP_ARG_COUNT) == 2);
+    CHECK(count_opcode("(define (f x) x) (define (g) (f (f 1)))", OP_CONSTANT) ==
+          count_opcode("(define (f x) x) (define (g) 1)", OP_CONSTANT));
+}
+
+static void test_redefine(SchemeVM* vm) {
+    EXPECT_TRUE(vm,
+        "(define (f) 1)"
+        "(define (call-f) (f))"
+        "(define a (call-f))"
+        "(define b (call-f))"
+        "(define (f) 2)"
+        "(equal? (list a b (call-f) (call-f)) '(1 1 2 2))");
+}
+
+static void test_set(SchemeVM* vm) {
+    EXPECT_TRUE(vm,
+        "(define (op x) (+ x 1))"
+        "(define (run) (op 10))"
+        "(define a (run))"
+        "(set! op (lambda (x) (* x 3)))"
+        "(define b (run))"
+        "(set! op -)"
+        "(equal? (list a b (run)) '(11 30 -10))");
+
+    // A native replaced by a closure
+    EXPECT_TRUE(vm,
+        "(define first car)"
+        "(define (head) (first '(5 6)))"
+        "(define a (head))"
+        "(set! first cdr)"
+        "(equal? (list a (head)) '(5 (6)))");
+
+    // Replaced by something that is not a procedure at all
+    EXPECT_ERROR(vm,
+        "(define (target) 1)"
+        "(define (hit) (target))"
+        "(hit)"
+        "(set! target 7)"
+        "(hit)",
+        "Attempted to call a non-function value");
+
+    // set! only assigns existing globals
+    EXPECT_ERROR(vm, "(set! never-defined 1)", "Undefined identifier: never-defined");
+    EXPECT_ERROR(vm, "(define (local y) (set! y 2))", "'set!' of local variable 'y' is not supported");
+}
+
+static void test_arity_change(SchemeVM* vm) {
+    EXPECT_ERROR(vm,
+        "(define (g x) x)"
+        "(define (call-g) (g 1))"
+        "(call-g)"
+        "(define (g) 0)"
+        "(call-g)",
+        "Expected 0 arguments but got 1");
+
+    EXPECT_ERROR(vm,
+        "(define (h x) x)"
+        "(define (call-h) (h 1))"
+        "(call-h)"
+        "(set! h cons)"
+        "(call-h)",
+        "cons: expected 2 arguments but got 1");
+
+    // And back to a matching arity
+    EXPECT_TRUE(vm,
+        "(define (g x) (* x 100))"
+        "(= (call-g) 100)");
+}
+
+// define_native replaces a global while the caller stays cached
+static void test_host_redefine(SchemeVM* vm) {
+    Value call, result;
+    EXPECT_TRUE(vm, "(define (f) 1) (define (call-f) (f)) (= (call-f) 1)");
+    CHECK(scheme_get_global(vm, "call-f", &call));
+    CHECK(scheme_call(vm, call, 0, NULL, &result) && AS_NUMBER(result) == 1);
+
+    scheme_define_native(vm, "f", 0, host_two);
+    CHECK(scheme_call(vm, call, 0, NULL, &result) && AS_NUMBER(result) == 2);
+}
+
+int main(void) {
+    SchemeVM* vm = scheme_new();
+    test_emitted();
+    test_redefine(vm);
+    test_set(vm);
+    test_arity_change(vm);
+    test_host_redefine(vm);
+    scheme_free(vm);
+    return test_summary("global_call_test");
+}
@@ -0,0 +1,107 @@
+// Scheme hash tables: keys of each kind, growth, and deletes that leave
+// tombstones behind
+
+#include "test.h"
+
+static void test_keys(SchemeVM* vm) {
+    scheme_eval(vm,
+        "(define t (make-hash-table))"
+        "(hash-table-set! t 'sym 1)"
+        "(hash-table-set! t \"str\" 2)"
+        "(hash-table-set! t 3 3)"
+        "(define p '(1 2))"
+        "(hash-table-set! t p 4)",
+        NULL);
+    EXPECT_NUMBER(vm, "(hash-table-ref t 'sym)", 1);
+    EXPECT_NUMBER(vm, "(hash-table-ref t (string-append \"s\" \"tr\"))", 2);
+    EXPECT_NUMBER(vm, "(hash-table-ref t (+ 1 2))", 3);
+    EXPECT_NUMBER(vm, "(hash-table-ref t p)", 4);
+
+    // Pairs hash by identity, like eqv?
+    EXPECT_NUMBER(vm, "(hash-table-ref/default t '(1 2) 0)", 0);
+    EXPECT_NUMBER(vm, "(hash-table-count t)", 4);
+
+    // Setting an existing key replaces its value
+    EXPECT_NUMBER(vm, "(hash-table-set! t 'sym 10) (hash-table-ref t 'sym)", 10);
+    EXPECT_NUMBER(vm, "(hash-table-count t)", 4);
+
+    EXPECT_NUMBER(vm, "(hash-table-ref t 'missing (lambda () 99))", 99);
+    EXPECT_ERROR(vm, "(hash-table-ref t 'missing)", "hash-table-ref");
+    EXPECT_ERROR(vm, "(hash-table-set! 5 1 1)", "hash-table-set!");
+    EXPECT_TRUE(vm, "(and (hash-table? t) (not (hash-table? p)))");
+}
+
+static void test_update_and_listing(SchemeVM* vm) {
+    scheme_eval(vm,
+        "(define counts (make-hash-table))"
+        "(define (tally word) (hash-table-update!/default counts word (lambda (n) (+ n 1)) 0))"
+        "(tally 'a) (tally 'b) (tally 'a) (tally 'a)",
+        NULL);
+    EXPECT_NUMBER(vm, "(hash-table-ref counts 'a)", 3);
+    EXPECT_NUMBER(vm, "(hash-table-ref counts 'b)", 1);
+    EXPECT_NUMBER(vm, "(length (hash-table-keys counts))", 2);
+    EXPECT_NUMBER(vm, "(apply + (hash-table-values counts))", 4);
+    EXPECT_TRUE(vm, "(equal? (assq 'a (hash-table->alist counts)) '(a . 3))");
+
+    EXPECT_TRUE(vm,
+        "(define seen (make-hash-table))"
+        "(hash-table-walk counts (lambda (k v) (hash-table-set! seen v k)))"
+        "(and (eq? (hash-table-ref seen 3) 'a) (eq? (hash-table-ref seen 1) 'b))");
+}
+
+static void test_growth(SchemeVM* vm) {
+    EXPECT_NUMBER(vm,
+        "(define big (make-hash-table))"
+        "(do ((i 0 (+ i 1))) ((= i 5000) #t) (hash-table-set! big i (* i i)))"
+        "(hash-table-count big)",
+        5000);
+    EXPECT_TRUE(vm,
+        "(do ((i 0 (+ i 1)) (ok #t (and ok (= (hash-table-ref big i) (* i i)))))"
+        "    ((= i 5000) ok))");
+
+    // String keys built at run time land in the same buckets as literals
+    EXPECT_NUMBER(vm,
+        "(define names (make-hash-table))"
+        "(do ((i 0 (+ i 1))) ((= i 1000) #t)"
+        "  (hash-table-set! names (string-append \"n\" (number->string i)) i))"
+        "(hash-table-ref names \"n777\")",
+        777);
+}
+
+// Repeated delete and reinsert cycles reuse tombstones rather than filling
+// the table, and never hide live keys
+static void test_delete(SchemeVM* vm) {
+    EXPECT_NUMBER(vm,
+        "(define d (make-hash-table))"
+        "(do ((i 0 (+ i 1))) ((= i 1000) #t) (hash-table-set! d i i))"
+        "(do ((i 0 (+ i 2))) ((>= i 1000) #t) (hash-table-delete! d i))"
+        "(hash-table-count d)",
+        500);
+    EXPECT_TRUE(vm, "(not (hash-table-contains? d 10))");
+    EXPECT_TRUE(vm, "(hash-table-contains? d 11)");
+    EXPECT_TRUE(vm,
+        "(do ((i 1 (+ i 2)) (ok #t (and ok (= (hash-table-ref d i) i))))"
+        "    ((>= i 1000) ok))");
+
+    EXPECT_NUMBER(vm,
+        "(do ((round 0 (+ round 1))) ((= round 20) #t)"
+        "  (do ((i 0 (+ i 2))) ((>= i 1000) #t) (hash-table-set! d i round))"
+        "  (do ((i 0 (+ i 2))) ((>= i 1000) #t) (hash-table-delete! d i)))"
+        "(hash-table-count d)",
+        500);
+    EXPECT_NUMBER(vm, "(hash-table-set! d 10 'back) (hash-table-count d)", 501);
+    EXPECT_TRUE(vm, "(eq? (hash-table-ref d 10) 'back)");
+
+    // Deleting a missing key is not an error
+    EXPECT_NUMBER(vm, "(hash-table-delete! d 'absent) (hash-table-count d)", 501);
+}
+
+int main(void) {
+    SchemeVM* vm = scheme_new();
+    test_keys(vm);
+    test_update_and_listing(vm);
+    test_growth(vm);
+    test_delete(vm);
+    scheme_free(vm);
+    return test_summary("hash_table_test");
+}
@@ -0,0 +1,125 @@
+// Named let and do loops, which compile to backward jumps unless a closure
+// captures a loop variable or the loop name is used outside a tail call
+
+#include "test.h"
+
+static void test_jumps(SchemeVM* vm) {
+    CHECK(count_opcode("(define (f n) (let loop ((i 0)) (if (= i n) i (loop (+ i 1)))))",
+                       OP_GET_CALLEE) == 0);
+    CHECK(count_opcode("(define (f n) (do ((i 0 (+ i 1))) ((= i n) i)))", OP_GET_CALLEE) == 0);
+
+    // Far more iterations than there are call frames
+    scheme_eval(vm, "(define (sum n) (let loop ((i 0) (acc 0))"
+                    "  (if (= i n) acc (loop (+ i 1) (+ acc i)))))", NULL);
+    EXPECT_NUMBER(vm, "(sum 100000)", 4999950000.0);
+    EXPECT_NUMBER(vm, "(do ((i 0 (+ i 1)) (acc 0 (+ acc 2))) ((= i 100000) acc))", 200000);
+
+    // Steps see the previous iteration's values, not partly updated ones
+    EXPECT_TRUE(vm, "(equal? (let loop ((a 0) (b 1) (n 0)) (if (= n 10) (list a b) (loop b (+ a b) (+ n 1))))"
+                    "        '(55 89))");
+
+    // A variable whose type changes between iterations
+    EXPECT_TRUE(vm, "(equal? (let loop ((x 1) (n 0)) (if (= n 2) x (loop \"s\" (+ n 1)))) \"s\")");
+}
+
+// A let in tail position binds its variables in the loop's own slots, so
+// the call in its body still jumps
+static void test_tail_lets(SchemeVM* vm) {
+    CHECK(count_opcode("(define (f n) (let loop ((i 0) (acc 0))"
+                       "  (if (= i n) acc (let ((x (* i 2))) (loop (+ i 1) (+ acc x))))))",
+                       OP_CALL) == 1);
+    EXPECT_NUMBER(vm, "(let loop ((i 0) (acc 0))"
+                      "  (if (= i 1000) acc (let ((x (* i 2))) (loop (+ i 1) (+ acc x)))))",
+                  999000);
+
+    // Nested lets in several branches, each branch reusing the same slots
+    EXPECT_NUMBER(vm, "(let loop ((i 0))"
+                      "  (cond ((= i 1000) (let ((a 1)) (let ((b 2)) (+ a b i))))"
+                      "        ((odd? i) (let ((a i)) (let ((b a)) (loop (+ b 1)))))"
+                      "        (else (let ((c (+ i 1))) (loop c)))))",
+                  1003);
+
+    // A closure over a let variable keeps that iteration's value
+    EXPECT_TRUE(vm, "(equal? (map (lambda (f) (f))"
+                    "  (let loop ((i 0) (fs '()))"
+                    "    (if (= i 3) fs (let ((j (* i 10))) (loop (+ i 1) (cons (lambda () j) fs))))))"
+                    "  '(20 10 0))");
+}
+
+// A let's own function runs to completion before the loop moves on, so its
+// references to loop variables do not stop the loop jumping
+static void test_let_references(SchemeVM* vm) {
+    CHECK(count_opcode("(define (f) (do ((i 0 (+ i 1)) (acc 0 (let ((sq (* i i))) (+ acc sq))))"
+                       "  ((= i 1000) acc)))",
+                       OP_GET_CALLEE) == 0);
+    EXPECT_NUMBER(vm, "(do ((i 0 (+ i 1)) (acc 0 (let ((sq (* i i))) (+ acc sq)))) ((= i 1000) acc))",
+                  332833500);
+    EXPECT_NUMBER(vm, "(let loop ((i 0) (acc 0))"
+                      "  (if (= i 1000) acc (loop (+ i 1) (let ((d (+ i 1))) (+ acc d)))))",
+                  500500);
+
+    // A lambda inside a let still captures the loop variable itself
+    EXPECT_TRUE(vm, "(equal? (map (lambda (f) (f))"
+                    "  (do ((i 0 (+ i 1)) (fs '() (let ((g (lambda () i))) (cons g fs)))) ((= i 3) fs)))"
+                    "  '(2 1 0))");
+}
+
+static void test_captured_variables(SchemeVM* vm) {
+    CHECK(count_opcode("(define (f n) (let loop ((i 0) (fs '()))"
+                       "  (if (= i n) fs (loop (+ i 1) (cons (lambda () i) fs)))))",
+                       OP_GET_CALLEE) == 1);
+
+    // Each iteration is a real call, so every closure sees its own binding
+    EXPECT_TRUE(vm, "(equal? (map (lambda (f) (f))"
+                    "  (let loop ((i 0) (fs '())) (if (= i 5) fs (loop (+ i 1) (cons (lambda () i) fs)))))"
+                    "  '(4 3 2 1 0))");
+    EXPECT_TRUE(vm, "(equal? (map (lambda (f) (f))"
+                    "  (do ((i 0 (+ i 1)) (fs '() (cons (lambda () i) fs))) ((= i 3) fs)))"
+                    "  '(2 1 0))");
+}
+
+static void test_non_tail_self_reference(SchemeVM* vm) {
+    CHECK(count_opcode("(define (f n) (let loop ((i n)) (if (= i 0) 1 (* i (loop (- i 1))))))",
+                       OP_GET_CALLEE) == 1);
+    EXPECT_NUMBER(vm, "(let loop ((i 10)) (if (= i 0) 1 (* i (loop (- i 1)))))", 3628800);
+
+    // The loop name as a value
+    EXPECT_NUMBER(vm, "(let walk ((t '(1 (2 3) (4 (5)))))"
+                      "  (if (pair? t) (apply + (map walk t)) (if (null? t) 0 t)))", 15);
+    EXPECT_TRUE(vm, "(let loop ((i 0)) (if (= i 3) (procedure? loop) (loop (+ i 1))))");
+}
+
+// Loops that make real calls use a frame per iteration
+static void test_frame_limit(SchemeVM* vm) {
+    char source[256];
+    scheme_eval(vm, "(define (captured n) (let loop ((i 0)) (if (= i n) (lambda () i) (loop (+ i 1)))))",
+                NULL);
+    scheme_eval(vm, "(define (plain n) (let loop ((i 0)) (if (= i n) i (loop (+ i 1)))))", NULL);
+
+    snprintf(source, sizeof(source), "((captured %d))", FRAMES_MAX / 2);
+    EXPECT_NUMBER(vm, source, FRAMES_MAX / 2);
+    snprintf(source, sizeof(source), "((captured %d))", FRAMES_MAX);
+    EXPECT_ERROR(vm, source, "Stack Overflow");
+
+    snprintf(source, sizeof(source), "(plain %d)", FRAMES_MAX * 1000);
+    EXPECT_NUMBER(vm, source, FRAMES_MAX * 1000);
+
+    // Deep non-tail recursion runs out of frames or value stack, whichever
+    // comes first, and the VM stays usable
+    snprintf(source, sizeof(source), "(let loop ((i %d)) (if (= i 0) 0 (+ 1 (loop (- i 1)))))",
+             FRAMES_MAX * 4);
+    EXPECT_ERROR(vm, source, "Stack");
+    EXPECT_NUMBER(vm, "((captured 3))", 3);
+}
+
+int main(void) {
+    SchemeVM* vm = scheme_new();
+    test_jumps(vm);
+    test_tail_lets(vm);
+    test_let_references(vm);
+    test_captured_variables(vm);
+    test_non_tail_self_reference(vm);
+    test_frame_limit(vm);
+    scheme_free(vm);
+    return test_summary("loop_test");
+}
@@ -0,0 +1,72 @@
+// Type inference and the OP_*_NUMBER opcodes codegen emits when both
+// operands are proven numbers
+
+#include "test.h"
+
+static void test_specialization(void) {
+    // Literals and let-bound locals are proven numbers
+    CHECK(count_opcode("(let ((a 1) (b 2.5)) (+ a b))", OP_ADD_NUMBER) == 1);
+    CHECK(count_opcode("(let ((a 1) (b 2.5)) (< a b))", OP_LESS_NUMBER) == 1);
+    CHECK(count_opcode("(let ((a 3)) (* a 0.5))", OP_MUL_NUMBER) == 1);
+
+    // Every partial result of a chain is a number
+    CHECK(count_opcode("(let ((a 1) (b 2.5)) (+ a b 0.25))", OP_ADD_NUMBER) == 2);
+
+    // if joins its branch types
+    CHECK(count_opcode("(define (f c) (let ((n (if c 1 2.5))) (+ n n)))", OP_ADD_NUMBER) == 1);
+
+    // Parameters, globals and mixed branches stay generic
+    CHECK(count_opcode("(define (f x) (+ x 1))", OP_ADD_NUMBER) == 0);
+    CHECK(count_opcode("(define (f x) (+ x 1))", OP_ADD) == 1);
+    CHECK(count_opcode("(define (f c) (let ((n (if c 1 \"x\"))) (+ n 1)))", OP_ADD_NUMBER) == 0);
+}
+
+static void test_mixed_results(SchemeVM* vm) {
+    EXPECT_NUMBER(vm, "(let ((a 1) (b 2.5)) (+ a b))", 3.5);
+    EXPECT_NUMBER(vm, "(let ((a 1) (b 2.5)) (- a b))", -1.5);
+    EXPECT_NUMBER(vm, "(let ((a 3) (b 0.5)) (* a b))", 1.5);
+    EXPECT_NUMBER(vm, "(let ((a 1) (b 4)) (/ a b))", 0.25);
+    EXPECT_NUMBER(vm, "(let ((a 1) (b 2.5)) (+ a b 0.25))", 3.75);
+    EXPECT_NUMBER(vm, "(let ((a 7)) (- a))", -7);
+    EXPECT_NUMBER(vm, "(let ((a 4)) (/ a))", 0.25);
+
+    EXPECT_TRUE(vm, "(let ((a 1) (b 1.0)) (= a b))");
+    EXPECT_TRUE(vm, "(let ((a 1) (b 2.5)) (< a b))");
+    EXPECT_TRUE(vm, "(let ((a 2.5) (b 2)) (>= a b))");
+    EXPECT_TRUE(vm, "(let ((a 2) (b 2.0)) (<= a b))");
+
+    // The same values through the generic opcodes give the same results
+    scheme_eval(vm, "(define (add a b) (+ a b))", NULL);
+    EXPECT_NUMBER(vm, "(add 1 2.5)", 3.5);
+    EXPECT_NUMBER(vm, "(let ((f (lambda (n) (* n 1.5)))) (+ (f 2) 1))", 4);
+    EXPECT_NUMBER(vm, "(define (pick c) (let ((n (if c 1 2.5))) (+ n n))) (pick #f)", 5);
+}
+
+static void test_type_errors(SchemeVM* vm) {
+    // Proven wrong types are rejected when compiling
+    EXPECT_ERROR(vm, "(let ((s \"a\")) (+ s 1))", "Expected number, got string");
+
+    // Unknown types reach the generic opcodes, which still check tags
+    scheme_eval(vm, "(define (inc x) (+ x 1))", NULL);
+    scheme_eval(vm, "(define (below x) (< x 1))", NULL);
+    scheme_eval(vm, "(define (maybe c) (let ((n (if c 1 \"x\"))) (+ n 1)))", NULL);
+    EXPECT_ERROR(vm, "(inc \"a\")", "Expected number, got string");
+    EXPECT_ERROR(vm, "(below \"a\")", "Expected number, got string");
+    EXPECT_NUMBER(vm, "(maybe #t)", 2);
+    EXPECT_ERROR(vm, "(maybe #f)", "Expected number, got string");
+
+    // OP_DIV_NUMBER still checks for division by zero
+    EXPECT_ERROR(vm, "(let ((a 1) (b 0)) (/ a b))", "Division by zero");
+
+    // The VM is still usable after the errors
+    EXPECT_NUMBER(vm, "(inc 41)", 42);
+}
+
+int main(void) {
+    SchemeVM* vm = scheme_new();
+    test_specialization();
+    test_mixed_results(vm);
+    test_type_errors(vm);
+    scheme_free(vm);
+    return test_summary("numeric_test");
+}
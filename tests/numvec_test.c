@@ -0,0 +1,125 @@
+// f64vector and u8vector, and the SIMD kernels under them checked against
+// plain loops at every length around the register widths
+
+#include <stdlib.h>
+#include "test.h"
+#include "vm/simd.h"
+
+#define MAX_LENGTH 150
+
+static void test_kernels(void) {
+    double x[MAX_LENGTH], y[MAX_LENGTH], d[MAX_LENGTH];
+    uint8_t a[MAX_LENGTH], b[MAX_LENGTH], c[MAX_LENGTH];
+    srand(1);
+
+    for (size_t n = 0; n < MAX_LENGTH; n++) {
+        for (size_t i = 0; i < n; i++) {
+            // Small integers keep the f64 sums exact in any order
+            x[i] = rand() % 100 - 50;
+            y[i] = rand() % 100 - 50;
+            a[i] = (uint8_t)rand();
+            b[i] = (uint8_t)rand();
+        }
+
+        double sum = 0, dot = 0;
+        uint64_t byte_sum = 0, byte_dot = 0;
+        for (size_t i = 0; i < n; i++) {
+            sum += x[i];
+            dot += x[i] * y[i];
+            byte_sum += a[i];
+            byte_dot += (uint64_t)a[i] * b[i];
+        }
+        CHECK(f64_sum(x, n) == sum);
+        CHECK(f64_dot(x, y, n) == dot);
+        CHECK(u8_sum(a, n) == byte_sum);
+        CHECK(u8_dot(a, b, n) == byte_dot);
+
+        if (n > 0) {
+            double lo = x[0], hi = x[0];
+            uint8_t byte_lo = a[0], byte_hi = a[0];
+            for (size_t i = 1; i < n; i++) {
+                if (x[i] < lo) lo = x[i];
+                if (x[i] > hi) hi = x[i];
+                if (a[i] < byte_lo) byte_lo = a[i];
+                if (a[i] > byte_hi) byte_hi = a[i];
+            }
+            CHECK(f64_min(x, n) == lo && f64_max(x, n) == hi);
+            CHECK(u8_min(a, n) == byte_lo && u8_max(a, n) == byte_hi);
+        }
+
+        bool same = true;
+        f64_add(d, x, y, n);
+        for (size_t i = 0; i < n; i++) same = same && d[i] == x[i] + y[i];
+        f64_mul(d, x, y, n);
+        for (size_t i = 0; i < n; i++) same = same && d[i] == x[i] * y[i];
+        f64_scale(d, x, 0.5, n);
+        for (size_t i = 0; i < n; i++) same = same && d[i] == x[i] * 0.5;
+        f64_fill(d, 2.5, n);
+        for (size_t i = 0; i < n; i++) same = same && d[i] == 2.5;
+        f64_copy(d, x, n);
+        for (size_t i = 0; i < n; i++) same = same && d[i] == x[i];
+
+        u8_add(c, a, b, n);
+        for (size_t i = 0; i < n; i++) same = same && c[i] == (uint8_t)(a[i] + b[i]);
+        u8_mul(c, a, b, n);
+        for (size_t i = 0; i < n; i++) same = same && c[i] == (uint8_t)(a[i] * b[i]);
+        u8_scale(c, a, 201, n);
+        for (size_t i = 0; i < n; i++) same = same && c[i] == (uint8_t)(a[i] * 201);
+        u8_fill(c, 7, n);
+        for (size_t i = 0; i < n; i++) same = same && c[i] == 7;
+        u8_copy(c, a, n);
+        for (size_t i = 0; i < n; i++) same = same && c[i] == a[i];
+        CHECK(same);
+    }
+}
+
+static void test_f64vector(SchemeVM* vm) {
+    scheme_eval(vm, "(define v (list->f64vector '(1 2 3)))", NULL);
+    EXPECT_TRUE(vm, "(f64vector? v)");
+    EXPECT_NUMBER(vm, "(f64vector-length v)", 3);
+    EXPECT_NUMBER(vm, "(f64vector-sum v)", 6);
+    EXPECT_NUMBER(vm, "(f64vector-dot v v)", 14);
+    EXPECT_NUMBER(vm, "(f64vector-min v)", 1);
+    EXPECT_NUMBER(vm, "(f64vector-max v)", 3);
+    EXPECT_TRUE(vm, "(equal? (f64vector->list (f64vector-scale v 2)) '(2 4 6))");
+    EXPECT_TRUE(vm, "(equal? (f64vector->list (f64vector-add v v)) '(2 4 6))");
+    EXPECT_TRUE(vm, "(equal? (f64vector->list (f64vector-mul v v)) '(1 4 9))");
+    EXPECT_NUMBER(vm, "(f64vector-ref (f64vector 0.5 1.5) 1)", 1.5);
+
+    // copy is independent of the original; fill! changes only its target
+    EXPECT_TRUE(vm, "(define u (f64vector-copy v)) (f64vector-fill! v 0)"
+                    "(equal? (list (f64vector->list u) (f64vector->list v)) '((1 2 3) (0 0 0)))");
+    EXPECT_TRUE(vm, "(f64vector-set! u 0 9) (= (f64vector-ref u 0) 9)");
+    EXPECT_NUMBER(vm, "(f64vector-sum (make-f64vector 1000 0.25))", 250);
+
+    EXPECT_ERROR(vm, "(f64vector-ref v 3)", "out of range");
+    EXPECT_ERROR(vm, "(f64vector-add v (f64vector 1))", "f64vector-add");
+    EXPECT_ERROR(vm, "(f64vector-min (make-f64vector 0 0))", "f64vector-min");
+    EXPECT_ERROR(vm, "(f64vector-set! v 0 \"a\")", "f64vector-set!");
+}
+
+static void test_u8vector(SchemeVM* vm) {
+    EXPECT_TRUE(vm, "(equal? (u8vector->list (u8vector-add (u8vector 200 1) (u8vector 100 2))) '(44 3))");
+    EXPECT_TRUE(vm, "(equal? (u8vector->list (u8vector-mul (u8vector 16 3) (u8vector 16 5))) '(0 15))");
+    EXPECT_TRUE(vm, "(equal? (u8vector->list (u8vector-scale (u8vector 128 2) 3)) '(128 6))");
+    EXPECT_NUMBER(vm, "(u8vector-dot (u8vector 255 255) (u8vector 255 255))", 130050);
+    EXPECT_NUMBER(vm, "(u8vector-sum (make-u8vector 1000 255))", 255000);
+    EXPECT_NUMBER(vm, "(u8vector-max (list->u8vector '(3 250 7)))", 250);
+    EXPECT_NUMBER(vm, "(u8vector-min (list->u8vector '(3 250 7)))", 3);
+    EXPECT_TRUE(vm, "(define b (u8vector 1 2)) (define b2 (u8vector-copy b)) (u8vector-fill! b 9)"
+                    "(equal? (list (u8vector->list b) (u8vector->list b2)) '((9 9) (1 2)))");
+    EXPECT_TRUE(vm, "(and (u8vector? b) (not (u8vector? (f64vector 1))))");
+
+    EXPECT_ERROR(vm, "(u8vector 256)", "u8vector");
+    EXPECT_ERROR(vm, "(u8vector-set! b 0 -1)", "u8vector-set!");
+    EXPECT_ERROR(vm, "(u8vector-ref b 2)", "out of range");
+}
+
+int main(void) {
+    SchemeVM* vm = scheme_new();
+    test_kernels();
+    test_f64vector(vm);
+    test_u8vector(vm);
+    scheme_free(vm);
+    return test_summary("numvec_test");
+}
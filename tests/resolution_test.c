@@ -0,0 +1,78 @@
+// Identifier resolution: each reference compiles to a local slot, an
+// upvalue or a global, and the nearest binding wins
+
+#include "test.h"
+
+static void test_kinds(void) {
+    CHECK(count_opcode("(define (f x) x)", OP_GET_LOCAL) == 1);
+    CHECK(count_opcode("(define (f x) x)", OP_GET_GLOBAL) == 0);
+    CHECK(count_opcode("(define (f x) (lambda () x))", OP_GET_UPVALUE) == 1);
+    CHECK(count_opcode("(define g 1) (define (f) g)", OP_GET_GLOBAL) == 1);
+    CHECK(count_opcode("(define (f x) (let ((y x)) y))", OP_GET_UPVALUE) == 0);
+
+    // A capture two functions out is threaded through the middle one
+    CHECK(count_opcode("(define (f x) (lambda () (lambda () x)))", OP_GET_UPVALUE) == 1);
+}
+
+static void test_values(SchemeVM* vm) {
+    EXPECT_NUMBER(vm, "(define (add-n n) (lambda (x) (+ x n))) ((add-n 3) 4)", 7);
+    EXPECT_NUMBER(vm,
+        "(define (nest a) (lambda (b) (lambda (c) (+ a (* b c)))))"
+        "(((nest 1) 2) 3)",
+        7);
+
+    // Each closure keeps its own captured value
+    EXPECT_NUMBER(vm,
+        "(define add1 (add-n 1)) (define add10 (add-n 10))"
+        "(+ (add1 0) (add10 0))",
+        11);
+
+    // Parameters in different functions with the same name do not collide
+    EXPECT_NUMBER(vm, "(define (outer x) ((lambda (x) (* x 2)) (+ x 1))) (outer 4)", 10);
+}
+
+static void test_shadowing(SchemeVM* vm) {
+    // A local shadows a global of the same name
+    EXPECT_NUMBER(vm, "(define v 100) (define (f v) v) (f 1)", 1);
+    EXPECT_NUMBER(vm, "v", 100);
+    EXPECT_NUMBER(vm, "(let ((v 2)) (+ v 1))", 3);
+
+    // A parameter named like a builtin is called as the parameter, not
+    // compiled to the builtin's opcode
+    EXPECT_NUMBER(vm, "(define (apply-op + a b) (+ a b)) (apply-op * 3 4)", 12);
+    EXPECT_TRUE(vm, "(define (first-of car p) (car p)) (equal? (first-of cdr '(1 2)) '(2))");
+    EXPECT_NUMBER(vm, "(let ((list 5)) list)", 5);
+
+    // An inner let shadows an outer one and the outer returns afterwards
+    EXPECT_NUMBER(vm, "(let ((a 1)) (+ (let ((a 10)) a) a))", 11);
+
+    // A let value sees the outer binding, not the one it introduces
+    EXPECT_NUMBER(vm, "(let ((a 1)) (let ((a (+ a 1))) a))", 2);
+}
+
+static void test_errors(SchemeVM* vm) {
+    EXPECT_ERROR(vm, "(define (f) never-bound)", "Undefined identifier: never-bound");
+    EXPECT_ERROR(vm, "(let ((a 1)) b)", "Undefined identifier: b");
+
+    // A let's names are not in scope in its own values
+    EXPECT_ERROR(vm, "(let ((p 1) (q p)) q)", "Undefined identifier: p");
+
+    // Slots are numbered in a byte
+    char source[4096];
+    int length = snprintf(source, sizeof(source), "(lambda (");
+    for (int i = 0; i < 300; i++) {
+        length += snprintf(source + length, sizeof(source) - length, "p%d ", i);
+    }
+    snprintf(source + length, sizeof(source) - length, ") p0)");
+    EXPECT_ERROR(vm, source, "Too many local variables in function");
+}
+
+int main(void) {
+    test_kinds();
+    SchemeVM* vm = scheme_new();
+    test_values(vm);
+    test_shadowing(vm);
+    test_errors(vm);
+    scheme_free(vm);
+    return test_summary("resolution_test");
+}
@@ -0,0 +1,74 @@
+// Strings, including the ropes that long appends build, and string ports
+
+#include "test.h"
+
+static void test_strings(SchemeVM* vm) {
+    EXPECT_NUMBER(vm, "(string-length \"hello\")", 5);
+    EXPECT_NUMBER(vm, "(string-length \"\")", 0);
+    EXPECT_TRUE(vm, "(string=? (string-append \"ab\" \"cd\") \"abcd\")");
+    EXPECT_TRUE(vm, "(string=? (string-append) \"\")");
+    EXPECT_TRUE(vm, "(not (string=? \"ab\" \"abc\"))");
+    EXPECT_TRUE(vm, "(equal? (number->string 42) \"42\")");
+    EXPECT_TRUE(vm, "(equal? (number->string 2.5) \"2.5\")");
+    EXPECT_TRUE(vm, "(equal? (number->string -7) \"-7\")");
+    EXPECT_TRUE(vm, "(and (string? \"a\") (not (string? 'a)))");
+}
+
+// Appends past the copy limit share their halves; results must not differ
+static void test_ropes(SchemeVM* vm) {
+    scheme_eval(vm,
+        "(define chunk \"0123456789012345678901234567890123456789\")"
+        "(define (grow s n) (if (= n 0) s (grow (string-append s chunk) (- n 1))))"
+        "(define (grow-left s n) (if (= n 0) s (grow-left (string-append chunk s) (- n 1))))",
+        NULL);
+    EXPECT_NUMBER(vm, "(string-length (grow \"\" 50))", 2000);
+    EXPECT_NUMBER(vm, "(string-length (grow-left \"\" 50))", 2000);
+
+    // The same characters however the rope is shaped
+    EXPECT_TRUE(vm, "(string=? (grow \"\" 50) (grow-left \"\" 50))");
+    EXPECT_TRUE(vm, "(equal? (grow \"x\" 20) (string-append \"x\" (grow \"\" 20)))");
+    EXPECT_TRUE(vm, "(not (string=? (grow \"x\" 20) (grow \"y\" 20)))");
+
+    // Deeper than the flattening limit, built one short piece at a time
+    EXPECT_TRUE(vm,
+        "(define long (do ((i 0 (+ i 1)) (s \"\" (string-append s (number->string (modulo i 10)))))"
+        "               ((= i 5000) s)))"
+        "(= (string-length long) 5000)");
+    EXPECT_TRUE(vm, "(string=? (string-append long \"!\") (string-append long \"!\"))");
+
+    // A rope used as a hash table key finds the flat string's entry
+    EXPECT_TRUE(vm,
+        "(define table (make-hash-table))"
+        "(hash-table-set! table (grow \"k\" 10) 1)"
+        "(= (hash-table-ref/default table (string-append \"k\" (grow \"\" 10)) 0) 1)");
+}
+
+static void test_ports(SchemeVM* vm) {
+    EXPECT_TRUE(vm,
+        "(define out (open-output-string))"
+        "(write-string \"hello, \" out)"
+        "(write-string \"world\" out)"
+        "(equal? (get-output-string out) \"hello, world\")");
+
+    // Many small writes
+    EXPECT_TRUE(vm,
+        "(define big (open-output-string))"
+        "(do ((i 0 (+ i 1))) ((= i 3000) #t) (write-string \"abc\" big))"
+        "(= (string-length (get-output-string big)) 9000)");
+
+    // Reading the port does not empty it
+    EXPECT_TRUE(vm, "(equal? (get-output-string out) (get-output-string out))");
+    EXPECT_TRUE(vm, "(equal? (get-output-string (open-output-string)) \"\")");
+
+    EXPECT_ERROR(vm, "(write-string 5 out)", "write-string");
+    EXPECT_ERROR(vm, "(get-output-string \"s\")", "get-output-string");
+}
+
+int main(void) {
+    SchemeVM* vm = scheme_new();
+    test_strings(vm);
+    test_ropes(vm);
+    test_ports(vm);
+    scheme_free(vm);
+    return test_summary("string_test");
+}
@@ -0,0 +1,84 @@
+// Interned symbols, eq?/eqv?, case, and the association-list lookups
+
+#include "test.h"
+
+static void test_symbols(SchemeVM* vm) {
+    EXPECT_TRUE(vm, "(eq? 'apple 'apple)");
+    EXPECT_TRUE(vm, "(not (eq? 'apple 'pear))");
+    EXPECT_TRUE(vm, "(eq? 'apple (string->symbol \"apple\"))");
+    EXPECT_TRUE(vm, "(equal? (symbol->string 'apple) \"apple\")");
+    EXPECT_TRUE(vm, "(eq? (string->symbol (string-append \"ap\" \"ple\")) 'apple)");
+    EXPECT_TRUE(vm, "(and (symbol? 'a) (not (symbol? \"a\")) (not (symbol? 1)))");
+
+    // Quoted keywords are symbols too, not strings
+    EXPECT_TRUE(vm, "(and (symbol? 'if) (eq? (car '(define x)) 'define))");
+    EXPECT_TRUE(vm, "(not (eq? 'apple \"apple\"))");
+
+    // eqv? compares numbers by value and other objects by identity
+    EXPECT_TRUE(vm, "(eqv? 2 (+ 1 1))");
+    EXPECT_TRUE(vm, "(not (eqv? '(1) '(1)))");
+    EXPECT_TRUE(vm, "(define p '(1)) (eq? p p)");
+
+    // Passed around as procedure values rather than compiled to OP_EQV
+    EXPECT_TRUE(vm, "(define same eq?) (same 'x 'x)");
+
+    EXPECT_ERROR(vm, "(symbol->string \"apple\")", "symbol->string");
+    EXPECT_ERROR(vm, "(string->symbol 'apple)", "string->symbol");
+}
+
+// One table serves every VM, so the same name is the same object in each
+static void test_interning_across_vms(SchemeVM* vm) {
+    SchemeVM* other = scheme_new();
+    Value here, there;
+    if (eval_or_report(vm, "'shared-name", &here, __FILE__, __LINE__) &&
+        eval_or_report(other, "(string->symbol \"shared-name\")", &there, __FILE__, __LINE__)) {
+        CHECK(IS_SYMBOL(here) && IS_SYMBOL(there));
+        CHECK(AS_SYMBOL(here) == AS_SYMBOL(there));
+    }
+    scheme_free(other);
+}
+
+static void test_case(SchemeVM* vm) {
+    scheme_eval(vm,
+        "(define (calc op a b)"
+        "  (case op"
+        "    ((add plus) (+ a b))"
+        "    ((sub) (- a b))"
+        "    ((1 2) 100)"
+        "    (else 0)))",
+        NULL);
+    EXPECT_NUMBER(vm, "(calc 'add 3 4)", 7);
+    EXPECT_NUMBER(vm, "(calc 'plus 3 4)", 7);
+    EXPECT_NUMBER(vm, "(calc 'sub 3 4)", -1);
+    EXPECT_NUMBER(vm, "(calc 2 0 0)", 100);
+    EXPECT_NUMBER(vm, "(calc 'mul 3 4)", 0);
+    EXPECT_NUMBER(vm, "(calc \"add\" 3 4)", 0);
+
+    // The key is evaluated once
+    scheme_eval(vm,
+        "(define out (open-output-string))"
+        "(define (key) (write-string \"k\" out) 'b)",
+        NULL);
+    EXPECT_NUMBER(vm, "(case (key) ((a) 1) ((b) 2) (else 3))", 2);
+    EXPECT_TRUE(vm, "(equal? (get-output-string out) \"k\")");
+}
+
+static void test_lookups(SchemeVM* vm) {
+    EXPECT_TRUE(vm, "(equal? (memq 'c '(a b c d)) '(c d))");
+    EXPECT_TRUE(vm, "(not (memq 'z '(a b c)))");
+    EXPECT_TRUE(vm, "(equal? (memv 2 '(1 2 3)) '(2 3))");
+    EXPECT_TRUE(vm, "(equal? (member \"b\" '(\"a\" \"b\")) '(\"b\"))");
+    EXPECT_TRUE(vm, "(equal? (assq 'b '((a 1) (b 2))) '(b 2))");
+    EXPECT_TRUE(vm, "(not (assv 5 '((1 . 2))))");
+    EXPECT_TRUE(vm, "(equal? (assoc \"k\" '((\"k\" . 1))) '(\"k\" . 1))");
+}
+
+int main(void) {
+    SchemeVM* vm = scheme_new();
+    test_symbols(vm);
+    test_interning_across_vms(vm);
+    test_case(vm);
+    test_lookups(vm);
+    scheme_free(vm);
+    return test_summary("symbol_test");
+}
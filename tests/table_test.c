@@ -0,0 +1,176 @@
+// The Swiss table that holds globals: growth, deletes, and reinserting
+// over deleted slots
+
+#include "test.h"
+#include "vm/table.h"
+
+#define KEY_COUNT 10000
+
+static void key_name(char* buffer, size_t size, int i) {
+    snprintf(buffer, size, "key-%d", i);
+}
+
+static bool has_number(Table* table, const char* key, double expected) {
+    Value value;
+    return table_get(table, key, &value) && IS_NUMBER(value) && AS_NUMBER(value) == expected;
+}
+
+static void test_growth(void) {
+    Table table;
+    init_table(&table);
+    Value value;
+    CHECK(!table_get(&table, "absent", &value));
+    CHECK(!table_delete(&table, "absent"));
+
+    char key[32];
+    bool all_new = true;
+    for (int i = 0; i < KEY_COUNT; i++) {
+        key_name(key, sizeof(key), i);
+        all_new &= table_set(&table, key, NUMBER_VAL(i));
+    }
+    CHECK(all_new);
+    CHECK(table.count == KEY_COUNT);
+    CHECK(table.capacity >= KEY_COUNT);
+
+    bool all_found = true;
+    for (int i = 0; i < KEY_COUNT; i++) {
+        key_name(key, sizeof(key), i);
+        all_found &= has_number(&table, key, i);
+    }
+    CHECK(all_found);
+
+    // Replacing a value keeps the count
+    CHECK(!table_set(&table, "key-5", NUMBER_VAL(-5)));
+    CHECK(has_number(&table, "key-5", -5));
+    CHECK(table.count == KEY_COUNT);
+
+    // Prefixes and extensions of stored keys are different keys
+    CHECK(!table_get(&table, "key-", &value));
+    CHECK(!table_get(&table, "key-50000", &value));
+    free_table(&table);
+}
+
+// The table copies keys, so the caller's buffer may change afterwards
+static void test_key_ownership(void) {
+    Table table;
+    init_table(&table);
+    char key[] = "original";
+    table_set(&table, key, NUMBER_VAL(1));
+    key[0] = 'X';
+    CHECK(has_number(&table, "original", 1));
+    Value value;
+    CHECK(!table_get(&table, key, &value));
+    free_table(&table);
+}
+
+static void test_delete_and_reinsert(void) {
+    Table table;
+    init_table(&table);
+    char key[32];
+    for (int i = 0; i < KEY_COUNT; i++) {
+        key_name(key, sizeof(key), i);
+        table_set(&table, key, NUMBER_VAL(i));
+    }
+
+    bool deleted = true;
+    for (int i = 0; i < KEY_COUNT; i += 2) {
+        key_name(key, sizeof(key), i);
+        deleted &= table_delete(&table, key);
+    }
+    CHECK(deleted);
+    CHECK(table.count == KEY_COUNT / 2);
+    CHECK(!table_delete(&table, "key-0"));
+
+    // Deleted slots must not end the probe for keys stored past them
+    bool odd_found = true, even_gone = true;
+    Value value;
+    for (int i = 0; i < KEY_COUNT; i++) {
+        key_name(key, sizeof(key), i);
+        if (i % 2) odd_found &= has_number(&table, key, i);
+        else even_gone &= !table_get(&table, key, &value);
+    }
+    CHECK(odd_found);
+    CHECK(even_gone);
+
+    // Cycling the same keys in and out reuses deleted slots instead of
+    // growing the table
+    int capacity = table.capacity;
+    bool reinserted = true;
+    for (int round = 0; round < 50; round++) {
+        for (int i = 0; i < KEY_COUNT; i += 2) {
+            key_name(key, sizeof(key), i);
+            reinserted &= table_set(&table, key, NUMBER_VAL(round));
+        }
+        for (int i = 0; i < KEY_COUNT; i += 2) {
+            key_name(key, sizeof(key), i);
+            table_delete(&table, key);
+        }
+    }
+    CHECK(reinserted);
+    CHECK(table.capacity == capacity);
+    CHECK(table.count == KEY_COUNT / 2);
+
+    CHECK(table_set(&table, "key-0", NUMBER_VAL(0)));
+    CHECK(has_number(&table, "key-0", 0));
+    CHECK(has_number(&table, "key-9999", 9999));
+    free_table(&table);
+}
+
+// A slot's version tells a cached lookup whether it still holds
+static void test_versions(void) {
+    Table table;
+    init_table(&table);
+    CHECK(table_find(&table, "f") == -1);
+
+    table_set(&table, "f", NUMBER_VAL(1));
+    int slot = table_find(&table, "f");
+    CHECK(slot >= 0);
+    uint32_t version = table.entries[slot].version;
+    CHECK(version != 0);
+
+    // Other keys leave it alone, even when the table grows under it
+    char key[32];
+    for (int i = 0; i < 1000; i++) {
+        key_name(key, sizeof(key), i);
+        table_set(&table, key, NUMBER_VAL(i));
+    }
+    slot = table_find(&table, "f");
+    CHECK(table.entries[slot].version == version);
+
+    // Setting it, even to the same value, gives a new version
+    table_set(&table, "f", NUMBER_VAL(1));
+    CHECK(table.entries[slot].version != version);
+    version = table.entries[slot].version;
+
+    // A deleted key's slot matches no version, and a key put back there
+    // gets a new one
+    table_delete(&table, "f");
+    CHECK(table.entries[slot].version == 0);
+    table_set(&table, "f", NUMBER_VAL(1));
+    CHECK(table.entries[table_find(&table, "f")].version != version);
+    free_table(&table);
+}
+
+// Globals are stored in the same table
+static void test_globals(void) {
+    SchemeVM* vm = scheme_new();
+    EXPECT_NUMBER(vm,
+        "(define g1 1) (define g2 2) (define g3 3) (define g4 4) (define g5 5)"
+        "(define g6 6) (define g7 7) (define g8 8) (define g9 9) (define g10 10)"
+        "(define g11 11) (define g12 12) (define g13 13) (define g14 14) (define g15 15)"
+        "(define g16 16) (define g17 17) (define g18 18) (define g19 19) (define g20 20)"
+        "(+ g1 g5 g10 g15 g20)",
+        51);
+    EXPECT_NUMBER(vm, "(define g5 50) (+ g5 g20)", 70);
+    EXPECT_ERROR(vm, "(+ g21 1)", "Undefined identifier: g21");
+    scheme_free(vm);
+}
+
+int main(void) {
+    test_growth();
+    test_key_ownership();
+    test_delete_and_reinsert();
+    test_versions();
+    test_globals();
+    return test_summary("table_test");
+}
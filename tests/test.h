@@ -0,0 +1,155 @@
+#ifndef TEST_H
+#define TEST_H
+
+// A small harness for the programs in this directory. Each drives the VM
+// through include/scheme.h, counts failed checks and ends with
+// `return test_summary("name");`, so ctest sees a nonzero exit status.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "scheme.h"
+#include "parser/parser.h"
+#include "analyzer/analyzer.h"
+#include "codegen/codegen.h"
+#include "utils/arena.h"
+#include "utils/error.h"
+
+static int test_failures = 0;
+static int test_checks = 0;
+
+#define CHECK(condition) check((condition), #condition, __FILE__, __LINE__)
+
+// Evaluates source and compares the value of its last form
+#define EXPECT_TRUE(vm, source) expect_true((vm), (source), __FILE__, __LINE__)
+#define EXPECT_NUMBER(vm, source, expected) \
+    expect_number((vm), (source), (expected), __FILE__, __LINE__)
+
+// Evaluates source, which must fail with a message containing fragment
+#define EXPECT_ERROR(vm, source, fragment) \
+    expect_error((vm), (source), (fragment), __FILE__, __LINE__)
+
+
+static inline void check(bool ok, const char* what, const char* file, int line) {
+    test_checks++;
+    if (ok) return;
+    test_failures++;
+    fprintf(stderr, "%s:%d: check failed: %s\n", file, line, what);
+}
+
+static inline bool eval_or_report(SchemeVM* vm, const char* source, Value* result,
+                                  const char* file, int line) {
+    test_checks++;
+    if (scheme_eval(vm, source, result)) return true;
+    test_failures++;
+    fprintf(stderr, "%s:%d: %s\n    failed: %s\n", file, line, source, scheme_error(vm));
+    return false;
+}
+
+static inline void expect_true(SchemeVM* vm, const char* source, const char* file, int line) {
+    Value result;
+    if (!eval_or_report(vm, source, &result, file, line)) return;
+    if (IS_BOOL(result) && AS_BOOL(result)) return;
+
+    test_failures++;
+    fprintf(stderr, "%s:%d: %s\n    expected #t, got ", file, line, source);
+    fflush(stderr);
+    print_value(result);
+    printf("\n");
+    fflush(stdout);
+}
+
+static inline void expect_number(SchemeVM* vm, const char* source, double expected,
+                                 const char* file, int line) {
+    Value result;
+    if (!eval_or_report(vm, source, &result, file, line)) return;
+    if (IS_NUMBER(result) && AS_NUMBER(result) == expected) return;
+
+    test_failures++;
+    fprintf(stderr, "%s:%d: %s\n    expected %g, got ", file, line, source, expected);
+    fflush(stderr);
+    print_value(result);
+    printf("\n");
+    fflush(stdout);
+}
+
+static inline void expect_error(SchemeVM* vm, const char* source, const char* fragment,
+                                const char* file, int line) {
+    test_checks++;
+    Value result;
+    if (scheme_eval(vm, source, &result)) {
+        test_failures++;
+        fprintf(stderr, "%s:%d: %s\n    expected an error containing \"%s\"\n",
+                file, line, source, fragment);
+    } else if (strstr(scheme_error(vm), fragment) == NULL) {
+        test_failures++;
+        fprintf(stderr, "%s:%d: %s\n    expected an error containing \"%s\", got \"%s\"\n",
+                file, line, source, fragment, scheme_error(vm));
+    }
+}
+
+
+// Counts op in code and in every function compiled into it
+static inline int count_in_bytecode(const Bytecode* code, Opcode op) {
+    int count = 0;
+    for (int32_t i = 0; i < code->count; i++) {
+        if (code->instructions[i].opcode == op) count++;
+    }
+    for (int32_t i = 0; i < code->constant_count; i++) {
+        if (IS_FUNCTION(code->constants[i])) {
+            count += count_in_bytecode(AS_FUNCTION(code->constants[i])->chunk, op);
+        }
+    }
+    return count;
+}
+
+// Compiles source with a front end of its own, so it may only refer to
+// builtins and to names it defines. Returns -1 if it does not compile.
+static inline int count_opcode(const char* source, Opcode op) {
+    ErrorContext errors;
+    Arena arena;
+    init_error(&errors, "<test>");
+    errors.quiet = true;
+    init_arena(&arena);
+    Parser* parser = init_parser(NULL, &arena, &errors);
+    Analyzer* analyzer = init_analyzer(parser);
+    scan_text(&parser->scanner, source, strlen(source));
+    reset_parser(parser);
+
+    AstNode* forms[64];
+    int form_count = 0;
+    while (parser->current != NULL && form_count < 64) {
+        AstNode* ast = parse_expression(parser);
+        if (!ast) break;
+        forms[form_count++] = ast;
+    }
+    for (int i = 0; i < form_count && !had_error(&errors); i++) {
+        analyze_ast(analyzer, forms[i]);
+    }
+
+    int count = -1;
+    if (!had_error(&errors)) {
+        Bytecode* code = compile_program(&arena, &errors, forms, form_count);
+        if (!had_error(&errors)) count = count_in_bytecode(code, op);
+        free_bytecode(code);
+        free(code);
+    }
+
+    free_analyzer(analyzer);
+    free_parser(parser);
+    free_arena(&arena);
+    cleanup_error(&errors);
+    return count;
+}
+
+
+static inline int test_summary(const char* name) {
+    if (test_failures > 0) {
+        fprintf(stderr, "%s: %d of %d checks failed\n", name, test_failures, test_checks);
+        return 1;
+    }
+    printf("%s: %d checks passed\n", name, test_checks);
+    return 0;
+}
+
+#endif // TEST_H
@@ -0,0 +1,150 @@
+// Green threads and channels multiplexed on one VM. The scheduler is
+// deterministic: the same program with the same budget always switches at
+// the same instructions.
+
+#define _POSIX_C_SOURCE 200809L
+#include <unistd.h>
+#include "test.h"
+
+static int input_pipe[2];
+
+// (feed n): makes n, and a newline, the next input read sees
+static Value host_feed(VM* vm, int32_t arg_count, Value* args) {
+    (void)arg_count;
+    char line[32];
+    int length = snprintf(line, sizeof(line), "%g\n", AS_NUMBER(args[0]));
+    if (write(input_pipe[1], line, (size_t)length) != length) {
+        runtime_error(vm, "feed: write failed");
+    }
+    return NIL_VAL;
+}
+
+static void test_channel_order(SchemeVM* vm) {
+    // Unbuffered: every send is a handover, in order
+    EXPECT_TRUE(vm,
+        "(define c (make-channel))"
+        "(spawn (lambda () (do ((i 1 (+ i 1))) ((> i 5) 'sent) (channel-send c i))))"
+        "(define (take n) (if (= n 0) '() (let ((x (channel-receive c))) (cons x (take (- n 1))))))"
+        "(equal? (take 5) '(1 2 3 4 5))");
+
+    // Buffered: the values come out first in, first out
+    EXPECT_TRUE(vm,
+        "(define b (make-channel 3))"
+        "(channel-send b 'x) (channel-send b 'y) (channel-send b 'z)"
+        "(equal? (list (channel-receive b) (channel-receive b) (channel-receive b)) '(x y z))");
+
+    // Senders waiting on a full channel are served in the order they came
+    EXPECT_TRUE(vm,
+        "(define one (make-channel 1))"
+        "(channel-send one 0)"
+        "(define s1 (spawn (lambda () (channel-send one 1))))"
+        "(define s2 (spawn (lambda () (channel-send one 2))))"
+        "(thread-yield)"
+        "(let ((a (channel-receive one)))"
+        "  (let ((b (channel-receive one)))"
+        "    (equal? (list a b (channel-receive one)) '(0 1 2))))");
+
+    EXPECT_TRUE(vm, "(and (channel? (make-channel)) (not (channel? 1)))");
+}
+
+static void test_join(SchemeVM* vm) {
+    EXPECT_TRUE(vm,
+        "(define (square-of n) (lambda () (* n n)))"
+        "(define t1 (spawn (square-of 7)))"
+        "(define t2 (spawn (square-of 8)))"
+        "(equal? (list (thread-join t2) (thread-join t1) (thread-join t1)) '(64 49 49))");
+    EXPECT_TRUE(vm, "(thread? t1)");
+
+    // An error ends the thread that raised it; joining it gives ()
+    EXPECT_ERROR(vm,
+        "(define bad (spawn (lambda () (vector-ref (make-vector 1 0) 5))))"
+        "(thread-join bad)",
+        "Vector index 5 out of range");
+    EXPECT_TRUE(vm, "(null? (thread-join bad))");
+
+    EXPECT_ERROR(vm, "(thread-join 5)", "thread-join: expected a thread");
+    EXPECT_ERROR(vm, "(spawn (lambda (x) x))", "spawn: expected a procedure of no arguments");
+}
+
+// Two threads record their tag once per round of busy work
+static const char* RACE =
+    "(define out (make-channel 100))"
+    "(define (worker tag) (lambda ()"
+    "  (do ((i 0 (+ i 1))) ((= i 4) tag)"
+    "    (channel-send out tag)"
+    "    (let spin ((j 0)) (if (= j 50) j (spin (+ j 1)))))))"
+    "(define a (spawn (worker 'a)))"
+    "(define b (spawn (worker 'b)))"
+    "(thread-join a) (thread-join b)"
+    "(define (drain n) (if (= n 0) '() (let ((x (channel-receive out))) (cons x (drain (- n 1))))))"
+    "(define order (drain 8))";
+
+static void test_budget(SchemeVM* vm) {
+    // Enough for either worker to finish in one turn
+    scheme_set_thread_budget(vm, 100000);
+    CHECK(scheme_eval(vm, RACE, NULL));
+    EXPECT_TRUE(vm, "(equal? order '(a a a a b b b b))");
+
+    // Less than one round of spinning per turn: the workers alternate
+    scheme_set_thread_budget(vm, 300);
+    CHECK(scheme_eval(vm, RACE, NULL));
+    EXPECT_TRUE(vm, "(equal? order '(a b a b a b a b))");
+
+    // And the same budget gives the same schedule every time
+    scheme_eval(vm, "(define previous order)", NULL);
+    CHECK(scheme_eval(vm, RACE, NULL));
+    EXPECT_TRUE(vm, "(equal? order previous)");
+
+    scheme_set_thread_budget(vm, THREAD_BUDGET);
+}
+
+static void test_blocking_read(SchemeVM* vm) {
+    CHECK(pipe(input_pipe) == 0);
+    FILE* saved_in = scheme_vm(vm)->in;
+    scheme_vm(vm)->in = fdopen(input_pipe[0], "r");
+    scheme_define_native(vm, "feed", 1, host_feed);
+
+    // The read gives way until the ticker has fed it
+    EXPECT_TRUE(vm,
+        "(define ticks 0)"
+        "(define ticker (spawn (lambda ()"
+        "  (do ((i 0 (+ i 1))) ((= i 1000) (feed 42)) (set! ticks (+ ticks 1))))))"
+        "(let ((x (read))) (equal? (list x ticks) '(42 1000)))");
+
+    // With nothing else to run, a read just waits for the data
+    Value seven = NUMBER_VAL(7);
+    host_feed(scheme_vm(vm), 1, &seven);
+    EXPECT_NUMBER(vm, "(read)", 7);
+
+    // read-line too, once the rest of the number's line is consumed
+    EXPECT_TRUE(vm, "(equal? (read-line) \"\")");
+    EXPECT_TRUE(vm,
+        "(define liner (spawn (lambda () (feed 5))))"
+        "(equal? (read-line) \"5\")");
+
+    fclose(scheme_vm(vm)->in);
+    close(input_pipe[1]);
+    scheme_vm(vm)->in = saved_in;
+}
+
+static void test_waiting_errors(SchemeVM* vm) {
+    EXPECT_ERROR(vm, "(channel-receive (make-channel))", "deadlock: every thread is waiting");
+    EXPECT_ERROR(vm, "(define lonely (make-channel)) (map channel-receive (list lonely))",
+                 "channel-receive: cannot wait inside a call made by a native procedure");
+    EXPECT_ERROR(vm, "(define me #f) (set! me (spawn (lambda () (thread-join me)))) (thread-join me)",
+                 "thread-join: a thread cannot wait for itself");
+
+    // The VM is still usable
+    EXPECT_TRUE(vm, "(= (thread-join (spawn (lambda () 3))) 3)");
+}
+
+int main(void) {
+    SchemeVM* vm = scheme_new();
+    test_channel_order(vm);
+    test_join(vm);
+    test_budget(vm);
+    test_blocking_read(vm);
+    test_waiting_errors(vm);
+    scheme_free(vm);
+    return test_summary("thread_test");
+}
@@ -0,0 +1,53 @@
+// Vectors: the inline opcodes, the same procedures as values, bounds
+// checks and structural equality
+
+#include "test.h"
+
+static void test_opcodes(void) {
+    CHECK(count_opcode("(define v (make-vector 3 0)) (vector-set! v 0 (vector-ref v 1))",
+                       OP_VECTOR_REF) == 1);
+    CHECK(count_opcode("(define v (vector 1 2)) (vector-length v)", OP_VECTOR_LENGTH) == 1);
+    CHECK(count_opcode("(define v (vector 1 2)) (vector-length v)", OP_VECTOR) == 1);
+}
+
+static void test_access(SchemeVM* vm) {
+    scheme_eval(vm, "(define v (make-vector 3 0))", NULL);
+    EXPECT_NUMBER(vm, "(vector-length v)", 3);
+    EXPECT_NUMBER(vm, "(vector-ref v 2)", 0);
+    EXPECT_TRUE(vm, "(vector-set! v 1 'x) (equal? (vector-ref v 1) 'x)");
+    EXPECT_TRUE(vm, "(equal? v (vector 0 'x 0))");
+    EXPECT_TRUE(vm, "(not (equal? v (vector 0 'x)))");
+    EXPECT_TRUE(vm, "(equal? (vector (vector 1) \"s\") (vector (vector 1) \"s\"))");
+    EXPECT_NUMBER(vm, "(vector-length (make-vector 0 0))", 0);
+    EXPECT_TRUE(vm, "(and (vector? v) (not (vector? '(1))))");
+
+    // Every element of make-vector is the fill value
+    EXPECT_TRUE(vm, "(define w (make-vector 100 7))"
+                    "(do ((i 0 (+ i 1)) (ok #t (and ok (= (vector-ref w i) 7)))) ((= i 100) ok))");
+}
+
+static void test_as_values(SchemeVM* vm) {
+    EXPECT_TRUE(vm, "(equal? (map vector-ref (list (vector 1 2) (vector 3 4)) '(1 0)) '(2 3))");
+    EXPECT_NUMBER(vm, "(apply vector-length (list (vector 1 2 3)))", 3);
+    EXPECT_TRUE(vm, "(equal? (apply vector '(1 2)) (vector 1 2))");
+    EXPECT_TRUE(vm, "(let ((set vector-set!) (u (make-vector 1 0))) (set u 0 5) (= (vector-ref u 0) 5))");
+}
+
+static void test_errors(SchemeVM* vm) {
+    EXPECT_ERROR(vm, "(vector-ref (vector 1 2) 2)", "out of range");
+    EXPECT_ERROR(vm, "(define (at v i) (vector-ref v i)) (at (vector 1) -1)", "out of range");
+    EXPECT_ERROR(vm, "(vector-set! (vector 1) 1 0)", "out of range");
+    EXPECT_ERROR(vm, "(define (at2 v i) (vector-ref v i)) (at2 '(1) 0)", "vector");
+    EXPECT_ERROR(vm, "(vector-ref (vector 1))", "vector-ref");
+    EXPECT_NUMBER(vm, "(vector-ref (vector 4 5) 1)", 5);
+}
+
+int main(void) {
+    SchemeVM* vm = scheme_new();
+    test_opcodes();
+    test_access(vm);
+    test_as_values(vm);
+    test_errors(vm);
+    scheme_free(vm);
+    return test_summary("vector_test");
+}